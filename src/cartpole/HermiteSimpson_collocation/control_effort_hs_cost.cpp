@@ -1,6 +1,9 @@
 #include "control_effort_hs_cost.hpp"
 
 #include <cassert>
+#include <stdexcept>
+
+#include "evaluation_arena.hpp"
 
 ControlEffortHermSimpCost::ControlEffortHermSimpCost(
     const std::string &cost_name,
@@ -15,12 +18,55 @@ ControlEffortHermSimpCost::ControlEffortHermSimpCost(
     , m_dt_segment{dt_segment}
 {}
 
+ControlEffortHermSimpCost::ControlEffortHermSimpCost(
+    const std::string &cost_name,
+    const std::string &ctrl_vars_name,
+    const std::string &ctrl_vars_mid_name,
+    const int ctrl_len,
+    const std::string &duration_vars_name)
+    : CostTerm(cost_name)
+    , m_ctrl_vars_name{ctrl_vars_name}
+    , m_ctrl_vars_mid_name{ctrl_vars_mid_name}
+    , m_ctrl_len{ctrl_len}
+    , m_dt_segment{}
+    , m_duration_vars_name{duration_vars_name}
+{}
+
+void ControlEffortHermSimpCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    m_ctrl_vars = x_init->GetComponent<TrajectoryVariables>(m_ctrl_vars_name);
+    m_ctrl_mid_vars
+        = x_init->GetComponent<TrajectoryVariables>(m_ctrl_vars_mid_name);
+    if (!m_ctrl_vars || !m_ctrl_mid_vars) {
+        throw std::invalid_argument(
+            "ControlEffortHermSimpCost. No trajectory variables named "
+            + m_ctrl_vars_name + " or " + m_ctrl_vars_mid_name);
+    }
+    if (!m_duration_vars_name.empty()) {
+        m_duration_var
+            = x_init->GetComponent<DurationVariable>(m_duration_vars_name);
+        if (!m_duration_var) {
+            throw std::invalid_argument(
+                "ControlEffortHermSimpCost. No duration variable named "
+                + m_duration_vars_name);
+        }
+    }
+}
+
+double ControlEffortHermSimpCost::getSegmentDuration() const
+{
+    if (m_duration_var) {
+        const int num_segments = m_ctrl_mid_vars->GetRows() / m_ctrl_len;
+        return m_duration_var->getSegmentDuration(num_segments);
+    }
+    return m_dt_segment;
+}
+
 double ControlEffortHermSimpCost::GetCost() const
 {
-    const Eigen::VectorXd ctrl_vars
-        = GetVariables()->GetComponent(m_ctrl_vars_name)->GetValues();
-    const Eigen::VectorXd ctrl_mid_vars
-        = GetVariables()->GetComponent(m_ctrl_vars_mid_name)->GetValues();
+    const Eigen::VectorXd &ctrl_vars = m_ctrl_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_mid_vars = m_ctrl_mid_vars->getValuesRef();
     assert(ctrl_vars.size() % m_ctrl_len == 0);
     assert(ctrl_mid_vars.size() % m_ctrl_len == 0);
     const int num_knots = ctrl_vars.size() / m_ctrl_len;
@@ -32,6 +78,7 @@ double ControlEffortHermSimpCost::GetCost() const
     // simpson quadrature over each segment
     // J = sum_k (dt/6) * (||u_k||^2 + 4||u_c,k||^2 + ||u_{k+1}||^2)
     // u_k and u_{k+1} are knot controls and u_c,k is the midpoint control
+    const double dt_segment = getSegmentDuration();
     double cost{0.0};
 
     for (int k = 0; k < num_segments; ++k) {
@@ -40,7 +87,7 @@ double ControlEffortHermSimpCost::GetCost() const
         const auto uk1
             = ctrl_vars(Eigen::seqN((k + 1) * m_ctrl_len, m_ctrl_len));
 
-        cost += (m_dt_segment / 6.0)
+        cost += (dt_segment / 6.0)
                 * (uk.squaredNorm() + 4.0 * uc.squaredNorm()
                    + uk1.squaredNorm());
     }
@@ -52,13 +99,17 @@ void ControlEffortHermSimpCost::FillJacobianBlock(
     ifopt::Component::Jacobian &jac) const
 {
     if (var_set == m_ctrl_vars_name) {
-        const Eigen::VectorXd ctrl_vars
-            = GetVariables()->GetComponent(m_ctrl_vars_name)->GetValues();
+        const Eigen::VectorXd &ctrl_vars = m_ctrl_vars->getValuesRef();
         assert(ctrl_vars.size() % m_ctrl_len == 0);
 
         const int num_knots = ctrl_vars.size() / m_ctrl_len;
         const int num_segments = num_knots - 1;
-        Eigen::VectorXd grad = Eigen::VectorXd::Zero(ctrl_vars.size());
+        EvaluationArena &arena = m_ctrl_vars->getArena();
+        const EvaluationArena::Frame frame(arena);
+        Eigen::Map<Eigen::VectorXd> grad
+            = arena.allocateVector(ctrl_vars.size());
+        grad.setZero();
+        const double dt_segment = getSegmentDuration();
 
         // for one HermiteSimpsn segment
         // J_k = (dt/6) * (||u_k||^2 + 4||u_c,k||^2 + ||u_{k+1}||^2)
@@ -70,38 +121,39 @@ void ControlEffortHermSimpCost::FillJacobianBlock(
                 = ctrl_vars(Eigen::seqN((k + 1) * m_ctrl_len, m_ctrl_len));
 
             grad(Eigen::seqN(k * m_ctrl_len, m_ctrl_len))
-                += (m_dt_segment / 3.0) * uk;
+                += (dt_segment / 3.0) * uk;
             grad(Eigen::seqN((k + 1) * m_ctrl_len, m_ctrl_len))
-                += (m_dt_segment / 3.0) * uk1;
+                += (dt_segment / 3.0) * uk1;
         }
 
-        std::vector<Eigen::Triplet<double>> triplets;
-        triplets.reserve(ctrl_vars.size());
+        TripletList triplets
+            = arena.makeVector<Eigen::Triplet<double>>(ctrl_vars.size());
 
         for (int i = 0; i < grad.size(); ++i) {
             triplets.push_back({0, i, grad(i)});
         }
 
-        jac.setFromTriplets(triplets.cbegin(), triplets.cend());
+        m_ctrl_jac_filler.fill(triplets, jac);
     }
 
     else if (var_set == m_ctrl_vars_mid_name) {
-        const Eigen::VectorXd ctrl_mid_vars
-            = GetVariables()->GetComponent(m_ctrl_vars_mid_name)->GetValues();
-        const Eigen::VectorXd ctrl_vars
-            = GetVariables()->GetComponent(m_ctrl_vars_name)->GetValues();
+        const Eigen::VectorXd &ctrl_mid_vars = m_ctrl_mid_vars->getValuesRef();
+        const Eigen::VectorXd &ctrl_vars = m_ctrl_vars->getValuesRef();
         assert(ctrl_vars.size() % m_ctrl_len == 0);
         assert(ctrl_mid_vars.size() % m_ctrl_len == 0);
         assert((ctrl_vars.size() / m_ctrl_len)
                == (ctrl_mid_vars.size() / m_ctrl_len) + 1);
 
         const int num_mid = ctrl_mid_vars.size() / m_ctrl_len;
+        const double dt_segment = getSegmentDuration();
 
         // for one HermiteSimpson segment
         // J_k = (dt/6) * (||u_k||^2 + 4||u_c,k||^2 + ||u_{k+1}||^2)
         // dJ_k/du_c,k = (dt/6) * 8*u_c,k = (4*dt/3) * u_c,k
-        std::vector<Eigen::Triplet<double>> triplets;
-        triplets.reserve(ctrl_mid_vars.size());
+        EvaluationArena &arena = m_ctrl_mid_vars->getArena();
+        const EvaluationArena::Frame frame(arena);
+        TripletList triplets
+            = arena.makeVector<Eigen::Triplet<double>>(ctrl_mid_vars.size());
 
         for (int k = 0; k < num_mid; ++k) {
             const auto uc
@@ -110,10 +162,13 @@ void ControlEffortHermSimpCost::FillJacobianBlock(
             for (int j = 0; j < m_ctrl_len; ++j) {
                 triplets.push_back({0,
                                     k * m_ctrl_len + j,
-                                    (4.0 * m_dt_segment / 3.0) * uc(j)});
+                                    (4.0 * dt_segment / 3.0) * uc(j)});
             }
         }
 
-        jac.setFromTriplets(triplets.cbegin(), triplets.cend());
+        m_ctrl_mid_jac_filler.fill(triplets, jac);
+    } else if (m_duration_var && (var_set == m_duration_vars_name)) {
+        // The cost is proportional to the duration, so dJ/dT = J/T.
+        jac.coeffRef(0, 0) = GetCost() / m_duration_var->getDuration();
     }
 }
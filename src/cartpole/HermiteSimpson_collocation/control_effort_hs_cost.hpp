@@ -1,7 +1,13 @@
 #pragma once
 
+#include <memory>
+
 #include <ifopt/cost_term.h>
 
+#include "duration_variable.hpp"
+#include "jacobian_filler.hpp"
+#include "trajectory_variables.hpp"
+
 class ControlEffortHermSimpCost : public ifopt::CostTerm
 {
 public:
@@ -11,14 +17,38 @@ public:
                               const int ctrl_len,
                               const double dt_segment);
 
+    // Same as above, but the duration of the trajectory is the optimization
+    // variable named duration_vars_name (see DurationVariable).
+    ControlEffortHermSimpCost(const std::string &cost_name,
+                              const std::string &ctrl_vars_name,
+                              const std::string &ctrl_vars_mid_name,
+                              const int ctrl_len,
+                              const std::string &duration_vars_name);
+
     double GetCost() const override;
 
     void FillJacobianBlock(std::string var_set,
                            ifopt::Component::Jacobian &jac) const override;
 
 private:
+    // Resolve the control variables by name once, when the cost is added to
+    // the problem.
+    void InitVariableDependedQuantities(const VariablesPtr &x_init) override;
+
+    // Duration of each segment, which is fixed or derived from the duration
+    // variable.
+    double getSegmentDuration() const;
+
     const std::string m_ctrl_vars_name;
     const std::string m_ctrl_vars_mid_name;
     const int m_ctrl_len;
     const double m_dt_segment;
+    // empty if the duration is fixed
+    const std::string m_duration_vars_name;
+    std::shared_ptr<TrajectoryVariables> m_ctrl_vars;
+    std::shared_ptr<TrajectoryVariables> m_ctrl_mid_vars;
+    std::shared_ptr<DurationVariable> m_duration_var;
+    // the gradients are updated in place after the first evaluation
+    mutable JacobianFiller m_ctrl_jac_filler;
+    mutable JacobianFiller m_ctrl_mid_jac_filler;
 };
@@ -1,27 +1,91 @@
 #include "hermite_simpson_collocation_constraints.hpp"
 
-#include <iostream>
+#include <cassert>
+#include <utility>
 
-std::vector<Eigen::Triplet<double>> sparseMatrixToTriplets(
-    const ifopt::Component::Jacobian &mat,
-    const int row_start,
-    const int col_start)
+#include "evaluation_arena.hpp"
+
+namespace
 {
-    std::vector<Eigen::Triplet<double>> triplets;
-    // Reserve space to avoid reallocations, the number of non-zeros is a good
-    // estimate
-    triplets.reserve(mat.nonZeros());
-
-    for (int i = 0; i < mat.outerSize(); ++i) {
-        // Iterate over all non-zero elements in the current outer dimension
-        // (column or row, depending on storage order)
-        for (ifopt::Component::Jacobian::InnerIterator it(mat, i); it; ++it) {
-            triplets.emplace_back(it.row() + row_start,
-                                  it.col() + col_start,
-                                  it.value());
+    // Evaluate the dynamics for each column of the state and control matrices,
+    // where column k belongs to time t0 + k*dt, into the columns of
+    // dyn_values. The inputs of each time point are copied into the buffers.
+    void evalDynamics(const FunctionDynamics &dynamics,
+                      const Eigen::Map<const Eigen::MatrixXd> &states,
+                      const Eigen::Map<const Eigen::MatrixXd> &controls,
+                      const double t0,
+                      const double dt,
+                      Eigen::VectorXd &state_buf,
+                      Eigen::VectorXd &control_buf,
+                      Eigen::MatrixXd &dyn_values)
+    {
+        assert(states.cols() == controls.cols());
+        assert(dyn_values.cols() == states.cols());
+        for (int k{}; k < states.cols(); ++k) {
+            state_buf = states.col(k);
+            control_buf = controls.col(k);
+            dynamics.eval(
+                state_buf, control_buf, t0 + k * dt, dyn_values.col(k));
+        }
+    }
+
+    // Same as evalDynamics(), but for the jacobians of the dynamics w.r.t the
+    // state and w.r.t the control, one per column.
+    void evalDynJacobians(
+        const FunctionDynamics &dynamics,
+        const Eigen::Map<const Eigen::MatrixXd> &states,
+        const Eigen::Map<const Eigen::MatrixXd> &controls,
+        const double t0,
+        const double dt,
+        Eigen::VectorXd &state_buf,
+        Eigen::VectorXd &control_buf,
+        std::vector<ifopt::Component::Jacobian> &jacs_wrt_state,
+        std::vector<ifopt::Component::Jacobian> &jacs_wrt_control)
+    {
+        assert(states.cols() == controls.cols());
+        assert(static_cast<int>(jacs_wrt_state.size()) == states.cols());
+        for (int k{}; k < states.cols(); ++k) {
+            state_buf = states.col(k);
+            control_buf = controls.col(k);
+            dynamics.jacobians(state_buf,
+                               control_buf,
+                               t0 + k * dt,
+                               jacs_wrt_state[k],
+                               jacs_wrt_control[k]);
+        }
+    }
+
+    // Append the triplets of scale*mat, with the row and column indices
+    // offset by row_start and col_start, so mat is a submatrix of a larger
+    // jacobian.
+    void appendScaledTriplets(const ifopt::Component::Jacobian &mat,
+                              const double scale,
+                              const int row_start,
+                              const int col_start,
+                              TripletList &triplets)
+    {
+        for (int i{}; i < mat.outerSize(); ++i) {
+            for (ifopt::Component::Jacobian::InnerIterator it(mat, i); it;
+                 ++it) {
+                triplets.emplace_back(row_start + it.row(),
+                                      col_start + it.col(),
+                                      scale * it.value());
+            }
+        }
+    }
+
+    // Append the triplets of value*I, for an identity matrix of size len
+    // offset by row_start and col_start.
+    void appendIdentityTriplets(const int len,
+                                const double value,
+                                const int row_start,
+                                const int col_start,
+                                TripletList &triplets)
+    {
+        for (int i{}; i < len; ++i) {
+            triplets.emplace_back(row_start + i, col_start + i, value);
         }
     }
-    return triplets;
 }
 
 HermiteMidpointConstraints::HermiteMidpointConstraints(
@@ -33,9 +97,7 @@ HermiteMidpointConstraints::HermiteMidpointConstraints(
     const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
     const int control_len,
     const double dt_segment,
-    const DynFn &dyn_fn,
-    const JacobianDynFn &jac_dyn_wrt_state_fn,
-    const JacobianDynFn &jac_dyn_wrt_control_fn)
+    FunctionDynamics dynamics)
     : ConstraintSet(num_constraints, "Hermite_midpoint_constraints")
     , m_state_vars{state_vars}
     , m_state_len{state_len}
@@ -44,74 +106,160 @@ HermiteMidpointConstraints::HermiteMidpointConstraints(
     , m_state_mid_vars{state_mid_vars}
     , m_ctrl_mid_vars{ctrl_mid_vars}
     , m_dt_segment{dt_segment}
-    , m_dyn_fn{dyn_fn}
-    , m_jac_dyn_wrt_state_fn{jac_dyn_wrt_state_fn}
-    , m_jac_dyn_wrt_control_fn{jac_dyn_wrt_control_fn}
+    , m_state_vars_name{state_vars->GetName()}
+    , m_ctrl_vars_name{ctrl_vars->GetName()}
+    , m_state_mid_vars_name{state_mid_vars->GetName()}
+    , m_ctrl_mid_vars_name{ctrl_mid_vars->GetName()}
+    , m_dynamics{std::move(dynamics)}
 {
     assert(num_constraints % m_state_len == 0);
     m_num_segments = num_constraints / m_state_len;
+
+    const int num_knot_pts = m_num_segments + 1;
+    m_dyn_values.resize(m_state_len, num_knot_pts);
+    m_state_buf.resize(m_state_len);
+    m_control_buf.resize(m_control_len);
+    m_jac_dyn_wrt_state.resize(num_knot_pts);
+    m_jac_dyn_wrt_control.resize(num_knot_pts);
+    m_dyn_state_values.resize(m_state_vars->getValuesRef().size());
+    m_dyn_ctrl_values.resize(m_ctrl_vars->getValuesRef().size());
+    m_jac_state_values.resize(m_state_vars->getValuesRef().size());
+    m_jac_ctrl_values.resize(m_ctrl_vars->getValuesRef().size());
 }
 
-Eigen::VectorXd HermiteMidpointConstraints::GetValues() const
+HermiteMidpointConstraints::HermiteMidpointConstraints(
+    const int num_constraints,
+    const std::shared_ptr<TrajectoryVariables> &state_vars,
+    const int state_len,
+    const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+    const std::shared_ptr<TrajectoryVariables> &state_mid_vars,
+    const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
+    const int control_len,
+    const std::shared_ptr<DurationVariable> &duration_var,
+    FunctionDynamics dynamics)
+    : HermiteMidpointConstraints(
+          num_constraints,
+          state_vars,
+          state_len,
+          ctrl_vars,
+          state_mid_vars,
+          ctrl_mid_vars,
+          control_len,
+          duration_var->getSegmentDuration(num_constraints / state_len),
+          std::move(dynamics))
+{
+    m_duration_var = duration_var;
+    m_duration_var_name = duration_var->GetName();
+}
+
+double HermiteMidpointConstraints::getSegmentDuration() const
 {
-    const Eigen::VectorXd state_vars = m_state_vars->GetValues();
-    const Eigen::VectorXd control_vars = m_ctrl_vars->GetValues();
-    const Eigen::VectorXd state_mid_vars = m_state_mid_vars->GetValues();
-    const Eigen::VectorXd control_mid_vars = m_ctrl_mid_vars->GetValues();
-
-    assert(state_vars.size() % m_state_len == 0);
-    assert(control_vars.size() % m_control_len == 0);
-    assert(state_mid_vars.size() % m_state_len == 0);
-    assert(control_mid_vars.size() % m_control_len == 0);
-    assert(control_vars.size() / m_control_len
-           == state_vars.size() / m_state_len);
-    assert(state_mid_vars.size() / m_state_len == m_num_segments);
-    assert(control_mid_vars.size() / m_control_len == m_num_segments);
-
-    Eigen::VectorXd constraint_values = Eigen::VectorXd::Zero(GetRows());
-    const double h = m_dt_segment;
+    if (m_duration_var) {
+        return m_duration_var->getSegmentDuration(m_num_segments);
+    }
+    return m_dt_segment;
+}
 
-    for (int k{}; k < m_num_segments; ++k) {
-        const auto xk = state_vars(Eigen::seqN(k * m_state_len, m_state_len));
-        const auto uk
-            = control_vars(Eigen::seqN(k * m_control_len, m_control_len));
-        const double tk = k * m_dt_segment;
-        const Eigen::VectorXd fk = m_dyn_fn(xk, uk, tk);
-        assert(fk.size() == m_state_len);
-
-        const auto xk1
-            = state_vars(Eigen::seqN((k + 1) * m_state_len, m_state_len));
-        const auto uk1
-            = control_vars(Eigen::seqN((k + 1) * m_control_len, m_control_len));
-        const double tk1 = (k + 1) * m_dt_segment;
-        const Eigen::VectorXd fk1 = m_dyn_fn(xk1, uk1, tk1);
-        assert(fk1.size() == m_state_len);
-
-        const auto xc
-            = state_mid_vars(Eigen::seqN(k * m_state_len, m_state_len));
-
-        const Eigen::VectorXd c_mid
-            = xc - 0.5 * (xk + xk1) - (h / 8.0) * (fk - fk1);
-
-        const int row = k * m_state_len;
-        constraint_values(Eigen::seqN(row, m_state_len)) = c_mid;
+void HermiteMidpointConstraints::updateDynValues() const
+{
+    // The constraints depend on the dynamics at the knot points only.
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_vec = m_ctrl_vars->getValuesRef();
+    const double h = getSegmentDuration();
+    if (m_has_dyn_values && (state_vec == m_dyn_state_values)
+        && (ctrl_vec == m_dyn_ctrl_values) && (h == m_dyn_segment_duration)) {
+        return;
     }
 
+    // F = [f_0, f_1, ..., f_N]
+    evalDynamics(m_dynamics,
+                 m_state_vars->getValuesMatrix(m_state_len),
+                 m_ctrl_vars->getValuesMatrix(m_control_len),
+                 0.0,
+                 h,
+                 m_state_buf,
+                 m_control_buf,
+                 m_dyn_values);
+    m_dyn_state_values = state_vec;
+    m_dyn_ctrl_values = ctrl_vec;
+    m_dyn_segment_duration = h;
+    m_has_dyn_values = true;
+}
+
+void HermiteMidpointConstraints::updateDynJacobians() const
+{
+    // The constraints depend on the dynamics at the knot points only.
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_vec = m_ctrl_vars->getValuesRef();
+    const double h = getSegmentDuration();
+    if (m_has_dyn_jacobians && (state_vec == m_jac_state_values)
+        && (ctrl_vec == m_jac_ctrl_values) && (h == m_jac_segment_duration)) {
+        return;
+    }
+
+    evalDynJacobians(m_dynamics,
+                     m_state_vars->getValuesMatrix(m_state_len),
+                     m_ctrl_vars->getValuesMatrix(m_control_len),
+                     0.0,
+                     h,
+                     m_state_buf,
+                     m_control_buf,
+                     m_jac_dyn_wrt_state,
+                     m_jac_dyn_wrt_control);
+    m_jac_state_values = state_vec;
+    m_jac_ctrl_values = ctrl_vec;
+    m_jac_segment_duration = h;
+    m_has_dyn_jacobians = true;
+}
+
+Eigen::VectorXd HermiteMidpointConstraints::GetValues() const
+{
+    Eigen::VectorXd constraint_values(GetRows());
+    fillValues(constraint_values);
     return constraint_values;
 }
 
+void HermiteMidpointConstraints::fillValues(
+    Eigen::Ref<Eigen::VectorXd> values) const
+{
+    assert(values.size() == GetRows());
+    // views with one vector per column, (len x (N+1)) for the knot points
+    // and (len x N) for the midpoints
+    const Eigen::Map<const Eigen::MatrixXd> states
+        = m_state_vars->getValuesMatrix(m_state_len);
+    const Eigen::Map<const Eigen::MatrixXd> states_mid
+        = m_state_mid_vars->getValuesMatrix(m_state_len);
+    const int N = m_num_segments;
+    assert(states.cols() == N + 1);
+    assert(states_mid.cols() == N);
+
+    // dynamics stage: F = [f_0, f_1, ..., f_N]
+    updateDynValues();
+
+    // Column k of the constraint matrix is
+    // x_c,k - 0.5 (x_k + x_(k+1)) - (h/8) (f_k - f_(k+1)), stored in the
+    // stacked layout of the output vector.
+    const double h = getSegmentDuration();
+    Eigen::Map<Eigen::MatrixXd> c_mid(values.data(), m_state_len, N);
+    c_mid.noalias()
+        = states_mid - 0.5 * (states.leftCols(N) + states.rightCols(N))
+          - (h / 8.0) * (m_dyn_values.leftCols(N) - m_dyn_values.rightCols(N));
+}
+
 void HermiteMidpointConstraints::FillJacobianBlock(
     std::string var_set,
     ifopt::Component::Jacobian &jac_block) const
 {
-    if (var_set == m_state_vars->GetName()) {
+    if (var_set == m_state_vars_name) {
         FillJacobianWrt(VariableType::STATE, jac_block);
-    } else if (var_set == m_ctrl_vars->GetName()) {
+    } else if (var_set == m_ctrl_vars_name) {
         FillJacobianWrt(VariableType::CONTROL, jac_block);
-    } else if (var_set == m_state_mid_vars->GetName()) {
+    } else if (var_set == m_state_mid_vars_name) {
         FillJacobianWrt(VariableType::STATE_MID, jac_block);
-    } else if (var_set == m_ctrl_mid_vars->GetName()) {
+    } else if (var_set == m_ctrl_mid_vars_name) {
         FillJacobianWrt(VariableType::CONTROL_MID, jac_block);
+    } else if (m_duration_var && (var_set == m_duration_var_name)) {
+        FillJacobianWrtDuration(jac_block);
     }
 }
 
@@ -134,23 +282,24 @@ void HermiteMidpointConstraints::FillJacobianWrt(
     const VariableType var_type,
     ifopt::Component::Jacobian &jac_block) const
 {
-    const Eigen::VectorXd state_vars = m_state_vars->GetValues();
-    const Eigen::VectorXd control_vars = m_ctrl_vars->GetValues();
-
-    const Eigen::VectorXd state_mid_vars = m_state_mid_vars->GetValues();
-    const Eigen::VectorXd control_mid_vars = m_ctrl_mid_vars->GetValues();
-
-    const double h
-        = m_dt_segment;  // will probably just rename m_dt_segment later
+    const bool is_mid = (var_type == VariableType::STATE_MID
+                         || var_type == VariableType::CONTROL_MID);
+    if (!is_mid) {
+        updateDynJacobians();
+    }
 
     // use list of triplets to simplify and avoid costly random
     // insertions when constructing the final sparse jacobian matrix.
-    std::vector<Eigen::Triplet<double>> triplet_list;
+    EvaluationArena &arena = m_state_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
     const int var_type_len = getVarTypeLen(var_type);
     const int num_nonzero_submatrices = 2;
     const int num_defect_vec_eqns = m_num_segments;
-    triplet_list.reserve(m_state_len * var_type_len * num_nonzero_submatrices
-                         * num_defect_vec_eqns);
+    // the jacobians of the dynamics are dense in the worst case, and the
+    // state blocks add an identity matrix
+    TripletList triplets = arena.makeVector<Eigen::Triplet<double>>(
+        m_state_len * (var_type_len + 1) * num_nonzero_submatrices
+        * num_defect_vec_eqns);
 
     // k indexes a trajectory segment,
     // j indexes the variable block whose contribution is being inserted into
@@ -164,159 +313,113 @@ void HermiteMidpointConstraints::FillJacobianWrt(
     //
     // this is why j_max is k + 2 for knot variables and k + 1 for midpoint
     // variables.
-    const size_t k_max = static_cast<size_t>(m_num_segments);
-
-    for (size_t k{}; k < k_max; ++k) {
-        const bool is_mid = (var_type == VariableType::STATE_MID
-                             || var_type == VariableType::CONTROL_MID);
-
-        // midpoint variable sets have one block per segment so only j = k is
-        // vald.
-        // knot variable sets have two neighboring blocks for
-        // segment k, j = k an j = k + 1.
-        const size_t j_max = is_mid ? (k + 1) : (k + 2);
-
-        for (size_t j = k; j < j_max; ++j) {
-            // j is used here instead of k because the loop bounds above
-            // guarantee that j already refers to the correct variable block
-            //
-            // midpoint  j = k is usd. 
-            //
-            // knot j = k and j = k + 1 are used.
-            auto statej
-                = is_mid
-                      ? state_mid_vars(
-                            Eigen::seqN(j * m_state_len, m_state_len))
-                      : state_vars(Eigen::seqN(j * m_state_len, m_state_len));
-            auto controlj
-                = is_mid ? control_mid_vars(
-                               Eigen::seqN(j * m_control_len, m_control_len))
-                         : control_vars(
-                               Eigen::seqN(j * m_control_len, m_control_len));
-
-            const double tj = is_mid ? ((static_cast<double>(j) + 0.5) * h)
-                                     : (m_dt_segment * j);
-
-            // segment k has rows starting at k * m_state_len
-            const int row_start = static_cast<int>(k) * m_state_len;
-
-            // variable block j has columns starting at j * var_type_len
-            const int col_start = static_cast<int>(j) * var_type_len;
-
-            ifopt::Component::Jacobian jac_constraints_wrt_var
-                = jacConstraintsWrtVar(var_type, k, j, statej, controlj, tj);
-
-            auto sub_triplets = sparseMatrixToTriplets(jac_constraints_wrt_var,
-                                                       row_start,
-                                                       col_start);
-            triplet_list.insert(triplet_list.cend(),
-                                sub_triplets.cbegin(),
-                                sub_triplets.cend());
+    for (int k{}; k < m_num_segments; ++k) {
+        const int j_max = is_mid ? (k + 1) : (k + 2);
+        for (int j = k; j < j_max; ++j) {
+            jacConstraintsWrtVar(var_type, k, j, triplets);
         }
     }
 
-    jac_block.setFromTriplets(triplet_list.cbegin(), triplet_list.cend());
+    m_jac_fillers[static_cast<int>(var_type)].fill(triplets, jac_block);
 }
 
-ifopt::Component::Jacobian HermiteMidpointConstraints::jacConstraintsWrtVar(
+void HermiteMidpointConstraints::jacConstraintsWrtVar(
     const VariableType var_type,
-    const size_t k,
-    const size_t j,
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double time) const
+    const int k,
+    const int j,
+    TripletList &triplets) const
 {
     switch (var_type) {
         case VariableType::STATE:
-            return jacConstraintsWrtState(k, j, state, control, time);
+            jacConstraintsWrtState(k, j, triplets);
+            return;
 
         case VariableType::CONTROL:
-            return jacConstraintsWrtControl(k, j, state, control, time);
-
-        case VariableType::STATE_MID: {
-            if (j != k) {
-                ifopt::Component::Jacobian Z(m_state_len, m_state_len);
-                Z.setZero();
-                return Z;
-            }
+            jacConstraintsWrtControl(k, j, triplets);
+            return;
 
-            ifopt::Component::Jacobian I(m_state_len, m_state_len);
-            I.setIdentity();
-            return I;
-        }
-
-        case VariableType::CONTROL_MID: {
-            if (j != k) {
-                ifopt::Component::Jacobian Z(m_state_len, m_control_len);
-                Z.setZero();
-                return Z;
+        case VariableType::STATE_MID:
+            // dc_k/dx_c,k = I
+            if (j == k) {
+                appendIdentityTriplets(m_state_len,
+                                       1.0,
+                                       k * m_state_len,
+                                       j * m_state_len,
+                                       triplets);
             }
+            return;
 
-            ifopt::Component::Jacobian Z(m_state_len, m_control_len);
-            Z.setZero();
-            return Z;
-        }
+        case VariableType::CONTROL_MID:
+            // the constraints do not depend on the midpoint controls
+            return;
     }
-
     assert(false);
-    ifopt::Component::Jacobian Z(m_state_len, m_state_len);
-    Z.setZero();
-    return Z;
 }
 
-ifopt::Component::Jacobian HermiteMidpointConstraints::jacConstraintsWrtState(
-    const size_t k,
-    const size_t j,
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double time) const
+void HermiteMidpointConstraints::jacConstraintsWrtState(
+    const int k,
+    const int j,
+    TripletList &triplets) const
 {
-    const double h = m_dt_segment;
-
     if (!(j == k || j == k + 1)) {
-        ifopt::Component::Jacobian Z(m_state_len, m_state_len);
-        Z.setZero();
-        return Z;
+        return;
     }
 
+    // dc_k/dx_j = -0.5 I + s_mid (h/8) df_j/dx_j
+    const double h = getSegmentDuration();
     const bool left = (j == k);
-    ifopt::Component::Jacobian dfj_dxj
-        = m_jac_dyn_wrt_state_fn(state, control, time);
-
-    ifopt::Component::Jacobian I(m_state_len, m_state_len);
-    I.setIdentity();
-
     const double s_mid = left ? -1.0 : +1.0;
-
-    ifopt::Component::Jacobian dcm_dx
-        = (-0.5) * I + (s_mid * (h / 8.0)) * dfj_dxj;
-
-    return dcm_dx;
+    const int row_start = k * m_state_len;
+    const int col_start = j * m_state_len;
+    appendIdentityTriplets(m_state_len, -0.5, row_start, col_start, triplets);
+    appendScaledTriplets(m_jac_dyn_wrt_state[j],
+                         s_mid * (h / 8.0),
+                         row_start,
+                         col_start,
+                         triplets);
 }
 
-ifopt::Component::Jacobian HermiteMidpointConstraints::jacConstraintsWrtControl(
-    const size_t k,
-    const size_t j,
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double time) const
+void HermiteMidpointConstraints::jacConstraintsWrtControl(
+    const int k,
+    const int j,
+    TripletList &triplets) const
 {
-    const double h = m_dt_segment;
-
     if (!(j == k || j == k + 1)) {
-        ifopt::Component::Jacobian Z(m_state_len, m_control_len);
-        Z.setZero();
-        return Z;
+        return;
     }
 
+    // dc_k/du_j = s_mid (h/8) df_j/du_j
+    const double h = getSegmentDuration();
     const bool left = (j == k);
-    ifopt::Component::Jacobian B
-        = m_jac_dyn_wrt_control_fn(state, control, time);
-
     const double s_mid = left ? -1.0 : +1.0;
+    appendScaledTriplets(m_jac_dyn_wrt_control[j],
+                         s_mid * (h / 8.0),
+                         k * m_state_len,
+                         j * m_control_len,
+                         triplets);
+}
 
-    ifopt::Component::Jacobian dcm_du = (s_mid * (h / 8.0)) * B;
-    return dcm_du;
+void HermiteMidpointConstraints::FillJacobianWrtDuration(
+    ifopt::Component::Jacobian &jac_block) const
+{
+    // With h = T/N the derivative of constraint k w.r.t the duration T is
+    // dc_k/dT = -1/(8N)*(f_k - f_(k+1)). The dynamics values are usually
+    // cached from the evaluation of the constraint values.
+    updateDynValues();
+    const int N = m_num_segments;
+
+    // The column of the jacobian is dense, one entry per constraint.
+    EvaluationArena &arena = m_state_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
+    TripletList triplets = arena.makeVector<Eigen::Triplet<double>>(GetRows());
+    for (int k{}; k < N; ++k) {
+        for (int i{}; i < m_state_len; ++i) {
+            const double dck_dT
+                = -(m_dyn_values(i, k) - m_dyn_values(i, k + 1)) / (8.0 * N);
+            triplets.emplace_back(k * m_state_len + i, 0, dck_dT);
+        }
+    }
+    m_duration_jac_filler.fill(triplets, jac_block);
 }
 
 /////////////////////////////////////////////////////////////
@@ -332,9 +435,7 @@ SimpsonDefectConstraints::SimpsonDefectConstraints(
     const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
     const int control_len,
     const double dt_segment,
-    const DynFn &dyn_fn,
-    const JacobianDynFn &jac_dyn_wrt_state_fn,
-    const JacobianDynFn &jac_dyn_wrt_control_fn)
+    FunctionDynamics dynamics)
     : ConstraintSet(num_constraints, "simpson_defect_constraints")
     , m_state_vars{state_vars}
     , m_state_len{state_len}
@@ -343,78 +444,195 @@ SimpsonDefectConstraints::SimpsonDefectConstraints(
     , m_state_mid_vars{state_mid_vars}
     , m_ctrl_mid_vars{ctrl_mid_vars}
     , m_dt_segment{dt_segment}
-    , m_dyn_fn{dyn_fn}
-    , m_jac_dyn_wrt_state_fn{jac_dyn_wrt_state_fn}
-    , m_jac_dyn_wrt_control_fn{jac_dyn_wrt_control_fn}
+    , m_state_vars_name{state_vars->GetName()}
+    , m_ctrl_vars_name{ctrl_vars->GetName()}
+    , m_state_mid_vars_name{state_mid_vars->GetName()}
+    , m_ctrl_mid_vars_name{ctrl_mid_vars->GetName()}
+    , m_dynamics{std::move(dynamics)}
 {
     assert(num_constraints % m_state_len == 0);
     m_num_segments = num_constraints / m_state_len;
+
+    const int num_knot_pts = m_num_segments + 1;
+    m_dyn_values.resize(m_state_len, num_knot_pts);
+    m_dyn_mid_values.resize(m_state_len, m_num_segments);
+    m_state_buf.resize(m_state_len);
+    m_control_buf.resize(m_control_len);
+    m_jac_dyn_wrt_state.resize(num_knot_pts);
+    m_jac_dyn_wrt_control.resize(num_knot_pts);
+    m_jac_dyn_mid_wrt_state.resize(m_num_segments);
+    m_jac_dyn_mid_wrt_control.resize(m_num_segments);
+    m_dyn_state_values.resize(m_state_vars->getValuesRef().size());
+    m_dyn_ctrl_values.resize(m_ctrl_vars->getValuesRef().size());
+    m_dyn_state_mid_values.resize(m_state_mid_vars->getValuesRef().size());
+    m_dyn_ctrl_mid_values.resize(m_ctrl_mid_vars->getValuesRef().size());
+    m_jac_state_values.resize(m_state_vars->getValuesRef().size());
+    m_jac_ctrl_values.resize(m_ctrl_vars->getValuesRef().size());
+    m_jac_state_mid_values.resize(m_state_mid_vars->getValuesRef().size());
+    m_jac_ctrl_mid_values.resize(m_ctrl_mid_vars->getValuesRef().size());
 }
 
-Eigen::VectorXd SimpsonDefectConstraints::GetValues() const
+SimpsonDefectConstraints::SimpsonDefectConstraints(
+    const int num_constraints,
+    const std::shared_ptr<TrajectoryVariables> &state_vars,
+    const int state_len,
+    const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+    const std::shared_ptr<TrajectoryVariables> &state_mid_vars,
+    const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
+    const int control_len,
+    const std::shared_ptr<DurationVariable> &duration_var,
+    FunctionDynamics dynamics)
+    : SimpsonDefectConstraints(
+          num_constraints,
+          state_vars,
+          state_len,
+          ctrl_vars,
+          state_mid_vars,
+          ctrl_mid_vars,
+          control_len,
+          duration_var->getSegmentDuration(num_constraints / state_len),
+          std::move(dynamics))
 {
-    const Eigen::VectorXd state_vars = m_state_vars->GetValues();
-    const Eigen::VectorXd control_vars = m_ctrl_vars->GetValues();
-    const Eigen::VectorXd state_mid_vars = m_state_mid_vars->GetValues();
-    const Eigen::VectorXd control_mid_vars = m_ctrl_mid_vars->GetValues();
-
-    assert(state_vars.size() % m_state_len == 0);
-    assert(control_vars.size() % m_control_len == 0);
-    assert(state_mid_vars.size() % m_state_len == 0);
-    assert(control_mid_vars.size() % m_control_len == 0);
-    assert(control_vars.size() / m_control_len
-           == state_vars.size() / m_state_len);
-    assert(state_mid_vars.size() / m_state_len == m_num_segments);
-    assert(control_mid_vars.size() / m_control_len == m_num_segments);
-
-    Eigen::VectorXd constraint_values = Eigen::VectorXd::Zero(GetRows());
-    const double h = m_dt_segment;
+    m_duration_var = duration_var;
+    m_duration_var_name = duration_var->GetName();
+}
 
-    for (int k{}; k < m_num_segments; ++k) {
-        const auto xk = state_vars(Eigen::seqN(k * m_state_len, m_state_len));
-        const auto uk
-            = control_vars(Eigen::seqN(k * m_control_len, m_control_len));
-        const double tk = k * m_dt_segment;
-        const Eigen::VectorXd fk = m_dyn_fn(xk, uk, tk);
-        assert(fk.size() == m_state_len);
-
-        const auto xk1
-            = state_vars(Eigen::seqN((k + 1) * m_state_len, m_state_len));
-        const auto uk1
-            = control_vars(Eigen::seqN((k + 1) * m_control_len, m_control_len));
-        const double tk1 = (k + 1) * m_dt_segment;
-        const Eigen::VectorXd fk1 = m_dyn_fn(xk1, uk1, tk1);
-        assert(fk1.size() == m_state_len);
-
-        const auto xc
-            = state_mid_vars(Eigen::seqN(k * m_state_len, m_state_len));
-        const auto uc
-            = control_mid_vars(Eigen::seqN(k * m_control_len, m_control_len));
-        const double tc = (k + 0.5) * h;
-        const Eigen::VectorXd fc = m_dyn_fn(xc, uc, tc);
-
-        const Eigen::VectorXd c_def
-            = xk1 - xk - (h / 6.0) * (fk + 4.0 * fc + fk1);
-
-        const int row = k * m_state_len;
-        constraint_values(Eigen::seqN(row, m_state_len)) = c_def;
+double SimpsonDefectConstraints::getSegmentDuration() const
+{
+    if (m_duration_var) {
+        return m_duration_var->getSegmentDuration(m_num_segments);
+    }
+    return m_dt_segment;
+}
+
+void SimpsonDefectConstraints::updateDynValues() const
+{
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_vec = m_ctrl_vars->getValuesRef();
+    const Eigen::VectorXd &state_mid_vec = m_state_mid_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_mid_vec = m_ctrl_mid_vars->getValuesRef();
+    const double h = getSegmentDuration();
+    if (m_has_dyn_values && (state_vec == m_dyn_state_values)
+        && (ctrl_vec == m_dyn_ctrl_values)
+        && (state_mid_vec == m_dyn_state_mid_values)
+        && (ctrl_mid_vec == m_dyn_ctrl_mid_values)
+        && (h == m_dyn_segment_duration)) {
+        return;
+    }
+
+    // F = [f_0, f_1, ..., f_N] at the knot points and
+    // F_c = [f_c,0, ..., f_c,(N-1)] at the midpoints
+    evalDynamics(m_dynamics,
+                 m_state_vars->getValuesMatrix(m_state_len),
+                 m_ctrl_vars->getValuesMatrix(m_control_len),
+                 0.0,
+                 h,
+                 m_state_buf,
+                 m_control_buf,
+                 m_dyn_values);
+    evalDynamics(m_dynamics,
+                 m_state_mid_vars->getValuesMatrix(m_state_len),
+                 m_ctrl_mid_vars->getValuesMatrix(m_control_len),
+                 0.5 * h,
+                 h,
+                 m_state_buf,
+                 m_control_buf,
+                 m_dyn_mid_values);
+    m_dyn_state_values = state_vec;
+    m_dyn_ctrl_values = ctrl_vec;
+    m_dyn_state_mid_values = state_mid_vec;
+    m_dyn_ctrl_mid_values = ctrl_mid_vec;
+    m_dyn_segment_duration = h;
+    m_has_dyn_values = true;
+}
+
+void SimpsonDefectConstraints::updateDynJacobians() const
+{
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_vec = m_ctrl_vars->getValuesRef();
+    const Eigen::VectorXd &state_mid_vec = m_state_mid_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_mid_vec = m_ctrl_mid_vars->getValuesRef();
+    const double h = getSegmentDuration();
+    if (m_has_dyn_jacobians && (state_vec == m_jac_state_values)
+        && (ctrl_vec == m_jac_ctrl_values)
+        && (state_mid_vec == m_jac_state_mid_values)
+        && (ctrl_mid_vec == m_jac_ctrl_mid_values)
+        && (h == m_jac_segment_duration)) {
+        return;
     }
 
+    evalDynJacobians(m_dynamics,
+                     m_state_vars->getValuesMatrix(m_state_len),
+                     m_ctrl_vars->getValuesMatrix(m_control_len),
+                     0.0,
+                     h,
+                     m_state_buf,
+                     m_control_buf,
+                     m_jac_dyn_wrt_state,
+                     m_jac_dyn_wrt_control);
+    evalDynJacobians(m_dynamics,
+                     m_state_mid_vars->getValuesMatrix(m_state_len),
+                     m_ctrl_mid_vars->getValuesMatrix(m_control_len),
+                     0.5 * h,
+                     h,
+                     m_state_buf,
+                     m_control_buf,
+                     m_jac_dyn_mid_wrt_state,
+                     m_jac_dyn_mid_wrt_control);
+    m_jac_state_values = state_vec;
+    m_jac_ctrl_values = ctrl_vec;
+    m_jac_state_mid_values = state_mid_vec;
+    m_jac_ctrl_mid_values = ctrl_mid_vec;
+    m_jac_segment_duration = h;
+    m_has_dyn_jacobians = true;
+}
+
+Eigen::VectorXd SimpsonDefectConstraints::GetValues() const
+{
+    Eigen::VectorXd constraint_values(GetRows());
+    fillValues(constraint_values);
     return constraint_values;
 }
 
+void SimpsonDefectConstraints::fillValues(
+    Eigen::Ref<Eigen::VectorXd> values) const
+{
+    assert(values.size() == GetRows());
+    // views with one vector per column, (len x (N+1)) for the knot points
+    const Eigen::Map<const Eigen::MatrixXd> states
+        = m_state_vars->getValuesMatrix(m_state_len);
+    const int N = m_num_segments;
+    assert(states.cols() == N + 1);
+
+    // dynamics stage: F = [f_0, f_1, ..., f_N] at the knot points and
+    // F_c = [f_c,0, ..., f_c,(N-1)] at the midpoints
+    updateDynValues();
+
+    // Column k of the defect matrix is
+    // x_(k+1) - x_k - (h/6) (f_k + 4 f_c,k + f_(k+1)), stored in the stacked
+    // layout of the output vector.
+    const double h = getSegmentDuration();
+    Eigen::Map<Eigen::MatrixXd> c_def(values.data(), m_state_len, N);
+    c_def.noalias() = states.rightCols(N) - states.leftCols(N)
+                      - (h / 6.0)
+                            * (m_dyn_values.leftCols(N) + 4.0 * m_dyn_mid_values
+                               + m_dyn_values.rightCols(N));
+}
+
 void SimpsonDefectConstraints::FillJacobianBlock(
     std::string var_set,
     ifopt::Component::Jacobian &jac_block) const
 {
-    if (var_set == m_state_vars->GetName()) {
+    if (var_set == m_state_vars_name) {
         FillJacobianWrt(VariableType::STATE, jac_block);
-    } else if (var_set == m_ctrl_vars->GetName()) {
+    } else if (var_set == m_ctrl_vars_name) {
         FillJacobianWrt(VariableType::CONTROL, jac_block);
-    } else if (var_set == m_state_mid_vars->GetName()) {
+    } else if (var_set == m_state_mid_vars_name) {
         FillJacobianWrt(VariableType::STATE_MID, jac_block);
-    } else if (var_set == m_ctrl_mid_vars->GetName()) {
+    } else if (var_set == m_ctrl_mid_vars_name) {
         FillJacobianWrt(VariableType::CONTROL_MID, jac_block);
+    } else if (m_duration_var && (var_set == m_duration_var_name)) {
+        FillJacobianWrtDuration(jac_block);
     }
 }
 
@@ -437,23 +655,20 @@ void SimpsonDefectConstraints::FillJacobianWrt(
     const VariableType var_type,
     ifopt::Component::Jacobian &jac_block) const
 {
-    const Eigen::VectorXd state_vars = m_state_vars->GetValues();
-    const Eigen::VectorXd control_vars = m_ctrl_vars->GetValues();
-
-    const Eigen::VectorXd state_mid_vars = m_state_mid_vars->GetValues();
-    const Eigen::VectorXd control_mid_vars = m_ctrl_mid_vars->GetValues();
-
-    const double h
-        = m_dt_segment;  // will probably just rename m_dt_segment later
+    updateDynJacobians();
 
     // use list of triplets to simplify and avoid costly random
     // insertions when constructing the final sparse jacobian matrix.
-    std::vector<Eigen::Triplet<double>> triplet_list;
+    EvaluationArena &arena = m_state_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
     const int var_type_len = getVarTypeLen(var_type);
     const int num_nonzero_submatrices = 2;
     const int num_defect_vec_eqns = m_num_segments;
-    triplet_list.reserve(m_state_len * var_type_len * num_nonzero_submatrices
-                         * num_defect_vec_eqns);
+    // the jacobians of the dynamics are dense in the worst case, and the
+    // state blocks add an identity matrix
+    TripletList triplets = arena.makeVector<Eigen::Triplet<double>>(
+        m_state_len * (var_type_len + 1) * num_nonzero_submatrices
+        * num_defect_vec_eqns);
 
     // k indexes a trajectory segment,
     // j indexes the variable block whose contribution is being inserted into
@@ -467,157 +682,120 @@ void SimpsonDefectConstraints::FillJacobianWrt(
     //
     // j_max is k + 2 for knot variables and k + 1 for midpoint
     // variables.
-    const size_t k_max = static_cast<size_t>(m_num_segments);
-
-    for (size_t k{}; k < k_max; ++k) {
-        const bool is_mid = (var_type == VariableType::STATE_MID
-                             || var_type == VariableType::CONTROL_MID);
-
-        // midpoint variable sets have one block per segment so only j = k is
-        // vald.
-        // knot variable sets have two neighboring blocks for
-        // segment k, j = k an j = k + 1.
-        const size_t j_max = is_mid ? (k + 1) : (k + 2);
-
-        for (size_t j = k; j < j_max; ++j) {
-            // j is used here instead of k because the loop bounds above
-            // guarantee that j already refers to the correct variable block
-            //
-            // midpoint  j = k is usd.
-            //
-            // knot j = k and j = k + 1 are used.
-            auto statej
-                = is_mid
-                      ? state_mid_vars(
-                            Eigen::seqN(j * m_state_len, m_state_len))
-                      : state_vars(Eigen::seqN(j * m_state_len, m_state_len));
-            auto controlj
-                = is_mid ? control_mid_vars(
-                               Eigen::seqN(j * m_control_len, m_control_len))
-                         : control_vars(
-                               Eigen::seqN(j * m_control_len, m_control_len));
-
-            const double tj = is_mid ? ((static_cast<double>(j) + 0.5) * h)
-                                     : (m_dt_segment * j);
-
-            // segment k has rows starting at k * m_state_len
-            const int row_start = static_cast<int>(k) * m_state_len;
-
-            // variable block j has columns starting at j * var_type_len
-            const int col_start = static_cast<int>(j) * var_type_len;
-
-            ifopt::Component::Jacobian jac_constraints_wrt_var
-                = jacConstraintsWrtVar(var_type, k, j, statej, controlj, tj);
-
-            auto sub_triplets = sparseMatrixToTriplets(jac_constraints_wrt_var,
-                                                       row_start,
-                                                       col_start);
-            triplet_list.insert(triplet_list.cend(),
-                                sub_triplets.cbegin(),
-                                sub_triplets.cend());
+    const bool is_mid = (var_type == VariableType::STATE_MID
+                         || var_type == VariableType::CONTROL_MID);
+    for (int k{}; k < m_num_segments; ++k) {
+        const int j_max = is_mid ? (k + 1) : (k + 2);
+        for (int j = k; j < j_max; ++j) {
+            jacConstraintsWrtVar(var_type, k, j, triplets);
         }
     }
 
-    jac_block.setFromTriplets(triplet_list.cbegin(), triplet_list.cend());
+    m_jac_fillers[static_cast<int>(var_type)].fill(triplets, jac_block);
 }
 
-ifopt::Component::Jacobian SimpsonDefectConstraints::jacConstraintsWrtVar(
+void SimpsonDefectConstraints::jacConstraintsWrtVar(
     const VariableType var_type,
-    const size_t k,
-    const size_t j,
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double time) const
+    const int k,
+    const int j,
+    TripletList &triplets) const
 {
-    const double h = m_dt_segment;
+    const double h = getSegmentDuration();
 
     switch (var_type) {
         case VariableType::STATE:
-            return jacConstraintsWrtState(k, j, state, control, time);
+            jacConstraintsWrtState(k, j, triplets);
+            return;
 
         case VariableType::CONTROL:
-            return jacConstraintsWrtControl(k, j, state, control, time);
+            jacConstraintsWrtControl(k, j, triplets);
+            return;
 
-        case VariableType::STATE_MID: {
-            if (j != k) {
-                ifopt::Component::Jacobian Z(m_state_len, m_state_len);
-                Z.setZero();
-                return Z;
+        case VariableType::STATE_MID:
+            // dc_k/dx_c,k = -(2h/3) df_c,k/dx_c,k
+            if (j == k) {
+                appendScaledTriplets(m_jac_dyn_mid_wrt_state[k],
+                                     -(2.0 * h / 3.0),
+                                     k * m_state_len,
+                                     j * m_state_len,
+                                     triplets);
             }
+            return;
 
-            ifopt::Component::Jacobian Ac
-                = m_jac_dyn_wrt_state_fn(state, control, time);
-            ifopt::Component::Jacobian dcd_dxc = -(2.0 * h / 3.0) * Ac;
-            return dcd_dxc;
-        }
-
-        case VariableType::CONTROL_MID: {
-            if (j != k) {
-                ifopt::Component::Jacobian Z(m_state_len, m_control_len);
-                Z.setZero();
-                return Z;
+        case VariableType::CONTROL_MID:
+            // dc_k/du_c,k = -(2h/3) df_c,k/du_c,k
+            if (j == k) {
+                appendScaledTriplets(m_jac_dyn_mid_wrt_control[k],
+                                     -(2.0 * h / 3.0),
+                                     k * m_state_len,
+                                     j * m_control_len,
+                                     triplets);
             }
-
-            ifopt::Component::Jacobian Bc
-                = m_jac_dyn_wrt_control_fn(state, control, time);
-            ifopt::Component::Jacobian dcd_duc = -(2.0 * h / 3.0) * Bc;
-            return dcd_duc;
-        }
+            return;
     }
-
     assert(false);
-    ifopt::Component::Jacobian Z(m_state_len, m_state_len);
-    Z.setZero();
-    return Z;
 }
 
-ifopt::Component::Jacobian SimpsonDefectConstraints::jacConstraintsWrtState(
-    const size_t k,
-    const size_t j,
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double time) const
+void SimpsonDefectConstraints::jacConstraintsWrtState(
+    const int k,
+    const int j,
+    TripletList &triplets) const
 {
-    const double h = m_dt_segment;
-
     if (!(j == k || j == k + 1)) {
-        ifopt::Component::Jacobian Z(m_state_len, m_state_len);
-        Z.setZero();
-        return Z;
+        return;
     }
 
+    // dc_k/dx_j = s_def I - (h/6) df_j/dx_j
+    const double h = getSegmentDuration();
     const bool left = (j == k);
-    ifopt::Component::Jacobian dfj_dxj
-        = m_jac_dyn_wrt_state_fn(state, control, time);
-
-    ifopt::Component::Jacobian I(m_state_len, m_state_len);
-    I.setIdentity();
-
     const double s_def_I = left ? -1.0 : +1.0;
-
-    ifopt::Component::Jacobian dcd_dx = ( s_def_I )*I + (-(h / 6.0)) * dfj_dxj;
-
-    return dcd_dx;
+    const int row_start = k * m_state_len;
+    const int col_start = j * m_state_len;
+    appendIdentityTriplets(
+        m_state_len, s_def_I, row_start, col_start, triplets);
+    appendScaledTriplets(
+        m_jac_dyn_wrt_state[j], -(h / 6.0), row_start, col_start, triplets);
 }
 
-ifopt::Component::Jacobian SimpsonDefectConstraints::jacConstraintsWrtControl(
-    const size_t k,
-    const size_t j,
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double time) const
+void SimpsonDefectConstraints::jacConstraintsWrtControl(
+    const int k,
+    const int j,
+    TripletList &triplets) const
 {
-    const double h = m_dt_segment;
-
     if (!(j == k || j == k + 1)) {
-        ifopt::Component::Jacobian Z(m_state_len, m_control_len);
-        Z.setZero();
-        return Z;
+        return;
     }
 
-    ifopt::Component::Jacobian B
-        = m_jac_dyn_wrt_control_fn(state, control, time);
+    // dc_k/du_j = -(h/6) df_j/du_j
+    const double h = getSegmentDuration();
+    appendScaledTriplets(m_jac_dyn_wrt_control[j],
+                         -(h / 6.0),
+                         k * m_state_len,
+                         j * m_control_len,
+                         triplets);
+}
 
-    ifopt::Component::Jacobian dcd_du = (-(h / 6.0)) * B;
-    return dcd_du;
+void SimpsonDefectConstraints::FillJacobianWrtDuration(
+    ifopt::Component::Jacobian &jac_block) const
+{
+    // With h = T/N the derivative of defect k w.r.t the duration T is
+    // dc_k/dT = -1/(6N)*(f_k + 4 f_c,k + f_(k+1)). The dynamics values are
+    // usually cached from the evaluation of the constraint values.
+    updateDynValues();
+    const int N = m_num_segments;
+
+    // The column of the jacobian is dense, one entry per constraint.
+    EvaluationArena &arena = m_state_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
+    TripletList triplets = arena.makeVector<Eigen::Triplet<double>>(GetRows());
+    for (int k{}; k < N; ++k) {
+        for (int i{}; i < m_state_len; ++i) {
+            const double dck_dT = -(m_dyn_values(i, k)
+                                    + 4.0 * m_dyn_mid_values(i, k)
+                                    + m_dyn_values(i, k + 1))
+                                  / (6.0 * N);
+            triplets.emplace_back(k * m_state_len + i, 0, dck_dT);
+        }
+    }
+    m_duration_jac_filler.fill(triplets, jac_block);
 }
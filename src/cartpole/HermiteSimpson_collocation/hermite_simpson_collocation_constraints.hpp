@@ -1,29 +1,25 @@
 #pragma once
 
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <ifopt/constraint_set.h>
 
+#include "collocation_constraints.hpp"
+#include "duration_variable.hpp"
+#include "jacobian_filler.hpp"
 #include "trajectory_variables.hpp"
 
-// A utility function to convert a sparse matrix to a vector of
-// triplets. row_start and col_start are used to offset the row and column
-// indices in order to use them for constructing a larger sparse matrix that
-// contains the provided one as a submatrix.
-std::vector<Eigen::Triplet<double>> sparseMatrixToTriplets(
-    const ifopt::Component::Jacobian &mat,
-    const int row_start,
-    const int col_start);
-
-// todo: consider the final time as an optimization variable in order to support
-// minimizing total time of a trajectory
-
-using DynFn = std::function<Eigen::VectorXd(const Eigen::VectorXd &state,
-                                            const Eigen::VectorXd &control,
-                                            const double time)>;
-
-using JacobianDynFn
-    = std::function<ifopt::Component::Jacobian(const Eigen::VectorXd &state,
-                                               const Eigen::VectorXd &control,
-                                               const double time)>;
+/*
+ * The dynamics are evaluated into buffers of the constraints through
+ * FunctionDynamics (eg. toFunctionDynamics() of a RobotDynamics), once per
+ * time point, and the triplets of the jacobians are taken from the arena of
+ * the state variables. The jacobian blocks are updated in place when their
+ * sparsity pattern does not change, so the evaluations do not allocate after
+ * the first iterates, and they are not thread safe.
+ */
 
 class HermiteMidpointConstraints final : public ifopt::ConstraintSet
 {
@@ -37,6 +33,8 @@ public:
      *
      * @param num_constraints Total number of scalar Hermite equations.
      *   This should be state_len * num_segments.
+     * @param dynamics Dynamics of the system, eg. toFunctionDynamics() of a
+     *   RobotDynamics, which is owned by the constraints.
      */
     HermiteMidpointConstraints(
         const int num_constraints,
@@ -47,11 +45,30 @@ public:
         const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
         const int control_len,
         const double dt_segment,
-        const DynFn &dyn_fn,
-        const JacobianDynFn &jac_dyn_wrt_state_fn,
-        const JacobianDynFn &jac_dyn_wrt_control_fn);
+        FunctionDynamics dynamics);
+
+    /*
+     * Same as above, but with the duration of the trajectory as an
+     * optimization variable, so h = T/N. The dynamics are assumed to be time
+     * invariant.
+     */
+    HermiteMidpointConstraints(
+        const int num_constraints,
+        const std::shared_ptr<TrajectoryVariables> &state_vars,
+        const int state_len,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+        const std::shared_ptr<TrajectoryVariables> &state_mid_vars,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
+        const int control_len,
+        const std::shared_ptr<DurationVariable> &duration_var,
+        FunctionDynamics dynamics);
 
     Eigen::VectorXd GetValues() const override;
+
+    // Same as GetValues(), but writes the values into a vector of GetRows()
+    // elements.
+    void fillValues(Eigen::Ref<Eigen::VectorXd> values) const;
+
     ifopt::Component::VecBound GetBounds() const override
     {
         return ifopt::Component::VecBound(GetRows(), {0.0, 0.0});
@@ -75,36 +92,47 @@ private:
     void FillJacobianWrt(const VariableType var_type,
                          ifopt::Component::Jacobian &jac_block) const;
 
+    // Create the jacobian of the constraints w.r.t the duration of the
+    // trajectory.
+    void FillJacobianWrtDuration(ifopt::Component::Jacobian &jac_block) const;
+
     int getVarTypeLen(const VariableType var_type) const;
 
-    // Create the jacobian of defect constraint vector k w.r.t the vector
-    // variable type (eg. state and control variables at the knot points and
-    // mid-points) at segment k ,knot point j.
-    ifopt::Component::Jacobian jacConstraintsWrtVar(
-        const VariableType var_type,
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
-
-    // Create the jacobian of defect constraint vector k w.r.t the state vector
-    // at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtState(
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
-
-    // Create the jacobian of defect constraint vector k w.r.t the control
-    // vector at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtControl(
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
+    // Duration of each segment, which is fixed or derived from the duration
+    // variable.
+    double getSegmentDuration() const;
+
+    // Append the triplets of the jacobian of defect constraint vector k
+    // w.r.t the vector variable type (eg. state and control variables at the
+    // knot points and mid-points) at segment k ,knot point j, at their
+    // position in the jacobian block.
+    void jacConstraintsWrtVar(const VariableType var_type,
+                              const int k,
+                              const int j,
+                              TripletList &triplets) const;
+
+    // Append the triplets of the jacobian of defect constraint vector k
+    // w.r.t the state vector at time point j.
+    void jacConstraintsWrtState(const int k,
+                                const int j,
+                                TripletList &triplets) const;
+
+    // Append the triplets of the jacobian of defect constraint vector k
+    // w.r.t the control vector at time point j.
+    void jacConstraintsWrtControl(const int k,
+                                  const int j,
+                                  TripletList &triplets) const;
+
+    // Evaluate the dynamics at every time point into the dynamics values,
+    // unless they were already evaluated for the current values of the
+    // variables. This lets the values and the jacobian w.r.t the duration
+    // share one evaluation per time point.
+    void updateDynValues() const;
+
+    // Evaluate the jacobians of the dynamics at every time point, unless they
+    // were already evaluated for the current values of the variables. This
+    // lets the jacobian blocks share one evaluation per time point.
+    void updateDynJacobians() const;
 
     const std::shared_ptr<TrajectoryVariables> m_state_vars;
     const int m_state_len;
@@ -113,10 +141,41 @@ private:
     const std::shared_ptr<TrajectoryVariables> m_state_mid_vars;
     const std::shared_ptr<TrajectoryVariables> m_ctrl_mid_vars;
     const double m_dt_segment;
-    const DynFn m_dyn_fn;
-    const JacobianDynFn m_jac_dyn_wrt_state_fn;
-    const JacobianDynFn m_jac_dyn_wrt_control_fn;
+    // duration of the trajectory if it is free, otherwise nullptr
+    std::shared_ptr<DurationVariable> m_duration_var;
+    // names of the variable sets, which are compared with the names passed to
+    // FillJacobianBlock() without copying them
+    const std::string m_state_vars_name;
+    const std::string m_ctrl_vars_name;
+    const std::string m_state_mid_vars_name;
+    const std::string m_ctrl_mid_vars_name;
+    std::string m_duration_var_name;
+    const FunctionDynamics m_dynamics;
     int m_num_segments;
+
+    // Workspace, sized once in the constructor and reused by every
+    // evaluation.
+    // dynamics at each knot point, one vector per column, and the variable
+    // values and the segment duration at which they were evaluated
+    mutable Eigen::MatrixXd m_dyn_values;
+    mutable bool m_has_dyn_values{false};
+    mutable Eigen::VectorXd m_dyn_state_values;
+    mutable Eigen::VectorXd m_dyn_ctrl_values;
+    mutable double m_dyn_segment_duration{};
+    // state and control at the time point being evaluated
+    mutable Eigen::VectorXd m_state_buf;
+    mutable Eigen::VectorXd m_control_buf;
+    // jacobians of the dynamics at each knot point, and the variable values
+    // and the segment duration at which they were evaluated
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_wrt_state;
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_wrt_control;
+    mutable bool m_has_dyn_jacobians{false};
+    mutable Eigen::VectorXd m_jac_state_values;
+    mutable Eigen::VectorXd m_jac_ctrl_values;
+    mutable double m_jac_segment_duration{};
+    // one filler per variable type
+    mutable std::array<JacobianFiller, 4> m_jac_fillers;
+    mutable JacobianFiller m_duration_jac_filler;
 };
 
 class SimpsonDefectConstraints final : public ifopt::ConstraintSet
@@ -131,6 +190,8 @@ public:
      *
      * @param num_constraints Total number of scalar Simpson equations.
      *   This should be state_len * num_segments.
+     * @param dynamics Dynamics of the system, eg. toFunctionDynamics() of a
+     *   RobotDynamics, which is owned by the constraints.
      */
     SimpsonDefectConstraints(
         const int num_constraints,
@@ -141,11 +202,30 @@ public:
         const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
         const int control_len,
         const double dt_segment,
-        const DynFn &dyn_fn,
-        const JacobianDynFn &jac_dyn_wrt_state_fn,
-        const JacobianDynFn &jac_dyn_wrt_control_fn);
+        FunctionDynamics dynamics);
+
+    /*
+     * Same as above, but with the duration of the trajectory as an
+     * optimization variable, so h = T/N. The dynamics are assumed to be time
+     * invariant.
+     */
+    SimpsonDefectConstraints(
+        const int num_constraints,
+        const std::shared_ptr<TrajectoryVariables> &state_vars,
+        const int state_len,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+        const std::shared_ptr<TrajectoryVariables> &state_mid_vars,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_mid_vars,
+        const int control_len,
+        const std::shared_ptr<DurationVariable> &duration_var,
+        FunctionDynamics dynamics);
 
     Eigen::VectorXd GetValues() const override;
+
+    // Same as GetValues(), but writes the values into a vector of GetRows()
+    // elements.
+    void fillValues(Eigen::Ref<Eigen::VectorXd> values) const;
+
     ifopt::Component::VecBound GetBounds() const override
     {
         return ifopt::Component::VecBound(GetRows(), {0.0, 0.0});
@@ -169,36 +249,47 @@ private:
     void FillJacobianWrt(const VariableType var_type,
                          ifopt::Component::Jacobian &jac_block) const;
 
+    // Create the jacobian of the constraints w.r.t the duration of the
+    // trajectory.
+    void FillJacobianWrtDuration(ifopt::Component::Jacobian &jac_block) const;
+
     int getVarTypeLen(const VariableType var_type) const;
 
-    // Create the jacobian of defect constraint vector k w.r.t the vector
-    // variable type (eg. state and control variables at the knot points and
-    // mid-points) at segment k ,knot point j.
-    ifopt::Component::Jacobian jacConstraintsWrtVar(
-        const VariableType var_type,
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
-
-    // Create the jacobian of defect constraint vector k w.r.t the state vector
-    // at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtState(
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
-
-    // Create the jacobian of defect constraint vector k w.r.t the control
-    // vector at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtControl(
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
+    // Duration of each segment, which is fixed or derived from the duration
+    // variable.
+    double getSegmentDuration() const;
+
+    // Append the triplets of the jacobian of defect constraint vector k
+    // w.r.t the vector variable type (eg. state and control variables at the
+    // knot points and mid-points) at segment k ,knot point j, at their
+    // position in the jacobian block.
+    void jacConstraintsWrtVar(const VariableType var_type,
+                              const int k,
+                              const int j,
+                              TripletList &triplets) const;
+
+    // Append the triplets of the jacobian of defect constraint vector k
+    // w.r.t the state vector at time point j.
+    void jacConstraintsWrtState(const int k,
+                                const int j,
+                                TripletList &triplets) const;
+
+    // Append the triplets of the jacobian of defect constraint vector k
+    // w.r.t the control vector at time point j.
+    void jacConstraintsWrtControl(const int k,
+                                  const int j,
+                                  TripletList &triplets) const;
+
+    // Evaluate the dynamics at every time point into the dynamics values,
+    // unless they were already evaluated for the current values of the
+    // variables. This lets the values and the jacobian w.r.t the duration
+    // share one evaluation per time point.
+    void updateDynValues() const;
+
+    // Evaluate the jacobians of the dynamics at every time point, unless they
+    // were already evaluated for the current values of the variables. This
+    // lets the jacobian blocks share one evaluation per time point.
+    void updateDynJacobians() const;
 
     const std::shared_ptr<TrajectoryVariables> m_state_vars;
     const int m_state_len;
@@ -207,8 +298,47 @@ private:
     const std::shared_ptr<TrajectoryVariables> m_state_mid_vars;
     const std::shared_ptr<TrajectoryVariables> m_ctrl_mid_vars;
     const double m_dt_segment;
-    const DynFn m_dyn_fn;
-    const JacobianDynFn m_jac_dyn_wrt_state_fn;
-    const JacobianDynFn m_jac_dyn_wrt_control_fn;
+    // duration of the trajectory if it is free, otherwise nullptr
+    std::shared_ptr<DurationVariable> m_duration_var;
+    // names of the variable sets, which are compared with the names passed to
+    // FillJacobianBlock() without copying them
+    const std::string m_state_vars_name;
+    const std::string m_ctrl_vars_name;
+    const std::string m_state_mid_vars_name;
+    const std::string m_ctrl_mid_vars_name;
+    std::string m_duration_var_name;
+    const FunctionDynamics m_dynamics;
     int m_num_segments;
+
+    // Workspace, sized once in the constructor and reused by every
+    // evaluation.
+    // dynamics at each knot point and each midpoint, one vector per column,
+    // and the variable values and the segment duration at which they were
+    // evaluated
+    mutable Eigen::MatrixXd m_dyn_values;
+    mutable Eigen::MatrixXd m_dyn_mid_values;
+    mutable bool m_has_dyn_values{false};
+    mutable Eigen::VectorXd m_dyn_state_values;
+    mutable Eigen::VectorXd m_dyn_ctrl_values;
+    mutable Eigen::VectorXd m_dyn_state_mid_values;
+    mutable Eigen::VectorXd m_dyn_ctrl_mid_values;
+    mutable double m_dyn_segment_duration{};
+    // state and control at the time point being evaluated
+    mutable Eigen::VectorXd m_state_buf;
+    mutable Eigen::VectorXd m_control_buf;
+    // jacobians of the dynamics at each knot point and midpoint, and the
+    // variable values and the segment duration at which they were evaluated
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_wrt_state;
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_wrt_control;
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_mid_wrt_state;
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_mid_wrt_control;
+    mutable bool m_has_dyn_jacobians{false};
+    mutable Eigen::VectorXd m_jac_state_values;
+    mutable Eigen::VectorXd m_jac_ctrl_values;
+    mutable Eigen::VectorXd m_jac_state_mid_values;
+    mutable Eigen::VectorXd m_jac_ctrl_mid_values;
+    mutable double m_jac_segment_duration{};
+    // one filler per variable type
+    mutable std::array<JacobianFiller, 4> m_jac_fillers;
+    mutable JacobianFiller m_duration_jac_filler;
 };
\ No newline at end of file
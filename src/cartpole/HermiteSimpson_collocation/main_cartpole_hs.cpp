@@ -9,11 +9,13 @@
 #include <rapidcsv.h>
 
 #include "control_effort_hs_cost.hpp"
+#include "duration_variable.hpp"
 #include "hermite_simpson_collocation_constraints.hpp"
 #include "hs_traj_extractor.hpp"
-#include "pinocchio/algorithm/aba-derivatives.hpp"
 #include "pinocchio/parsers/urdf.hpp"
+#include "robot_dynamics.hpp"
 #include "save_trajectory.hpp"
+#include "trajectory_costs.hpp"
 #include "trajectory_variables.hpp"
 
 namespace pin = pinocchio;
@@ -89,198 +91,6 @@ ifopt::Component::VecBound createControlBounds(const int num_control_vars,
     return bounds;
 }
 
-/*
- * Calculate the output of the cartpole dynamics function given the current
- * state, and control input.
- */
-Eigen::VectorXd cartpoleDyn(const Eigen::VectorXd &state,
-                            const Eigen::VectorXd &control,
-                            const double /*time*/,
-                            const pin::Model &model)
-{
-    // data required by algorithm
-    pin::Data data(model);
-
-    // state = x = [q, dq] = [q1, q2, dq1, dq2]
-    assert(state.size() == 4);
-    // control = [u]
-    assert(control.size() == 1);
-
-    // Get the torque. The second joint torque is always zero (underactuated)
-    Eigen::VectorXd tau = Eigen::VectorXd::Zero(model.nv);
-    tau(0) = control(0);
-
-    // Get the joint configuration.
-    const auto q = state(Eigen::seqN(0, state.size() / 2));
-    // Get the generalized joint velocity.
-    const auto v = state(Eigen::seqN(state.size() / 2, state.size() / 2));
-
-    // calculate the forward dynamics = [dq, ddq]
-    pin::aba(model, data, q, v, tau);
-    Eigen::VectorXd dx = Eigen::VectorXd::Zero(2 * model.nv);
-    dx << v, data.ddq;  // concatenate
-    return dx;
-}
-
-/*
- * Calculate the jacobian of the cartpole dynamics function w.r.t the state
- * input.
- */
-ifopt::Component::Jacobian jacCartpoleDynWrtState(
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double /*time*/,
-    const pin::Model &model)
-{
-    // data required by algorithm
-    pin::Data data(model);
-
-    // state = x = [q, dq] = [q1, q2, dq1, dq2]
-    assert(state.size() == 4);
-    // control = [u]
-    assert(control.size() == 1);
-
-    // Get the torque. The second joint torque is always zero (underactuated)
-    Eigen::VectorXd tau = Eigen::VectorXd::Zero(model.nv);
-    tau(0) = control(0);
-
-    // Get the joint configuration. Note that pinocchio has an additional
-    // universe joint at index 0.
-    const auto q = state(Eigen::seqN(0, state.size() / 2));
-    // Get the generalized joint velocity.
-    const auto v = state(Eigen::seqN(state.size() / 2, state.size() / 2));
-
-    // calculate the partial derivative of generalized joint acceleration w.r.t
-    // the generalized joint configuration, joint velocity, and joint torque
-    Eigen::MatrixXd ddq_dq = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dv = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dtau = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    pin::computeABADerivatives(model,
-                               data,
-                               q,
-                               v,
-                               tau,
-                               ddq_dq,
-                               ddq_dv,
-                               ddq_dtau);
-
-    /*
-      Jacobian of the forward dynamics function f w.r.t the state x=[q v] is:
-      df/dx = [df/dq df/dv] =
-      [dv/dq dv/dv;
-       da/dq da/dv] =
-      [0 I;
-       da/dq da/dv]
-      where v = dq/dt, a = dv / dt
-
-      Note that the zero submatrix and identity submatrix each have
-      size=(state_len/2 x state_len/2)
-     */
-
-    const int state_len = state.size();
-    std::vector<Eigen::Triplet<double>> triplets;
-    triplets.reserve(state_len / 2 + state_len / 2 * state_len);
-    // fill in dv/dv=I
-    for (int i{}; i < state_len / 2; ++i) {
-        for (int j{}; j < state_len / 2; ++j) {
-            if (i == j) {
-                triplets.push_back({i, j + state_len / 2, 1.0});
-            }
-        }
-    }
-
-    // fill in da/dq
-    for (int i{}; i < ddq_dq.rows(); ++i) {
-        for (int j{}; j < ddq_dq.cols(); ++j) {
-            triplets.push_back({i + state_len / 2, j, ddq_dq(i, j)});
-        }
-    }
-    // fill in da/dv
-    for (int i{}; i < ddq_dv.rows(); ++i) {
-        for (int j{}; j < ddq_dv.cols(); ++j) {
-            triplets.push_back(
-                {i + state_len / 2, j + state_len / 2, ddq_dv(i, j)});
-        }
-    }
-    ifopt::Component::Jacobian jac(state_len, state_len);
-    jac.setFromTriplets(triplets.cbegin(), triplets.cend());
-    return jac;
-}
-
-/*
- * Calculate the jacobian of the cartpole dynamics function w.r.t the control
- * input.
- */
-
-// todo: currently pin::computeABADerivatives() gets called twice for the same
-// computation in jacCartpoleDynWrtState() and jacCartpoleDynWrtControl(). This
-// is redundant because pin::computeABADerivatives() calculates the derivates
-// required for the jacobian w.r.t the state and w.r.t the control. An
-// optimization would be to refactor the code so that
-// pin::computeABADerivatives() only gets called once between these two
-// functions.
-ifopt::Component::Jacobian jacCartpoleDynWrtControl(
-    const Eigen::VectorXd &state,
-    const Eigen::VectorXd &control,
-    const double /*time*/,
-    const pin::Model &model)
-{
-    // data required by algorithm
-    pin::Data data(model);
-
-    // state = x = [q, dq] = [q1, q2, dq1, dq2]
-    assert(state.size() == 4);
-    // control = [u]
-    assert(control.size() == 1);
-
-    // Get the torque. The second joint torque is always zero (underactuated)
-    Eigen::VectorXd tau = Eigen::VectorXd::Zero(model.nv);
-    tau(0) = control(0);
-
-    // Get the joint configuration. Note that pinocchio has an additional
-    // universe joint at index 0.
-    const auto q = state(Eigen::seqN(0, state.size() / 2));
-    // Get the generalized joint velocity.
-    const auto v = state(Eigen::seqN(state.size() / 2, state.size() / 2));
-
-    // calculate the partial derivative of generalized joint acceleration w.r.t
-    // the generalized joint configuration, joint velocity, and joint torque
-    Eigen::MatrixXd ddq_dq = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dv = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dtau = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    pin::computeABADerivatives(model,
-                               data,
-                               q,
-                               v,
-                               tau,
-                               ddq_dq,
-                               ddq_dv,
-                               ddq_dtau);
-
-    /*
-      Jacobian of the forward dynamics function f w.r.t the control u=[tau(0)]
-      is:
-      df/du = df/dtau(0) =
-      [dv/dtau(0);
-       da/dtau(0)] =
-      [0;
-       da/dtau(0)]
-      where v = dq/dt, a = dv / dt
-     */
-
-    const int state_len = state.size();
-    std::vector<Eigen::Triplet<double>> triplets;
-    triplets.reserve(state_len / 2);
-    // fill da/dtau(0), which is the first column of da/dtau, where tau is the
-    // generalized joint vector.
-    for (int i{}; i < state_len / 2; ++i) {
-        triplets.push_back({i + state_len / 2, 0, ddq_dtau(i, 0)});
-    }
-    ifopt::Component::Jacobian jac(state_len, 1);
-    jac.setFromTriplets(triplets.cbegin(), triplets.cend());
-    return jac;
-}
-
 void guessStateTraj(const int state_len,
                     const int num_segments,
                     const Eigen::VectorXd &state_start,
@@ -311,10 +121,16 @@ void guessStateTraj(const int state_len,
 
 int main(int argc, char **argv)
 {
-    if (argc != 2) {
-        std::cout << "Path to model required." << std::endl;
+    if ((argc != 2) && (argc != 3)) {
+        std::cout << "Path to model required. Add --free-time to optimize the "
+                     "duration of the trajectory."
+                  << std::endl;
         return 0;
     }
+    // With a free final time traj_dur is only the initial guess of the
+    // duration, which is traded off against the control effort.
+    const bool free_time
+        = (argc == 3) && (std::string(argv[2]) == "--free-time");
 
     // Load the urdf model
     const std::string urdf_filename = argv[1];
@@ -402,59 +218,81 @@ int main(int argc, char **argv)
                                                 std::move(control_mid_bounds));
     nlp.AddVariableSet(traj_control_mid_vars);
 
-    // add constraints
-    const auto dyn_fn = [&](const Eigen::VectorXd &state,
-                            const Eigen::VectorXd &control,
-                            const double time) {
-        return cartpoleDyn(state, control, time, model);
-    };
-    const auto jac_dyn_wrt_state_fn = [&](const Eigen::VectorXd &state,
-                                          const Eigen::VectorXd &control,
-                                          const double time) {
-        return jacCartpoleDynWrtState(state, control, time, model);
-    };
-    const auto jac_dyn_wrt_control_fn = [&](const Eigen::VectorXd &state,
-                                            const Eigen::VectorXd &control,
-                                            const double time) {
-        return jacCartpoleDynWrtControl(state, control, time, model);
-    };
+    // add constraints. Each constraint set evaluates the dynamics with its
+    // own workspace.
     const int num_hermite_constraints = state_len * num_segments;
     const int num_simpson_constraints = state_len * num_segments;
 
-    const auto hermite_constraints
-        = std::make_shared<HermiteMidpointConstraints>(num_hermite_constraints,
-                                                       traj_state_vars,
-                                                       state_len,
-                                                       traj_control_vars,
-                                                       traj_state_mid_vars,
-                                                       traj_control_mid_vars,
-                                                       control_len,
-                                                       dt_segment,
-                                                       dyn_fn,
-                                                       jac_dyn_wrt_state_fn,
-                                                       jac_dyn_wrt_control_fn);
-
-    const auto simpson_constraints
-        = std::make_shared<SimpsonDefectConstraints>(num_simpson_constraints,
-                                                     traj_state_vars,
-                                                     state_len,
-                                                     traj_control_vars,
-                                                     traj_state_mid_vars,
-                                                     traj_control_mid_vars,
-                                                     control_len,
-                                                     dt_segment,
-                                                     dyn_fn,
-                                                     jac_dyn_wrt_state_fn,
-                                                     jac_dyn_wrt_control_fn);
-
+    std::shared_ptr<HermiteMidpointConstraints> hermite_constraints;
+    std::shared_ptr<SimpsonDefectConstraints> simpson_constraints;
+    std::shared_ptr<DurationVariable> duration_var;
+    if (free_time) {
+        const double min_dur = 0.5;
+        const double max_dur = 5.0;
+        duration_var = std::make_shared<DurationVariable>(
+            "traj_duration", traj_dur, min_dur, max_dur);
+        nlp.AddVariableSet(duration_var);
+
+        hermite_constraints = std::make_shared<HermiteMidpointConstraints>(
+            num_hermite_constraints,
+            traj_state_vars,
+            state_len,
+            traj_control_vars,
+            traj_state_mid_vars,
+            traj_control_mid_vars,
+            control_len,
+            duration_var,
+            toFunctionDynamics(std::make_shared<RobotDynamics>(model)));
+        simpson_constraints = std::make_shared<SimpsonDefectConstraints>(
+            num_simpson_constraints,
+            traj_state_vars,
+            state_len,
+            traj_control_vars,
+            traj_state_mid_vars,
+            traj_control_mid_vars,
+            control_len,
+            duration_var,
+            toFunctionDynamics(std::make_shared<RobotDynamics>(model)));
+        nlp.AddCostSet(std::make_shared<ControlEffortHermSimpCost>(
+            "effort_cost",
+            traj_control_vars->GetName(),
+            traj_control_mid_vars->GetName(),
+            control_len,
+            duration_var->GetName()));
+        // weight of one second against the effort in N^2*s
+        const double time_weight = 100.0;
+        nlp.AddCostSet(std::make_shared<MinimumTimeCost>(
+            "time_cost", duration_var->GetName(), time_weight));
+    } else {
+        hermite_constraints = std::make_shared<HermiteMidpointConstraints>(
+            num_hermite_constraints,
+            traj_state_vars,
+            state_len,
+            traj_control_vars,
+            traj_state_mid_vars,
+            traj_control_mid_vars,
+            control_len,
+            dt_segment,
+            toFunctionDynamics(std::make_shared<RobotDynamics>(model)));
+        simpson_constraints = std::make_shared<SimpsonDefectConstraints>(
+            num_simpson_constraints,
+            traj_state_vars,
+            state_len,
+            traj_control_vars,
+            traj_state_mid_vars,
+            traj_control_mid_vars,
+            control_len,
+            dt_segment,
+            toFunctionDynamics(std::make_shared<RobotDynamics>(model)));
+        nlp.AddCostSet(std::make_shared<ControlEffortHermSimpCost>(
+            "effort_cost",
+            traj_control_vars->GetName(),
+            traj_control_mid_vars->GetName(),
+            control_len,
+            dt_segment));
+    }
     nlp.AddConstraintSet(hermite_constraints);
     nlp.AddConstraintSet(simpson_constraints);
-    nlp.AddCostSet(std::make_shared<ControlEffortHermSimpCost>(
-        "effort_cost",
-        traj_control_vars->GetName(),
-        traj_control_mid_vars->GetName(),
-        control_len,
-        dt_segment));
 
     nlp.PrintCurrent();
     std::cout << "state variables: " << std::endl;
@@ -474,7 +312,7 @@ int main(int argc, char **argv)
     ipopt.SetOption("max_cpu_time", 60.0);
     ipopt.SetOption("print_level", 5);
     ipopt.SetOption("print_frequency_time", 3.0);
-    ipopt.SetOption("derivative_test", "first-order");
+    // the derivatives are checked offline by main_derivative_check
     ipopt.SetOption("mu_strategy", "adaptive");
     ipopt.SetOption("output_file", "ipopt.out");
 
@@ -494,7 +332,11 @@ int main(int argc, char **argv)
 
     const double start_time = 0.0;
     const double sample_period = 0.020;
+    const double opt_traj_dur
+        = free_time ? duration_var->getDuration() : traj_dur;
+    std::cout << "trajectory duration: " << opt_traj_dur << std::endl;
 
+    // The extractor views the solution, which is kept here.
     const Eigen::VectorXd solved_state_vars = traj_state_vars->GetValues();
     const Eigen::VectorXd solved_state_mid_vars
         = traj_state_mid_vars->GetValues();
@@ -506,22 +348,22 @@ int main(int argc, char **argv)
     // Extract/create trajectories and save to files
     //////////////////////////////////////////////////////////////////////
     HermSimpTrajExtractor traj_extractor(start_time,
-                                         traj_dur,
-                                         traj_state_vars->GetValues(),
-                                         traj_state_mid_vars->GetValues(),
+                                         opt_traj_dur,
+                                         solved_state_vars,
+                                         solved_state_mid_vars,
                                          state_len,
-                                         traj_control_vars->GetValues(),
-                                         traj_control_mid_vars->GetValues(),
+                                         solved_control_vars,
+                                         solved_control_mid_vars,
                                          control_len,
-                                         dt_segment,
+                                         opt_traj_dur / num_segments,
                                          model,
-                                         cartpoleDyn);
+                                         computeDyn);
     saveDiscreteJointStateTrajCsv(
         "collocation-state-traj-hermite-simpson-cartpole.csv",
-        traj_extractor.createCollocationStateTraj(model));
+        traj_extractor.createCollocationStateTraj());
     saveDiscreteJointDataTrajCsv(
         "collocation-ctrl-traj-hermite-simpson-cartpole.csv",
-        traj_extractor.createCollocationCtrlTraj(model));
+        traj_extractor.createCollocationCtrlTraj());
 
     // save sample trajectory to file
     // const double sample_period = 0.020;
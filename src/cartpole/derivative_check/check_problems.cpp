@@ -0,0 +1,334 @@
+#include "check_problems.hpp"
+
+#include <utility>
+
+#include "collocation_constraints.hpp"
+#include "control_basis.hpp"
+#include "control_effort_hs_cost.hpp"
+#include "control_effort_trapezoidal_cost.hpp"
+#include "duration_variable.hpp"
+#include "finite_difference_dynamics.hpp"
+#include "hermite_simpson_collocation_constraints.hpp"
+#include "quadrature.hpp"
+#include "robot_dynamics.hpp"
+#include "trajectory_costs.hpp"
+
+namespace pin = pinocchio;
+
+namespace
+{
+    template <typename Component>
+    auto bindJacobian(const std::shared_ptr<Component> &component)
+    {
+        return [component](std::string var_set,
+                           ifopt::Component::Jacobian &jac_block) {
+            component->FillJacobianBlock(std::move(var_set), jac_block);
+        };
+    }
+
+    template <typename Constraints>
+    void addConstraints(ifopt::Problem &nlp,
+                        CheckProblem &problem,
+                        const std::shared_ptr<Constraints> &constraints)
+    {
+        nlp.AddConstraintSet(constraints);
+        problem.constraints.push_back(
+            {.num_rows = constraints->GetRows(),
+             .fill_values =
+                 [constraints](Eigen::Ref<Eigen::VectorXd> values) {
+                     constraints->fillValues(values);
+                 },
+             .fill_jacobian_block = bindJacobian(constraints)});
+    }
+
+    template <typename Cost>
+    void addCost(ifopt::Problem &nlp,
+                 CheckProblem &problem,
+                 const std::shared_ptr<Cost> &cost)
+    {
+        nlp.AddCostSet(cost);
+        problem.costs.push_back(
+            {.num_rows = 1,
+             .fill_values =
+                 [cost](Eigen::Ref<Eigen::VectorXd> values) {
+                     values(0) = cost->GetCost();
+                 },
+             .fill_jacobian_block = bindJacobian(cost)});
+    }
+
+    std::shared_ptr<DurationVariable> createDurationVar()
+    {
+        return std::make_shared<DurationVariable>(
+            "traj_duration", traj_dur, 0.5, 5.0);
+    }
+}
+
+std::shared_ptr<TrajectoryVariables> createVars(const std::string &name,
+                                                const int num_vars)
+{
+    return std::make_shared<TrajectoryVariables>(
+        name,
+        Eigen::VectorXd::LinSpaced(num_vars, -0.5, 0.5),
+        ifopt::Component::VecBound(num_vars, {-ifopt::inf, ifopt::inf}));
+}
+
+CheckProblem buildTrapezoidalProblem(ifopt::Problem &nlp,
+                                     const pin::Model &model,
+                                     const bool free_time,
+                                     const bool use_ctrl_basis)
+{
+    CheckProblem problem;
+    const int state_len = model.nq + model.nv;
+    const int control_len = model.nv;
+    const int num_knots = num_segments + 1;
+    const int num_constraints = state_len * num_segments;
+    auto state_vars = createVars("traj_state_vars", num_knots * state_len);
+    nlp.AddVariableSet(state_vars);
+    const Quadrature quadrature = trapezoidalQuadrature(
+        "traj_control_vars", num_segments, dt_segment);
+
+    if (use_ctrl_basis) {
+        const ControlBasis ctrl_basis = bSplineControlBasis(num_knots, 6, 3);
+        auto ctrl_vars = createVars("traj_control_vars",
+                                    ctrl_basis.getNumCoeffs() * control_len);
+        nlp.AddVariableSet(ctrl_vars);
+        auto constraints
+            = std::make_shared<CollocationConstraints<RobotDynamics>>(
+                num_constraints,
+                state_vars,
+                state_len,
+                ctrl_vars,
+                control_len,
+                dt_segment,
+                RobotDynamics(model));
+        constraints->setControlBasis(ctrl_basis);
+        addConstraints(nlp, problem, constraints);
+        addCost(nlp,
+                problem,
+                std::make_shared<ControlBasisEffortCost>(
+                    "effort_cost",
+                    quadrature.front(),
+                    ctrl_basis,
+                    Eigen::VectorXd::Ones(control_len)));
+        return problem;
+    }
+
+    auto ctrl_vars = createVars("traj_control_vars", num_knots * control_len);
+    nlp.AddVariableSet(ctrl_vars);
+    if (free_time) {
+        auto duration_var = createDurationVar();
+        nlp.AddVariableSet(duration_var);
+        addConstraints(
+            nlp,
+            problem,
+            std::make_shared<CollocationConstraints<RobotDynamics>>(
+                num_constraints,
+                state_vars,
+                state_len,
+                ctrl_vars,
+                control_len,
+                duration_var,
+                RobotDynamics(model)));
+        addCost(nlp,
+                problem,
+                std::make_shared<ControlEffortTrapezoidalCost>(
+                    "effort_cost",
+                    ctrl_vars->GetName(),
+                    control_len,
+                    duration_var->GetName()));
+        addCost(nlp,
+                problem,
+                std::make_shared<MinimumTimeCost>("time_cost",
+                                                  duration_var->GetName()));
+        // effort of the later part of the trajectory, whose weights scale
+        // with the duration
+        addCost(nlp,
+                problem,
+                std::make_shared<ControlEffortCost>(
+                    "late_effort_cost",
+                    timeWeightedQuadrature(
+                        trapezoidalQuadrature(ctrl_vars->GetName(),
+                                              num_segments,
+                                              1.0 / num_segments),
+                        [](const double t) { return t * t; }),
+                    Eigen::VectorXd::Ones(control_len),
+                    duration_var->GetName()));
+        return problem;
+    }
+
+    addConstraints(nlp,
+                   problem,
+                   std::make_shared<CollocationConstraints<RobotDynamics>>(
+                       num_constraints,
+                       state_vars,
+                       state_len,
+                       ctrl_vars,
+                       control_len,
+                       dt_segment,
+                       RobotDynamics(model)));
+    addCost(nlp,
+            problem,
+            std::make_shared<ControlEffortCost>(
+                "effort_cost", quadrature, Eigen::VectorXd::Ones(control_len)));
+    addCost(nlp,
+            problem,
+            std::make_shared<ControlRateCost>(
+                "rate_cost",
+                ctrl_vars->GetName(),
+                dt_segment,
+                Eigen::VectorXd::Ones(control_len)));
+    addCost(nlp,
+            problem,
+            std::make_shared<TerminalStateCost>(
+                "terminal_cost",
+                state_vars->GetName(),
+                Eigen::VectorXd::Ones(state_len),
+                Eigen::VectorXd::Ones(state_len)));
+    return problem;
+}
+
+CheckProblem buildFiniteDifferenceProblem(ifopt::Problem &nlp,
+                                          const pin::Model &model,
+                                          const int num_threads)
+{
+    CheckProblem problem;
+    const int state_len = model.nq + model.nv;
+    const int control_len = model.nv;
+    const int num_knots = num_segments + 1;
+    auto state_vars = createVars("traj_state_vars", num_knots * state_len);
+    auto ctrl_vars = createVars("traj_control_vars", num_knots * control_len);
+    nlp.AddVariableSet(state_vars);
+    nlp.AddVariableSet(ctrl_vars);
+    using FdDynamics = FiniteDifferenceDynamics<RobotDynamics>;
+    addConstraints(nlp,
+                   problem,
+                   std::make_shared<CollocationConstraints<FdDynamics>>(
+                       state_len * num_segments,
+                       state_vars,
+                       state_len,
+                       ctrl_vars,
+                       control_len,
+                       dt_segment,
+                       FdDynamics(RobotDynamics(model), 1e-6, num_threads)));
+    addCost(nlp,
+            problem,
+            std::make_shared<ControlEffortCost>(
+                "effort_cost",
+                trapezoidalQuadrature(
+                    ctrl_vars->GetName(), num_segments, dt_segment),
+                Eigen::VectorXd::Ones(control_len)));
+    return problem;
+}
+
+CheckProblem buildHermiteSimpsonProblem(ifopt::Problem &nlp,
+                                        const pin::Model &model,
+                                        const bool free_time)
+{
+    CheckProblem problem;
+    const int state_len = model.nq + model.nv;
+    const int control_len = model.nv;
+    const int num_knots = num_segments + 1;
+    const int num_constraints = state_len * num_segments;
+    auto state_vars = createVars("traj_state_vars", num_knots * state_len);
+    auto ctrl_vars = createVars("traj_control_vars", num_knots * control_len);
+    auto state_mid_vars
+        = createVars("traj_state_mid_vars", num_segments * state_len);
+    auto ctrl_mid_vars
+        = createVars("traj_control_mid_vars", num_segments * control_len);
+    nlp.AddVariableSet(state_vars);
+    nlp.AddVariableSet(ctrl_vars);
+    nlp.AddVariableSet(state_mid_vars);
+    nlp.AddVariableSet(ctrl_mid_vars);
+
+    if (free_time) {
+        auto duration_var = createDurationVar();
+        nlp.AddVariableSet(duration_var);
+        addConstraints(
+            nlp,
+            problem,
+            std::make_shared<HermiteMidpointConstraints>(
+                num_constraints,
+                state_vars,
+                state_len,
+                ctrl_vars,
+                state_mid_vars,
+                ctrl_mid_vars,
+                control_len,
+                duration_var,
+                toFunctionDynamics(std::make_shared<RobotDynamics>(model))));
+        addConstraints(
+            nlp,
+            problem,
+            std::make_shared<SimpsonDefectConstraints>(
+                num_constraints,
+                state_vars,
+                state_len,
+                ctrl_vars,
+                state_mid_vars,
+                ctrl_mid_vars,
+                control_len,
+                duration_var,
+                toFunctionDynamics(std::make_shared<RobotDynamics>(model))));
+        addCost(nlp,
+                problem,
+                std::make_shared<ControlEffortHermSimpCost>(
+                    "effort_cost",
+                    ctrl_vars->GetName(),
+                    ctrl_mid_vars->GetName(),
+                    control_len,
+                    duration_var->GetName()));
+        addCost(nlp,
+                problem,
+                std::make_shared<MinimumTimeCost>("time_cost",
+                                                  duration_var->GetName()));
+        return problem;
+    }
+
+    addConstraints(
+        nlp,
+        problem,
+        std::make_shared<HermiteMidpointConstraints>(
+            num_constraints,
+            state_vars,
+            state_len,
+            ctrl_vars,
+            state_mid_vars,
+            ctrl_mid_vars,
+            control_len,
+            dt_segment,
+            toFunctionDynamics(std::make_shared<RobotDynamics>(model))));
+    addConstraints(
+        nlp,
+        problem,
+        std::make_shared<SimpsonDefectConstraints>(
+            num_constraints,
+            state_vars,
+            state_len,
+            ctrl_vars,
+            state_mid_vars,
+            ctrl_mid_vars,
+            control_len,
+            dt_segment,
+            toFunctionDynamics(std::make_shared<RobotDynamics>(model))));
+    addCost(nlp,
+            problem,
+            std::make_shared<ControlEffortHermSimpCost>(
+                "effort_cost",
+                ctrl_vars->GetName(),
+                ctrl_mid_vars->GetName(),
+                control_len,
+                dt_segment));
+    // the same effort with the library cost, weighted towards the end
+    addCost(nlp,
+            problem,
+            std::make_shared<ControlEffortCost>(
+                "late_effort_cost",
+                timeWeightedQuadrature(
+                    hermiteSimpsonQuadrature(ctrl_vars->GetName(),
+                                             ctrl_mid_vars->GetName(),
+                                             num_segments,
+                                             dt_segment),
+                    [](const double t) { return t; }),
+                Eigen::VectorXd::Ones(control_len)));
+    return problem;
+}
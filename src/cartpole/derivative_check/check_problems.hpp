@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ifopt/composite.h>
+#include <ifopt/problem.h>
+
+#include "pinocchio/multibody/model.hpp"
+#include "trajectory_variables.hpp"
+
+/*
+ * Collocation problems of the offline checks (main_derivative_check and
+ * main_allocation_check), so both checks evaluate the same problems.
+ */
+
+// Sizes of the problems, as in the main programs.
+const int num_segments = 10;
+const double traj_dur = 2.0;
+const double dt_segment = traj_dur / num_segments;
+
+/*
+ * Constraint sets and cost terms of a problem, which are also added to the
+ * ifopt::Problem. Their evaluation functions are bound to the concrete types,
+ * because the ones of the ifopt base classes are private.
+ */
+struct CheckProblem
+{
+    struct Component
+    {
+        int num_rows;
+        // Evaluates the values into a vector of size num_rows, ie.
+        // fillValues() of the constraints or GetCost() of a cost term.
+        std::function<void(Eigen::Ref<Eigen::VectorXd> values)> fill_values;
+        std::function<void(std::string var_set,
+                           ifopt::Component::Jacobian &jac_block)>
+            fill_jacobian_block;
+    };
+
+    std::vector<Component> constraints;
+    std::vector<Component> costs;
+};
+
+// Unbounded variables with nonzero initial values, so the problems are not
+// evaluated at a special point. The bounds do not affect the checks.
+std::shared_ptr<TrajectoryVariables> createVars(const std::string &name,
+                                                const int num_vars);
+
+/*
+ * Trapezoidal collocation problem as in main_cartpole_trapezoidal and
+ * main_so101_trapezoidal.
+ *
+ * @param free_time Optimize the duration of the trajectory.
+ * @param use_ctrl_basis Parameterize the controls with a cubic B-spline.
+ */
+CheckProblem buildTrapezoidalProblem(ifopt::Problem &nlp,
+                                     const pinocchio::Model &model,
+                                     const bool free_time,
+                                     const bool use_ctrl_basis);
+
+/*
+ * Trapezoidal collocation problem whose dynamics jacobians are finite
+ * differences (see FiniteDifferenceDynamics).
+ *
+ * @param num_threads Threads of the finite differences.
+ */
+CheckProblem buildFiniteDifferenceProblem(ifopt::Problem &nlp,
+                                          const pinocchio::Model &model,
+                                          const int num_threads);
+
+/*
+ * Hermite-Simpson collocation problem as in main_cartpole_HS.
+ *
+ * @param free_time Optimize the duration of the trajectory.
+ */
+CheckProblem buildHermiteSimpsonProblem(ifopt::Problem &nlp,
+                                        const pinocchio::Model &model,
+                                        const bool free_time);
@@ -0,0 +1,412 @@
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ifopt/problem.h>
+
+#include "check_problems.hpp"
+#include "pinocchio/parsers/mjcf.hpp"
+#include "pinocchio/parsers/urdf.hpp"
+
+namespace pin = pinocchio;
+
+/////////////////////////////////////////////////////////////
+// Counting of the heap allocations
+/////////////////////////////////////////////////////////////
+
+namespace
+{
+    // Heap allocations of the program, counted by the replacements of the
+    // allocation functions below.
+    std::atomic<long> num_allocations{0};
+
+    void countAllocation()
+    {
+        num_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    long getNumAllocations()
+    {
+        return num_allocations.load(std::memory_order_relaxed);
+    }
+}
+
+#if defined(__GLIBC__)
+// Eigen allocates with malloc, so the C allocation functions are replaced as
+// well. They forward to the implementations of glibc.
+extern "C"
+{
+    void *__libc_malloc(std::size_t size);
+    void *__libc_calloc(std::size_t num, std::size_t size);
+    void *__libc_realloc(void *ptr, std::size_t size);
+    void *__libc_memalign(std::size_t alignment, std::size_t size);
+    void __libc_free(void *ptr);
+
+    void *malloc(std::size_t size) noexcept
+    {
+        countAllocation();
+        return __libc_malloc(size);
+    }
+
+    void *calloc(std::size_t num, std::size_t size) noexcept
+    {
+        countAllocation();
+        return __libc_calloc(num, size);
+    }
+
+    void *realloc(void *ptr, std::size_t size) noexcept
+    {
+        countAllocation();
+        return __libc_realloc(ptr, size);
+    }
+
+    void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+    {
+        countAllocation();
+        return __libc_memalign(alignment, size);
+    }
+
+    void *memalign(std::size_t alignment, std::size_t size) noexcept
+    {
+        countAllocation();
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **ptr,
+                       std::size_t alignment,
+                       std::size_t size) noexcept
+    {
+        countAllocation();
+        *ptr = __libc_memalign(alignment, size);
+        return *ptr ? 0 : ENOMEM;
+    }
+
+    void free(void *ptr) noexcept
+    {
+        __libc_free(ptr);
+    }
+}
+
+namespace
+{
+    void *allocate(const std::size_t size)
+    {
+        return __libc_malloc(size);
+    }
+
+    void *allocateAligned(const std::size_t size, const std::size_t alignment)
+    {
+        return __libc_memalign(alignment, size);
+    }
+
+    void deallocate(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+#else
+// Only the allocations through operator new are counted.
+namespace
+{
+    void *allocate(const std::size_t size)
+    {
+        return std::malloc(size);
+    }
+
+    void *allocateAligned(const std::size_t size, const std::size_t alignment)
+    {
+        return std::aligned_alloc(alignment,
+                                  (size + alignment - 1) / alignment
+                                      * alignment);
+    }
+
+    void deallocate(void *ptr)
+    {
+        std::free(ptr);
+    }
+}
+#endif
+
+void *operator new(const std::size_t size)
+{
+    countAllocation();
+    if (void *ptr = allocate(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](const std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    countAllocation();
+    if (void *ptr = allocateAligned(size == 0 ? 1 : size,
+                                    static_cast<std::size_t>(alignment))) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](const std::size_t size, const std::align_val_t alignment)
+{
+    return ::operator new(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t /*alignment*/) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t /*alignment*/) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr,
+                     std::size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr,
+                       std::size_t /*size*/,
+                       std::align_val_t /*alignment*/) noexcept
+{
+    deallocate(ptr);
+}
+
+/////////////////////////////////////////////////////////////
+// Evaluation of the problems
+/////////////////////////////////////////////////////////////
+
+/*
+ * Evaluates the constraints and costs of a problem and their jacobians w.r.t
+ * every variable set, as a solver does for each iterate, but into outputs that
+ * are allocated once. The components are called directly, because the
+ * evaluation functions of ifopt::Problem return new vectors and matrices.
+ */
+class IterateEvaluator
+{
+public:
+    // @param problem Components of nlp, see buildTrapezoidalProblem().
+    IterateEvaluator(const ifopt::Problem &nlp, const CheckProblem &problem)
+        : m_var_sets{nlp.GetOptVariables()->GetComponents()}
+    {
+        for (const auto &vars : m_var_sets) {
+            m_var_names.push_back(vars->GetName());
+            m_init_values.push_back(vars->GetValues());
+            m_iterate_values.push_back(vars->GetValues());
+        }
+        m_components = problem.constraints;
+        m_components.insert(
+            m_components.end(), problem.costs.cbegin(), problem.costs.cend());
+        for (std::size_t c{}; c < m_components.size(); ++c) {
+            m_values.emplace_back(m_components[c].num_rows);
+            for (std::size_t s{}; s < m_var_sets.size(); ++s) {
+                m_jac_blocks.push_back(
+                    JacobianBlock{.component_index = c,
+                                  .var_set_index = s,
+                                  .var_set_arg = {},
+                                  .jac = ifopt::Component::Jacobian(
+                                      m_components[c].num_rows,
+                                      m_var_sets[s]->GetRows())});
+            }
+        }
+    }
+
+    /*
+     * Set the variables of iterate i, which are offset from the initial
+     * values, and evaluate the problem.
+     *
+     * @return Number of heap allocations of the evaluation.
+     */
+    long evaluate(const int iterate)
+    {
+        // The names are passed by value, so the copies are made before the
+        // allocations are counted.
+        for (std::size_t s{}; s < m_var_sets.size(); ++s) {
+            for (int i{}; i < m_iterate_values[s].size(); ++i) {
+                m_iterate_values[s](i)
+                    = m_init_values[s](i)
+                      + 0.05 * std::sin(0.7 * iterate + 1.3 * i + s);
+            }
+        }
+        for (auto &block : m_jac_blocks) {
+            block.var_set_arg = m_var_names[block.var_set_index];
+        }
+
+        const long num_before = getNumAllocations();
+        for (std::size_t s{}; s < m_var_sets.size(); ++s) {
+            m_var_sets[s]->SetVariables(m_iterate_values[s]);
+        }
+        for (std::size_t c{}; c < m_components.size(); ++c) {
+            m_components[c].fill_values(m_values[c]);
+        }
+        for (auto &block : m_jac_blocks) {
+            m_components[block.component_index].fill_jacobian_block(
+                std::move(block.var_set_arg), block.jac);
+        }
+        return getNumAllocations() - num_before;
+    }
+
+private:
+    // Jacobian of a component w.r.t one variable set.
+    struct JacobianBlock
+    {
+        std::size_t component_index;
+        std::size_t var_set_index;
+        std::string var_set_arg;
+        ifopt::Component::Jacobian jac;
+    };
+
+    const ifopt::Composite::ComponentVec m_var_sets;
+    std::vector<std::string> m_var_names;
+    std::vector<Eigen::VectorXd> m_init_values;
+    std::vector<Eigen::VectorXd> m_iterate_values;
+    // the constraint sets and then the cost terms
+    std::vector<CheckProblem::Component> m_components;
+    std::vector<Eigen::VectorXd> m_values;
+    std::vector<JacobianBlock> m_jac_blocks;
+};
+
+// Adds the variable sets, constraint sets and cost terms to an empty problem,
+// and returns them.
+using ProblemBuilder = std::function<CheckProblem(ifopt::Problem &nlp)>;
+
+/*
+ * Print the allocations of each evaluation function of ifopt::Problem for one
+ * iterate. These are the functions that IPOPT calls, and they allocate at
+ * every iteration: ifopt returns new vectors and matrices, and builds a new
+ * jacobian block per constraint set and variable set, so the jacobians are
+ * rebuilt from their triplets (see JacobianFiller). The counts are therefore
+ * not checked.
+ */
+void printIfoptAllocations(ifopt::Problem &nlp)
+{
+    const Eigen::VectorXd x = nlp.GetVariableValues();
+    const std::vector<
+        std::pair<std::string, std::function<void(ifopt::Problem &)>>>
+        functions{
+            {"EvaluateConstraints",
+             [&x](ifopt::Problem &p) { p.EvaluateConstraints(x.data()); }},
+            {"GetJacobianOfConstraints",
+             [](ifopt::Problem &p) { p.GetJacobianOfConstraints(); }},
+            {"EvaluateCostFunction",
+             [&x](ifopt::Problem &p) { p.EvaluateCostFunction(x.data()); }},
+            {"EvaluateCostFunctionGradient", [&x](ifopt::Problem &p) {
+                 p.EvaluateCostFunctionGradient(x.data());
+             }}};
+    for (const auto &[name, function] : functions) {
+        // the first call may grow the buffers of the components
+        function(nlp);
+        const long num_before = getNumAllocations();
+        function(nlp);
+        std::cout << "  ifopt " << name << ": "
+                  << getNumAllocations() - num_before << " allocations"
+                  << std::endl;
+    }
+}
+
+/*
+ * Check that the evaluations of the constraints, costs and their jacobians do
+ * not allocate heap memory once they have been evaluated for a few iterates,
+ * when they are called directly with jacobian blocks that are kept between
+ * iterates. The exit code is nonzero if such an evaluation allocates, so it
+ * can run in CI.
+ *
+ * An IPOPT iteration still allocates: the evaluation path of ifopt::Problem
+ * is only reported, see printIfoptAllocations().
+ */
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        std::cout << "Paths to the cartpole urdf and the SO101 mjcf model "
+                     "required (in this order)."
+                  << std::endl;
+        return 0;
+    }
+    pin::Model cartpole_model;
+    pin::urdf::buildModel(argv[1], cartpole_model);
+    pin::Model so101_model;
+    pin::mjcf::buildModel(argv[2], so101_model);
+
+    const std::vector<std::pair<std::string, ProblemBuilder>> problems{
+        {"SO101 trapezoidal",
+         [&so101_model](ifopt::Problem &nlp) {
+             return buildTrapezoidalProblem(nlp, so101_model, false, false);
+         }},
+        {"cartpole trapezoidal, free final time",
+         [&cartpole_model](ifopt::Problem &nlp) {
+             return buildTrapezoidalProblem(nlp, cartpole_model, true, false);
+         }},
+        {"cartpole trapezoidal, B-spline controls",
+         [&cartpole_model](ifopt::Problem &nlp) {
+             return buildTrapezoidalProblem(nlp, cartpole_model, false, true);
+         }},
+        {"cartpole Hermite-Simpson", [&cartpole_model](ifopt::Problem &nlp) {
+             return buildHermiteSimpsonProblem(nlp, cartpole_model, false);
+         }}};
+
+    // The first iterates size the buffers, the arenas and the sparsity
+    // patterns of the jacobians.
+    const int num_warm_up_iterates = 3;
+    const int num_checked_iterates = 5;
+    bool passed = true;
+    for (const auto &[name, build_problem] : problems) {
+        ifopt::Problem nlp;
+        const CheckProblem problem = build_problem(nlp);
+        IterateEvaluator evaluator(nlp, problem);
+
+        for (int i{}; i < num_warm_up_iterates; ++i) {
+            evaluator.evaluate(i);
+        }
+        long max_allocations{};
+        for (int i{}; i < num_checked_iterates; ++i) {
+            max_allocations = std::max(
+                max_allocations,
+                evaluator.evaluate(num_warm_up_iterates + i));
+        }
+        std::cout << name << ": " << max_allocations
+                  << " allocations per iterate" << std::endl;
+        passed = passed && (max_allocations == 0);
+        printIfoptAllocations(nlp);
+    }
+    std::cout << (passed ? "no allocations per iterate"
+                         : "the evaluations allocate")
+              << std::endl;
+    return passed ? 0 : 1;
+}
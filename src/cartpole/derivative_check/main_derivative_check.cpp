@@ -0,0 +1,75 @@
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ifopt/problem.h>
+
+#include "check_problems.hpp"
+#include "derivative_check.hpp"
+#include "pinocchio/parsers/urdf.hpp"
+
+namespace pin = pinocchio;
+
+/*
+ * Check the jacobians of the constraints and costs of the collocation problems
+ * against finite differences, instead of running IPOPT's derivative_test with
+ * every solve. The exit code is nonzero if a block of the jacobians has a
+ * larger relative error than the tolerance, so it can run in CI.
+ */
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        std::cout << "Path to model required." << std::endl;
+        return 0;
+    }
+    const std::string urdf_filename = argv[1];
+    pin::Model model;
+    pin::urdf::buildModel(urdf_filename, model);
+    std::cout << "model name: " << model.name << std::endl;
+
+    // The random points are within +-1 of the initial values.
+    DerivativeCheckOptions options;
+    options.perturbation = 1.0;
+    const double tol = 1e-5;
+
+    const std::vector<std::pair<std::string, ProblemBuilder>> problems{
+        {"trapezoidal",
+         [&model](ifopt::Problem &nlp) {
+             buildTrapezoidalProblem(nlp, model, false, false);
+         }},
+        {"trapezoidal, free final time",
+         [&model](ifopt::Problem &nlp) {
+             buildTrapezoidalProblem(nlp, model, true, false);
+         }},
+        {"trapezoidal, B-spline controls",
+         [&model](ifopt::Problem &nlp) {
+             buildTrapezoidalProblem(nlp, model, false, true);
+         }},
+        {"trapezoidal, finite difference dynamics",
+         [&model](ifopt::Problem &nlp) {
+             // two threads, so the split between them is checked as well
+             buildFiniteDifferenceProblem(nlp, model, 2);
+         }},
+        {"Hermite-Simpson",
+         [&model](ifopt::Problem &nlp) {
+             buildHermiteSimpsonProblem(nlp, model, false);
+         }},
+        {"Hermite-Simpson, free final time", [&model](ifopt::Problem &nlp) {
+             buildHermiteSimpsonProblem(nlp, model, true);
+         }}};
+
+    bool passed = true;
+    for (const auto &[name, build_problem] : problems) {
+        std::cout << "checking derivatives of the " << name << " problem"
+                  << std::endl;
+        const std::vector<BlockDerivativeError> errors
+            = checkDerivatives(build_problem, options);
+        printDerivativeErrors(std::cout, errors);
+        passed = passed && derivativesWithinTolerance(errors, tol);
+    }
+    std::cout << (passed ? "all derivatives within tolerance "
+                         : "derivatives exceed tolerance ")
+              << tol << std::endl;
+    return passed ? 0 : 1;
+}
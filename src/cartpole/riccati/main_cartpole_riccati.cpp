@@ -0,0 +1,159 @@
+#include <cmath>
+#include <iostream>
+#include <numbers>
+
+#include <ifopt/ipopt_solver.h>
+#include <ifopt/problem.h>
+
+#include "collocation_constraints.hpp"
+#include "physics_initial_guess.hpp"
+#include "pinocchio/parsers/urdf.hpp"
+#include "riccati_ip_solver.hpp"
+#include "robot_dynamics.hpp"
+#include "trajectory_bounds.hpp"
+#include "trajectory_costs.hpp"
+#include "trajectory_variables.hpp"
+
+namespace pin = pinocchio;
+
+/*
+ * Add the variables, constraints and cost of the cartpole swing up problem
+ * with trapezoidal collocation.
+ */
+void createCartpoleProblem(ifopt::Problem &nlp,
+                           const pin::Model &model,
+                           const int num_segments)
+{
+    const double traj_dur = 2.0;
+    const double dt_segment = traj_dur / num_segments;
+
+    // final q0 position
+    const double d = 0.8;
+    const double d_max = 2 * d;
+    const int state_len = 4;
+    const int num_state_vars = (num_segments + 1) * state_len;
+    const Eigen::VectorXd state_end{{d, std::numbers::pi, 0.0, 0.0}};
+    const Eigen::VectorXd state_start = Eigen::VectorXd::Zero(state_len);
+    // bounds of q0, q1, dq0 and dq1
+    const ifopt::Component::VecBound path_bounds{
+        {-d_max, d_max},
+        {-2 * std::numbers::pi, 2 * std::numbers::pi},
+        {-ifopt::inf, ifopt::inf},
+        {-ifopt::inf, ifopt::inf}};
+    auto traj_state_vars = std::make_shared<TrajectoryVariables>(
+        "traj_state_vars",
+        createLinearStateGuess(state_start, state_end, num_segments),
+        createStateBounds(
+            num_state_vars, path_bounds, state_start, state_end));
+    nlp.AddVariableSet(traj_state_vars);
+
+    const int control_len = 1;
+    const int num_control_vars = control_len * (num_segments + 1);
+    const double max_control_force = 100.0;
+    auto traj_control_vars = std::make_shared<TrajectoryVariables>(
+        "traj_control_vars",
+        Eigen::VectorXd::Zero(num_control_vars),
+        createControlBounds(num_control_vars, max_control_force));
+    nlp.AddVariableSet(traj_control_vars);
+
+    const auto col_constraints
+        = std::make_shared<CollocationConstraints<RobotDynamics>>(
+            state_len * num_segments,
+            traj_state_vars,
+            state_len,
+            traj_control_vars,
+            control_len,
+            dt_segment,
+            RobotDynamics(model));
+    nlp.AddConstraintSet(col_constraints);
+    // The same effort as ControlEffortTrapezoidalCost, but with a constant
+    // hessian that the Riccati solver adds exactly.
+    nlp.AddCostSet(std::make_shared<ControlEffortCost>(
+        "effort_cost",
+        trapezoidalQuadrature(
+            traj_control_vars->GetName(), num_segments, dt_segment),
+        Eigen::VectorXd::Ones(control_len)));
+}
+
+/*
+ * Solve the cartpole swing up problem with IPOPT and with the structure
+ * exploiting interior point solver for an increasing number of segments, and
+ * compare the solutions. The time of the linear solves of the Riccati solver
+ * should grow linearly with the number of segments.
+ */
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        std::cout << "Path to model required." << std::endl;
+        return 0;
+    }
+
+    // Load the urdf model
+    const std::string urdf_filename = argv[1];
+    pin::Model model;
+    pin::urdf::buildModel(urdf_filename, model);
+    std::cout << "model name: " << model.name << std::endl;
+
+    const int state_len = 4;
+    const int control_len = 1;
+    StageLayout layout;
+    layout.var_block_lens = {{"traj_state_vars", state_len},
+                             {"traj_control_vars", control_len}};
+    layout.constraint_block_lens = {{"trap_col_constraints", state_len}};
+
+    const double tol = 1e-6;
+    // maximum relative difference of the objectives
+    const double max_objective_diff = 1e-3;
+    bool valid = true;
+
+    for (const int num_segments : {10, 20, 40, 80, 160}) {
+        ifopt::Problem nlp_ipopt;
+        createCartpoleProblem(nlp_ipopt, model, num_segments);
+        ifopt::IpoptSolver ipopt;
+        ipopt.SetOption("tol", tol);
+        ipopt.SetOption("max_iter", 3000);
+        ipopt.SetOption("max_cpu_time", 60.0);
+        ipopt.SetOption("print_level", 0);
+        ipopt.Solve(nlp_ipopt);
+        const Eigen::VectorXd x_ipopt = nlp_ipopt.GetVariableValues();
+        const double objective_ipopt
+            = nlp_ipopt.EvaluateCostFunction(x_ipopt.data());
+
+        ifopt::Problem nlp_riccati;
+        createCartpoleProblem(nlp_riccati, model, num_segments);
+        RiccatiIpOptions options;
+        options.tol = tol;
+        options.print = false;
+        RiccatiIpSolver riccati(layout, options);
+        riccati.Solve(nlp_riccati);
+        const RiccatiIpSolver::Statistics &stats = riccati.getStatistics();
+        const Eigen::VectorXd x_riccati = nlp_riccati.GetVariableValues();
+
+        const double objective_diff
+            = std::abs(stats.objective - objective_ipopt)
+              / std::max(1.0, std::abs(objective_ipopt));
+        const bool solved = stats.status == RiccatiIpSolver::Status::SUCCESS;
+        valid = valid && solved && (objective_diff <= max_objective_diff);
+
+        std::cout << "segments: " << num_segments << std::endl;
+        std::cout << "  ipopt:   objective = " << objective_ipopt
+                  << ", status = " << ipopt.GetReturnStatus()
+                  << ", time = " << ipopt.GetTotalWallclockTime() * 1e3
+                  << " ms" << std::endl;
+        std::cout << "  riccati: objective = " << stats.objective
+                  << ", solved = " << solved
+                  << ", iterations = " << stats.iterations
+                  << ", time = " << stats.total_time << " ms"
+                  << ", linear solve time per iteration = "
+                  << stats.linear_solve_time
+                         / std::max(1, stats.iterations)
+                  << " ms" << std::endl;
+        std::cout << "  relative objective difference = " << objective_diff
+                  << ", max variable difference = "
+                  << (x_riccati - x_ipopt).lpNorm<Eigen::Infinity>()
+                  << std::endl;
+    }
+
+    std::cout << (valid ? "PASSED" : "FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
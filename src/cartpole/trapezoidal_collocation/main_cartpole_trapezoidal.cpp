@@ -1,95 +1,36 @@
 #include <iostream>
 #include <numbers>
+#include <string>
 
 #include <ifopt/ipopt_solver.h>
 #include <ifopt/problem.h>
 
+#include "collocation_constraints.hpp"
 #include "control_effort_trapezoidal_cost.hpp"
+#include "duration_variable.hpp"
+#include "physics_initial_guess.hpp"
 #include "pinocchio/parsers/urdf.hpp"
 #include "robot_dynamics.hpp"
 #include "save_trajectory.hpp"
+#include "trajectory_bounds.hpp"
+#include "trajectory_costs.hpp"
 #include "trajectory_variables.hpp"
-#include "trapezoidal_collocation_constraints.hpp"
 #include "trapezoidal_traj_extractor.hpp"
 
 namespace pin = pinocchio;
 
-/*
- * Create an upper and lower bound for each state vector along the trajectory.
- * @param d Final position of the cart.
- * @param d_max Maximum position of the cart at any time along the trajectory.
- */
-ifopt::Component::VecBound createStateBounds(const int num_state_vars,
-                                             const int state_len,
-                                             const double d_max,
-                                             const Eigen::VectorXd &state_start,
-                                             const Eigen::VectorXd &state_end)
-{
-    // vector of bounds initally all zero
-    ifopt::Component::VecBound bounds;
-    // for each state vector
-    const int num_state_vecs = num_state_vars / state_len;
-    for (int i{}; i < num_state_vecs; ++i) {
-        if (i == 0) {
-            // initial state bounds
-            for (int j{}; j < state_len; ++j) {
-                bounds.push_back({state_start(j), state_start(j)});
-            }
-        } else if (i == num_state_vecs - 1) {
-            // final state bounds
-            for (int j{}; j < state_len; ++j) {
-                bounds.push_back({state_end(j), state_end(j)});
-            }
-        } else {
-            // path bounds
-
-            // bound for q0
-            bounds.push_back({-d_max, d_max});
-            // bound for q1
-            bounds.push_back({-2 * std::numbers::pi, 2 * std::numbers::pi});
-            // bound for dq0
-            bounds.push_back({-ifopt::inf, ifopt::inf});
-            // bound for dq1
-            bounds.push_back({-ifopt::inf, ifopt::inf});
-        }
-    }
-    assert(bounds.size() == num_state_vars);
-    return bounds;
-}
-
-ifopt::Component::VecBound createControlBounds(const int num_control_vars,
-                                               const double max_force)
-{
-    // vector of bounds all
-    ifopt::Component::VecBound bounds(num_control_vars,
-                                      {-max_force, max_force});
-    return bounds;
-}
-
-Eigen::VectorXd guessStateTraj(const int state_len,
-                               const int num_segments,
-                               const Eigen::VectorXd &state_start,
-                               const Eigen::VectorXd &state_end)
-{
-    const int num_time_pts = num_segments + 1;
-    Eigen::VectorXd ret = Eigen::VectorXd::Zero(num_time_pts * state_len);
-    // linearly interpolate from start state to end state
-    for (int k{}; k < num_time_pts; ++k) {
-        auto statek = ret(Eigen::seqN(k * state_len, state_len));
-        const double alpha
-            = static_cast<double>(k)
-              / (num_time_pts - 1);  // trajectory progress factor
-        statek = alpha * (state_end - state_start) + state_start;
-    }
-    return ret;
-}
-
 int main(int argc, char **argv)
 {
-    if (argc != 2) {
-        std::cout << "Path to model required." << std::endl;
+    if ((argc != 2) && (argc != 3)) {
+        std::cout << "Path to model required. Add --free-time to optimize the "
+                     "duration of the trajectory."
+                  << std::endl;
         return 0;
     }
+    // With a free final time traj_dur is only the initial guess of the
+    // duration, which is traded off against the control effort.
+    const bool free_time
+        = (argc == 3) && (std::string(argv[2]) == "--free-time");
 
     // Load the urdf model
     const std::string urdf_filename = argv[1];
@@ -114,69 +55,84 @@ int main(int argc, char **argv)
     const Eigen::VectorXd state_end{{d, std::numbers::pi, 0.0, 0.0}};
     // const Eigen::VectorXd state_start{{d, std::numbers::pi, 0.0, 0.0}};
     const Eigen::VectorXd state_start = Eigen::VectorXd::Zero(state_len);
-    ifopt::Component::VecBound state_bounds = createStateBounds(num_state_vars,
-                                                                state_len,
-                                                                d_max,
-                                                                state_start,
-                                                                state_end);
-
-    // init guess for state variables
-    auto state_init
-        = guessStateTraj(state_len, num_segments, state_start, state_end);
-    auto traj_state_vars
-        = std::make_shared<TrajectoryVariables>("traj_state_vars",
-                                                std::move(state_init),
-                                                std::move(state_bounds));
+    // bounds of q0, q1, dq0 and dq1
+    const ifopt::Component::VecBound path_bounds{
+        {-d_max, d_max},
+        {-2 * std::numbers::pi, 2 * std::numbers::pi},
+        {-ifopt::inf, ifopt::inf},
+        {-ifopt::inf, ifopt::inf}};
+    ifopt::Component::VecBound state_bounds = createStateBounds(
+        num_state_vars, path_bounds, state_start, state_end);
+
+    // Init guess for state and control variables from minimum jerk joint
+    // profiles and the inverse dynamics along them.
+    const int control_len = 1;
+    InitialGuess init_guess = createPhysicsInitialGuess(
+        model, state_start, state_end, control_len, traj_dur, num_segments);
+    auto traj_state_vars = std::make_shared<TrajectoryVariables>(
+        "traj_state_vars",
+        std::move(init_guess.state_vars),
+        std::move(state_bounds));
     nlp.AddVariableSet(traj_state_vars);
 
     // control bounds
-    const int control_len = 1;
     const int num_control_vars = control_len * (num_segments + 1);
     const double max_control_force = 100.0;
     ifopt::Component::VecBound control_bounds
         = createControlBounds(num_control_vars, max_control_force);
 
-    // init guess for control variables
-    auto control_init = Eigen::VectorXd::Zero(num_control_vars);
-    auto traj_control_vars
-        = std::make_shared<TrajectoryVariables>("traj_control_vars",
-                                                std::move(control_init),
-                                                std::move(control_bounds));
+    auto traj_control_vars = std::make_shared<TrajectoryVariables>(
+        "traj_control_vars",
+        std::move(init_guess.ctrl_vars),
+        std::move(control_bounds));
     nlp.AddVariableSet(traj_control_vars);
 
-    // add constraints
-    const auto dyn_fn
-        = [&](const Eigen::VectorXd &state,
-              const Eigen::VectorXd &control,
-              const double time) { return dyn(state, control, time, model); };
-    const auto jac_dyn_wrt_state_fn = [&](const Eigen::VectorXd &state,
-                                          const Eigen::VectorXd &control,
-                                          const double time) {
-        return jacDynWrtState(state, control, time, model);
-    };
-    const auto jac_dyn_wrt_control_fn = [&](const Eigen::VectorXd &state,
-                                            const Eigen::VectorXd &control,
-                                            const double time) {
-        return jacDynWrtControl(state, control, time, model);
-    };
+    // add constraints and costs
     const int num_constraints = state_len * num_segments;
-    const auto col_constraints
-        = std::make_shared<TrapezoidalCollocationConstraints>(
-            num_constraints,
-            traj_state_vars,
-            state_len,
-            traj_control_vars,
+    std::shared_ptr<CollocationConstraints<RobotDynamics>> col_constraints;
+    std::shared_ptr<DurationVariable> duration_var;
+    if (free_time) {
+        const double min_dur = 0.5;
+        const double max_dur = 5.0;
+        duration_var = std::make_shared<DurationVariable>(
+            "traj_duration", traj_dur, min_dur, max_dur);
+        nlp.AddVariableSet(duration_var);
+
+        col_constraints
+            = std::make_shared<CollocationConstraints<RobotDynamics>>(
+                num_constraints,
+                traj_state_vars,
+                state_len,
+                traj_control_vars,
+                control_len,
+                duration_var,
+                RobotDynamics(model));
+        nlp.AddCostSet(std::make_shared<ControlEffortTrapezoidalCost>(
+            "effort_cost",
+            traj_control_vars->GetName(),
+            control_len,
+            duration_var->GetName()));
+        // weight of one second against the effort in N^2*s
+        const double time_weight = 100.0;
+        nlp.AddCostSet(std::make_shared<MinimumTimeCost>(
+            "time_cost", duration_var->GetName(), time_weight));
+    } else {
+        col_constraints
+            = std::make_shared<CollocationConstraints<RobotDynamics>>(
+                num_constraints,
+                traj_state_vars,
+                state_len,
+                traj_control_vars,
+                control_len,
+                dt_segment,
+                RobotDynamics(model));
+        nlp.AddCostSet(std::make_shared<ControlEffortTrapezoidalCost>(
+            "effort_cost",
+            traj_control_vars->GetName(),
             control_len,
-            dt_segment,
-            dyn_fn,
-            jac_dyn_wrt_state_fn,
-            jac_dyn_wrt_control_fn);
+            dt_segment));
+    }
     nlp.AddConstraintSet(col_constraints);
-    nlp.AddCostSet(std::make_shared<ControlEffortTrapezoidalCost>(
-        "effort_cost",
-        traj_control_vars->GetName(),
-        control_len,
-        dt_segment));
 
     nlp.PrintCurrent();
     std::cout << "state variables: " << std::endl;
@@ -193,7 +149,7 @@ int main(int argc, char **argv)
     ipopt.SetOption("max_cpu_time", 60.0);
     // ipopt.SetOption("print_level", 5);
     // ipopt.SetOption("print_frequency_time", 3.0);
-    ipopt.SetOption("derivative_test", "first-order");
+    // the derivatives are checked offline by main_derivative_check
     ipopt.SetOption("mu_strategy", "adaptive");
     ipopt.SetOption("output_file", "ipopt.out");
 
@@ -211,21 +167,26 @@ int main(int argc, char **argv)
     ///////////////////////////////////////////////////////////////////////
     // Extract/create trajectories and save to files
     //////////////////////////////////////////////////////////////////////
+    const double opt_traj_dur
+        = free_time ? duration_var->getDuration() : traj_dur;
+    std::cout << "trajectory duration: " << opt_traj_dur << std::endl;
+    // The extractor views the solution, which is kept here.
+    const Eigen::VectorXd state_values = traj_state_vars->GetValues();
+    const Eigen::VectorXd ctrl_values = traj_control_vars->GetValues();
     TrapezoidalTrajExtractor traj_extractor(start_time,
-                                            traj_dur,
-                                            traj_state_vars->GetValues(),
+                                            opt_traj_dur,
+                                            state_values,
                                             state_len,
-                                            traj_control_vars->GetValues(),
+                                            ctrl_values,
                                             control_len,
-                                            dt_segment,
                                             model,
-                                            dyn);
+                                            computeDyn);
     saveDiscreteJointStateTrajCsv(
         "collocation-state-traj-trapezoidal-cartpole.csv",
-        traj_extractor.createCollocationStateTraj(model));
+        traj_extractor.createCollocationStateTraj());
     saveDiscreteJointDataTrajCsv(
         "collocation-ctrl-traj-trapezoidal-cartpole.csv",
-        traj_extractor.createCollocationCtrlTraj(model));
+        traj_extractor.createCollocationCtrlTraj());
 
     // save sample trajectory to file
     const double sample_period = 0.020;
@@ -10,6 +10,7 @@
 #include <cstring>
 #include <deque>
 #include <iostream>
+#include <ranges>
 #include <thread>
 #include <vector>
 #include <utility>
@@ -539,22 +540,39 @@ bool SO101Bus::execute_traj_full(const DiscreteJointStateTraj &traj,
                                  const PosUnit pos_unit,
                                  DiscreteJointStateTraj& meas_traj)
 {
-  if (traj.empty()) return true;
+  return execute_traj_(traj, pos_unit, meas_traj);
+}
+
+bool SO101Bus::execute_traj_full(const SampledStateTrajView &traj,
+                                 const PosUnit pos_unit,
+                                 DiscreteJointStateTraj& meas_traj)
+{
+  return execute_traj_(traj, pos_unit, meas_traj);
+}
+
+template <typename Traj>
+bool SO101Bus::execute_traj_(const Traj &traj,
+                             const PosUnit pos_unit,
+                             DiscreteJointStateTraj& meas_traj)
+{
+  if (std::ranges::empty(traj)) return true;
 
   if (!ensure_connected_()) return false;
 
   const int fd = port_.fd();
   const auto& ids = cfg_.ids;
 
-  // align t=0 with the first waypoint timestamp
-  const double t0 = traj.front().time;
+  // align t=0 with the first waypoint timestamp, in a single pass over the
+  // waypoints
+  double t0 = 0.0;
   const auto start = std::chrono::steady_clock::now();
   double max_sample_time_err_ms = 0.0;
 
   std::array<uint16_t, 6> last_target_pos_tic{};
 
-  for (size_t i = 0; i < traj.size(); ++i) {
-    const JointState& e = traj[i];
+  size_t i = 0;
+  for (const JointState& e : traj) {
+    if (i == 0) t0 = e.time;
 
     // sleep until the scheduled send time
     double rel_s = e.time - t0;
@@ -595,7 +613,7 @@ bool SO101Bus::execute_traj_full(const DiscreteJointStateTraj &traj,
     std::cout << "]" << std::endl;
 
     if (!write_all_positions(target_pos_tic, cfg_.rw_timeout_ms)) {
-      std::fprintf(stderr, "execute_traj_full(deque): waypoint %zu sync write failed\n", i);
+      std::fprintf(stderr, "execute_traj_full: waypoint %zu sync write failed\n", i);
       return false;
     }
     last_target_pos_tic = target_pos_tic;
@@ -610,7 +628,7 @@ bool SO101Bus::execute_traj_full(const DiscreteJointStateTraj &traj,
                   .ddq = Eigen::VectorXd::Zero(cfg_.ids.size())};
     if (!read_all_states(cfg_.rw_timeout_ms, pos_unit, js.q, js.dq)) {
       std::fprintf(stderr,
-                   "execute_traj_full(deque): read_all_states failed "
+                   "execute_traj_full: read_all_states failed "
                    "after waypoint %zu\n",
                    i);
       return false;
@@ -622,6 +640,7 @@ bool SO101Bus::execute_traj_full(const DiscreteJointStateTraj &traj,
     }
 
     meas_traj.push_back(std::move(js));
+    ++i;
   }
 
   if (cfg_.record_timing_stats) {
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "calibration.hpp"
+#include "sampled_state_traj_view.hpp"
 #include "traj_element.hpp"
 
 // SO101Bus: feetech bus operations adn position only trajectory execution
@@ -82,6 +83,14 @@ public:
                          const PosUnit pos_unit,
                          DiscreteJointStateTraj& meas_traj);
 
+  /*
+   * @brief Same as above, but the waypoints are evaluated from the view while
+   * the trajectory is executed, so they are not stored.
+   */
+  bool execute_traj_full(const SampledStateTrajView &traj,
+                         const PosUnit pos_unit,
+                         DiscreteJointStateTraj& meas_traj);
+
   static int  open_port_1Mbps(const char* path);
 
   [[nodiscard]] bool feetech_ping(uint8_t id, int timeout_ms);
@@ -135,6 +144,12 @@ public:
   };
   bool ensure_connected_();
 
+  // execute_traj_full() for a deque or a view of waypoints
+  template <typename Traj>
+  bool execute_traj_(const Traj &traj,
+                     const PosUnit pos_unit,
+                     DiscreteJointStateTraj& meas_traj);
+
     const Config cfg_;
   Port   port_;
 };
@@ -96,6 +96,16 @@ void Simulator::setTrajectory(DiscreteJointStateTraj target_traj)
     // todo: validate size of state
     m_target_traj_orig = std::move(target_traj);
     m_target_traj = m_target_traj_orig;
+    m_target_view.reset();
+}
+
+void Simulator::setTrajectory(SampledStateTrajView target_traj)
+{
+    m_target_traj_orig.clear();
+    m_target_traj.clear();
+    m_target_view = std::move(target_traj);
+    m_target_view_it = m_target_view->begin();
+    m_target_view_sample.reset();
 }
 
 void Simulator::setCsvRecordFileName(const std::string& name)
@@ -175,6 +185,10 @@ void Simulator::reset()
         timer.reset();
     }
     m_target_traj = m_target_traj_orig;
+    if (m_target_view) {
+        m_target_view_it = m_target_view->begin();
+        m_target_view_sample.reset();
+    }
     m_traj_record.clear();
     m_timers.find(TimerId::Record)->second.reset(true);
 }
@@ -295,6 +309,19 @@ void Simulator::updateControl()
     // std::cout << "updateControl() time: " << m_data->time << std::endl;
 
     // get the last control input up to the current time
+    if (m_target_view) {
+        // The last sample is kept, like the element that is put back on the
+        // queue below.
+        while (m_target_view_it != std::default_sentinel
+               && (m_target_view_it->time < m_data->time)) {
+            m_target_view_sample = *m_target_view_it;
+            ++m_target_view_it;
+        }
+        if (m_target_view_sample) {
+            setControl(*m_target_view_sample);
+        }
+        return;
+    }
     std::optional<JointState> e;
     while (!m_target_traj.empty()
            && (m_target_traj.front().time < m_data->time)) {
@@ -313,9 +340,24 @@ void Simulator::updateControl()
     // used for the control input.
     m_target_traj.push_front(*e);
 
-    for (size_t i{}; i < e->q.size(); ++i) {
-        m_data->ctrl[i] = e->q(i);
+    setControl(*e);
+}
+
+void Simulator::setControl(const JointState &target)
+{
+    for (size_t i{}; i < target.q.size(); ++i) {
+        m_data->ctrl[i] = target.q(i);
+    }
+}
+
+bool Simulator::isTargetTrajDone() const
+{
+    if (m_target_view) {
+        return (m_target_view_it == std::default_sentinel)
+               && m_target_view_sample.has_value();
     }
+    // only the last element is left on the queue
+    return m_target_traj.size() == 1;
 }
 
 void Simulator::record()
@@ -336,7 +378,7 @@ void Simulator::record()
                                        .ddq = std::move(ddq)});
 
     // save the recording if the end of the target trajectory is reached
-    if ((m_target_traj.size() == 1) && !m_traj_record.empty()) {
+    if (isTargetTrajDone() && !m_traj_record.empty()) {
         std::cout << "saving recording" << std::endl;
         saveDiscreteJointStateTrajCsv(m_record_filename_csv, m_traj_record);
         // stop recording by disabling the record timer
@@ -10,6 +10,7 @@
 #include <optional>
 #include <sstream>
 #include <thread>
+#include <sampled_state_traj_view.hpp>
 #include <traj_element.hpp>
 
 #include <GLFW/glfw3.h>
@@ -26,6 +27,10 @@ public:
 
     void setTrajectory(DiscreteJointStateTraj target_traj);
 
+    // Same as above, but the samples are evaluated while the simulation
+    // runs, so the trajectory is not stored. A reset starts a new pass.
+    void setTrajectory(SampledStateTrajView target_traj);
+
     void setCsvRecordFileName(const std::string& name);
     
     void run();
@@ -55,7 +60,11 @@ private:
     void dispFrame();
 
     void updateControl();
+    // position targets of the actuators
+    void setControl(const JointState &target);
     void record();
+    // The sim time has passed the last element of the target trajectory.
+    bool isTargetTrajDone() const;
 
     const int m_control_step_ms;
     const int m_frame_step_ms;
@@ -96,6 +105,11 @@ private:
     DiscreteJointStateTraj m_target_traj_orig;
     // target trajectory that gets popped during sim
     DiscreteJointStateTraj m_target_traj;
+    // lazy target trajectory, if set instead of m_target_traj, the iterator
+    // of the current pass and the last sample up to the sim time
+    std::optional<SampledStateTrajView> m_target_view;
+    SampledStateTrajView::Iterator m_target_view_it;
+    std::optional<JointState> m_target_view_sample;
     // recorded actual trajectory
     DiscreteJointStateTraj m_traj_record;
 
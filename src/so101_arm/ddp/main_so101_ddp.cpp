@@ -0,0 +1,140 @@
+#include <chrono>
+#include <iostream>
+#include <numbers>
+#include <pinocchio/parsers/mjcf.hpp>
+
+#include "box_ddp_solver.hpp"
+#include "euler_traj_extractor.hpp"
+#include "robot_dynamics.hpp"
+#include "save_trajectory.hpp"
+
+namespace pin = pinocchio;
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        std::cout << "Path to model required." << std::endl;
+        return 0;
+    }
+
+    // Load the mujoco model
+    const std::string mj_filename = argv[1];
+    pin::Model model;
+    pin::mjcf::buildModel(mj_filename, model);
+    std::cout << "model name: " << model.name << std::endl;
+
+    // define problem
+    const double start_time = 0.0;
+    const double traj_dur = 2.0;
+    const int num_segments = 100;
+    const double dt_segment = traj_dur / num_segments;
+
+    const int state_len = 6 * 2;
+    const int control_len = 6;
+    const Eigen::VectorXd state_start = Eigen::VectorXd::Zero(state_len);
+    Eigen::VectorXd state_end = Eigen::VectorXd::Zero(state_len);
+    state_end(0) = -std::numbers::pi / 4;
+
+    // control bounds
+    const double rated_torque_kgcm = 10 / 1.2;
+    const double gravity = 9.81;
+    const double max_control_force = rated_torque_kgcm * gravity / 100.0;
+    const Eigen::VectorXd control_max
+        = Eigen::VectorXd::Constant(control_len, max_control_force);
+    const Eigen::VectorXd control_min = -control_max;
+
+    // Penalize the control effort along the trajectory and the distance to the
+    // goal state at the end of the trajectory.
+    DdpCost cost{.state_goal = state_end,
+                 .state_weights = Eigen::VectorXd::Zero(state_len),
+                 .terminal_state_weights
+                 = Eigen::VectorXd::Constant(state_len, 1e3),
+                 .control_weights = Eigen::VectorXd::Ones(control_len)};
+
+    const auto dyn_fn
+        = [&](const Eigen::VectorXd &state,
+              const Eigen::VectorXd &control,
+              const double time) { return dyn(state, control, time, model); };
+    const auto jac_dyn_wrt_state_fn = [&](const Eigen::VectorXd &state,
+                                          const Eigen::VectorXd &control,
+                                          const double time) {
+        return jacDynWrtState(state, control, time, model);
+    };
+    const auto jac_dyn_wrt_control_fn = [&](const Eigen::VectorXd &state,
+                                            const Eigen::VectorXd &control,
+                                            const double time) {
+        return jacDynWrtControl(state, control, time, model);
+    };
+
+    BoxDdpSolver solver(state_len,
+                        control_len,
+                        num_segments,
+                        dt_segment,
+                        dyn_fn,
+                        jac_dyn_wrt_state_fn,
+                        jac_dyn_wrt_control_fn,
+                        cost,
+                        control_min,
+                        control_max,
+                        DdpOptions{});
+
+    // solve from rest with zero controls
+    const Eigen::VectorXd ctrl_init
+        = Eigen::VectorXd::Zero(control_len * (num_segments + 1));
+    auto t_start = std::chrono::steady_clock::now();
+    const BoxDdpSolver::Result result = solver.solve(state_start, ctrl_init);
+    std::chrono::duration<double, std::milli> solve_ms
+        = std::chrono::steady_clock::now() - t_start;
+    std::cout << "DDP solve: cost = " << result.cost
+              << ", iterations = " << result.iterations
+              << ", converged = " << result.converged
+              << ", time = " << solve_ms.count() << " ms" << std::endl;
+    std::cout << "final state: "
+              << result.state_vars.tail(state_len).transpose() << std::endl;
+
+    // Replan to a slightly shifted goal, warm started from the previous
+    // solution.
+    Eigen::VectorXd state_end_shifted = state_end;
+    state_end_shifted(0) += 0.05;
+    solver.setStateGoal(state_end_shifted);
+    t_start = std::chrono::steady_clock::now();
+    const BoxDdpSolver::Result replan_result
+        = solver.solve(state_start, result.ctrl_vars);
+    solve_ms = std::chrono::steady_clock::now() - t_start;
+    std::cout << "DDP replan: cost = " << replan_result.cost
+              << ", iterations = " << replan_result.iterations
+              << ", converged = " << replan_result.converged
+              << ", time = " << solve_ms.count() << " ms" << std::endl;
+
+    ///////////////////////////////////////////////////////////////////////
+    // Extract/create trajectories and save to files
+    //////////////////////////////////////////////////////////////////////
+    // The DDP rolls out the dynamics with the explicit Euler method, so the
+    // trajectories are interpolated consistently with it. The replanned
+    // solution is the one to execute.
+    EulerTrajExtractor traj_extractor(start_time,
+                                      traj_dur,
+                                      replan_result.state_vars,
+                                      state_len,
+                                      replan_result.ctrl_vars,
+                                      control_len,
+                                      dt_segment,
+                                      model,
+                                      computeDyn);
+    saveDiscreteJointStateTrajCsv(
+        "collocation-state-traj-ddp-so101.csv",
+        traj_extractor.createCollocationStateTraj());
+    saveDiscreteJointDataTrajCsv(
+        "collocation-ctrl-traj-ddp-so101.csv",
+        traj_extractor.createCollocationCtrlTraj());
+
+    const double sample_period = 0.020;
+    saveDiscreteJointStateTrajCsv(
+        "sample-state-traj-ddp-so101.csv",
+        traj_extractor.createSampledStateTraj(sample_period));
+    saveDiscreteJointDataTrajCsv(
+        "sample-ctrl-traj-ddp-so101.csv",
+        traj_extractor.createSampledCtrlTraj(sample_period));
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include <cmath>
+#include <iostream>
+#include <numbers>
+#include <pinocchio/parsers/mjcf.hpp>
+
+#include <ifopt/ipopt_solver.h>
+#include <ifopt/problem.h>
+
+#include "collocation_constraints.hpp"
+#include "physics_initial_guess.hpp"
+#include "riccati_ip_solver.hpp"
+#include "robot_dynamics.hpp"
+#include "trajectory_bounds.hpp"
+#include "trajectory_costs.hpp"
+#include "trajectory_variables.hpp"
+
+namespace pin = pinocchio;
+
+/*
+ * Add the variables, constraints and cost of the SO101 reaching problem with
+ * trapezoidal collocation.
+ * @param state_end Goal state of the reach.
+ * @param traj_dur Duration of the trajectory.
+ */
+void createSo101Problem(ifopt::Problem &nlp,
+                        const pin::Model &model,
+                        const int num_segments,
+                        const Eigen::VectorXd &state_end,
+                        const double traj_dur)
+{
+    const double dt_segment = traj_dur / num_segments;
+
+    const int state_len = 6 * 2;
+    const int num_state_vars = (num_segments + 1) * state_len;
+    const Eigen::VectorXd state_start = Eigen::VectorXd::Zero(state_len);
+    // joint position bounds of the arm, end effector (gripper) bounds and
+    // free joint velocities
+    ifopt::Component::VecBound path_bounds(
+        state_len / 2 - 1,
+        {-1.0 / 4.0 * std::numbers::pi, 1.0 / 4.0 * std::numbers::pi});
+    path_bounds.push_back({0.0, 2.25});
+    path_bounds.resize(state_len, {-ifopt::inf, ifopt::inf});
+    auto traj_state_vars = std::make_shared<TrajectoryVariables>(
+        "traj_state_vars",
+        createLinearStateGuess(state_start, state_end, num_segments),
+        createStateBounds(
+            num_state_vars, path_bounds, state_start, state_end));
+    nlp.AddVariableSet(traj_state_vars);
+
+    const int control_len = 6;
+    const int num_control_vars = control_len * (num_segments + 1);
+    const double rated_torque_kgcm = 10 / 1.2;
+    const double gravity = 9.81;
+    const double max_control_force = rated_torque_kgcm * gravity / 100.0;
+    auto traj_control_vars = std::make_shared<TrajectoryVariables>(
+        "traj_control_vars",
+        Eigen::VectorXd::Zero(num_control_vars),
+        createControlBounds(num_control_vars, max_control_force));
+    nlp.AddVariableSet(traj_control_vars);
+
+    const auto col_constraints
+        = std::make_shared<CollocationConstraints<RobotDynamics>>(
+            state_len * num_segments,
+            traj_state_vars,
+            state_len,
+            traj_control_vars,
+            control_len,
+            dt_segment,
+            RobotDynamics(model));
+    nlp.AddConstraintSet(col_constraints);
+    // The same effort as ControlEffortTrapezoidalCost, but with a constant
+    // hessian that the Riccati solver adds exactly.
+    nlp.AddCostSet(std::make_shared<ControlEffortCost>(
+        "effort_cost",
+        trapezoidalQuadrature(
+            traj_control_vars->GetName(), num_segments, dt_segment),
+        Eigen::VectorXd::Ones(control_len)));
+}
+
+/*
+ * Solve the SO101 reaching problem with IPOPT and with the structure
+ * exploiting interior point solver for an increasing number of segments, and
+ * compare the solutions. The time of the linear solves of the Riccati solver
+ * should grow linearly with the number of segments.
+ *
+ * Then shift the goal state and the duration slightly, and compare the
+ * sensitivity update of the Riccati solution with a full solve of the shifted
+ * problem.
+ */
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        std::cout << "Path to model required." << std::endl;
+        return 0;
+    }
+
+    // Load the mujoco model
+    const std::string mj_filename = argv[1];
+    pin::Model model;
+    pin::mjcf::buildModel(mj_filename, model);
+    std::cout << "model name: " << model.name << std::endl;
+
+    const int state_len = 6 * 2;
+    const int control_len = 6;
+    StageLayout layout;
+    layout.var_block_lens = {{"traj_state_vars", state_len},
+                             {"traj_control_vars", control_len}};
+    layout.constraint_block_lens = {{"trap_col_constraints", state_len}};
+
+    Eigen::VectorXd state_end = Eigen::VectorXd::Zero(state_len);
+    state_end(0) = -std::numbers::pi / 4;
+    const double traj_dur = 2.0;
+
+    const double tol = 1e-6;
+    // maximum relative difference of the objectives
+    const double max_objective_diff = 1e-3;
+    bool valid = true;
+
+    for (const int num_segments : {10, 20, 40, 80}) {
+        ifopt::Problem nlp_ipopt;
+        createSo101Problem(nlp_ipopt, model, num_segments, state_end, traj_dur);
+        ifopt::IpoptSolver ipopt;
+        ipopt.SetOption("tol", tol);
+        ipopt.SetOption("max_iter", 3000);
+        ipopt.SetOption("max_cpu_time", 60.0);
+        ipopt.SetOption("print_level", 0);
+        ipopt.Solve(nlp_ipopt);
+        const Eigen::VectorXd x_ipopt = nlp_ipopt.GetVariableValues();
+        const double objective_ipopt
+            = nlp_ipopt.EvaluateCostFunction(x_ipopt.data());
+
+        ifopt::Problem nlp_riccati;
+        createSo101Problem(
+            nlp_riccati, model, num_segments, state_end, traj_dur);
+        RiccatiIpOptions options;
+        options.tol = tol;
+        options.print = false;
+        RiccatiIpSolver riccati(layout, options);
+        riccati.Solve(nlp_riccati);
+        const RiccatiIpSolver::Statistics &stats = riccati.getStatistics();
+        const Eigen::VectorXd x_riccati = nlp_riccati.GetVariableValues();
+
+        const double objective_diff
+            = std::abs(stats.objective - objective_ipopt)
+              / std::max(1.0, std::abs(objective_ipopt));
+        const bool solved = stats.status == RiccatiIpSolver::Status::SUCCESS;
+        valid = valid && solved && (objective_diff <= max_objective_diff);
+
+        std::cout << "segments: " << num_segments << std::endl;
+        std::cout << "  ipopt:   objective = " << objective_ipopt
+                  << ", status = " << ipopt.GetReturnStatus()
+                  << ", time = " << ipopt.GetTotalWallclockTime() * 1e3
+                  << " ms" << std::endl;
+        std::cout << "  riccati: objective = " << stats.objective
+                  << ", solved = " << solved
+                  << ", iterations = " << stats.iterations
+                  << ", time = " << stats.total_time << " ms"
+                  << ", linear solve time per iteration = "
+                  << stats.linear_solve_time
+                         / std::max(1, stats.iterations)
+                  << " ms" << std::endl;
+        std::cout << "  relative objective difference = " << objective_diff
+                  << ", max variable difference = "
+                  << (x_riccati - x_ipopt).lpNorm<Eigen::Infinity>()
+                  << std::endl;
+    }
+
+    // sensitivity update for a re-detected goal
+    {
+        const int num_segments = 40;
+        ifopt::Problem nlp;
+        createSo101Problem(nlp, model, num_segments, state_end, traj_dur);
+        RiccatiIpOptions options;
+        options.tol = tol;
+        options.print = false;
+        RiccatiIpSolver riccati(layout, options);
+        riccati.Solve(nlp);
+        const Eigen::VectorXd x_nominal = nlp.GetVariableValues();
+
+        Eigen::VectorXd state_end_shifted = state_end;
+        state_end_shifted(0) += 0.02;
+        state_end_shifted(1) -= 0.02;
+        const double traj_dur_shifted = traj_dur + 0.02;
+
+        ifopt::Problem nlp_full;
+        createSo101Problem(nlp_full,
+                           model,
+                           num_segments,
+                           state_end_shifted,
+                           traj_dur_shifted);
+        RiccatiIpSolver riccati_full(layout, options);
+        riccati_full.Solve(nlp_full);
+        const Eigen::VectorXd x_full = nlp_full.GetVariableValues();
+        const double error_nominal
+            = (x_nominal - x_full).lpNorm<Eigen::Infinity>();
+        std::cout << "goal shift, segments: " << num_segments << std::endl;
+        std::cout << "  full solve: time = "
+                  << riccati_full.getStatistics().total_time
+                  << " ms, max variable difference to nominal = "
+                  << error_nominal << std::endl;
+
+        for (const int num_corrector_iter : {0, 1, 3}) {
+            ifopt::Problem nlp_sens;
+            createSo101Problem(nlp_sens,
+                               model,
+                               num_segments,
+                               state_end_shifted,
+                               traj_dur_shifted);
+            const RiccatiIpSolver::SensitivityStatistics sens_stats
+                = riccati.sensitivityUpdate(nlp_sens, num_corrector_iter);
+            const double error
+                = (nlp_sens.GetVariableValues() - x_full)
+                      .lpNorm<Eigen::Infinity>();
+            valid = valid && (error < error_nominal);
+            std::cout << "  sensitivity update with " << num_corrector_iter
+                      << " corrector iterations: time = " << sens_stats.time
+                      << " ms, constraint violation = "
+                      << sens_stats.constraint_violation
+                      << ", max variable difference to full solve = "
+                      << error << std::endl;
+        }
+    }
+
+    std::cout << (valid ? "PASSED" : "FAILED") << std::endl;
+    return valid ? 0 : 1;
+}
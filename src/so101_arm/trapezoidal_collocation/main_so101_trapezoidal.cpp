@@ -1,105 +1,59 @@
 #include <iostream>
 #include <numbers>
+#include <optional>
 #include <pinocchio/parsers/mjcf.hpp>
 #include <so101_bus.hpp>
 
-#include <ifopt/ipopt_solver.h>
 #include <ifopt/problem.h>
 
-#include "control_effort_trapezoidal_cost.hpp"
+#include "collocation_constraints.hpp"
+#include "control_basis.hpp"
+#include "nlp_scaling.hpp"
+#include "physics_initial_guess.hpp"
+#include "reduced_model.hpp"
 #include "robot_dynamics.hpp"
 #include "save_trajectory.hpp"
 #include "simulator.hpp"
+#include "traj_compression.hpp"
+#include "trajectory_bounds.hpp"
+#include "trajectory_costs.hpp"
 #include "trajectory_variables.hpp"
-#include "trapezoidal_collocation_constraints.hpp"
 #include "trapezoidal_traj_extractor.hpp"
 
 namespace pin = pinocchio;
 
-/*
- * Create an upper and lower bound for each state vector along the trajectory.
- */
-ifopt::Component::VecBound createStateBounds(const int num_state_vars,
-                                             const int state_len,
-                                             const Eigen::VectorXd &state_start,
-                                             const Eigen::VectorXd &state_end)
-{
-    // vector of bounds initally all zero
-    ifopt::Component::VecBound bounds;
-    // for each state vector
-    const int num_state_vecs = num_state_vars / state_len;
-    for (int i{}; i < num_state_vecs; ++i) {
-        if (i == 0) {
-            // initial state bounds
-            for (int j{}; j < state_len; ++j) {
-                bounds.push_back({state_start(j), state_start(j)});
-            }
-        } else if (i == num_state_vecs - 1) {
-            // final state bounds
-            for (int j{}; j < state_len; ++j) {
-                bounds.push_back({state_end(j), state_end(j)});
-            }
-        } else {
-            // path bounds
-
-            // joint positions path bounds
-            for (int j{}; j < state_len / 2 - 1; ++j) {
-                bounds.push_back({-1.0 / 4.0 * std::numbers::pi,
-                                  1.0 / 4.0 * std::numbers::pi});
-            }
-            // end effector path bounds
-            bounds.push_back({0.0, 2.25});
-            
-            // joint velocity path bounds
-            for (int j{}; j < state_len / 2; ++j) {
-                bounds.push_back({-ifopt::inf, ifopt::inf});
-            }
-        }
-    }
-    assert(bounds.size() == num_state_vars);
-    return bounds;
-}
-
-ifopt::Component::VecBound createControlBounds(const int num_control_vars,
-                                               const double max_force)
-{
-    // vector of bounds all
-    ifopt::Component::VecBound bounds(num_control_vars,
-                                      {-max_force, max_force});
-    return bounds;
-}
-
-Eigen::VectorXd guessStateTraj(const int state_len,
-                               const int num_segments,
-                               const Eigen::VectorXd &state_start,
-                               const Eigen::VectorXd &state_end)
-{
-    const int num_time_pts = num_segments + 1;
-    Eigen::VectorXd ret = Eigen::VectorXd::Zero(num_time_pts * state_len);
-    // linearly interpolate from start state to end state
-    for (int k{}; k < num_time_pts; ++k) {
-        auto statek = ret(Eigen::seqN(k * state_len, state_len));
-        const double alpha
-            = static_cast<double>(k)
-              / (num_time_pts - 1);  // trajectory progress factor
-        statek = alpha * (state_end - state_start) + state_start;
-    }
-    return ret;
-}
-
 int main(int argc, char **argv)
 {
-    if (argc != 3) {
-        std::cout << "Path to model and calibration file required (in this order)." << std::endl;
+    if ((argc < 3) || (argc > 5)) {
+        std::cout << "Path to model and calibration file required (in this "
+                     "order). Add --lock-gripper to lock the gripper at its "
+                     "start position and --ctrl-basis to parameterize the "
+                     "controls with a cubic B-spline."
+                  << std::endl;
         return 0;
     }
+    // Lock the gripper for moves where it does not change, so the
+    // optimization runs on a smaller model.
+    bool lock_gripper = false;
+    bool use_ctrl_basis = false;
+    for (int i = 3; i < argc; ++i) {
+        const std::string option(argv[i]);
+        if (option == "--lock-gripper") {
+            lock_gripper = true;
+        } else if (option == "--ctrl-basis") {
+            use_ctrl_basis = true;
+        } else {
+            std::cout << "Unknown option " << option << std::endl;
+            return 0;
+        }
+    }
     const std::string calibration_file_path(argv[2]);
     
     // Load the urdf model
     const std::string mj_filename = argv[1];
-    pin::Model model;
-    pin::mjcf::buildModel(mj_filename, model);
-    std::cout << "model name: " << model.name << std::endl;
+    pin::Model full_model;
+    pin::mjcf::buildModel(mj_filename, full_model);
+    std::cout << "model name: " << full_model.name << std::endl;
 
     // define problem
     ifopt::Problem nlp;
@@ -108,36 +62,63 @@ int main(int argc, char **argv)
     const int num_segments = 10;
     const double dt_segment = traj_dur / num_segments;
 
+    // start and end states of the full model
+    const Eigen::VectorXd full_state_end{{-std::numbers::pi / 4,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0,
+                                          0.0}};
+    const Eigen::VectorXd full_state_start
+        = Eigen::VectorXd::Zero(full_state_end.size());
+
+    // Without locked joints the reduced model equals the full model.
+    const std::vector<std::string> locked_joints
+        = lock_gripper ? std::vector<std::string>{"gripper"}
+                       : std::vector<std::string>{};
+    const ReducedModel reduced = buildLockedJointsModel(
+        full_model, locked_joints, full_state_start.head(full_model.nq));
+    const pin::Model &model = reduced.model;
+
     // state bounds
-    const int state_len = 6 * 2;
+    const int state_len = model.nq + model.nv;
     const int num_state_vars = (num_segments + 1) * state_len;
-    const Eigen::VectorXd state_end{{-std::numbers::pi / 4,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0,
-                                     0.0}};
-    const Eigen::VectorXd state_start = Eigen::VectorXd::Zero(state_len);
-    ifopt::Component::VecBound state_bounds
-        = createStateBounds(num_state_vars, state_len, state_start, state_end);
+    const Eigen::VectorXd state_end = reduceState(reduced, full_state_end);
+    const Eigen::VectorXd state_start = reduceState(reduced, full_state_start);
+    // joint position bounds of the arm and the end effector (gripper) of the
+    // full model, selected for the joints of the reduced model, and free
+    // joint velocities
+    ifopt::Component::VecBound full_q_bounds(
+        full_model.nq,
+        {-1.0 / 4.0 * std::numbers::pi, 1.0 / 4.0 * std::numbers::pi});
+    full_q_bounds[full_model.idx_qs[full_model.getJointId("gripper")]]
+        = {0.0, 2.25};
+    ifopt::Component::VecBound path_bounds;
+    for (const int i : reduced.q_indices) {
+        path_bounds.push_back(full_q_bounds[i]);
+    }
+    path_bounds.resize(state_len, {-ifopt::inf, ifopt::inf});
+    ifopt::Component::VecBound state_bounds = createStateBounds(
+        num_state_vars, path_bounds, state_start, state_end);
 
-    // init guess for state variables
-    auto state_init
-        = guessStateTraj(state_len, num_segments, state_start, state_end);
-    auto traj_state_vars
-        = std::make_shared<TrajectoryVariables>("traj_state_vars",
-                                                std::move(state_init),
-                                                state_bounds);
+    // Init guess for state and control variables from minimum jerk joint
+    // profiles and the inverse dynamics along them.
+    const int control_len = model.nv;
+    InitialGuess init_guess = createPhysicsInitialGuess(
+        model, state_start, state_end, control_len, traj_dur, num_segments);
+    auto traj_state_vars = std::make_shared<TrajectoryVariables>(
+        "traj_state_vars",
+        std::move(init_guess.state_vars),
+        state_bounds);
     nlp.AddVariableSet(traj_state_vars);
 
     // control bounds
-    const int control_len = 6;
     const int num_control_vars = control_len * (num_segments + 1);
     const double rated_torque_kgcm = 10 / 1.2;
     const double gravity = 9.81;
@@ -145,47 +126,55 @@ int main(int argc, char **argv)
     ifopt::Component::VecBound control_bounds
         = createControlBounds(num_control_vars, max_control_force);
 
-    // init guess for control variables
-    auto control_init = Eigen::VectorXd::Zero(num_control_vars);
-    auto traj_control_vars
-        = std::make_shared<TrajectoryVariables>("traj_control_vars",
-                                                std::move(control_init),
-                                                control_bounds);
+    // With --ctrl-basis, parameterize the controls with a cubic B-spline,
+    // whose coefficients are the control variables. It gives smooth torques
+    // and a smaller NLP. The basis functions are nonnegative and sum to one,
+    // so the torque bounds apply to the coefficients as well.
+    const int num_ctrl_coeffs = 6;
+    const int ctrl_basis_degree = 3;
+    std::optional<ControlBasis> ctrl_basis;
+    std::shared_ptr<TrajectoryVariables> traj_control_vars;
+    if (use_ctrl_basis) {
+        ctrl_basis.emplace(bSplineControlBasis(
+            num_segments + 1, num_ctrl_coeffs, ctrl_basis_degree));
+        traj_control_vars = std::make_shared<TrajectoryVariables>(
+            "traj_control_vars",
+            ctrl_basis->fitCoefficients(init_guess.ctrl_vars, control_len),
+            createControlBounds(num_ctrl_coeffs * control_len,
+                                max_control_force));
+    } else {
+        traj_control_vars = std::make_shared<TrajectoryVariables>(
+            "traj_control_vars",
+            std::move(init_guess.ctrl_vars),
+            control_bounds);
+    }
     nlp.AddVariableSet(traj_control_vars);
 
     // add constraints
-    const auto dyn_fn
-        = [&](const Eigen::VectorXd &state,
-              const Eigen::VectorXd &control,
-              const double time) { return dyn(state, control, time, model); };
-    const auto jac_dyn_wrt_state_fn = [&](const Eigen::VectorXd &state,
-                                          const Eigen::VectorXd &control,
-                                          const double time) {
-        return jacDynWrtState(state, control, time, model);
-    };
-    const auto jac_dyn_wrt_control_fn = [&](const Eigen::VectorXd &state,
-                                            const Eigen::VectorXd &control,
-                                            const double time) {
-        return jacDynWrtControl(state, control, time, model);
-    };
     const int num_constraints = state_len * num_segments;
     const auto col_constraints
-        = std::make_shared<TrapezoidalCollocationConstraints>(
+        = std::make_shared<CollocationConstraints<RobotDynamics>>(
             num_constraints,
             traj_state_vars,
             state_len,
             traj_control_vars,
             control_len,
             dt_segment,
-            dyn_fn,
-            jac_dyn_wrt_state_fn,
-            jac_dyn_wrt_control_fn);
+            RobotDynamics(model));
+    const Quadrature quadrature = trapezoidalQuadrature(
+        traj_control_vars->GetName(), num_segments, dt_segment);
+    if (ctrl_basis) {
+        col_constraints->setControlBasis(*ctrl_basis);
+        nlp.AddCostSet(std::make_shared<ControlBasisEffortCost>(
+            "effort_cost",
+            quadrature.front(),
+            *ctrl_basis,
+            Eigen::VectorXd::Ones(control_len)));
+    } else {
+        nlp.AddCostSet(std::make_shared<ControlEffortCost>(
+            "effort_cost", quadrature, Eigen::VectorXd::Ones(control_len)));
+    }
     nlp.AddConstraintSet(col_constraints);
-    nlp.AddCostSet(std::make_shared<ControlEffortTrapezoidalCost>(
-        "effort_cost",
-        traj_control_vars->GetName(),
-        control_len,
-        dt_segment));
 
     nlp.PrintCurrent();
     std::cout << "state variables: " << std::endl;
@@ -195,14 +184,15 @@ int main(int argc, char **argv)
     std::cout << "collocation constraint values:" << std::endl;
     std::cout << col_constraints->GetValues().transpose() << std::endl;
 
-    // choose solver and options
-    ifopt::IpoptSolver ipopt;
+    // choose solver and options. The variables, defects and cost are scaled
+    // automatically from the bounds and the jacobian at the initial guess.
+    ScaledIpoptSolver ipopt;
     ipopt.SetOption("tol", 1e-3);
     ipopt.SetOption("max_iter", 3000);
     ipopt.SetOption("max_cpu_time", 60.0);
     // ipopt.SetOption("print_level", 5);
     // ipopt.SetOption("print_frequency_time", 3.0);
-    ipopt.SetOption("derivative_test", "first-order");
+    // the derivatives are checked offline by main_derivative_check
     ipopt.SetOption("mu_strategy", "adaptive");
     ipopt.SetOption("output_file", "ipopt.out");
 
@@ -220,31 +210,55 @@ int main(int argc, char **argv)
     ///////////////////////////////////////////////////////////////////////
     // Extract/create trajectories and save to files
     //////////////////////////////////////////////////////////////////////
+    // The extractor views the solution, which is kept here.
+    const Eigen::VectorXd state_values = traj_state_vars->GetValues();
+    // controls at the knot points
+    const Eigen::VectorXd ctrl_values
+        = ctrl_basis
+              ? ctrl_basis->evalControls(traj_control_vars->GetValues(),
+                                         control_len)
+              : traj_control_vars->GetValues();
     TrapezoidalTrajExtractor traj_extractor(start_time,
                                             traj_dur,
-                                            traj_state_vars->GetValues(),
+                                            state_values,
                                             state_len,
-                                            traj_control_vars->GetValues(),
+                                            ctrl_values,
                                             control_len,
                                             dt_segment,
                                             model,
-                                            dyn);
+                                            computeDyn);
+    // The trajectories are expanded to the joints of the full model, with
+    // the locked joints held at their positions.
+    const DiscreteJointStateTraj col_state_traj = expandStateTraj(
+        reduced, traj_extractor.createCollocationStateTraj());
     saveDiscreteJointStateTrajCsv(
-        "collocation-state-traj-trapezoidal-so101.csv",
-        traj_extractor.createCollocationStateTraj(model));
+        "collocation-state-traj-trapezoidal-so101.csv", col_state_traj);
     saveDiscreteJointDataTrajCsv(
         "collocation-ctrl-traj-trapezoidal-so101.csv",
-        traj_extractor.createCollocationCtrlTraj(model));
+        expandCtrlTraj(reduced,
+                       full_model,
+                       col_state_traj,
+                       traj_extractor.createCollocationCtrlTraj()));
 
     // save sample trajectory to file
     const double sample_period = 0.020;
-    const DiscreteJointStateTraj sampled_state_traj
-        = traj_extractor.createSampledStateTraj(sample_period);
-    saveDiscreteJointStateTrajCsv("sample-state-traj-trapezoidal-so101.csv",
-                                  sampled_state_traj);
-    saveDiscreteJointDataTrajCsv(
-        "sample-ctrl-traj-trapezoidal-so101.csv",
-        traj_extractor.createSampledCtrlTraj(sample_period));
+    // The simulator and the arm evaluate the samples while they run, so the
+    // samples are only stored for the files.
+    const SampledStateTrajView sampled_state_view = expandStateTraj(
+        reduced, traj_extractor.viewSampledStateTraj(sample_period));
+    {
+        const DiscreteJointStateTraj sampled_state_traj
+            = sampled_state_view.toTraj();
+        saveDiscreteJointStateTrajCsv(
+            "sample-state-traj-trapezoidal-so101.csv", sampled_state_traj);
+        saveDiscreteJointDataTrajCsv(
+            "sample-ctrl-traj-trapezoidal-so101.csv",
+            expandCtrlTraj(
+                reduced,
+                full_model,
+                sampled_state_traj,
+                traj_extractor.createSampledCtrlTraj(sample_period)));
+    }
 
     // save bounds
     saveColBoundsCsv("state-traj-bounds-trapezoidal-so101.csv",
@@ -262,7 +276,7 @@ int main(int argc, char **argv)
     // Send trajectory to simulated robot
     //////////////////////////////////////////////////////////////////////
     Simulator::getInstance()->setCsvRecordFileName("sim-record-state-traj-trapezoidal-so101.csv");
-    Simulator::getInstance()->setTrajectory(sampled_state_traj);
+    Simulator::getInstance()->setTrajectory(sampled_state_view);
 
     Simulator::getInstance()->run();
 
@@ -283,8 +297,19 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    // The servos hold each goal position until the next one, so samples
+    // within half a tic (4095 per revolution) of the last sent goal are
+    // skipped, which reduces the serial traffic on slow segments.
+    const DiscreteJointStateTraj hw_state_traj
+        = compressStateTraj(sampled_state_view,
+                            Eigen::VectorXd::Constant(full_model.nq,
+                                                      std::numbers::pi / 4095),
+                            WaypointReconstruction::Hold);
+    std::cout << "sending " << hw_state_traj.size() << " of "
+              << sampled_state_view.size() << " waypoints" << std::endl;
+
     DiscreteJointStateTraj meas_traj;
-    if (!bus.execute_traj_full(sampled_state_traj, PosUnit::RADIAN, meas_traj)) {
+    if (!bus.execute_traj_full(hw_state_traj, PosUnit::RADIAN, meas_traj)) {
         std::cerr << "trajectory execution failed\n";
         return 2;
     }
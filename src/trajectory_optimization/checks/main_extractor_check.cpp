@@ -0,0 +1,535 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "euler_traj_extractor.hpp"
+#include "hs_traj_extractor.hpp"
+#include "knot_dynamics.hpp"
+#include "pinocchio/parsers/urdf.hpp"
+#include "robot_dynamics.hpp"
+#include "sampled_state_traj_view.hpp"
+#include "traj_compression.hpp"
+#include "trapezoidal_traj_extractor.hpp"
+
+/*
+ * Checks the trajectory extractors against the solution vectors they are
+ * created from and the dynamics at the knot points, and checks that the lazy
+ * view, the threaded dynamics and the duration constructors give the same
+ * trajectories as the plain evaluation.
+ */
+
+namespace pin = pinocchio;
+
+// Sizes of the trajectories that are checked. The samples are a quarter of a
+// segment apart, so every fourth sample is at a knot point and every other
+// one at a midpoint.
+const int num_segments = 6;
+const double start_time = 0.5;
+const double traj_dur = 2.0;
+const double dt_segment = traj_dur / num_segments;
+const double sample_period = dt_segment / 4;
+const int samples_per_segment = 4;
+
+// The extractors view their solution vectors, so a temporary must not bind.
+static_assert(std::is_constructible_v<SolutionView, const Eigen::VectorXd &>);
+static_assert(!std::is_constructible_v<SolutionView, Eigen::VectorXd>);
+static_assert(std::is_constructible_v<TrapezoidalTrajExtractor,
+                                      double,
+                                      double,
+                                      const Eigen::VectorXd &,
+                                      int,
+                                      const Eigen::VectorXd &,
+                                      int,
+                                      const pin::Model &,
+                                      const KnotDynFn &>);
+static_assert(!std::is_constructible_v<TrapezoidalTrajExtractor,
+                                       double,
+                                       double,
+                                       Eigen::VectorXd,
+                                       int,
+                                       const Eigen::VectorXd &,
+                                       int,
+                                       const pin::Model &,
+                                       const KnotDynFn &>);
+
+// Returns the largest absolute error of a check.
+using CheckFn = std::function<double()>;
+
+double maxError(const Eigen::Ref<const Eigen::VectorXd> &value,
+                const Eigen::Ref<const Eigen::VectorXd> &expected)
+{
+    return (value - expected).cwiseAbs().maxCoeff();
+}
+
+// Error of a trajectory point w.r.t a state [q; dq] and its time derivative
+// [dq; ddq].
+double stateError(const JointState &point,
+                  const double time,
+                  const Eigen::Ref<const Eigen::VectorXd> &state,
+                  const Eigen::Ref<const Eigen::VectorXd> &dstate_dt)
+{
+    const int nv = state.size() / 2;
+    return std::max({std::abs(point.time - time),
+                     maxError(point.q, state.head(nv)),
+                     maxError(point.dq, state.tail(nv)),
+                     maxError(point.ddq, dstate_dt.tail(nv))});
+}
+
+double dataError(const JointData &point,
+                 const double time,
+                 const Eigen::Ref<const Eigen::VectorXd> &data)
+{
+    return std::max(std::abs(point.time - time), maxError(point.data, data));
+}
+
+// Error between two state trajectories, infinite if their sizes differ.
+double trajError(const DiscreteJointStateTraj &traj,
+                 const DiscreteJointStateTraj &expected)
+{
+    if (traj.size() != expected.size()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double max_error{};
+    for (std::size_t i{}; i < traj.size(); ++i) {
+        const JointState &point = expected[i];
+        Eigen::VectorXd state(point.q.size() + point.dq.size());
+        Eigen::VectorXd dstate_dt(state.size());
+        state << point.q, point.dq;
+        dstate_dt << point.dq, point.ddq;
+        max_error = std::max(max_error,
+                             stateError(traj[i], point.time, state, dstate_dt));
+    }
+    return max_error;
+}
+
+// Stacked dynamics at the stacked states and controls, one point at a time.
+Eigen::VectorXd computeKnotDynamics(const pin::Model &model,
+                                    const Eigen::VectorXd &state_vars,
+                                    const Eigen::VectorXd &ctrl_vars)
+{
+    const int state_len = model.nq + model.nv;
+    const int ctrl_len = model.nv;
+    DynamicsWorkspace ws(model);
+    Eigen::VectorXd dyn_vals(state_vars.size());
+    for (int k{}; k < state_vars.size() / state_len; ++k) {
+        computeDyn(state_vars.segment(k * state_len, state_len),
+                   ctrl_vars.segment(k * ctrl_len, ctrl_len),
+                   0.0,
+                   model,
+                   ws,
+                   dyn_vals.segment(k * state_len, state_len));
+    }
+    return dyn_vals;
+}
+
+// Error of the iteration over a view w.r.t the materialized samples.
+double viewError(const SampledStateTrajView &view,
+                 const DiscreteJointStateTraj &expected)
+{
+    DiscreteJointStateTraj traj;
+    for (const JointState &sample : view) {
+        traj.push_back(sample);
+    }
+    if (view.size() != static_cast<int>(expected.size())) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return std::max(trajError(traj, expected),
+                    trajError(view.toTraj(), expected));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        std::cout << "Path to model required." << std::endl;
+        return 0;
+    }
+    const std::string urdf_filename = argv[1];
+    pin::Model model;
+    pin::urdf::buildModel(urdf_filename, model);
+    std::cout << "model name: " << model.name << std::endl;
+
+    const int state_len = model.nq + model.nv;
+    const int ctrl_len = model.nv;
+    const int num_knots = num_segments + 1;
+
+    // Random solution vectors. They do not satisfy the collocation
+    // constraints, so the checks only use what holds for any solution.
+    // Eigen::VectorXd::Random() is not seeded, so they are the same in every
+    // run.
+    const Eigen::VectorXd state_vars
+        = Eigen::VectorXd::Random(num_knots * state_len);
+    const Eigen::VectorXd ctrl_vars
+        = Eigen::VectorXd::Random(num_knots * ctrl_len);
+    const Eigen::VectorXd state_mid_vars
+        = Eigen::VectorXd::Random(num_segments * state_len);
+    const Eigen::VectorXd ctrl_mid_vars
+        = Eigen::VectorXd::Random(num_segments * ctrl_len);
+    const Eigen::VectorXd dyn_vals
+        = computeKnotDynamics(model, state_vars, ctrl_vars);
+    const Eigen::VectorXd mid_dyn_vals
+        = computeKnotDynamics(model, state_mid_vars, ctrl_mid_vars);
+    const auto state = [&](const Eigen::VectorXd &vars, const int k) {
+        return vars.segment(k * state_len, state_len);
+    };
+    const auto ctrl = [&](const Eigen::VectorXd &vars, const int k) {
+        return vars.segment(k * ctrl_len, ctrl_len);
+    };
+
+    TrapezoidalTrajExtractor trapezoidal(start_time,
+                                         traj_dur,
+                                         state_vars,
+                                         state_len,
+                                         ctrl_vars,
+                                         ctrl_len,
+                                         dt_segment,
+                                         model,
+                                         computeDyn);
+    HermSimpTrajExtractor hermite_simpson(start_time,
+                                          traj_dur,
+                                          state_vars,
+                                          state_mid_vars,
+                                          state_len,
+                                          ctrl_vars,
+                                          ctrl_mid_vars,
+                                          ctrl_len,
+                                          dt_segment,
+                                          model,
+                                          computeDyn);
+
+    const std::vector<std::pair<std::string, CheckFn>> checks{
+        {"trapezoidal collocation points",
+         [&] {
+             const DiscreteJointStateTraj states
+                 = trapezoidal.createCollocationStateTraj();
+             const DiscreteJointDataTraj ctrls
+                 = trapezoidal.createCollocationCtrlTraj();
+             if ((states.size() != std::size_t{num_knots})
+                 || (ctrls.size() != std::size_t{num_knots})) {
+                 return std::numeric_limits<double>::infinity();
+             }
+             double max_error{};
+             for (int k{}; k < num_knots; ++k) {
+                 const double time = start_time + k * dt_segment;
+                 max_error = std::max(
+                     {max_error,
+                      stateError(states[k],
+                                 time,
+                                 state(state_vars, k),
+                                 state(dyn_vals, k)),
+                      dataError(ctrls[k], time, ctrl(ctrl_vars, k))});
+             }
+             return max_error;
+         }},
+        {"trapezoidal samples at the knot points",
+         [&] {
+             const DiscreteJointStateTraj states
+                 = trapezoidal.createSampledStateTraj(sample_period);
+             const DiscreteJointDataTraj ctrls
+                 = trapezoidal.createSampledCtrlTraj(sample_period);
+             const std::size_t min_samples = samples_per_segment * num_segments;
+             if ((states.size() < min_samples)
+                 || (ctrls.size() != states.size())) {
+                 return std::numeric_limits<double>::infinity();
+             }
+             double max_error{};
+             for (std::size_t i{}; i < states.size();
+                  i += samples_per_segment) {
+                 const int k = i / samples_per_segment;
+                 const double time = start_time + k * dt_segment;
+                 max_error = std::max(
+                     {max_error,
+                      stateError(states[i],
+                                 time,
+                                 state(state_vars, k),
+                                 state(dyn_vals, k)),
+                      dataError(ctrls[i], time, ctrl(ctrl_vars, k))});
+             }
+             return max_error;
+         }},
+        {"trapezoidal jerks",
+         [&] {
+             // The accelerations are linear within the segments. The jerks
+             // are discontinuous at the knot points, which are skipped.
+             const int nv = model.nv;
+             const DiscreteJointDataTraj jerks
+                 = trapezoidal.createSampledJerkTraj(sample_period);
+             double max_error{};
+             for (std::size_t i{}; i < jerks.size(); ++i) {
+                 if (i % samples_per_segment == 0) {
+                     continue;
+                 }
+                 const int k = i / samples_per_segment;
+                 const Eigen::VectorXd jerk
+                     = (state(dyn_vals, k + 1) - state(dyn_vals, k)).tail(nv)
+                       / dt_segment;
+                 max_error = std::max(
+                     max_error,
+                     dataError(jerks[i], start_time + i * sample_period, jerk));
+             }
+             return max_error;
+         }},
+        {"Hermite-Simpson collocation points",
+         [&] {
+             // knot points and midpoints alternate
+             const DiscreteJointStateTraj states
+                 = hermite_simpson.createCollocationStateTraj();
+             const DiscreteJointDataTraj ctrls
+                 = hermite_simpson.createCollocationCtrlTraj();
+             const std::size_t num_points = num_knots + num_segments;
+             if ((states.size() != num_points)
+                 || (ctrls.size() != num_points)) {
+                 return std::numeric_limits<double>::infinity();
+             }
+             double max_error{};
+             for (int k{}; k < num_knots; ++k) {
+                 const double time = start_time + k * dt_segment;
+                 max_error = std::max(
+                     {max_error,
+                      stateError(states[2 * k],
+                                 time,
+                                 state(state_vars, k),
+                                 state(dyn_vals, k)),
+                      dataError(ctrls[2 * k], time, ctrl(ctrl_vars, k))});
+                 if (k == num_segments) {
+                     break;
+                 }
+                 const double mid_time = time + 0.5 * dt_segment;
+                 max_error = std::max(
+                     {max_error,
+                      stateError(states[2 * k + 1],
+                                 mid_time,
+                                 state(state_mid_vars, k),
+                                 state(mid_dyn_vals, k)),
+                      dataError(
+                          ctrls[2 * k + 1], mid_time, ctrl(ctrl_mid_vars, k))});
+             }
+             return max_error;
+         }},
+        {"Hermite-Simpson samples at the collocation points",
+         [&] {
+             // The states are only interpolated through the knot points, the
+             // controls through the knot points and the midpoints.
+             const DiscreteJointStateTraj states
+                 = hermite_simpson.createSampledStateTraj(sample_period);
+             const DiscreteJointDataTraj ctrls
+                 = hermite_simpson.createSampledCtrlTraj(sample_period);
+             const std::size_t min_samples = samples_per_segment * num_segments;
+             if ((states.size() < min_samples)
+                 || (ctrls.size() != states.size())) {
+                 return std::numeric_limits<double>::infinity();
+             }
+             double max_error{};
+             const int samples_per_half = samples_per_segment / 2;
+             for (std::size_t i{}; i < states.size(); i += samples_per_half) {
+                 const int k = i / samples_per_segment;
+                 const double time = start_time + i * sample_period;
+                 if (i % samples_per_segment != 0) {
+                     max_error = std::max(
+                         max_error,
+                         dataError(ctrls[i], time, ctrl(ctrl_mid_vars, k)));
+                     continue;
+                 }
+                 max_error = std::max(
+                     {max_error,
+                      stateError(states[i],
+                                 time,
+                                 state(state_vars, k),
+                                 state(dyn_vals, k)),
+                      dataError(ctrls[i], time, ctrl(ctrl_vars, k))});
+             }
+             return max_error;
+         }},
+        {"Euler samples",
+         [&] {
+             // Linear states and zero-order hold of the controls, which are
+             // discontinuous at the knot points.
+             EulerTrajExtractor euler(start_time,
+                                      traj_dur,
+                                      state_vars,
+                                      state_len,
+                                      ctrl_vars,
+                                      ctrl_len,
+                                      dt_segment,
+                                      model,
+                                      computeDyn);
+             const DiscreteJointStateTraj states
+                 = euler.createSampledStateTraj(sample_period);
+             const DiscreteJointDataTraj ctrls
+                 = euler.createSampledCtrlTraj(sample_period);
+             if (ctrls.size() != states.size()) {
+                 return std::numeric_limits<double>::infinity();
+             }
+             const int nv = model.nv;
+             double max_error{};
+             for (std::size_t i{}; i < states.size(); ++i) {
+                 const int k = std::min<int>(i / samples_per_segment,
+                                             num_segments - 1);
+                 const double s = (i - k * samples_per_segment)
+                                  / static_cast<double>(samples_per_segment);
+                 const Eigen::VectorXd expected
+                     = (1 - s) * state(state_vars, k)
+                       + s * state(state_vars, k + 1);
+                 const JointState &point = states[i];
+                 max_error = std::max(
+                     {max_error,
+                      std::abs(point.time - start_time - i * sample_period),
+                      maxError(point.q, expected.head(nv)),
+                      maxError(point.dq, expected.tail(nv))});
+                 if (i % samples_per_segment != 0) {
+                     max_error = std::max(
+                         max_error,
+                         dataError(ctrls[i], point.time, ctrl(ctrl_vars, k)));
+                 }
+             }
+             return max_error;
+         }},
+        {"sampled state trajectory views",
+         [&] {
+             return std::max(
+                 viewError(trapezoidal.viewSampledStateTraj(sample_period),
+                           trapezoidal.createSampledStateTraj(sample_period)),
+                 viewError(
+                     hermite_simpson.viewSampledStateTraj(sample_period),
+                     hermite_simpson.createSampledStateTraj(sample_period)));
+         }},
+        {"transformed and compressed views",
+         [&] {
+             // streaming consumers of a view against the materialized
+             // samples
+             const SampledStateTrajView view
+                 = trapezoidal.viewSampledStateTraj(sample_period);
+             DiscreteJointStateTraj doubled = view.toTraj();
+             for (JointState &sample : doubled) {
+                 sample.q *= 2.0;
+             }
+             double max_error = viewError(
+                 view.transform([](const JointState &sample, JointState &out) {
+                     out = sample;
+                     out.q *= 2.0;
+                 }),
+                 doubled);
+             const Eigen::VectorXd tolerance
+                 = Eigen::VectorXd::Constant(model.nq, 1e-3);
+             for (const WaypointReconstruction reconstruction :
+                  {WaypointReconstruction::Linear,
+                   WaypointReconstruction::Hold}) {
+                 const DiscreteJointStateTraj waypoints
+                     = compressStateTraj(view, tolerance, reconstruction);
+                 const DiscreteJointStateTraj expected = compressStateTraj(
+                     view.toTraj(), tolerance, reconstruction);
+                 if (waypoints.size() != expected.size()) {
+                     return std::numeric_limits<double>::infinity();
+                 }
+                 max_error
+                     = std::max(max_error, trajError(waypoints, expected));
+             }
+             return max_error;
+         }},
+        {"knot dynamics on a thread pool",
+         [&] {
+             // The pool is reused by all evaluations, like for a batch of
+             // solutions, and has more threads than some of the ranges.
+             double max_error{};
+             Eigen::VectorXd threaded_dyn_vals(state_vars.size());
+             for (const int num_threads : {0, 4, 64}) {
+                 KnotDynamicsPool pool(model, num_threads);
+                 for (int i{}; i < 3; ++i) {
+                     threaded_dyn_vals.setZero();
+                     evalKnotDynamics(computeDyn,
+                                      model,
+                                      state_vars,
+                                      state_len,
+                                      ctrl_vars,
+                                      ctrl_len,
+                                      start_time,
+                                      dt_segment,
+                                      &pool,
+                                      threaded_dyn_vals);
+                     max_error = std::max(
+                         max_error, maxError(threaded_dyn_vals, dyn_vals));
+                 }
+             }
+             KnotDynamicsPool pool(model, 4);
+             TrapezoidalTrajExtractor threaded(start_time,
+                                               traj_dur,
+                                               state_vars,
+                                               state_len,
+                                               ctrl_vars,
+                                               ctrl_len,
+                                               dt_segment,
+                                               model,
+                                               computeDyn,
+                                               &pool);
+             HermSimpTrajExtractor threaded_hs(start_time,
+                                               traj_dur,
+                                               state_vars,
+                                               state_mid_vars,
+                                               state_len,
+                                               ctrl_vars,
+                                               ctrl_mid_vars,
+                                               ctrl_len,
+                                               dt_segment,
+                                               model,
+                                               computeDyn,
+                                               &pool);
+             return std::max(
+                 {max_error,
+                  trajError(threaded.createCollocationStateTraj(),
+                            trapezoidal.createCollocationStateTraj()),
+                  trajError(threaded_hs.createCollocationStateTraj(),
+                            hermite_simpson.createCollocationStateTraj())});
+         }},
+        {"duration constructors", [&] {
+             // The segment durations are derived from the duration.
+             TrapezoidalTrajExtractor trapezoidal_dur(start_time,
+                                                      traj_dur,
+                                                      state_vars,
+                                                      state_len,
+                                                      ctrl_vars,
+                                                      ctrl_len,
+                                                      model,
+                                                      computeDyn);
+             HermSimpTrajExtractor hermite_simpson_dur(start_time,
+                                                       traj_dur,
+                                                       state_vars,
+                                                       state_mid_vars,
+                                                       state_len,
+                                                       ctrl_vars,
+                                                       ctrl_mid_vars,
+                                                       ctrl_len,
+                                                       model,
+                                                       computeDyn);
+             return std::max(
+                 trajError(trapezoidal_dur.createCollocationStateTraj(),
+                           trapezoidal.createCollocationStateTraj()),
+                 trajError(hermite_simpson_dur.createCollocationStateTraj(),
+                           hermite_simpson.createCollocationStateTraj()));
+         }}};
+
+    const double tol = 1e-9;
+    bool passed = true;
+    for (const auto &[name, check] : checks) {
+        double error = std::numeric_limits<double>::infinity();
+        try {
+            error = check();
+        } catch (const std::exception &e) {
+            std::cout << name << ": " << e.what() << std::endl;
+        }
+        std::cout << name << ": max error " << error << std::endl;
+        passed = passed && (error <= tol);
+    }
+    std::cout << (passed ? "all extractor checks within tolerance "
+                         : "extractor checks exceed tolerance ")
+              << tol << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "cubic_spline.hpp"
+#include "linear_spline.hpp"
+#include "polynomial_interpolation.hpp"
+#include "polynomial_spline.hpp"
+#include "quadratic_spline.hpp"
+
+/*
+ * Checks the polynomial splines against the interpolation formulas they
+ * replace (see polynomial_interpolation.hpp), and the faster evaluation paths
+ * (fixed sizes, uniform sampling, cursors and analytic derivatives) against
+ * the plain evaluation.
+ */
+
+// Sizes of the splines that are checked.
+const int dim = 4;
+const int num_knots = 6;
+const double start_time = 0.5;
+const double duration = 2.0;
+
+// Value of the interpolation formula of segment k, of duration h, at time dt
+// from the start of the segment.
+using ReferenceFn = std::function<Eigen::VectorXd(
+    const int k, const double h, const double dt)>;
+
+// Returns the largest absolute error of a check.
+using CheckFn = std::function<double()>;
+
+// Times at which the splines are compared, non-decreasing. The knot times and
+// times within each segment.
+std::vector<double> createCheckTimes(const Eigen::VectorXd &knot_times)
+{
+    std::vector<double> times;
+    for (int k{}; k < knot_times.size() - 1; ++k) {
+        const double h = knot_times(k + 1) - knot_times(k);
+        for (const double s : {0.0, 0.1, 0.25, 0.5, 0.7, 0.9}) {
+            times.push_back(knot_times(k) + s * h);
+        }
+    }
+    times.push_back(knot_times(knot_times.size() - 1));
+    return times;
+}
+
+/*
+ * Knot values whose differences are the trapezoidal integrals of the
+ * gradients, as for a trapezoidal collocation solution. The quadratic spline
+ * through them is continuous, so it matches interp_quad() at the end time.
+ */
+Eigen::MatrixXd integrateTrapezoidal(const Eigen::MatrixXd &grad_vals,
+                                     const Eigen::VectorXd &knot_times)
+{
+    Eigen::MatrixXd func_vals = Eigen::MatrixXd::Zero(dim, num_knots);
+    for (int k{}; k < num_knots - 1; ++k) {
+        const double h = knot_times(k + 1) - knot_times(k);
+        func_vals.col(k + 1)
+            = func_vals.col(k)
+              + 0.5 * h * (grad_vals.col(k) + grad_vals.col(k + 1));
+    }
+    return func_vals;
+}
+
+// Segment of a time, ie. the last segment that starts at or before it.
+int findSegment(const Eigen::VectorXd &knot_times, const double time)
+{
+    int k{};
+    while ((k < knot_times.size() - 2) && (knot_times(k + 1) <= time)) {
+        ++k;
+    }
+    return k;
+}
+
+double maxError(const Eigen::Ref<const Eigen::MatrixXd> &value,
+                const Eigen::Ref<const Eigen::MatrixXd> &expected)
+{
+    return (value - expected).cwiseAbs().maxCoeff();
+}
+
+template <typename Spline>
+double maxReferenceError(const Spline &spline,
+                         const Eigen::VectorXd &knot_times,
+                         const ReferenceFn &reference)
+{
+    double max_error{};
+    for (const double time : createCheckTimes(knot_times)) {
+        const int k = findSegment(knot_times, time);
+        const double h = knot_times(k + 1) - knot_times(k);
+        max_error = std::max(
+            max_error,
+            maxError(spline.getValue(time),
+                     reference(k, h, time - knot_times(k))));
+    }
+    return max_error;
+}
+
+/*
+ * Compares the uniform samples and a cursor with getValue() and
+ * getDerivative(), up to the derivative of order max_order.
+ */
+template <typename Spline>
+double maxSamplingError(const Spline &spline,
+                        const Eigen::VectorXd &knot_times,
+                        const int max_order)
+{
+    using Vector = typename Spline::Vector;
+    double max_error{};
+    Vector value(dim);
+    Vector expected(dim);
+
+    const double dt = 0.05;
+    const int num_samples = 40;
+    for (int order{}; order <= max_order; ++order) {
+        const typename Spline::Knots samples = spline.sampleUniform(
+            knot_times(0), dt, num_samples, order);
+        for (int i{}; i < num_samples; ++i) {
+            spline.getDerivative(knot_times(0) + i * dt, order, expected);
+            max_error = std::max(max_error, maxError(samples.col(i), expected));
+        }
+    }
+
+    auto cursor = spline.getCursor();
+    for (const double time : createCheckTimes(knot_times)) {
+        for (int order{}; order <= max_order; ++order) {
+            cursor.getDerivative(time, order, value);
+            spline.getDerivative(time, order, expected);
+            max_error = std::max(max_error, maxError(value, expected));
+        }
+    }
+
+    // the cursor holds the end value after the end time
+    const double end_time = knot_times(knot_times.size() - 1);
+    cursor.getValue(end_time + 0.1, value);
+    return std::max(max_error, maxError(value, spline.getValue(end_time)));
+}
+
+/*
+ * Compares the analytic derivatives of order 1 to max_order with central
+ * differences of the derivative of one order lower, within the segments.
+ */
+template <typename Spline>
+double maxDerivativeError(const Spline &spline,
+                          const Eigen::VectorXd &knot_times,
+                          const int max_order)
+{
+    using Vector = typename Spline::Vector;
+    const double step = 1e-5;
+    double max_error{};
+    Vector value(dim);
+    Vector value_plus(dim);
+    Vector value_minus(dim);
+    for (int k{}; k < knot_times.size() - 1; ++k) {
+        const double h = knot_times(k + 1) - knot_times(k);
+        for (const double s : {0.3, 0.6}) {
+            const double time = knot_times(k) + s * h;
+            for (int order{1}; order <= max_order; ++order) {
+                spline.getDerivative(time, order, value);
+                spline.getDerivative(time + step, order - 1, value_plus);
+                spline.getDerivative(time - step, order - 1, value_minus);
+                max_error = std::max(
+                    max_error,
+                    maxError(value, (value_plus - value_minus) / (2 * step)));
+            }
+        }
+    }
+    return max_error;
+}
+
+// Returns the number of calls that did not throw std::invalid_argument.
+double countMissingThrows(const std::vector<std::function<void()>> &calls)
+{
+    double num_missing{};
+    for (const auto &call : calls) {
+        try {
+            call();
+            ++num_missing;
+        } catch (const std::invalid_argument &) {
+        }
+    }
+    return num_missing;
+}
+
+int main()
+{
+    // Eigen::MatrixXd::Random() is not seeded, so the knots are the same in
+    // every run.
+    const Eigen::MatrixXd func_vals = Eigen::MatrixXd::Random(dim, num_knots);
+    const Eigen::MatrixXd grad_vals = Eigen::MatrixXd::Random(dim, num_knots);
+    const Eigen::MatrixXd mid_vals
+        = Eigen::MatrixXd::Random(dim, num_knots - 1);
+    const Eigen::VectorXd uniform_times
+        = uniformKnotTimes(num_knots, start_time, duration);
+    Eigen::VectorXd knot_times(num_knots);
+    knot_times << 0.5, 0.6, 1.1, 1.3, 2.0, 2.5;
+
+    // Hermite basis functions, see CubicSpline
+    const ReferenceFn cubic_ref
+        = [&](const int k, const double h, const double dt) {
+              const double s = dt / h;
+              return Eigen::VectorXd(
+                  (2 * s * s * s - 3 * s * s + 1) * func_vals.col(k)
+                  + (s * s * s - 2 * s * s + s) * h * grad_vals.col(k)
+                  + (-2 * s * s * s + 3 * s * s) * func_vals.col(k + 1)
+                  + (s * s * s - s * s) * h * grad_vals.col(k + 1));
+          };
+    // values at the knots of the trapezoidal reference
+    const Eigen::MatrixXd uniform_integral
+        = integrateTrapezoidal(grad_vals, uniform_times);
+    const Eigen::MatrixXd integral
+        = integrateTrapezoidal(grad_vals, knot_times);
+    const auto create_gradient_ref = [&](const Eigen::MatrixXd &vals) {
+        return ReferenceFn(
+            [&](const int k, const double h, const double dt) {
+                return interp_quad<Eigen::VectorXd>(vals.col(k),
+                                                    grad_vals.col(k),
+                                                    grad_vals.col(k + 1),
+                                                    h,
+                                                    dt);
+            });
+    };
+    const ReferenceFn midpoint_ref
+        = [&](const int k, const double h, const double dt) {
+              return interp_quad_midpoint<Eigen::VectorXd>(
+                  func_vals.col(k),
+                  mid_vals.col(k),
+                  func_vals.col(k + 1),
+                  h,
+                  dt);
+          };
+    const ReferenceFn linear_ref
+        = [&](const int k, const double h, const double dt) {
+              return interp_linear<Eigen::VectorXd>(
+                  func_vals.col(k), func_vals.col(k + 1), h, dt);
+          };
+
+    using QuadType = QuadraticConstraintType;
+    const CubicSpline<> cubic(func_vals, grad_vals, knot_times);
+    const CubicSpline<dim> cubic_fixed(func_vals, grad_vals, knot_times);
+    const QuadraticSpline<> quadratic(
+        integral, grad_vals, QuadType::Gradient, knot_times);
+
+    const std::vector<std::pair<std::string, CheckFn>> checks{
+        {"cubic spline, uniform knots",
+         [&] {
+             return maxReferenceError(
+                 CubicSpline<>(func_vals, grad_vals, start_time, duration),
+                 uniform_times,
+                 cubic_ref);
+         }},
+        {"cubic spline, non-uniform knots",
+         [&] { return maxReferenceError(cubic, knot_times, cubic_ref); }},
+        {"quadratic spline, gradients, uniform knots",
+         [&] {
+             return maxReferenceError(
+                 QuadraticSpline<>(uniform_integral,
+                                   grad_vals,
+                                   QuadType::Gradient,
+                                   start_time,
+                                   duration),
+                 uniform_times,
+                 create_gradient_ref(uniform_integral));
+         }},
+        {"quadratic spline, gradients, non-uniform knots",
+         [&] {
+             return maxReferenceError(
+                 quadratic, knot_times, create_gradient_ref(integral));
+         }},
+        {"quadratic spline, midpoints, uniform knots",
+         [&] {
+             return maxReferenceError(
+                 QuadraticSpline<>(func_vals,
+                                   mid_vals,
+                                   QuadType::Midpoint,
+                                   start_time,
+                                   duration),
+                 uniform_times,
+                 midpoint_ref);
+         }},
+        {"quadratic spline, midpoints, non-uniform knots",
+         [&] {
+             return maxReferenceError(
+                 QuadraticSpline<>(
+                     func_vals, mid_vals, QuadType::Midpoint, knot_times),
+                 knot_times,
+                 midpoint_ref);
+         }},
+        {"linear spline, uniform knots",
+         [&] {
+             return maxReferenceError(
+                 LinearSpline<>(func_vals, start_time, duration),
+                 uniform_times,
+                 linear_ref);
+         }},
+        {"linear spline, non-uniform knots",
+         [&] {
+             return maxReferenceError(
+                 LinearSpline<>(func_vals, knot_times), knot_times, linear_ref);
+         }},
+        {"fixed size cubic spline",
+         [&] {
+             return maxError(
+                 cubic_fixed.sampleUniform(start_time, 0.05, 40, 1),
+                 cubic.sampleUniform(start_time, 0.05, 40, 1));
+         }},
+        {"cubic spline sampling and cursor",
+         [&] { return maxSamplingError(cubic_fixed, knot_times, 3); }},
+        {"quadratic spline sampling and cursor",
+         [&] { return maxSamplingError(quadratic, knot_times, 2); }},
+        {"cubic spline derivatives",
+         [&] { return maxDerivativeError(cubic_fixed, knot_times, 3); }},
+        {"quadratic spline derivatives",
+         [&] { return maxDerivativeError(quadratic, knot_times, 2); }},
+        {"invalid arguments throw", [&] {
+             const Eigen::VectorXd unsorted_times = knot_times.reverse();
+             return countMissingThrows({
+                 [&] {
+                     CubicSpline<>(func_vals.leftCols(1),
+                                   grad_vals.leftCols(1),
+                                   start_time,
+                                   duration);
+                 },
+                 [&] { CubicSpline<>(func_vals, mid_vals, knot_times); },
+                 [&] { CubicSpline<>(func_vals, grad_vals, unsorted_times); },
+                 [&] {
+                     QuadraticSpline<>(
+                         func_vals, grad_vals, QuadType::Midpoint, knot_times);
+                 },
+                 [&] { LinearSpline<>(func_vals, unsorted_times); },
+                 [&] { cubic.getValue(start_time - 0.1); },
+                 [&] { cubic.getValue(knot_times(num_knots - 1) + 0.1); },
+                 [&] { cubic.sampleUniform(start_time, 0.1, 30); },
+             });
+         }}};
+
+    const double tol = 1e-6;
+    bool passed = true;
+    for (const auto &[name, check] : checks) {
+        double error = std::numeric_limits<double>::infinity();
+        try {
+            error = check();
+        } catch (const std::exception &e) {
+            std::cout << name << ": " << e.what() << std::endl;
+        }
+        std::cout << name << ": max error " << error << std::endl;
+        passed = passed && (error <= tol);
+    }
+    std::cout << (passed ? "all spline checks within tolerance "
+                         : "spline checks exceed tolerance ")
+              << tol << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include "quadrature.hpp"
+
+#include <cassert>
+
+Quadrature trapezoidalQuadrature(const std::string &var_set,
+                                 const int num_segments,
+                                 const double dt_segment)
+{
+    assert(num_segments > 0);
+    const int num_knots = num_segments + 1;
+    QuadratureWeights knots{var_set,
+                            Eigen::VectorXd::Constant(num_knots, dt_segment),
+                            Eigen::VectorXd::LinSpaced(
+                                num_knots, 0.0, num_segments * dt_segment)};
+    knots.weights(0) = 0.5 * dt_segment;
+    knots.weights(num_segments) = 0.5 * dt_segment;
+    return {knots};
+}
+
+Quadrature hermiteSimpsonQuadrature(const std::string &var_set,
+                                    const std::string &mid_var_set,
+                                    const int num_segments,
+                                    const double dt_segment)
+{
+    assert(num_segments > 0);
+    const int num_knots = num_segments + 1;
+    const double duration = num_segments * dt_segment;
+    QuadratureWeights knots{
+        var_set,
+        Eigen::VectorXd::Constant(num_knots, dt_segment / 3.0),
+        Eigen::VectorXd::LinSpaced(num_knots, 0.0, duration)};
+    knots.weights(0) = dt_segment / 6.0;
+    knots.weights(num_segments) = dt_segment / 6.0;
+
+    QuadratureWeights mids{
+        mid_var_set,
+        Eigen::VectorXd::Constant(num_segments, 2.0 * dt_segment / 3.0),
+        Eigen::VectorXd::LinSpaced(num_segments,
+                                   0.5 * dt_segment,
+                                   duration - 0.5 * dt_segment)};
+    return {knots, mids};
+}
+
+Quadrature timeWeightedQuadrature(
+    Quadrature quadrature,
+    const std::function<double(double)> &time_weight)
+{
+    for (auto &term : quadrature) {
+        for (int k{}; k < term.weights.size(); ++k) {
+            term.weights(k) *= time_weight(term.times(k));
+        }
+    }
+    return quadrature;
+}
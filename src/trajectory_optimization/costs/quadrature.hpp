@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+// Quadrature of an integral over the trajectory for the vectors of one
+// variable set. The integral of g(u(t)) is approximated by
+// sum_k weights(k)*g(u_k), where u_k is vector k of the variable set at time
+// times(k).
+struct QuadratureWeights
+{
+    std::string var_set;
+    Eigen::VectorXd weights;
+    Eigen::VectorXd times;
+};
+
+// A quadrature rule of a collocation scheme, with one entry per variable set
+// that holds vectors at the quadrature points (eg. the knot controls and the
+// midpoint controls of Hermite-Simpson collocation).
+using Quadrature = std::vector<QuadratureWeights>;
+
+/*
+ * Trapezoidal quadrature over num_segments segments of equal duration, with
+ * one vector per knot point: weights [h/2, h, ..., h, h/2].
+ */
+Quadrature trapezoidalQuadrature(const std::string &var_set,
+                                 const int num_segments,
+                                 const double dt_segment);
+
+/*
+ * Simpson quadrature of Hermite-Simpson collocation, with one vector per knot
+ * point and one vector per segment midpoint. The knot weights are
+ * [h/6, h/3, ..., h/3, h/6] and the midpoint weights are 2h/3.
+ */
+Quadrature hermiteSimpsonQuadrature(const std::string &var_set,
+                                    const std::string &mid_var_set,
+                                    const int num_segments,
+                                    const double dt_segment);
+
+/*
+ * Multiply the weights of a quadrature by a function of time, eg. to penalize
+ * the later part of a trajectory more with time_weight(t) = t*t.
+ */
+Quadrature timeWeightedQuadrature(
+    Quadrature quadrature,
+    const std::function<double(double)> &time_weight);
@@ -0,0 +1,440 @@
+#include "trajectory_costs.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+#include "evaluation_arena.hpp"
+
+namespace
+{
+    std::shared_ptr<TrajectoryVariables> getTrajectoryVariables(
+        const ifopt::Composite::Ptr &x_init,
+        const std::string &var_set,
+        const std::string &cost_name)
+    {
+        const auto vars = x_init->GetComponent<TrajectoryVariables>(var_set);
+        if (!vars) {
+            throw std::invalid_argument(cost_name
+                                        + ". No trajectory variables named "
+                                        + var_set);
+        }
+        return vars;
+    }
+
+    // Write the gradient of a cost w.r.t the variables col_start,
+    // col_start+1, ... into the jacobian (a single row). The values are
+    // updated in place if the jacobian already has these entries (eg. from
+    // the previous call), otherwise the entries are appended in order, so no
+    // triplets are needed.
+    void fillGradient(const Eigen::Ref<const Eigen::VectorXd> &grad,
+                      const int col_start,
+                      ifopt::Component::Jacobian &jac)
+    {
+        const Eigen::Index num_entries = grad.size();
+        if ((num_entries > 0) && jac.isCompressed()
+            && (jac.nonZeros() == num_entries)
+            && (jac.innerIndexPtr()[0] == col_start)
+            && (jac.innerIndexPtr()[num_entries - 1]
+                == col_start + num_entries - 1)) {
+            Eigen::Map<Eigen::VectorXd>(jac.valuePtr(), num_entries) = grad;
+            return;
+        }
+        jac.setZero();
+        jac.reserve(num_entries);
+        jac.startVec(0);
+        for (int i{}; i < num_entries; ++i) {
+            jac.insertBack(0, col_start + i) = grad(i);
+        }
+        jac.finalize();
+    }
+
+    // Diagonal hessian with the given diagonal, starting at the variable
+    // index start.
+    ifopt::Component::Jacobian diagonalHessian(const int num_vars,
+                                               const int start,
+                                               const Eigen::VectorXd &diag)
+    {
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(diag.size());
+        for (int i{}; i < diag.size(); ++i) {
+            triplets.push_back({start + i, start + i, diag(i)});
+        }
+        ifopt::Component::Jacobian hess(num_vars, num_vars);
+        hess.setFromTriplets(triplets.cbegin(), triplets.cend());
+        return hess;
+    }
+}
+
+QuadraticCostTerm::QuadraticCostTerm(const std::string &cost_name)
+    : CostTerm(cost_name)
+{}
+
+bool QuadraticCostTerm::hasConstantHessian() const
+{
+    return true;
+}
+
+const ifopt::Component::Jacobian &QuadraticCostTerm::getHessian(
+    const std::string &var_set) const
+{
+    const auto it = m_hessians.find(var_set);
+    if (it == m_hessians.cend()) {
+        return m_zero_hessian;
+    }
+    return it->second;
+}
+
+ControlEffortCost::ControlEffortCost(const std::string &cost_name,
+                                     Quadrature quadrature,
+                                     const Eigen::VectorXd &ctrl_weights)
+    : QuadraticCostTerm(cost_name)
+    , m_quadrature{std::move(quadrature)}
+    , m_ctrl_weights{ctrl_weights}
+    , m_ctrl_len{static_cast<int>(ctrl_weights.size())}
+{}
+
+ControlEffortCost::ControlEffortCost(const std::string &cost_name,
+                                     Quadrature quadrature,
+                                     const Eigen::VectorXd &ctrl_weights,
+                                     const std::string &duration_vars_name)
+    : QuadraticCostTerm(cost_name)
+    , m_quadrature{std::move(quadrature)}
+    , m_ctrl_weights{ctrl_weights}
+    , m_ctrl_len{static_cast<int>(ctrl_weights.size())}
+    , m_duration_vars_name{duration_vars_name}
+{}
+
+void ControlEffortCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    if (!m_duration_vars_name.empty()) {
+        m_duration_var
+            = x_init->GetComponent<DurationVariable>(m_duration_vars_name);
+        if (!m_duration_var) {
+            throw std::invalid_argument(GetName()
+                                        + ". No duration variable named "
+                                        + m_duration_vars_name);
+        }
+    }
+
+    m_vars.clear();
+    m_weights.clear();
+    m_grads.clear();
+    m_hessians.clear();
+    for (const auto &term : m_quadrature) {
+        const auto vars
+            = getTrajectoryVariables(x_init, term.var_set, GetName());
+        if (vars->GetRows() != term.weights.size() * m_ctrl_len) {
+            throw std::invalid_argument(
+                GetName() + ". The quadrature of " + term.var_set
+                + " does not match the number of control vectors.");
+        }
+        m_vars.push_back(vars);
+
+        // W(i, k) = r_i*w_k, so J = sum(W.*U.^2), dJ/dU = 2*W.*U and the
+        // hessian is diagonal with entries 2*W for a fixed final time.
+        Eigen::MatrixXd weights = m_ctrl_weights * term.weights.transpose();
+        if (hasConstantHessian()) {
+            m_hessians[term.var_set]
+                = diagonalHessian(vars->GetRows(),
+                                  0,
+                                  2.0 * weights.reshaped().eval());
+        }
+        m_weights.push_back(std::move(weights));
+        m_grads.push_back(Eigen::MatrixXd(m_ctrl_len, term.weights.size()));
+    }
+}
+
+bool ControlEffortCost::hasConstantHessian() const
+{
+    return m_duration_vars_name.empty();
+}
+
+double ControlEffortCost::getTimeScale() const
+{
+    return m_duration_var ? m_duration_var->getDuration() : 1.0;
+}
+
+double ControlEffortCost::GetCost() const
+{
+    double cost{};
+    for (std::size_t s{}; s < m_vars.size(); ++s) {
+        // view with one control vector per column
+        const Eigen::Map<const Eigen::MatrixXd> ctrl_vecs
+            = m_vars[s]->getValuesMatrix(m_ctrl_len);
+        cost += (m_weights[s].array() * ctrl_vecs.array().square()).sum();
+    }
+    return getTimeScale() * cost;
+}
+
+void ControlEffortCost::FillJacobianBlock(std::string var_set,
+                                          ifopt::Component::Jacobian &jac) const
+{
+    if (m_duration_var && (var_set == m_duration_vars_name)) {
+        // The cost is proportional to the duration, so dJ/dT = J/T.
+        jac.coeffRef(0, 0) = GetCost() / m_duration_var->getDuration();
+        return;
+    }
+    for (std::size_t s{}; s < m_vars.size(); ++s) {
+        if (var_set != m_quadrature[s].var_set) {
+            continue;
+        }
+        const Eigen::Map<const Eigen::MatrixXd> ctrl_vecs
+            = m_vars[s]->getValuesMatrix(m_ctrl_len);
+        m_grads[s].array()
+            = 2.0 * getTimeScale() * m_weights[s].array() * ctrl_vecs.array();
+        fillGradient(m_grads[s].reshaped(), 0, jac);
+        return;
+    }
+}
+
+ControlBasisEffortCost::ControlBasisEffortCost(
+    const std::string &cost_name,
+    QuadratureWeights quadrature,
+    ControlBasis ctrl_basis,
+    const Eigen::VectorXd &ctrl_weights)
+    : QuadraticCostTerm(cost_name)
+    , m_quadrature{std::move(quadrature)}
+    , m_ctrl_basis{std::move(ctrl_basis)}
+    , m_ctrl_weights{ctrl_weights}
+    , m_ctrl_len{static_cast<int>(ctrl_weights.size())}
+{
+    if (m_quadrature.weights.size() != m_ctrl_basis.getNumKnots()) {
+        throw std::invalid_argument(
+            "ControlBasisEffortCost. The quadrature must have one weight per "
+            "knot point of the control basis.");
+    }
+}
+
+void ControlBasisEffortCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    m_coeff_vars
+        = getTrajectoryVariables(x_init, m_quadrature.var_set, GetName());
+    const int num_coeffs = m_ctrl_basis.getNumCoeffs();
+    if (m_coeff_vars->GetRows() != num_coeffs * m_ctrl_len) {
+        throw std::invalid_argument(
+            GetName() + ". The control basis of " + m_quadrature.var_set
+            + " does not match the number of coefficient vectors.");
+    }
+
+    const Eigen::SparseMatrix<double> basis = m_ctrl_basis.getMatrix();
+    m_quad_mat = basis.transpose() * m_quadrature.weights.asDiagonal() * basis;
+    m_grad.resize(m_ctrl_len, num_coeffs);
+
+    // J = sum_i r_i*c_i*M*c_i', where c_i is row i of C, so the hessian
+    // w.r.t the stacked coefficients has the entries 2*r_i*M(m, n) at
+    // (m*ctrl_len + i, n*ctrl_len + i).
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(m_quad_mat.nonZeros() * m_ctrl_len);
+    for (int m{}; m < m_quad_mat.outerSize(); ++m) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(m_quad_mat, m); it;
+             ++it) {
+            for (int i{}; i < m_ctrl_len; ++i) {
+                triplets.push_back({static_cast<int>(it.row()) * m_ctrl_len + i,
+                                    static_cast<int>(it.col()) * m_ctrl_len + i,
+                                    2.0 * m_ctrl_weights(i) * it.value()});
+            }
+        }
+    }
+    const int num_vars = m_coeff_vars->GetRows();
+    ifopt::Component::Jacobian hess(num_vars, num_vars);
+    hess.setFromTriplets(triplets.cbegin(), triplets.cend());
+    m_hessians.clear();
+    m_hessians[m_quadrature.var_set] = std::move(hess);
+}
+
+double ControlBasisEffortCost::GetCost() const
+{
+    // view with one coefficient vector per column
+    const Eigen::Map<const Eigen::MatrixXd> coeffs
+        = m_coeff_vars->getValuesMatrix(m_ctrl_len);
+    EvaluationArena &arena = m_coeff_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
+    Eigen::Map<Eigen::MatrixXd> coeffs_quad
+        = arena.allocateMatrix(coeffs.rows(), m_quad_mat.cols());
+    coeffs_quad.noalias() = coeffs * m_quad_mat;
+    return (m_ctrl_weights.asDiagonal() * coeffs)
+        .cwiseProduct(coeffs_quad)
+        .sum();
+}
+
+void ControlBasisEffortCost::FillJacobianBlock(
+    std::string var_set,
+    ifopt::Component::Jacobian &jac) const
+{
+    if (var_set == m_quadrature.var_set) {
+        // dJ/dC = 2*diag(r)*C*M
+        const Eigen::Map<const Eigen::MatrixXd> coeffs
+            = m_coeff_vars->getValuesMatrix(m_ctrl_len);
+        m_grad.noalias() = coeffs * m_quad_mat;
+        m_grad = 2.0 * m_ctrl_weights.asDiagonal() * m_grad;
+        fillGradient(m_grad.reshaped(), 0, jac);
+    }
+}
+
+ControlRateCost::ControlRateCost(const std::string &cost_name,
+                                 const std::string &ctrl_vars_name,
+                                 const double dt_segment,
+                                 const Eigen::VectorXd &ctrl_weights)
+    : QuadraticCostTerm(cost_name)
+    , m_ctrl_vars_name{ctrl_vars_name}
+    , m_dt_segment{dt_segment}
+    , m_ctrl_weights{ctrl_weights}
+    , m_ctrl_len{static_cast<int>(ctrl_weights.size())}
+{}
+
+void ControlRateCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    m_ctrl_vars = getTrajectoryVariables(x_init, m_ctrl_vars_name, GetName());
+    const int num_vars = m_ctrl_vars->GetRows();
+    assert(num_vars % m_ctrl_len == 0);
+    const int num_knots = num_vars / m_ctrl_len;
+    const int num_segments = num_knots - 1;
+
+    m_weights = (m_ctrl_weights / m_dt_segment)
+                * Eigen::RowVectorXd::Ones(num_segments);
+    m_grad.resize(m_ctrl_len, num_knots);
+
+    // The hessian of r_i*(u_(k+1,i) - u_(k,i))^2 / h is 2*r_i/h*[1 -1; -1 1]
+    // w.r.t (u_(k,i), u_(k+1,i)).
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(4 * m_ctrl_len * num_segments);
+    for (int k{}; k < num_segments; ++k) {
+        for (int i{}; i < m_ctrl_len; ++i) {
+            const int a = k * m_ctrl_len + i;
+            const int b = (k + 1) * m_ctrl_len + i;
+            const double h = 2.0 * m_weights(i, k);
+            triplets.push_back({a, a, h});
+            triplets.push_back({a, b, -h});
+            triplets.push_back({b, a, -h});
+            triplets.push_back({b, b, h});
+        }
+    }
+    ifopt::Component::Jacobian hess(num_vars, num_vars);
+    hess.setFromTriplets(triplets.cbegin(), triplets.cend());
+    m_hessians.clear();
+    m_hessians[m_ctrl_vars_name] = std::move(hess);
+}
+
+double ControlRateCost::GetCost() const
+{
+    const Eigen::Map<const Eigen::MatrixXd> ctrl_vecs
+        = m_ctrl_vars->getValuesMatrix(m_ctrl_len);
+    const int N = m_weights.cols();
+    return (m_weights.array()
+            * (ctrl_vecs.rightCols(N) - ctrl_vecs.leftCols(N)).array().square())
+        .sum();
+}
+
+void ControlRateCost::FillJacobianBlock(std::string var_set,
+                                        ifopt::Component::Jacobian &jac) const
+{
+    if (var_set == m_ctrl_vars_name) {
+        const Eigen::Map<const Eigen::MatrixXd> ctrl_vecs
+            = m_ctrl_vars->getValuesMatrix(m_ctrl_len);
+        const int N = m_weights.cols();
+        // Segment k adds G_k = 2*r/h.*(u_(k+1) - u_k) to the gradient w.r.t
+        // u_(k+1) and subtracts it from the gradient w.r.t u_k.
+        const auto rate_grads
+            = 2.0 * m_weights.array()
+              * (ctrl_vecs.rightCols(N) - ctrl_vecs.leftCols(N)).array();
+        m_grad.setZero();
+        m_grad.leftCols(N).array() -= rate_grads;
+        m_grad.rightCols(N).array() += rate_grads;
+        fillGradient(m_grad.reshaped(), 0, jac);
+    }
+}
+
+TerminalStateCost::TerminalStateCost(const std::string &cost_name,
+                                     const std::string &state_vars_name,
+                                     const Eigen::VectorXd &target_state,
+                                     const Eigen::VectorXd &state_weights)
+    : QuadraticCostTerm(cost_name)
+    , m_state_vars_name{state_vars_name}
+    , m_target_state{target_state}
+    , m_state_weights{state_weights}
+    , m_state_len{static_cast<int>(state_weights.size())}
+{
+    if (m_target_state.size() != m_state_len) {
+        throw std::invalid_argument(
+            "TerminalStateCost. The target state and the state weights must "
+            "have the same size.");
+    }
+}
+
+void TerminalStateCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    m_state_vars
+        = getTrajectoryVariables(x_init, m_state_vars_name, GetName());
+    const int num_vars = m_state_vars->GetRows();
+    assert(num_vars % m_state_len == 0);
+    m_hessians.clear();
+    m_hessians[m_state_vars_name] = diagonalHessian(
+        num_vars, num_vars - m_state_len, 2.0 * m_state_weights);
+}
+
+double TerminalStateCost::GetCost() const
+{
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const auto final_state = state_vec.tail(m_state_len);
+    return (m_state_weights.array()
+            * (final_state - m_target_state).array().square())
+        .sum();
+}
+
+void TerminalStateCost::FillJacobianBlock(std::string var_set,
+                                          ifopt::Component::Jacobian &jac) const
+{
+    if (var_set == m_state_vars_name) {
+        // only the final state has a nonzero gradient
+        const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+        const auto final_state = state_vec.tail(m_state_len);
+        EvaluationArena &arena = m_state_vars->getArena();
+        const EvaluationArena::Frame frame(arena);
+        Eigen::Map<Eigen::VectorXd> grad = arena.allocateVector(m_state_len);
+        grad = 2.0
+               * (m_state_weights.array()
+                  * (final_state - m_target_state).array())
+                     .matrix();
+        fillGradient(grad, state_vec.size() - m_state_len, jac);
+    }
+}
+
+MinimumTimeCost::MinimumTimeCost(const std::string &cost_name,
+                                 const std::string &duration_vars_name,
+                                 const double weight)
+    : QuadraticCostTerm(cost_name)
+    , m_duration_vars_name{duration_vars_name}
+    , m_weight{weight}
+{}
+
+void MinimumTimeCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    m_duration_var
+        = x_init->GetComponent<DurationVariable>(m_duration_vars_name);
+    if (!m_duration_var) {
+        throw std::invalid_argument(
+            GetName() + ". No duration variable named " + m_duration_vars_name);
+    }
+    // the cost is linear, so its hessian is zero
+    m_hessians.clear();
+}
+
+double MinimumTimeCost::GetCost() const
+{
+    return m_weight * m_duration_var->getDuration();
+}
+
+void MinimumTimeCost::FillJacobianBlock(std::string var_set,
+                                        ifopt::Component::Jacobian &jac) const
+{
+    if (var_set == m_duration_vars_name) {
+        jac.coeffRef(0, 0) = m_weight;
+    }
+}
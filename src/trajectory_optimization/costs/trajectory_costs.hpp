@@ -0,0 +1,240 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ifopt/cost_term.h>
+
+#include "control_basis.hpp"
+#include "duration_variable.hpp"
+#include "quadrature.hpp"
+#include "trajectory_variables.hpp"
+
+/*
+ * Base of the cost terms whose hessian is constant (quadratic costs). The
+ * hessian w.r.t each variable set is computed once when the cost is added to
+ * the problem, so a solver with exact hessians (eg. RiccatiIpSolver) can add
+ * it instead of approximating it. The hessian blocks between different
+ * variable sets are zero.
+ */
+class QuadraticCostTerm : public ifopt::CostTerm
+{
+public:
+    explicit QuadraticCostTerm(const std::string &cost_name);
+
+    // False if the hessian depends on the variables (eg. an effort cost with
+    // a free final time), in which case getHessian() must not be used.
+    virtual bool hasConstantHessian() const;
+
+    // Hessian of the cost w.r.t the variables of var_set. It has no entries
+    // if the cost does not depend on var_set.
+    const ifopt::Component::Jacobian &getHessian(
+        const std::string &var_set) const;
+
+protected:
+    std::map<std::string, ifopt::Component::Jacobian> m_hessians;
+
+private:
+    const ifopt::Component::Jacobian m_zero_hessian;
+};
+
+/*
+ * Weighted control effort (eg. an energy like objective when the controls are
+ * joint torques), integrated with the quadrature of a collocation scheme:
+ * J = sum_k w_k * sum_i r_i*u_(k,i)^2, where w are the quadrature weights and
+ * r are the weights of the control elements. With a free final time T, the
+ * weights are those of a trajectory of unit duration and J is multiplied by T,
+ * so the hessian is only constant for a fixed final time.
+ */
+class ControlEffortCost : public QuadraticCostTerm
+{
+public:
+    /*
+     * @param quadrature Quadrature weights for each control variable set, eg.
+     *   from trapezoidalQuadrature() or hermiteSimpsonQuadrature().
+     * @param ctrl_weights Weight of each element of a control vector.
+     */
+    ControlEffortCost(const std::string &cost_name,
+                      Quadrature quadrature,
+                      const Eigen::VectorXd &ctrl_weights);
+
+    /*
+     * Control effort of a trajectory with a free final time.
+     *
+     * @param quadrature Quadrature weights of a trajectory of unit duration,
+     *   eg. trapezoidalQuadrature(var_set, N, 1.0 / N). The times of a time
+     *   weighted quadrature are fractions of the duration.
+     * @param duration_vars_name Name of the DurationVariable.
+     */
+    ControlEffortCost(const std::string &cost_name,
+                      Quadrature quadrature,
+                      const Eigen::VectorXd &ctrl_weights,
+                      const std::string &duration_vars_name);
+
+    bool hasConstantHessian() const override;
+
+    double GetCost() const override;
+
+    void FillJacobianBlock(std::string var_set,
+                           ifopt::Component::Jacobian &jac) const override;
+
+private:
+    // Resolve the control and duration variables and precompute the weights
+    // and the hessian, once the cost is added to the problem.
+    void InitVariableDependedQuantities(const VariablesPtr &x_init) override;
+
+    // Duration of the trajectory if it is free, otherwise 1 (the weights
+    // already include the segment durations).
+    double getTimeScale() const;
+
+    const Quadrature m_quadrature;
+    const Eigen::VectorXd m_ctrl_weights;
+    const int m_ctrl_len;
+    const std::string m_duration_vars_name;
+    std::vector<std::shared_ptr<TrajectoryVariables>> m_vars;
+    std::shared_ptr<DurationVariable> m_duration_var;
+    // product of the control weights and the quadrature weights, one column
+    // per control vector
+    std::vector<Eigen::MatrixXd> m_weights;
+    // gradient w.r.t each variable set, reused by every call
+    mutable std::vector<Eigen::MatrixXd> m_grads;
+};
+
+/*
+ * Weighted control effort for controls parameterized with a basis (see
+ * ControlBasis), integrated with a quadrature at the knot points:
+ * J = sum_k w_k * sum_i r_i*u_(k,i)^2 with U = C*B'. The cost is quadratic in
+ * the coefficients C, with the constant matrix M = B'*diag(w)*B.
+ */
+class ControlBasisEffortCost : public QuadraticCostTerm
+{
+public:
+    /*
+     * @param quadrature Quadrature weights of the knot controls, eg. from
+     *   trapezoidalQuadrature(). Its var_set is the name of the coefficient
+     *   variables.
+     * @param ctrl_weights Weight of each element of a control vector.
+     */
+    ControlBasisEffortCost(const std::string &cost_name,
+                           QuadratureWeights quadrature,
+                           ControlBasis ctrl_basis,
+                           const Eigen::VectorXd &ctrl_weights);
+
+    double GetCost() const override;
+
+    void FillJacobianBlock(std::string var_set,
+                           ifopt::Component::Jacobian &jac) const override;
+
+private:
+    // Resolve the coefficient variables and precompute M and the hessian,
+    // once the cost is added to the problem.
+    void InitVariableDependedQuantities(const VariablesPtr &x_init) override;
+
+    const QuadratureWeights m_quadrature;
+    const ControlBasis m_ctrl_basis;
+    const Eigen::VectorXd m_ctrl_weights;
+    const int m_ctrl_len;
+    std::shared_ptr<TrajectoryVariables> m_coeff_vars;
+    // M = B'*diag(w)*B, (number of coefficients x number of coefficients)
+    Eigen::SparseMatrix<double> m_quad_mat;
+    mutable Eigen::MatrixXd m_grad;
+};
+
+/*
+ * Weighted squared rate of change of the controls (eg. to penalize jerk when
+ * the controls are joint torques): J = sum_k sum_i r_i*(u_(k+1,i) -
+ * u_(k,i))^2 / h, which approximates the integral of r'*(du/dt)^2 for
+ * controls at knot points with segments of equal duration h.
+ */
+class ControlRateCost : public QuadraticCostTerm
+{
+public:
+    /*
+     * @param ctrl_weights Weight of each element of a control vector.
+     */
+    ControlRateCost(const std::string &cost_name,
+                    const std::string &ctrl_vars_name,
+                    const double dt_segment,
+                    const Eigen::VectorXd &ctrl_weights);
+
+    double GetCost() const override;
+
+    void FillJacobianBlock(std::string var_set,
+                           ifopt::Component::Jacobian &jac) const override;
+
+private:
+    // Resolve the control variables and precompute the weights and the
+    // hessian, once the cost is added to the problem.
+    void InitVariableDependedQuantities(const VariablesPtr &x_init) override;
+
+    const std::string m_ctrl_vars_name;
+    const double m_dt_segment;
+    const Eigen::VectorXd m_ctrl_weights;
+    const int m_ctrl_len;
+    std::shared_ptr<TrajectoryVariables> m_ctrl_vars;
+    // control weights divided by the segment duration, one column per
+    // segment
+    Eigen::MatrixXd m_weights;
+    mutable Eigen::MatrixXd m_grad;
+};
+
+/*
+ * Weighted squared distance of the final state from a target state:
+ * J = sum_i q_i*(x_(N,i) - x_target,i)^2. It is an alternative to fixing the
+ * final state with bounds.
+ */
+class TerminalStateCost : public QuadraticCostTerm
+{
+public:
+    /*
+     * @param state_weights Weight of each element of the state vector.
+     */
+    TerminalStateCost(const std::string &cost_name,
+                      const std::string &state_vars_name,
+                      const Eigen::VectorXd &target_state,
+                      const Eigen::VectorXd &state_weights);
+
+    double GetCost() const override;
+
+    void FillJacobianBlock(std::string var_set,
+                           ifopt::Component::Jacobian &jac) const override;
+
+private:
+    // Resolve the state variables and precompute the hessian, once the cost
+    // is added to the problem.
+    void InitVariableDependedQuantities(const VariablesPtr &x_init) override;
+
+    const std::string m_state_vars_name;
+    const Eigen::VectorXd m_target_state;
+    const Eigen::VectorXd m_state_weights;
+    const int m_state_len;
+    std::shared_ptr<TrajectoryVariables> m_state_vars;
+};
+
+/*
+ * Weighted duration of a trajectory with a free final time: J = w*T. Combined
+ * with an effort cost, the weight trades off the duration against the effort.
+ */
+class MinimumTimeCost : public QuadraticCostTerm
+{
+public:
+    MinimumTimeCost(const std::string &cost_name,
+                    const std::string &duration_vars_name,
+                    const double weight = 1.0);
+
+    double GetCost() const override;
+
+    void FillJacobianBlock(std::string var_set,
+                           ifopt::Component::Jacobian &jac) const override;
+
+private:
+    // Resolve the duration variable, once the cost is added to the problem.
+    void InitVariableDependedQuantities(const VariablesPtr &x_init) override;
+
+    const std::string m_duration_vars_name;
+    const double m_weight;
+    std::shared_ptr<DurationVariable> m_duration_var;
+};
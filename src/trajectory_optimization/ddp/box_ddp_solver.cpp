@@ -0,0 +1,374 @@
+#include "box_ddp_solver.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // Get the indices of the true elements of a mask.
+    std::vector<int> maskIndices(
+        const Eigen::Array<bool, Eigen::Dynamic, 1> &mask)
+    {
+        std::vector<int> indices;
+        indices.reserve(mask.size());
+        for (int i{}; i < mask.size(); ++i) {
+            if (mask(i)) {
+                indices.push_back(i);
+            }
+        }
+        return indices;
+    }
+}
+
+bool solveBoxQp(const Eigen::MatrixXd &H,
+                const Eigen::VectorXd &g,
+                const Eigen::VectorXd &lower,
+                const Eigen::VectorXd &upper,
+                Eigen::VectorXd &x,
+                Eigen::Array<bool, Eigen::Dynamic, 1> &free)
+{
+    const int max_iter = 100;
+    const double min_grad = 1e-8;
+    const double min_rel_improvement = 1e-10;
+    const double armijo = 0.1;
+    const double step_dec = 0.6;
+    const double min_step = 1e-20;
+
+    const int n = g.size();
+    const auto value = [&](const Eigen::VectorXd &v) {
+        return 0.5 * v.dot(H * v) + g.dot(v);
+    };
+
+    x = x.cwiseMax(lower).cwiseMin(upper);
+    free.setConstant(n, true);
+    bool done = false;
+
+    for (int iter{}; iter < max_iter; ++iter) {
+        const Eigen::VectorXd grad = g + H * x;
+
+        // An element is clamped if it is on a bound and the gradient points
+        // outside the feasible box.
+        for (int i{}; i < n; ++i) {
+            free(i) = !(((x(i) <= lower(i)) && (grad(i) > 0.0))
+                        || ((x(i) >= upper(i)) && (grad(i) < 0.0)));
+        }
+        const std::vector<int> idx = maskIndices(free);
+        if (idx.empty()) {
+            return true;
+        }
+
+        const Eigen::MatrixXd H_ff = H(idx, idx);
+        const Eigen::LLT<Eigen::MatrixXd> llt(H_ff);
+        if (llt.info() != Eigen::Success) {
+            return false;
+        }
+
+        const Eigen::VectorXd grad_f = grad(idx);
+        if (done || (grad_f.norm() < min_grad)) {
+            return true;
+        }
+
+        // Newton step on the free subspace
+        Eigen::VectorXd dx = Eigen::VectorXd::Zero(n);
+        dx(idx) = -llt.solve(grad_f);
+
+        // projected backtracking line search
+        const double v0 = value(x);
+        double step = 1.0;
+        bool accepted = false;
+        while (step > min_step) {
+            const Eigen::VectorXd x_new
+                = (x + step * dx).cwiseMax(lower).cwiseMin(upper);
+            const double v_new = value(x_new);
+            if ((v_new - v0) <= armijo * grad.dot(x_new - x)) {
+                done = (v0 - v_new)
+                       < min_rel_improvement * (1.0 + std::abs(v0));
+                x = x_new;
+                accepted = true;
+                break;
+            }
+            step *= step_dec;
+        }
+        if (!accepted) {
+            done = true;
+        }
+    }
+    return true;
+}
+
+BoxDdpSolver::BoxDdpSolver(const int state_len,
+                           const int control_len,
+                           const int num_segments,
+                           const double dt_segment,
+                           const DynFn &dyn_fn,
+                           const JacobianDynFn &jac_dyn_wrt_state_fn,
+                           const JacobianDynFn &jac_dyn_wrt_control_fn,
+                           DdpCost cost,
+                           Eigen::VectorXd control_min,
+                           Eigen::VectorXd control_max,
+                           const DdpOptions &options)
+    : m_state_len{state_len}
+    , m_control_len{control_len}
+    , m_num_segments{num_segments}
+    , m_dt_segment{dt_segment}
+    , m_dyn_fn{dyn_fn}
+    , m_jac_dyn_wrt_state_fn{jac_dyn_wrt_state_fn}
+    , m_jac_dyn_wrt_control_fn{jac_dyn_wrt_control_fn}
+    , m_cost{std::move(cost)}
+    , m_control_min{std::move(control_min)}
+    , m_control_max{std::move(control_max)}
+    , m_options{options}
+    , m_reg{options.reg_init}
+    , m_k_fb(num_segments, Eigen::MatrixXd::Zero(control_len, state_len))
+{
+    if (m_num_segments < 1) {
+        throw std::invalid_argument(
+            "BoxDdpSolver. Need at least 1 time segment.");
+    }
+    if ((m_cost.state_goal.size() != m_state_len)
+        || (m_cost.state_weights.size() != m_state_len)
+        || (m_cost.terminal_state_weights.size() != m_state_len)) {
+        throw std::invalid_argument(
+            "BoxDdpSolver. state cost terms must have the state length.");
+    }
+    if ((m_cost.control_weights.size() != m_control_len)
+        || (m_control_min.size() != m_control_len)
+        || (m_control_max.size() != m_control_len)) {
+        throw std::invalid_argument(
+            "BoxDdpSolver. control cost terms and bounds must have the "
+            "control length.");
+    }
+}
+
+void BoxDdpSolver::setStateGoal(const Eigen::VectorXd &state_goal)
+{
+    assert(state_goal.size() == m_state_len);
+    m_cost.state_goal = state_goal;
+}
+
+BoxDdpSolver::Result BoxDdpSolver::solve(const Eigen::VectorXd &state_start,
+                                         const Eigen::VectorXd &ctrl_init)
+{
+    assert(state_start.size() == m_state_len);
+    assert(ctrl_init.size() >= m_control_len * m_num_segments);
+
+    // initialize the nominal trajectory and policy
+    m_states = state_start.replicate(1, m_num_segments + 1);
+    m_ctrls = Eigen::Map<const Eigen::MatrixXd>(ctrl_init.data(),
+                                                m_control_len,
+                                                m_num_segments);
+    m_k_ff = Eigen::MatrixXd::Zero(m_control_len, m_num_segments);
+    for (auto &k_fb : m_k_fb) {
+        k_fb.setZero();
+    }
+    m_reg = m_options.reg_init;
+
+    Eigen::MatrixXd states(m_state_len, m_num_segments + 1);
+    Eigen::MatrixXd ctrls(m_control_len, m_num_segments);
+    double cost = rollout(0.0, states, ctrls);
+    m_states = states;
+    m_ctrls = ctrls;
+
+    bool converged = false;
+    int iter{};
+    for (; (iter < m_options.max_iter) && !converged; ++iter) {
+        // backward pass, increasing the regularization until the control
+        // hessian is positive definite
+        bool backward_ok = backwardPass();
+        while (!backward_ok && (m_reg < m_options.reg_max)) {
+            m_reg = std::max(m_reg * m_options.reg_factor, m_options.reg_min);
+            backward_ok = backwardPass();
+        }
+        if (!backward_ok) {
+            break;
+        }
+
+        // The nominal trajectory is (locally) optimal if no reduction is
+        // expected.
+        if (-m_dv_lin < m_options.tol * std::abs(cost)) {
+            converged = true;
+            break;
+        }
+
+        // forward pass with backtracking line search
+        bool accepted = false;
+        double alpha = 1.0;
+        double new_cost = cost;
+        for (int i{}; i < m_options.max_line_search_iter; ++i) {
+            new_cost = rollout(alpha, states, ctrls);
+            const double expected
+                = -(alpha * m_dv_lin + alpha * alpha * m_dv_quad);
+            const double actual = cost - new_cost;
+            const bool sufficient_reduction
+                = (expected > 0.0)
+                      ? (actual / expected > m_options.min_reduction_ratio)
+                      : (actual > 0.0);
+            if (sufficient_reduction) {
+                accepted = true;
+                break;
+            }
+            alpha *= m_options.line_search_factor;
+        }
+
+        if (accepted) {
+            const double rel_reduction
+                = (cost - new_cost) / std::max(std::abs(cost), 1e-12);
+            m_states = states;
+            m_ctrls = ctrls;
+            cost = new_cost;
+            m_reg = std::max(m_reg / m_options.reg_factor, m_options.reg_min);
+            converged = rel_reduction < m_options.tol;
+        } else {
+            m_reg *= m_options.reg_factor;
+            if (m_reg > m_options.reg_max) {
+                break;
+            }
+        }
+    }
+
+    // convert to the stacked layout with one vector per knot point
+    Result result{.state_vars = Eigen::Map<const Eigen::VectorXd>(
+                      m_states.data(),
+                      m_states.size()),
+                  .ctrl_vars = Eigen::VectorXd::Zero(m_control_len
+                                                     * (m_num_segments + 1)),
+                  .cost = cost,
+                  .iterations = iter,
+                  .converged = converged};
+    result.ctrl_vars.head(m_ctrls.size())
+        = Eigen::Map<const Eigen::VectorXd>(m_ctrls.data(), m_ctrls.size());
+    result.ctrl_vars.tail(m_control_len) = m_ctrls.col(m_num_segments - 1);
+    return result;
+}
+
+double BoxDdpSolver::rollout(const double alpha,
+                             Eigen::MatrixXd &states,
+                             Eigen::MatrixXd &ctrls) const
+{
+    double cost{};
+    states.col(0) = m_states.col(0);
+    for (int k{}; k < m_num_segments; ++k) {
+        const Eigen::VectorXd state = states.col(k);
+        const Eigen::VectorXd control
+            = (m_ctrls.col(k) + alpha * m_k_ff.col(k)
+               + m_k_fb[k] * (state - m_states.col(k)))
+                  .cwiseMax(m_control_min)
+                  .cwiseMin(m_control_max);
+        ctrls.col(k) = control;
+        cost += runningCost(state, control);
+
+        // explicit Euler integration of the dynamics
+        const double tk = k * m_dt_segment;
+        states.col(k + 1) = state + m_dt_segment * m_dyn_fn(state, control, tk);
+    }
+    cost += terminalCost(states.col(m_num_segments));
+    return cost;
+}
+
+bool BoxDdpSolver::backwardPass()
+{
+    const double h = m_dt_segment;
+    const Eigen::MatrixXd I
+        = Eigen::MatrixXd::Identity(m_state_len, m_state_len);
+
+    // value function at the final knot point is the terminal cost
+    const Eigen::VectorXd &q_f = m_cost.terminal_state_weights;
+    Eigen::VectorXd v_x = q_f.cwiseProduct(m_states.col(m_num_segments)
+                                           - m_cost.state_goal);
+    Eigen::MatrixXd v_xx = q_f.asDiagonal();
+
+    m_dv_lin = 0.0;
+    m_dv_quad = 0.0;
+
+    for (int k = m_num_segments - 1; k >= 0; --k) {
+        const Eigen::VectorXd state = m_states.col(k);
+        const Eigen::VectorXd control = m_ctrls.col(k);
+        const double tk = k * h;
+
+        // linearization of the discrete dynamics
+        // x_(k+1) = x_k + h * f(x_k, u_k) => A = I + h * df/dx, B = h * df/du
+        const Eigen::MatrixXd A
+            = I
+              + h * Eigen::MatrixXd(m_jac_dyn_wrt_state_fn(state, control, tk));
+        const Eigen::MatrixXd B
+            = h * Eigen::MatrixXd(m_jac_dyn_wrt_control_fn(state, control, tk));
+
+        // derivatives of the running cost
+        const Eigen::VectorXd l_x
+            = h * m_cost.state_weights.cwiseProduct(state - m_cost.state_goal);
+        const Eigen::VectorXd l_u
+            = h * m_cost.control_weights.cwiseProduct(control);
+
+        // quadratic expansion of the action-value function
+        const Eigen::VectorXd Q_x = l_x + A.transpose() * v_x;
+        const Eigen::VectorXd Q_u = l_u + B.transpose() * v_x;
+        Eigen::MatrixXd Q_xx = A.transpose() * v_xx * A;
+        Q_xx.diagonal() += h * m_cost.state_weights;
+        Eigen::MatrixXd Q_uu = B.transpose() * v_xx * B;
+        Q_uu.diagonal() += h * m_cost.control_weights;
+        const Eigen::MatrixXd Q_ux = B.transpose() * v_xx * A;
+
+        // regularize the value function hessian for computing the policy
+        const Eigen::MatrixXd v_xx_reg = v_xx + m_reg * I;
+        Eigen::MatrixXd Q_uu_reg = B.transpose() * v_xx_reg * B;
+        Q_uu_reg.diagonal() += h * m_cost.control_weights;
+        const Eigen::MatrixXd Q_ux_reg = B.transpose() * v_xx_reg * A;
+
+        // feedforward term from the control bounded QP, warm started with the
+        // previous solution
+        Eigen::VectorXd k_ff = m_k_ff.col(k);
+        Eigen::Array<bool, Eigen::Dynamic, 1> free;
+        if (!solveBoxQp(Q_uu_reg,
+                        Q_u,
+                        m_control_min - control,
+                        m_control_max - control,
+                        k_ff,
+                        free)) {
+            return false;
+        }
+
+        // feedback gains only act on the controls that are not clamped
+        Eigen::MatrixXd K = Eigen::MatrixXd::Zero(m_control_len, m_state_len);
+        const std::vector<int> idx = maskIndices(free);
+        if (!idx.empty()) {
+            const Eigen::MatrixXd Q_uu_ff = Q_uu_reg(idx, idx);
+            const Eigen::LLT<Eigen::MatrixXd> llt(Q_uu_ff);
+            if (llt.info() != Eigen::Success) {
+                return false;
+            }
+            K(idx, Eigen::all) = -llt.solve(Q_ux_reg(idx, Eigen::all));
+        }
+
+        // expected cost reduction
+        m_dv_lin += k_ff.dot(Q_u);
+        m_dv_quad += 0.5 * k_ff.dot(Q_uu * k_ff);
+
+        // update the value function
+        v_x = Q_x + K.transpose() * Q_uu * k_ff + K.transpose() * Q_u
+              + Q_ux.transpose() * k_ff;
+        v_xx = Q_xx + K.transpose() * Q_uu * K + K.transpose() * Q_ux
+               + Q_ux.transpose() * K;
+        v_xx = 0.5 * (v_xx + v_xx.transpose()).eval();
+
+        m_k_ff.col(k) = k_ff;
+        m_k_fb[k] = K;
+    }
+    return true;
+}
+
+double BoxDdpSolver::runningCost(const Eigen::VectorXd &state,
+                                 const Eigen::VectorXd &control) const
+{
+    const Eigen::VectorXd dx = state - m_cost.state_goal;
+    return 0.5 * m_dt_segment
+           * (dx.dot(m_cost.state_weights.cwiseProduct(dx))
+              + control.dot(m_cost.control_weights.cwiseProduct(control)));
+}
+
+double BoxDdpSolver::terminalCost(const Eigen::VectorXd &state) const
+{
+    const Eigen::VectorXd dx = state - m_cost.state_goal;
+    return 0.5 * dx.dot(m_cost.terminal_state_weights.cwiseProduct(dx));
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <functional>
+#include <vector>
+
+// Quadratic cost used by the DDP solver. The running cost is integrated over
+// each segment with the segment duration:
+//   l_k = dt/2 * ((x_k - x_goal)' Q (x_k - x_goal) + u_k' R u_k)
+// and the terminal cost is:
+//   l_N = 1/2 * (x_N - x_goal)' Qf (x_N - x_goal)
+// Q, Qf and R are diagonal and given by their diagonal elements.
+struct DdpCost
+{
+    Eigen::VectorXd state_goal;
+    Eigen::VectorXd state_weights;
+    Eigen::VectorXd terminal_state_weights;
+    Eigen::VectorXd control_weights;
+};
+
+struct DdpOptions
+{
+    int max_iter = 100;
+    // stop when the relative cost reduction of an iteration is below this
+    double tol = 1e-6;
+    // Levenberg-Marquardt style regularization added to the value function
+    // hessian in the backward pass
+    double reg_init = 1e-6;
+    double reg_min = 1e-8;
+    double reg_max = 1e8;
+    double reg_factor = 10.0;
+    // backtracking line search on the feedforward step
+    int max_line_search_iter = 10;
+    double line_search_factor = 0.5;
+    // minimum ratio of actual to expected cost reduction to accept a step
+    double min_reduction_ratio = 1e-4;
+};
+
+/*
+ * Iterative LQR / DDP solver with box constraints on the controls (box-DDP).
+ *
+ * The continuous dynamics x' = f(x, u, t) are discretized with the explicit
+ * Euler method over segments of fixed duration:
+ *   x_(k+1) = x_k + dt * f(x_k, u_k, t_k)
+ * The backward pass is a Riccati recursion on the quadratic expansion of the
+ * value function, where the feedforward control update of each stage is a box
+ * constrained QP solved with a projected Newton method. The forward pass rolls
+ * out the nonlinear dynamics with a backtracking line search on the
+ * feedforward term.
+ *
+ * Reference: Tassa, Mansard, Todorov, "Control-Limited Differential Dynamic
+ * Programming", ICRA 2014.
+ */
+class BoxDdpSolver
+{
+public:
+    using Jacobian = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+    // calback signature for evaluating the dynamics
+    using DynFn = std::function<Eigen::VectorXd(const Eigen::VectorXd &state,
+                                                const Eigen::VectorXd &control,
+                                                const double time)>;
+    // callback signature for evaluating the jacobian of the dynamics w.r.t one
+    // of its inputs (eg. state or control)
+    using JacobianDynFn
+        = std::function<Jacobian(const Eigen::VectorXd &state,
+                                 const Eigen::VectorXd &control,
+                                 const double time)>;
+
+    struct Result
+    {
+        // States and controls using the same stacked layout as
+        // TrajectoryVariables, with one vector per knot point. DDP applies
+        // num_segments controls, so the control at the final knot point is a
+        // copy of the last applied control.
+        Eigen::VectorXd state_vars;
+        Eigen::VectorXd ctrl_vars;
+        double cost;
+        int iterations;
+        bool converged;
+    };
+
+    /*
+     * @param num_segments Number of time segments. There is one more knot
+     *   point than the number of segments.
+     * @param dt_segment The fixed duration of every time segment.
+     * @param control_min Lower bound of each control element.
+     * @param control_max Upper bound of each control element.
+     */
+    BoxDdpSolver(const int state_len,
+                 const int control_len,
+                 const int num_segments,
+                 const double dt_segment,
+                 const DynFn &dyn_fn,
+                 const JacobianDynFn &jac_dyn_wrt_state_fn,
+                 const JacobianDynFn &jac_dyn_wrt_control_fn,
+                 DdpCost cost,
+                 Eigen::VectorXd control_min,
+                 Eigen::VectorXd control_max,
+                 const DdpOptions &options);
+
+    /*
+     * Solve from the initial state.
+     *
+     * @param ctrl_init Initial guess of the controls, stacked with one vector
+     *   per knot point (eg. the controls of a previous solution for warm
+     *   starting). Only the first num_segments vectors are used.
+     */
+    Result solve(const Eigen::VectorXd &state_start,
+                 const Eigen::VectorXd &ctrl_init);
+
+    // Set the goal state of the cost, eg. for replanning to a new target.
+    void setStateGoal(const Eigen::VectorXd &state_goal);
+
+private:
+    // Simulate the dynamics with the current controls and feedback policy.
+    // Returns the total cost of the rollout.
+    double rollout(const double alpha,
+                   Eigen::MatrixXd &states,
+                   Eigen::MatrixXd &ctrls) const;
+
+    // Run the Riccati recursion and update the feedforward and feedback
+    // terms. Returns false if the control hessian was not positive definite.
+    bool backwardPass();
+
+    double runningCost(const Eigen::VectorXd &state,
+                       const Eigen::VectorXd &control) const;
+    double terminalCost(const Eigen::VectorXd &state) const;
+
+    const int m_state_len;
+    const int m_control_len;
+    const int m_num_segments;
+    const double m_dt_segment;
+    const DynFn m_dyn_fn;
+    const JacobianDynFn m_jac_dyn_wrt_state_fn;
+    const JacobianDynFn m_jac_dyn_wrt_control_fn;
+    DdpCost m_cost;
+    const Eigen::VectorXd m_control_min;
+    const Eigen::VectorXd m_control_max;
+    const DdpOptions m_options;
+
+    double m_reg;
+    // nominal trajectory with one column per knot point
+    Eigen::MatrixXd m_states;
+    Eigen::MatrixXd m_ctrls;
+    // feedforward terms (one column per segment) and feedback gains
+    Eigen::MatrixXd m_k_ff;
+    std::vector<Eigen::MatrixXd> m_k_fb;
+    // expected cost reduction terms of the last backward pass
+    double m_dv_lin;
+    double m_dv_quad;
+};
+
+/*
+ * Minimize 0.5*x'*H*x + g'*x subject to lower <= x <= upper with a projected
+ * Newton method.
+ *
+ * @param x Initial guess on input, solution on output.
+ * @param free Set to true for the elements that are not clamped to a bound at
+ *   the solution.
+ * @return False if the hessian of the free subspace is not positive definite.
+ */
+bool solveBoxQp(const Eigen::MatrixXd &H,
+                const Eigen::VectorXd &g,
+                const Eigen::VectorXd &lower,
+                const Eigen::VectorXd &upper,
+                Eigen::VectorXd &x,
+                Eigen::Array<bool, Eigen::Dynamic, 1> &free);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cassert>
+
+#include <ifopt/variable_set.h>
+
+// Duration of the trajectory as a single optimization variable, for problems
+// with a free final time (eg. minimum time problems). The trajectory starts at
+// a time of zero and its segments have equal durations.
+class DurationVariable final : public ifopt::VariableSet
+{
+public:
+    /*
+     * @param init_duration Initial solution value (guessed duration).
+     * @param min_duration Lower bound of the duration, which must be positive.
+     * @param max_duration Upper bound of the duration.
+     */
+    DurationVariable(const std::string &name,
+                     const double init_duration,
+                     const double min_duration,
+                     const double max_duration)
+        : VariableSet(1, name)
+        , m_duration{init_duration}
+        , m_bounds{min_duration, max_duration}
+    {
+        assert((min_duration > 0.0) && (min_duration <= max_duration));
+    }
+
+    void SetVariables(const Eigen::VectorXd &x) override
+    {
+        m_duration = x(0);
+    }
+
+    Eigen::VectorXd GetValues() const override
+    {
+        return Eigen::VectorXd::Constant(1, m_duration);
+    }
+
+    ifopt::Component::VecBound GetBounds() const override
+    {
+        return {m_bounds};
+    }
+
+    double getDuration() const
+    {
+        return m_duration;
+    }
+
+    // Duration of each segment for a trajectory with num_segments segments.
+    double getSegmentDuration(const int num_segments) const
+    {
+        return m_duration / num_segments;
+    }
+
+private:
+    double m_duration;
+    const ifopt::Bounds m_bounds;
+};
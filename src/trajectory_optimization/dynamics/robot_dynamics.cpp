@@ -1,19 +1,60 @@
 #include "robot_dynamics.hpp"
 
+#include <memory>
+
 namespace pin = pinocchio;
 
-Eigen::VectorXd dyn(const Eigen::VectorXd &state,
-                    const Eigen::VectorXd &control,
-                    const double /*time*/,
-                    const pin::Model &model)
+namespace
 {
-    // data required by algorithm
-    pin::Data data(model);
+    // Workspace and jacobians of the functions that return their outputs,
+    // eg. dyn(), for the model they were last called with.
+    struct ReturningWorkspace
+    {
+        explicit ReturningWorkspace(const pin::Model &model)
+            : model{&model}
+            , ws{model}
+        {}
+
+        const pin::Model *model;
+        DynamicsWorkspace ws;
+        Jacobian jac_wrt_state;
+        Jacobian jac_wrt_control;
+    };
+
+    // Workspace of the calling thread, which is created again when the
+    // functions are called with another model. Each call only allocates its
+    // output then.
+    ReturningWorkspace &getThreadWorkspace(const pin::Model &model)
+    {
+        thread_local std::unique_ptr<ReturningWorkspace> rws;
+        if (!rws || (rws->model != &model)
+            || (rws->ws.tau.size() != model.nv)
+            || (static_cast<int>(rws->ws.data.oMi.size()) != model.njoints)) {
+            rws = std::make_unique<ReturningWorkspace>(model);
+        }
+        return *rws;
+    }
+}
 
+DynamicsWorkspace::DynamicsWorkspace(const pin::Model &model)
+    : data(model)
+    , tau{Eigen::VectorXd::Zero(model.nv)}
+    , ddq_dq{Eigen::MatrixXd::Zero(model.nv, model.nv)}
+    , ddq_dv{Eigen::MatrixXd::Zero(model.nv, model.nv)}
+    , ddq_dtau{Eigen::MatrixXd::Zero(model.nv, model.nv)}
+{}
+
+void computeDyn(const Eigen::VectorXd &state,
+                const Eigen::VectorXd &control,
+                const double /*time*/,
+                const pin::Model &model,
+                DynamicsWorkspace &ws,
+                Eigen::Ref<Eigen::VectorXd> dx)
+{
     // Map control inputs to torque. This assumes control elements are in order
     // of joint torques, up to the size of the control vector.
-    Eigen::VectorXd tau = Eigen::VectorXd::Zero(model.nv);
-    tau(Eigen::seqN(0, control.size())) = control;
+    ws.tau.setZero();
+    ws.tau(Eigen::seqN(0, control.size())) = control;
 
     // Get the joint configuration.
     const auto q = state(Eigen::seqN(0, state.size() / 2));
@@ -21,30 +62,32 @@ Eigen::VectorXd dyn(const Eigen::VectorXd &state,
     const auto v = state(Eigen::seqN(state.size() / 2, state.size() / 2));
 
     // calculate the forward dynamics = [dq, ddq]
-    pin::aba(model, data, q, v, tau);
-    Eigen::VectorXd dx = Eigen::VectorXd::Zero(2 * model.nv);
-    dx << v, data.ddq;  // concatenate
-    // std::cout << "state = \n" << state << std::endl;
-    // std::cout << "control = \n" << control << std::endl;
-    // std::cout << "tau = \n" << tau << std::endl;
-    // std::cout << "q = \n" << q << std::endl;
-    // std::cout << "v = \n" << v << std::endl;
-    // std::cout << "data.ddq = \n" << data.ddq << std::endl;
-    return dx;
+    pin::aba(model, ws.data, q, v, ws.tau);
+    dx << v, ws.data.ddq;  // concatenate
 }
 
-Jacobian jacDynWrtState(const Eigen::VectorXd &state,
-                        const Eigen::VectorXd &control,
-                        const double /*time*/,
-                        const pin::Model &model)
+Eigen::VectorXd dyn(const Eigen::VectorXd &state,
+                    const Eigen::VectorXd &control,
+                    const double time,
+                    const pin::Model &model)
 {
-    // data required by algorithm
-    pin::Data data(model);
+    Eigen::VectorXd dx(2 * model.nv);
+    computeDyn(state, control, time, model, getThreadWorkspace(model).ws, dx);
+    return dx;
+}
 
+void computeDynJacobians(const Eigen::VectorXd &state,
+                         const Eigen::VectorXd &control,
+                         const double /*time*/,
+                         const pin::Model &model,
+                         DynamicsWorkspace &ws,
+                         Jacobian &jac_wrt_state,
+                         Jacobian &jac_wrt_control)
+{
     // Map control inputs to torque. This assumes control elements are in order
     // of joint torques, up to the size of the control vector.
-    Eigen::VectorXd tau = Eigen::VectorXd::Zero(model.nv);
-    tau(Eigen::seqN(0, control.size())) = control;
+    ws.tau.setZero();
+    ws.tau(Eigen::seqN(0, control.size())) = control;
 
     // Get the joint configuration. Note that pinocchio has an additional
     // universe joint at index 0.
@@ -54,17 +97,14 @@ Jacobian jacDynWrtState(const Eigen::VectorXd &state,
 
     // calculate the partial derivative of generalized joint acceleration w.r.t
     // the generalized joint configuration, joint velocity, and joint torque
-    Eigen::MatrixXd ddq_dq = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dv = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dtau = Eigen::MatrixXd::Zero(model.nv, model.nv);
     pin::computeABADerivatives(model,
-                               data,
+                               ws.data,
                                q,
                                v,
-                               tau,
-                               ddq_dq,
-                               ddq_dv,
-                               ddq_dtau);
+                               ws.tau,
+                               ws.ddq_dq,
+                               ws.ddq_dv,
+                               ws.ddq_dtau);
 
     /*
       Jacobian of the forward dynamics function f w.r.t the state x=[q v] is:
@@ -77,78 +117,7 @@ Jacobian jacDynWrtState(const Eigen::VectorXd &state,
 
       Note that the zero submatrix and identity submatrix each have
       size=(state_len/2 x state_len/2)
-     */
-
-    const int state_len = state.size();
-    std::vector<Eigen::Triplet<double>> triplets;
-    triplets.reserve(state_len / 2 + state_len / 2 * state_len);
-    // fill in dv/dv=I
-    for (int i{}; i < state_len / 2; ++i) {
-        for (int j{}; j < state_len / 2; ++j) {
-            if (i == j) {
-                triplets.push_back({i, j + state_len / 2, 1.0});
-            }
-        }
-    }
-    // fill in da/dq
-    for (int i{}; i < ddq_dq.rows(); ++i) {
-        for (int j{}; j < ddq_dq.cols(); ++j) {
-            triplets.push_back({i + state_len / 2, j, ddq_dq(i, j)});
-        }
-    }
-    // fill in da/dv
-    for (int i{}; i < ddq_dv.rows(); ++i) {
-        for (int j{}; j < ddq_dv.cols(); ++j) {
-            triplets.push_back(
-                {i + state_len / 2, j + state_len / 2, ddq_dv(i, j)});
-        }
-    }
-    Jacobian jac(state_len, state_len);
-    jac.setFromTriplets(triplets.cbegin(), triplets.cend());
-    return jac;
-}
-
-// todo: currently pin::computeABADerivatives() gets called twice for the same
-// computation in jacDynWrtState() and jacDynWrtControl(). This
-// is redundant because pin::computeABADerivatives() calculates the derivates
-// required for the jacobian w.r.t the state and w.r.t the control. An
-// optimization would be to refactor the code so that
-// pin::computeABADerivatives() only gets called once between these two
-// functions.
-Jacobian jacDynWrtControl(const Eigen::VectorXd &state,
-                          const Eigen::VectorXd &control,
-                          const double /*time*/,
-                          const pin::Model &model)
-{
-    // data required by algorithm
-    pin::Data data(model);
-
-    // Map control inputs to torque. This assumes control elements are in order
-    // of joint torques, up to the size of the control vector.
-    Eigen::VectorXd tau = Eigen::VectorXd::Zero(model.nv);
-    tau(Eigen::seqN(0, control.size())) = control;
 
-    // Get the joint configuration. Note that pinocchio has an additional
-    // universe joint at index 0.
-    const auto q = state(Eigen::seqN(0, state.size() / 2));
-    // Get the generalized joint velocity.
-    const auto v = state(Eigen::seqN(state.size() / 2, state.size() / 2));
-
-    // calculate the partial derivative of generalized joint acceleration w.r.t
-    // the generalized joint configuration, joint velocity, and joint torque
-    Eigen::MatrixXd ddq_dq = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dv = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    Eigen::MatrixXd ddq_dtau = Eigen::MatrixXd::Zero(model.nv, model.nv);
-    pin::computeABADerivatives(model,
-                               data,
-                               q,
-                               v,
-                               tau,
-                               ddq_dq,
-                               ddq_dv,
-                               ddq_dtau);
-
-    /*
       Jacobian of the forward dynamics function f w.r.t the control u is:
 
       df/du =
@@ -156,24 +125,96 @@ Jacobian jacDynWrtControl(const Eigen::VectorXd &state,
        da/du] =
       [0;
        da/du]
-      where v = dq/dt, a = dv / dt
 
       The length of u can be up to the length of the number of joints, so only
       use the first len(u) columns of da/dtau for da/du.
      */
-
     const int state_len = state.size();
-    std::vector<Eigen::Triplet<double>> triplets;
-    triplets.reserve(state_len / 2);
-    // std::cout << "ddq_dtau = \n" << ddq_dtau << std::endl;
-
-    // fill da/du
-    for (int i{}; i < state_len / 2; ++i) {
-        for (int j{}; j < control.size(); ++j) {
-            triplets.push_back({i + state_len / 2, j, ddq_dtau(i, j)});
+    const int nv = state_len / 2;
+    const int control_len = control.size();
+
+    // Create the sparsity pattern on the first call. The values are set
+    // below.
+    const int nnz_state = nv + nv * state_len;
+    if ((jac_wrt_state.rows() != state_len)
+        || (jac_wrt_state.cols() != state_len)
+        || (jac_wrt_state.nonZeros() != nnz_state)
+        || !jac_wrt_state.isCompressed()) {
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(nnz_state);
+        // dv/dv=I
+        for (int i{}; i < nv; ++i) {
+            triplets.push_back({i, i + nv, 1.0});
+        }
+        // da/dq and da/dv
+        for (int i{}; i < nv; ++i) {
+            for (int j{}; j < state_len; ++j) {
+                triplets.push_back({i + nv, j, 0.0});
+            }
+        }
+        jac_wrt_state.resize(state_len, state_len);
+        jac_wrt_state.setFromTriplets(triplets.cbegin(), triplets.cend());
+    }
+    const int nnz_control = nv * control_len;
+    if ((jac_wrt_control.rows() != state_len)
+        || (jac_wrt_control.cols() != control_len)
+        || (jac_wrt_control.nonZeros() != nnz_control)
+        || !jac_wrt_control.isCompressed()) {
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(nnz_control);
+        // da/du
+        for (int i{}; i < nv; ++i) {
+            for (int j{}; j < control_len; ++j) {
+                triplets.push_back({i + nv, j, 0.0});
+            }
         }
+        jac_wrt_control.resize(state_len, control_len);
+        jac_wrt_control.setFromTriplets(triplets.cbegin(), triplets.cend());
     }
-    Jacobian jac(state_len, control.size());
-    jac.setFromTriplets(triplets.cbegin(), triplets.cend());
-    return jac;
+
+    // update the values in place
+    for (int i = nv; i < state_len; ++i) {
+        for (Jacobian::InnerIterator it(jac_wrt_state, i); it; ++it) {
+            it.valueRef() = (it.col() < nv) ? ws.ddq_dq(i - nv, it.col())
+                                            : ws.ddq_dv(i - nv, it.col() - nv);
+        }
+        for (Jacobian::InnerIterator it(jac_wrt_control, i); it; ++it) {
+            it.valueRef() = ws.ddq_dtau(i - nv, it.col());
+        }
+    }
+}
+
+Jacobian jacDynWrtState(const Eigen::VectorXd &state,
+                        const Eigen::VectorXd &control,
+                        const double time,
+                        const pin::Model &model)
+{
+    ReturningWorkspace &rws = getThreadWorkspace(model);
+    computeDynJacobians(state,
+                        control,
+                        time,
+                        model,
+                        rws.ws,
+                        rws.jac_wrt_state,
+                        rws.jac_wrt_control);
+    return rws.jac_wrt_state;
+}
+
+// Note that this evaluates the same derivatives of the forward dynamics as
+// jacDynWrtState(). Use computeDynJacobians() to get both jacobians from a
+// single evaluation.
+Jacobian jacDynWrtControl(const Eigen::VectorXd &state,
+                          const Eigen::VectorXd &control,
+                          const double time,
+                          const pin::Model &model)
+{
+    ReturningWorkspace &rws = getThreadWorkspace(model);
+    computeDynJacobians(state,
+                        control,
+                        time,
+                        model,
+                        rws.ws,
+                        rws.jac_wrt_state,
+                        rws.jac_wrt_control);
+    return rws.jac_wrt_control;
 }
@@ -6,9 +6,52 @@
 
 using Jacobian = Eigen::SparseMatrix<double, Eigen::RowMajor>;
 
+// Preallocated pinocchio data and buffers for evaluating the dynamics and its
+// jacobians without heap allocations. A workspace must not be shared between
+// threads.
+struct DynamicsWorkspace
+{
+    explicit DynamicsWorkspace(const pinocchio::Model &model);
+
+    pinocchio::Data data;
+    Eigen::VectorXd tau;
+    Eigen::MatrixXd ddq_dq;
+    Eigen::MatrixXd ddq_dv;
+    Eigen::MatrixXd ddq_dtau;
+};
+
+/*
+ * Same as dyn(), but writes the output into dx and uses the buffers of the
+ * workspace, so it does not allocate.
+ *
+ * @param dx Output of the dynamics function, of the same size as the state.
+ */
+void computeDyn(const Eigen::VectorXd &state,
+                const Eigen::VectorXd &control,
+                const double /*time*/,
+                const pinocchio::Model &model,
+                DynamicsWorkspace &ws,
+                Eigen::Ref<Eigen::VectorXd> dx);
+
+/*
+ * Calculate the jacobians of the dynamics function w.r.t the state and w.r.t
+ * the control with a single evaluation of the derivatives of the forward
+ * dynamics. If the jacobians already have the sparsity pattern of a previous
+ * call, only their values are updated, which does not allocate.
+ */
+void computeDynJacobians(const Eigen::VectorXd &state,
+                         const Eigen::VectorXd &control,
+                         const double /*time*/,
+                         const pinocchio::Model &model,
+                         DynamicsWorkspace &ws,
+                         Jacobian &jac_wrt_state,
+                         Jacobian &jac_wrt_control);
+
 /*
  * Calculate the output of the dynamics function given the current state, and
- * control input.
+ * control input. This and the jacobian functions below reuse a workspace of
+ * the calling thread for the model of the previous call, so they only
+ * allocate their outputs.
  */
 Eigen::VectorXd dyn(const Eigen::VectorXd &state,
                     const Eigen::VectorXd &control,
@@ -31,3 +74,68 @@ Jacobian jacDynWrtControl(const Eigen::VectorXd &state,
                           const Eigen::VectorXd &control,
                           const double /*time*/,
                           const pinocchio::Model &model);
+
+/*
+ * Dynamics of a robot model with its own workspace, for use with
+ * CollocationConstraints. The model must outlive this object. The members are
+ * not thread safe because they share the workspace.
+ */
+class RobotDynamics
+{
+public:
+    explicit RobotDynamics(const pinocchio::Model &model)
+        : m_model{model}
+        , m_ws{model}
+        , m_state_buf(model.nq + model.nv)
+        , m_control_buf(model.nv)
+    {}
+
+    void eval(const Eigen::VectorXd &state,
+              const Eigen::VectorXd &control,
+              const double time,
+              Eigen::Ref<Eigen::VectorXd> dx)
+    {
+        computeDyn(state, control, time, m_model, m_ws, dx);
+    }
+
+    // Dynamics at several time points, with one state and control vector per
+    // column of states and controls, into the columns of dyn_values.
+    void evalAtKnots(const Eigen::Ref<const Eigen::MatrixXd> &states,
+                     const Eigen::Ref<const Eigen::MatrixXd> &controls,
+                     const Eigen::VectorXd &times,
+                     Eigen::Ref<Eigen::MatrixXd> dyn_values)
+    {
+        for (int j{}; j < times.size(); ++j) {
+            m_state_buf = states.col(j);
+            m_control_buf = controls.col(j);
+            computeDyn(m_state_buf,
+                       m_control_buf,
+                       times(j),
+                       m_model,
+                       m_ws,
+                       dyn_values.col(j));
+        }
+    }
+
+    void jacobians(const Eigen::VectorXd &state,
+                   const Eigen::VectorXd &control,
+                   const double time,
+                   Jacobian &jac_wrt_state,
+                   Jacobian &jac_wrt_control)
+    {
+        computeDynJacobians(state,
+                            control,
+                            time,
+                            m_model,
+                            m_ws,
+                            jac_wrt_state,
+                            jac_wrt_control);
+    }
+
+private:
+    const pinocchio::Model &m_model;
+    DynamicsWorkspace m_ws;
+    // contiguous state and control of evalAtKnots
+    Eigen::VectorXd m_state_buf;
+    Eigen::VectorXd m_control_buf;
+};
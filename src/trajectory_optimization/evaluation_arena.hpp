@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#include <Eigen/Dense>
+
+/*
+ * Memory for the temporaries of the evaluations of the constraints and costs
+ * (eg. triplet lists and gradients), so the evaluations do not allocate once
+ * the arena has grown to the largest one.
+ *
+ * Allocations bump an offset into a single block and are released together
+ * when the Frame that was opened before them is destroyed. Requests that do
+ * not fit into the block are served from the heap until the arena is rewound
+ * to empty, ie. when the outermost frame is destroyed or the arena is reset
+ * (eg. by TrajectoryVariables for every new iterate). The block then grows to
+ * the peak usage, so the following evaluations of the same size fit.
+ *
+ * It is a std::pmr::memory_resource, so standard containers can use it (see
+ * makeVector()). Deallocations are no-ops. An arena must not be shared between
+ * threads.
+ */
+class EvaluationArena final : public std::pmr::memory_resource
+{
+    // Heap allocation of a request that did not fit into the block. The
+    // header is followed by the memory of the request.
+    struct Chunk
+    {
+        Chunk *prev;
+        std::size_t alignment;
+    };
+
+public:
+    // Releases the allocations made during its lifetime when it is destroyed.
+    class Frame
+    {
+    public:
+        explicit Frame(EvaluationArena &arena)
+            : m_arena{arena}
+            , m_offset{arena.m_offset}
+            , m_chunks{arena.m_chunks}
+        {}
+
+        ~Frame()
+        {
+            m_arena.rewind(m_offset, m_chunks);
+        }
+
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+
+    private:
+        EvaluationArena &m_arena;
+        const std::size_t m_offset;
+        Chunk *const m_chunks;
+    };
+
+    EvaluationArena() = default;
+
+    ~EvaluationArena() override
+    {
+        releaseChunks(nullptr);
+        if (m_block) {
+            ::operator delete(m_block, std::align_val_t{block_alignment});
+        }
+    }
+
+    EvaluationArena(const EvaluationArena &) = delete;
+    EvaluationArena &operator=(const EvaluationArena &) = delete;
+
+    // Release all allocations. There must be no open frames.
+    void reset()
+    {
+        rewind(0, nullptr);
+    }
+
+    // Uninitialized matrix, which is valid until the enclosing frame is
+    // destroyed.
+    Eigen::Map<Eigen::MatrixXd> allocateMatrix(const Eigen::Index rows,
+                                               const Eigen::Index cols)
+    {
+        void *data = allocate(rows * cols * sizeof(double), alignof(double));
+        return Eigen::Map<Eigen::MatrixXd>(
+            static_cast<double *>(data), rows, cols);
+    }
+
+    // Uninitialized vector, which is valid until the enclosing frame is
+    // destroyed.
+    Eigen::Map<Eigen::VectorXd> allocateVector(const Eigen::Index size)
+    {
+        void *data = allocate(size * sizeof(double), alignof(double));
+        return Eigen::Map<Eigen::VectorXd>(static_cast<double *>(data), size);
+    }
+
+    // Empty vector with the given capacity, whose memory is valid until the
+    // enclosing frame is destroyed.
+    template <typename T>
+    std::pmr::vector<T> makeVector(const std::size_t capacity)
+    {
+        std::pmr::vector<T> vec(this);
+        vec.reserve(capacity);
+        return vec;
+    }
+
+    // Size of the block, which bounds the allocations of an evaluation that
+    // does not allocate from the heap.
+    std::size_t getCapacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    static constexpr std::size_t block_alignment = 64;
+
+    void *do_allocate(const std::size_t bytes,
+                      const std::size_t alignment) override
+    {
+        const std::size_t start
+            = (m_offset + alignment - 1) / alignment * alignment;
+        if ((alignment <= block_alignment) && (start + bytes <= m_capacity)) {
+            m_offset = start + bytes;
+            m_peak = std::max(m_peak, m_offset + m_overflow);
+            return m_block + start;
+        }
+
+        // The overflow counts the worst case padding, so the requests fit
+        // into a block of the peak size.
+        const std::size_t chunk_alignment
+            = std::max(alignment, alignof(Chunk));
+        const std::size_t header
+            = (sizeof(Chunk) + chunk_alignment - 1) / chunk_alignment
+              * chunk_alignment;
+        std::byte *mem = static_cast<std::byte *>(::operator new(
+            header + bytes, std::align_val_t{chunk_alignment}));
+        m_chunks = new (mem) Chunk{m_chunks, chunk_alignment};
+        m_overflow += bytes + alignment;
+        m_peak = std::max(m_peak, m_offset + m_overflow);
+        return mem + header;
+    }
+
+    void do_deallocate(void * /*p*/,
+                       const std::size_t /*bytes*/,
+                       const std::size_t /*alignment*/) override
+    {}
+
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    // Release the allocations after offset and the chunks after chunks. The
+    // block grows to the peak usage when the arena becomes empty.
+    void rewind(const std::size_t offset, Chunk *const chunks)
+    {
+        releaseChunks(chunks);
+        m_offset = offset;
+        if ((offset != 0) || (m_peak <= m_capacity)) {
+            return;
+        }
+        if (m_block) {
+            ::operator delete(m_block, std::align_val_t{block_alignment});
+        }
+        m_block = static_cast<std::byte *>(
+            ::operator new(m_peak, std::align_val_t{block_alignment}));
+        m_capacity = m_peak;
+    }
+
+    void releaseChunks(Chunk *const chunks)
+    {
+        while (m_chunks != chunks) {
+            Chunk *const prev = m_chunks->prev;
+            const std::size_t alignment = m_chunks->alignment;
+            m_chunks->~Chunk();
+            ::operator delete(m_chunks, std::align_val_t{alignment});
+            m_chunks = prev;
+        }
+        if (!m_chunks) {
+            m_overflow = 0;
+        }
+    }
+
+    std::byte *m_block{nullptr};
+    std::size_t m_capacity{};
+    std::size_t m_offset{};
+    // heap allocations, the last one first
+    Chunk *m_chunks{nullptr};
+    // bytes allocated from the heap since the arena was last empty
+    std::size_t m_overflow{};
+    // largest usage of the block and the heap since the arena was created
+    std::size_t m_peak{};
+};
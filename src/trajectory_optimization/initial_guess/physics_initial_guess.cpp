@@ -0,0 +1,120 @@
+#include "physics_initial_guess.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+#include "pinocchio/algorithm/rnea.hpp"
+
+namespace pin = pinocchio;
+
+void minimumJerkProfile(const Eigen::VectorXd &q_start,
+                        const Eigen::VectorXd &v_start,
+                        const Eigen::VectorXd &q_end,
+                        const Eigen::VectorXd &v_end,
+                        const double duration,
+                        const double time,
+                        Eigen::VectorXd &q,
+                        Eigen::VectorXd &v,
+                        Eigen::VectorXd &a)
+{
+    assert(duration > 0.0);
+    const double T = duration;
+    const double t = time;
+
+    // q(t) = q0 + v0*t + c3*t^3 + c4*t^4 + c5*t^5, where the coefficients
+    // match the end position and velocity with zero accelerations at both
+    // ends.
+    const Eigen::ArrayXd h = (q_end - q_start).array();
+    const Eigen::ArrayXd v0 = v_start.array();
+    const Eigen::ArrayXd vf = v_end.array();
+    const Eigen::ArrayXd c3 = (20.0 * h - (8.0 * vf + 12.0 * v0) * T)
+                              / (2.0 * T * T * T);
+    const Eigen::ArrayXd c4 = (-30.0 * h + (14.0 * vf + 16.0 * v0) * T)
+                              / (2.0 * T * T * T * T);
+    const Eigen::ArrayXd c5 = (12.0 * h - 6.0 * (vf + v0) * T)
+                              / (2.0 * T * T * T * T * T);
+
+    q = (q_start.array() + v0 * t + c3 * t * t * t + c4 * t * t * t * t
+         + c5 * t * t * t * t * t)
+            .matrix();
+    v = (v0 + 3.0 * c3 * t * t + 4.0 * c4 * t * t * t
+         + 5.0 * c5 * t * t * t * t)
+            .matrix();
+    a = (6.0 * c3 * t + 12.0 * c4 * t * t + 20.0 * c5 * t * t * t).matrix();
+}
+
+InitialGuess createPhysicsInitialGuessAt(const pin::Model &model,
+                                         const Eigen::VectorXd &state_start,
+                                         const Eigen::VectorXd &state_end,
+                                         const int control_len,
+                                         const double traj_dur,
+                                         const Eigen::VectorXd &times)
+{
+    const int state_len = state_start.size();
+    if ((state_len != 2 * model.nv) || (state_end.size() != state_len)) {
+        throw std::invalid_argument(
+            "createPhysicsInitialGuessAt. The states must have twice the "
+            "number of joints of the model.");
+    }
+    if ((control_len < 0) || (control_len > model.nv)) {
+        throw std::invalid_argument(
+            "createPhysicsInitialGuessAt. The control length must not exceed "
+            "the number of joints of the model.");
+    }
+
+    const int nv = model.nv;
+    const auto q_start = state_start(Eigen::seqN(0, nv));
+    const auto v_start = state_start(Eigen::seqN(nv, nv));
+    const auto q_end = state_end(Eigen::seqN(0, nv));
+    const auto v_end = state_end(Eigen::seqN(nv, nv));
+
+    const int num_time_pts = times.size();
+    InitialGuess guess;
+    guess.state_vars.resize(num_time_pts * state_len);
+    guess.ctrl_vars.resize(num_time_pts * control_len);
+
+    pin::Data data(model);
+    Eigen::VectorXd q(nv), v(nv), a(nv);
+    for (int k{}; k < num_time_pts; ++k) {
+        minimumJerkProfile(
+            q_start, v_start, q_end, v_end, traj_dur, times(k), q, v, a);
+        auto statek = guess.state_vars(Eigen::seqN(k * state_len, state_len));
+        statek << q, v;
+
+        // joint torques that produce the profile accelerations, including
+        // gravity compensation
+        const Eigen::VectorXd &tau = pin::rnea(model, data, q, v, a);
+        guess.ctrl_vars(Eigen::seqN(k * control_len, control_len))
+            = tau(Eigen::seqN(0, control_len));
+    }
+    return guess;
+}
+
+InitialGuess createPhysicsInitialGuess(const pin::Model &model,
+                                       const Eigen::VectorXd &state_start,
+                                       const Eigen::VectorXd &state_end,
+                                       const int control_len,
+                                       const double traj_dur,
+                                       const int num_segments)
+{
+    const Eigen::VectorXd times
+        = Eigen::VectorXd::LinSpaced(num_segments + 1, 0.0, traj_dur);
+    return createPhysicsInitialGuessAt(
+        model, state_start, state_end, control_len, traj_dur, times);
+}
+
+Eigen::VectorXd createLinearStateGuess(const Eigen::VectorXd &state_start,
+                                       const Eigen::VectorXd &state_end,
+                                       const int num_segments)
+{
+    assert(state_start.size() == state_end.size());
+    const int state_len = state_start.size();
+    const int num_time_pts = num_segments + 1;
+    Eigen::VectorXd ret(num_time_pts * state_len);
+    for (int k{}; k < num_time_pts; ++k) {
+        const double alpha = static_cast<double>(k) / num_segments;
+        ret.segment(k * state_len, state_len)
+            = alpha * (state_end - state_start) + state_start;
+    }
+    return ret;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include "pinocchio/multibody/data.hpp"
+#include "pinocchio/multibody/model.hpp"
+
+// Initial guess of the discrete states and controls over the trajectory. The
+// vectors use the same stacked layout as TrajectoryVariables, with one state
+// and one control vector per time point.
+struct InitialGuess
+{
+    Eigen::VectorXd state_vars;
+    Eigen::VectorXd ctrl_vars;
+};
+
+/*
+ * Evaluate the minimum jerk (quintic) profile between a start and end
+ * configuration with the given boundary velocities and zero boundary
+ * accelerations. The profile is evaluated element wise for all joints.
+ *
+ * @param time Time since the start of the profile, in [0, duration].
+ * @param q Output joint positions.
+ * @param v Output joint velocities.
+ * @param a Output joint accelerations.
+ */
+void minimumJerkProfile(const Eigen::VectorXd &q_start,
+                        const Eigen::VectorXd &v_start,
+                        const Eigen::VectorXd &q_end,
+                        const Eigen::VectorXd &v_end,
+                        const double duration,
+                        const double time,
+                        Eigen::VectorXd &q,
+                        Eigen::VectorXd &v,
+                        Eigen::VectorXd &a);
+
+/*
+ * Create an initial guess that is consistent with the robot dynamics. The
+ * joint positions follow minimum jerk profiles from the start state to the end
+ * state, the joint velocities are the derivatives of these profiles, and the
+ * controls are the joint torques from the inverse dynamics (pin::rnea), which
+ * include gravity compensation. A state is [q, v] as used by dyn().
+ *
+ * The controls are the first control_len joint torques, the same mapping as
+ * used by dyn(). For an underactuated robot (eg. the cartpole) the torques of
+ * the unactuated joints are dropped, so the guess is only approximately
+ * consistent with the dynamics.
+ *
+ * @param times Times at which to evaluate the guess, relative to the start of
+ *   the trajectory.
+ */
+InitialGuess createPhysicsInitialGuessAt(const pinocchio::Model &model,
+                                         const Eigen::VectorXd &state_start,
+                                         const Eigen::VectorXd &state_end,
+                                         const int control_len,
+                                         const double traj_dur,
+                                         const Eigen::VectorXd &times);
+
+/*
+ * Create an initial guess at the knot points of a trajectory with
+ * num_segments segments of equal duration (see createPhysicsInitialGuessAt).
+ */
+InitialGuess createPhysicsInitialGuess(const pinocchio::Model &model,
+                                       const Eigen::VectorXd &state_start,
+                                       const Eigen::VectorXd &state_end,
+                                       const int control_len,
+                                       const double traj_dur,
+                                       const int num_segments);
+
+/*
+ * Stacked states at the knot points of a trajectory with num_segments
+ * segments, linearly interpolated from the start state to the end state. It
+ * ignores the dynamics, eg. for comparing solvers from a simple common start.
+ */
+Eigen::VectorXd createLinearStateGuess(const Eigen::VectorXd &state_start,
+                                       const Eigen::VectorXd &state_end,
+                                       const int num_segments);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#include <ifopt/composite.h>
+
+// Triplets of a jacobian block, eg. allocated from an EvaluationArena.
+using TripletList = std::pmr::vector<Eigen::Triplet<double>>;
+
+/*
+ * Fills a jacobian block from triplets whose positions are the same in every
+ * evaluation (eg. the defects of a collocation scheme). The first call builds
+ * the jacobian with setFromTriplets() and records where the value of each
+ * triplet is stored. The following calls with the same jacobian only update
+ * its values, which does not allocate. Duplicate triplets are summed in both
+ * cases.
+ *
+ * The jacobian is rebuilt when the positions of the triplets or the sparsity
+ * pattern of the jacobian differ from the recorded ones, eg. for a new
+ * jacobian of each call. ifopt::ConstraintSet::GetJacobian(), which IPOPT
+ * calls, passes a new empty block every time, so under IPOPT the jacobians
+ * are always rebuilt and allocated. The in-place update only applies to
+ * callers that keep their jacobian blocks between evaluations, eg.
+ * main_allocation_check.
+ */
+class JacobianFiller
+{
+public:
+    template <typename Triplets>
+    void fill(const Triplets &triplets, ifopt::Component::Jacobian &jac)
+    {
+        if (!hasPattern(triplets, jac)) {
+            jac.setFromTriplets(triplets.begin(), triplets.end());
+            recordPattern(triplets, jac);
+            return;
+        }
+        double *values = jac.valuePtr();
+        std::fill_n(values, jac.nonZeros(), 0.0);
+        for (std::size_t i{}; i < triplets.size(); ++i) {
+            values[m_value_indices[i]] += triplets[i].value();
+        }
+    }
+
+private:
+    using StorageIndex = ifopt::Component::Jacobian::StorageIndex;
+
+    template <typename Triplets>
+    bool hasPattern(const Triplets &triplets,
+                    const ifopt::Component::Jacobian &jac) const
+    {
+        if (!jac.isCompressed() || (jac.rows() != m_rows)
+            || (jac.cols() != m_cols)
+            || (static_cast<std::size_t>(jac.nonZeros()) != m_inner.size())
+            || (triplets.size() != m_value_indices.size())) {
+            return false;
+        }
+        if (!std::equal(m_outer.cbegin(), m_outer.cend(), jac.outerIndexPtr())
+            || !std::equal(
+                m_inner.cbegin(), m_inner.cend(), jac.innerIndexPtr())) {
+            return false;
+        }
+        for (std::size_t i{}; i < triplets.size(); ++i) {
+            if ((triplets[i].row() != m_triplet_rows[i])
+                || (triplets[i].col() != m_triplet_cols[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Triplets>
+    void recordPattern(const Triplets &triplets,
+                       const ifopt::Component::Jacobian &jac)
+    {
+        m_rows = jac.rows();
+        m_cols = jac.cols();
+        m_outer.assign(jac.outerIndexPtr(),
+                       jac.outerIndexPtr() + jac.outerSize() + 1);
+        m_inner.assign(jac.innerIndexPtr(),
+                       jac.innerIndexPtr() + jac.nonZeros());
+        m_triplet_rows.resize(triplets.size());
+        m_triplet_cols.resize(triplets.size());
+        m_value_indices.resize(triplets.size());
+        for (std::size_t i{}; i < triplets.size(); ++i) {
+            // the column indices of each row are sorted
+            const StorageIndex row = triplets[i].row();
+            const StorageIndex col = triplets[i].col();
+            const auto first = m_inner.cbegin() + m_outer[row];
+            const auto last = m_inner.cbegin() + m_outer[row + 1];
+            m_triplet_rows[i] = row;
+            m_triplet_cols[i] = col;
+            m_value_indices[i] = std::lower_bound(first, last, col)
+                                 - m_inner.cbegin();
+        }
+    }
+
+    Eigen::Index m_rows{-1};
+    Eigen::Index m_cols{-1};
+    // sparsity pattern of the jacobian (row major)
+    std::vector<StorageIndex> m_outer;
+    std::vector<StorageIndex> m_inner;
+    // position of each triplet and the index of its value in the jacobian
+    std::vector<StorageIndex> m_triplet_rows;
+    std::vector<StorageIndex> m_triplet_cols;
+    std::vector<std::ptrdiff_t> m_value_indices;
+};
@@ -0,0 +1,148 @@
+#include "block_tridiagonal_solver.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+BlockTridiagonalSolver::BlockTridiagonalSolver(std::vector<int> block_sizes)
+    : m_block_sizes{std::move(block_sizes)}
+{
+    if (m_block_sizes.empty()) {
+        throw std::invalid_argument(
+            "BlockTridiagonalSolver. Need at least one block.");
+    }
+
+    const int num_blocks = m_block_sizes.size();
+    m_block_offsets.reserve(num_blocks);
+    m_diag.reserve(num_blocks);
+    m_off_diag.reserve(num_blocks - 1);
+    for (int k{}; k < num_blocks; ++k) {
+        m_block_offsets.push_back(m_rows);
+        m_rows += m_block_sizes[k];
+        m_diag.emplace_back(
+            Eigen::MatrixXd::Zero(m_block_sizes[k], m_block_sizes[k]));
+        if (k < num_blocks - 1) {
+            m_off_diag.emplace_back(
+                Eigen::MatrixXd::Zero(m_block_sizes[k + 1], m_block_sizes[k]));
+        }
+    }
+    m_pivots.resize(num_blocks);
+    m_gains.resize(num_blocks - 1);
+}
+
+void BlockTridiagonalSolver::setZero()
+{
+    for (auto &block : m_diag) {
+        block.setZero();
+    }
+    for (auto &block : m_off_diag) {
+        block.setZero();
+    }
+}
+
+bool BlockTridiagonalSolver::factorize()
+{
+    const int num_blocks = numBlocks();
+
+    // Backward recursion from the last stage. The pivot block of a stage is
+    // its diagonal block minus the contribution of the following stages.
+    Eigen::MatrixXd pivot = m_diag[num_blocks - 1];
+    for (int k = num_blocks - 1; k >= 0; --k) {
+        if (m_block_sizes[k] > 0) {
+            m_pivots[k].compute(pivot);
+            const auto &d = m_pivots[k].vectorD();
+            if ((m_pivots[k].info() != Eigen::Success) || !d.allFinite()
+                || (d.cwiseAbs().minCoeff() == 0.0)) {
+                return false;
+            }
+        }
+        if (k == 0) {
+            break;
+        }
+
+        // G_(k-1) = P_k^-1 * L_(k-1)
+        auto &gain = m_gains[k - 1];
+        if (m_block_sizes[k] > 0) {
+            gain = m_pivots[k].solve(m_off_diag[k - 1]);
+        } else {
+            gain.resize(0, m_block_sizes[k - 1]);
+        }
+        pivot = m_diag[k - 1];
+        pivot.noalias() -= m_off_diag[k - 1].transpose() * gain;
+    }
+    return true;
+}
+
+Inertia BlockTridiagonalSolver::inertia() const
+{
+    Inertia ret;
+    for (int k{}; k < numBlocks(); ++k) {
+        if (m_block_sizes[k] == 0) {
+            continue;
+        }
+        const auto &d = m_pivots[k].vectorD();
+        for (int i{}; i < d.size(); ++i) {
+            if (d(i) > 0.0) {
+                ++ret.num_pos;
+            } else if (d(i) < 0.0) {
+                ++ret.num_neg;
+            } else {
+                ++ret.num_zero;
+            }
+        }
+    }
+    return ret;
+}
+
+void BlockTridiagonalSolver::solve(Eigen::VectorXd &rhs) const
+{
+    assert(rhs.size() == m_rows);
+    const int num_blocks = numBlocks();
+
+    // Backward sweep to eliminate the following stages from the right hand
+    // side: r_k = r_k - G_k' * r_(k+1)
+    for (int k = num_blocks - 2; k >= 0; --k) {
+        rhs.segment(m_block_offsets[k], m_block_sizes[k]).noalias()
+            -= m_gains[k].transpose()
+               * rhs.segment(m_block_offsets[k + 1], m_block_sizes[k + 1]);
+    }
+
+    // Forward sweep: x_0 = P_0^-1 * r_0 and
+    // x_(k+1) = P_(k+1)^-1 * r_(k+1) - G_k * x_k
+    for (int k{}; k < num_blocks; ++k) {
+        auto x_k = rhs.segment(m_block_offsets[k], m_block_sizes[k]);
+        if (m_block_sizes[k] == 0) {
+            continue;
+        }
+        x_k = m_pivots[k].solve(x_k);
+        if (k > 0) {
+            x_k.noalias()
+                -= m_gains[k - 1]
+                   * rhs.segment(m_block_offsets[k - 1],
+                                 m_block_sizes[k - 1]);
+        }
+    }
+}
+
+Eigen::VectorXd BlockTridiagonalSolver::multiply(
+    const Eigen::VectorXd &x) const
+{
+    assert(x.size() == m_rows);
+    Eigen::VectorXd y(m_rows);
+    for (int k{}; k < numBlocks(); ++k) {
+        const auto x_k = x.segment(m_block_offsets[k], m_block_sizes[k]);
+        auto y_k = y.segment(m_block_offsets[k], m_block_sizes[k]);
+        y_k.noalias()
+            = m_diag[k].selfadjointView<Eigen::Lower>() * x_k;
+        if (k > 0) {
+            y_k.noalias()
+                += m_off_diag[k - 1]
+                   * x.segment(m_block_offsets[k - 1], m_block_sizes[k - 1]);
+        }
+        if (k < numBlocks() - 1) {
+            y_k.noalias()
+                += m_off_diag[k].transpose()
+                   * x.segment(m_block_offsets[k + 1], m_block_sizes[k + 1]);
+        }
+    }
+    return y;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <vector>
+
+// Number of positive, negative and zero eigenvalues of a symmetric matrix.
+struct Inertia
+{
+    int num_pos{};
+    int num_neg{};
+    int num_zero{};
+};
+
+/*
+ * Solver for symmetric block tridiagonal linear systems, such as the KKT
+ * systems of collocation problems when the variables and constraints are
+ * ordered by time stage:
+ *
+ *   | D_0  L_0'                 |
+ *   | L_0  D_1  L_1'            |
+ *   |      L_1  D_2  ...        |
+ *   |           ...  ...  L_M'  |
+ *   |                L_M  D_N   |
+ *
+ * The matrix is factorized with a backward Riccati recursion over the stages:
+ *   P_N = D_N
+ *   P_k = D_k - L_k' * P_(k+1)^-1 * L_k
+ * which only needs dense operations on the stage blocks. The cost of the
+ * factorization is O(N * n^3) for N stages of size n, instead of depending on
+ * the fill-in of a general sparse factorization.
+ *
+ * The pivot blocks P_k are factorized with a pivoted LDL' decomposition. The
+ * inertia of the full matrix is the sum of the inertias of the pivot blocks
+ * (Sylvester's law of inertia), which is used by interior point methods to
+ * detect nonconvexity.
+ */
+class BlockTridiagonalSolver
+{
+public:
+    /*
+     * @param block_sizes Size of each diagonal block (one per stage). Empty
+     *   blocks are allowed.
+     */
+    explicit BlockTridiagonalSolver(std::vector<int> block_sizes);
+
+    int numBlocks() const
+    {
+        return m_block_sizes.size();
+    }
+
+    int blockSize(const int k) const
+    {
+        return m_block_sizes[k];
+    }
+
+    // Total number of rows of the full matrix.
+    int rows() const
+    {
+        return m_rows;
+    }
+
+    // Offset of block k in the full vector.
+    int blockOffset(const int k) const
+    {
+        return m_block_offsets[k];
+    }
+
+    // Diagonal block k. Only the lower triangle is used.
+    Eigen::MatrixXd &diagBlock(const int k)
+    {
+        return m_diag[k];
+    }
+
+    const Eigen::MatrixXd &diagBlock(const int k) const
+    {
+        return m_diag[k];
+    }
+
+    // Block below the diagonal block k (block row k+1, block column k).
+    Eigen::MatrixXd &offDiagBlock(const int k)
+    {
+        return m_off_diag[k];
+    }
+
+    const Eigen::MatrixXd &offDiagBlock(const int k) const
+    {
+        return m_off_diag[k];
+    }
+
+    // Set all blocks to zero while keeping their sizes.
+    void setZero();
+
+    /*
+     * Factorize the matrix with the current values of the blocks.
+     * @return False if a pivot block is singular.
+     */
+    bool factorize();
+
+    // Inertia of the last factorized matrix.
+    Inertia inertia() const;
+
+    // Solve the linear system in place with the last factorization.
+    void solve(Eigen::VectorXd &rhs) const;
+
+    // Calculate y = A*x with the current values of the blocks.
+    Eigen::VectorXd multiply(const Eigen::VectorXd &x) const;
+
+private:
+    std::vector<int> m_block_sizes;
+    std::vector<int> m_block_offsets;
+    int m_rows{};
+
+    std::vector<Eigen::MatrixXd> m_diag;
+    std::vector<Eigen::MatrixXd> m_off_diag;
+
+    // factorization of the pivot blocks P_k and the gain matrices
+    // G_k = P_(k+1)^-1 * L_k
+    std::vector<Eigen::LDLT<Eigen::MatrixXd>> m_pivots;
+    std::vector<Eigen::MatrixXd> m_gains;
+};
@@ -0,0 +1,896 @@
+#include "riccati_ip_solver.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "trajectory_costs.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    // parameters of the inertia correction
+    const double delta_w_init = 1e-4;
+    const double delta_w_min = 1e-20;
+    const double delta_w_max = 1e40;
+    const double delta_w_dec = 1.0 / 3.0;
+    const double delta_w_inc_first = 100.0;
+    const double delta_w_inc = 8.0;
+
+    // parameters of the line search
+    const double armijo = 1e-4;
+    const double alpha_min = 1e-12;
+    // filter line search
+    const double gamma_theta = 1e-5;
+    const double gamma_phi = 1e-8;
+    const double s_theta = 1.1;
+    const double s_phi = 2.3;
+    // maximum ratio of the bound multipliers to their primal estimates
+    const double kappa_sigma = 1e10;
+    // scaling limit of the optimality error
+    const double s_max = 100.0;
+
+    // Largest step in [0, 1] that keeps v + alpha*dv at least a fraction
+    // (1 - tau) of v away from zero, for the elements selected by the mask.
+    double fractionToBoundary(const Eigen::VectorXd &v,
+                              const Eigen::VectorXd &dv,
+                              const Eigen::Array<bool, Eigen::Dynamic, 1> &mask,
+                              const double tau)
+    {
+        double alpha = 1.0;
+        for (int i{}; i < v.size(); ++i) {
+            if (mask(i) && (dv(i) < 0.0)) {
+                alpha = std::min(alpha, -tau * v(i) / dv(i));
+            }
+        }
+        return alpha;
+    }
+}
+
+RiccatiIpSolver::RiccatiIpSolver(StageLayout layout,
+                                 const RiccatiIpOptions &options)
+    : m_layout{std::move(layout)}
+    , m_options{options}
+{}
+
+void RiccatiIpSolver::setupStages(ifopt::Problem &nlp)
+{
+    const int n = nlp.GetNumberOfOptimizationVariables();
+    const int m = nlp.GetNumberOfConstraints();
+
+    // variable bounds
+    const ifopt::Component::VecBound var_bounds
+        = nlp.GetBoundsOnOptimizationVariables();
+    m_lower.resize(n);
+    m_upper.resize(n);
+    m_has_lower.resize(n);
+    m_has_upper.resize(n);
+    m_is_free.resize(n);
+    for (int i{}; i < n; ++i) {
+        m_lower(i) = var_bounds[i].lower_;
+        m_upper(i) = var_bounds[i].upper_;
+        m_is_free(i) = m_lower(i) < m_upper(i);
+        m_has_lower(i) = m_is_free(i) && (m_lower(i) > -ifopt::inf);
+        m_has_upper(i) = m_is_free(i) && (m_upper(i) < ifopt::inf);
+    }
+
+    // constraint values
+    const ifopt::Component::VecBound constraint_bounds
+        = nlp.GetBoundsOnConstraints();
+    m_constraint_target.resize(m);
+    for (int i{}; i < m; ++i) {
+        if (constraint_bounds[i].lower_ != constraint_bounds[i].upper_) {
+            throw std::invalid_argument(
+                "RiccatiIpSolver. Only equality constraints are supported.");
+        }
+        m_constraint_target(i) = constraint_bounds[i].lower_;
+    }
+
+    // Split a variable or constraint set into blocks of stages. Returns the
+    // stage of each element.
+    const auto assign_stages = [](const ifopt::Composite &composite,
+                                  const std::map<std::string, int> &block_lens,
+                                  const int size) {
+        std::vector<int> stages;
+        stages.reserve(size);
+        for (const auto &component : composite.GetComponents()) {
+            const auto it = block_lens.find(component->GetName());
+            if ((it == block_lens.cend()) || (it->second <= 0)
+                || (component->GetRows() % it->second != 0)) {
+                throw std::invalid_argument(
+                    "RiccatiIpSolver. Missing or invalid stage layout for "
+                    + component->GetName());
+            }
+            for (int i{}; i < component->GetRows(); ++i) {
+                stages.push_back(i / it->second);
+            }
+        }
+        assert(static_cast<int>(stages.size()) == size);
+        return stages;
+    };
+    m_var_stage
+        = assign_stages(*nlp.GetOptVariables(), m_layout.var_block_lens, n);
+    m_row_stage = assign_stages(nlp.GetConstraints(),
+                                m_layout.constraint_block_lens,
+                                m);
+
+    int num_stages{};
+    for (const int stage : m_var_stage) {
+        num_stages = std::max(num_stages, stage + 1);
+    }
+    for (const int stage : m_row_stage) {
+        num_stages = std::max(num_stages, stage + 1);
+    }
+
+    // Order the stage blocks of the KKT system as the free variables of the
+    // stage followed by the constraints of the stage.
+    m_stage_vars.assign(num_stages, {});
+    m_var_local.assign(n, -1);
+    for (int i{}; i < n; ++i) {
+        if (m_is_free(i)) {
+            auto &stage_vars = m_stage_vars[m_var_stage[i]];
+            m_var_local[i] = stage_vars.size();
+            stage_vars.push_back(i);
+        }
+    }
+    std::vector<int> block_sizes(num_stages);
+    for (int k{}; k < num_stages; ++k) {
+        block_sizes[k] = m_stage_vars[k].size();
+    }
+    m_row_local.resize(m);
+    for (int i{}; i < m; ++i) {
+        m_row_local[i] = block_sizes[m_row_stage[i]]++;
+    }
+
+    m_hess_diag.clear();
+    m_hess_off_diag.clear();
+    for (int k{}; k < num_stages; ++k) {
+        const int num_vars = m_stage_vars[k].size();
+        m_hess_diag.emplace_back(Eigen::MatrixXd::Zero(num_vars, num_vars));
+        if (k < num_stages - 1) {
+            m_hess_off_diag.emplace_back(Eigen::MatrixXd::Zero(
+                m_stage_vars[k + 1].size(), num_vars));
+        }
+    }
+
+    m_kkt = std::make_unique<BlockTridiagonalSolver>(std::move(block_sizes));
+
+    // the sparsity pattern of the jacobian at the initial point
+    validateStageCoupling(nlp.GetJacobianOfConstraints());
+    setupCostHessians(nlp);
+}
+
+void RiccatiIpSolver::validateStageCoupling(const Jacobian &jac) const
+{
+    for (int row{}; row < jac.outerSize(); ++row) {
+        for (Jacobian::InnerIterator it(jac, row); it; ++it) {
+            const int col = it.col();
+            if (!m_is_free(col)) {
+                continue;
+            }
+            const int stage_diff = m_var_stage[col] - m_row_stage[row];
+            if ((stage_diff != 0) && (stage_diff != 1)) {
+                std::ostringstream os;
+                os << "RiccatiIpSolver. Constraint " << row << " of stage "
+                   << m_row_stage[row] << " depends on variable " << col
+                   << " of stage " << m_var_stage[col]
+                   << ", but only the variables of its stage and the next "
+                      "one are allowed.";
+                throw std::invalid_argument(os.str());
+            }
+        }
+    }
+}
+
+void RiccatiIpSolver::setupCostHessians(ifopt::Problem &nlp)
+{
+    const int n = nlp.GetNumberOfOptimizationVariables();
+    const auto var_sets = nlp.GetOptVariables()->GetComponents();
+    m_approx_costs.clear();
+    std::vector<Eigen::Triplet<double>> triplets;
+    for (const auto &cost : nlp.GetCosts().GetComponents()) {
+        const auto quadratic_cost
+            = std::dynamic_pointer_cast<QuadraticCostTerm>(cost);
+        if (!quadratic_cost || !quadratic_cost->hasConstantHessian()) {
+            m_approx_costs.push_back(cost);
+            continue;
+        }
+        int var_offset{};
+        for (const auto &var_set : var_sets) {
+            const Jacobian &hess
+                = quadratic_cost->getHessian(var_set->GetName());
+            for (int row{}; row < hess.outerSize(); ++row) {
+                for (Jacobian::InnerIterator it(hess, row); it; ++it) {
+                    const int i = var_offset + it.row();
+                    const int j = var_offset + it.col();
+                    if (!m_is_free(i) || !m_is_free(j)) {
+                        continue;
+                    }
+                    const int stage_diff = m_var_stage[i] - m_var_stage[j];
+                    if (std::abs(stage_diff) > 1) {
+                        throw std::invalid_argument(
+                            "RiccatiIpSolver. The hessian of "
+                            + cost->GetName()
+                            + " couples stages that are not neighbours.");
+                    }
+                    // the blocks above the diagonal follow from symmetry
+                    if ((stage_diff == 1)
+                        || ((stage_diff == 0)
+                            && (m_var_local[i] >= m_var_local[j]))) {
+                        triplets.push_back({i, j, it.value()});
+                    }
+                }
+            }
+            var_offset += var_set->GetRows();
+        }
+    }
+    m_const_hess.resize(n, n);
+    m_const_hess.setFromTriplets(triplets.cbegin(), triplets.cend());
+}
+
+Eigen::VectorXd RiccatiIpSolver::evalApproxLagrangianGradient(
+    ifopt::Problem &nlp,
+    const Eigen::VectorXd &x,
+    const Eigen::VectorXd &lambda) const
+{
+    nlp.SetVariables(x.data());
+    Eigen::VectorXd grad
+        = nlp.GetJacobianOfConstraints().transpose() * lambda;
+    for (const auto &cost : m_approx_costs) {
+        grad += cost->GetJacobian().transpose();
+    }
+    return grad;
+}
+
+void RiccatiIpSolver::computeHessian(ifopt::Problem &nlp,
+                                     const Eigen::VectorXd &x,
+                                     const Eigen::VectorXd &lambda)
+{
+    const int num_stages = m_stage_vars.size();
+    int max_stage_vars{};
+    for (const auto &stage_vars : m_stage_vars) {
+        max_stage_vars = std::max<int>(max_stage_vars, stage_vars.size());
+    }
+
+    // Estimates of the blocks above the diagonal, which are averaged with the
+    // blocks below the diagonal to keep the hessian symmetric.
+    std::vector<Eigen::MatrixXd> hess_upper(m_hess_off_diag.size());
+    for (int k{}; k < num_stages - 1; ++k) {
+        hess_upper[k].resize(m_stage_vars[k].size(),
+                             m_stage_vars[k + 1].size());
+    }
+
+    // Perturbing variable j of every third stage at once gives independent
+    // columns of the hessian, because a stage only couples to its
+    // neighbours.
+    const int num_colors = 3;
+    const double sqrt_eps = std::sqrt(std::numeric_limits<double>::epsilon());
+    const Eigen::VectorXd grad_approx
+        = evalApproxLagrangianGradient(nlp, x, lambda);
+    Eigen::VectorXd x_pert = x;
+    for (int color{}; color < num_colors; ++color) {
+        for (int j{}; j < max_stage_vars; ++j) {
+            bool perturbed = false;
+            for (int k = color; k < num_stages; k += num_colors) {
+                if (j < static_cast<int>(m_stage_vars[k].size())) {
+                    const int i = m_stage_vars[k][j];
+                    x_pert(i) = x(i) + sqrt_eps * std::max(1.0, std::abs(x(i)));
+                    perturbed = true;
+                }
+            }
+            if (!perturbed) {
+                continue;
+            }
+
+            const Eigen::VectorXd dgrad
+                = evalApproxLagrangianGradient(nlp, x_pert, lambda)
+                  - grad_approx;
+
+            for (int k = color; k < num_stages; k += num_colors) {
+                if (j >= static_cast<int>(m_stage_vars[k].size())) {
+                    continue;
+                }
+                const int i = m_stage_vars[k][j];
+                const double h = x_pert(i) - x(i);
+                x_pert(i) = x(i);
+
+                const auto &vars = m_stage_vars[k];
+                for (int l{}; l < static_cast<int>(vars.size()); ++l) {
+                    m_hess_diag[k](l, j) = dgrad(vars[l]) / h;
+                }
+                if (k > 0) {
+                    const auto &prev_vars = m_stage_vars[k - 1];
+                    for (int l{}; l < static_cast<int>(prev_vars.size()); ++l) {
+                        hess_upper[k - 1](l, j) = dgrad(prev_vars[l]) / h;
+                    }
+                }
+                if (k < num_stages - 1) {
+                    const auto &next_vars = m_stage_vars[k + 1];
+                    for (int l{}; l < static_cast<int>(next_vars.size()); ++l) {
+                        m_hess_off_diag[k](l, j) = dgrad(next_vars[l]) / h;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int k{}; k < num_stages; ++k) {
+        m_hess_diag[k] = 0.5 * (m_hess_diag[k] + m_hess_diag[k].transpose());
+        if (k < num_stages - 1) {
+            m_hess_off_diag[k]
+                = 0.5 * (m_hess_off_diag[k] + hess_upper[k].transpose());
+        }
+    }
+
+    // constant hessians of the quadratic cost terms
+    for (int row{}; row < m_const_hess.outerSize(); ++row) {
+        const int row_stage = m_var_stage[row];
+        const int row_local = m_var_local[row];
+        for (Jacobian::InnerIterator it(m_const_hess, row); it; ++it) {
+            const int col = it.col();
+            const int col_local = m_var_local[col];
+            if (m_var_stage[col] == row_stage) {
+                m_hess_diag[row_stage](row_local, col_local) += it.value();
+                if (row_local != col_local) {
+                    m_hess_diag[row_stage](col_local, row_local) += it.value();
+                }
+            } else {
+                m_hess_off_diag[row_stage - 1](row_local, col_local)
+                    += it.value();
+            }
+        }
+    }
+}
+
+void RiccatiIpSolver::assembleKkt(const Jacobian &jac,
+                                  const Eigen::VectorXd &sigma,
+                                  const double delta_w)
+{
+    m_kkt->setZero();
+    const int num_stages = m_stage_vars.size();
+
+    // hessian of the lagrangian, barrier term and regularization
+    for (int k{}; k < num_stages; ++k) {
+        const int num_vars = m_stage_vars[k].size();
+        auto &diag = m_kkt->diagBlock(k);
+        diag.topLeftCorner(num_vars, num_vars) = m_hess_diag[k];
+        for (int l{}; l < num_vars; ++l) {
+            diag(l, l) += sigma(m_stage_vars[k][l]) + delta_w;
+        }
+        for (int l = num_vars; l < m_kkt->blockSize(k); ++l) {
+            diag(l, l) = -m_options.reg_constraints;
+        }
+        if (k < num_stages - 1) {
+            m_kkt->offDiagBlock(k).topLeftCorner(m_stage_vars[k + 1].size(),
+                                                 num_vars)
+                = m_hess_off_diag[k];
+        }
+    }
+
+    // jacobian of the constraints
+    for (int row{}; row < jac.outerSize(); ++row) {
+        const int row_stage = m_row_stage[row];
+        const int row_local = m_row_local[row];
+        for (Jacobian::InnerIterator it(jac, row); it; ++it) {
+            const int col = it.col();
+            if (!m_is_free(col)) {
+                continue;
+            }
+            const int col_stage = m_var_stage[col];
+            const int col_local = m_var_local[col];
+            if (col_stage == row_stage) {
+                m_kkt->diagBlock(row_stage)(row_local, col_local) += it.value();
+                m_kkt->diagBlock(row_stage)(col_local, row_local) += it.value();
+            } else if (col_stage == row_stage + 1) {
+                m_kkt->offDiagBlock(row_stage)(col_local, row_local)
+                    += it.value();
+            } else {
+                throw std::runtime_error(
+                    "RiccatiIpSolver. A constraint depends on variables "
+                    "that are not in its stage or the next one.");
+            }
+        }
+    }
+}
+
+bool RiccatiIpSolver::factorizeKkt(const Jacobian &jac,
+                                   const Eigen::VectorXd &sigma,
+                                   double &delta_w_last)
+{
+    const int num_free = m_is_free.count();
+    const int m = m_row_stage.size();
+    double delta_w = 0.0;
+    while (delta_w <= delta_w_max) {
+        assembleKkt(jac, sigma, delta_w);
+        if (m_kkt->factorize()) {
+            const Inertia inertia = m_kkt->inertia();
+            if ((inertia.num_pos == num_free) && (inertia.num_neg == m)) {
+                if (delta_w > 0.0) {
+                    delta_w_last = delta_w;
+                }
+                return true;
+            }
+        }
+        if (delta_w == 0.0) {
+            delta_w = (delta_w_last == 0.0)
+                          ? delta_w_init
+                          : std::max(delta_w_min, delta_w_dec * delta_w_last);
+        } else {
+            delta_w *= (delta_w_last == 0.0) ? delta_w_inc_first : delta_w_inc;
+        }
+    }
+    return false;
+}
+
+void RiccatiIpSolver::scatterToKkt(const Eigen::VectorXd &vars,
+                                   const Eigen::VectorXd &rows,
+                                   Eigen::VectorXd &kkt) const
+{
+    kkt.resize(m_kkt->rows());
+    for (int i{}; i < vars.size(); ++i) {
+        if (m_is_free(i)) {
+            kkt(m_kkt->blockOffset(m_var_stage[i]) + m_var_local[i]) = vars(i);
+        }
+    }
+    for (int i{}; i < rows.size(); ++i) {
+        kkt(m_kkt->blockOffset(m_row_stage[i]) + m_row_local[i]) = rows(i);
+    }
+}
+
+void RiccatiIpSolver::gatherFromKkt(const Eigen::VectorXd &kkt,
+                                    Eigen::VectorXd &vars,
+                                    Eigen::VectorXd &rows) const
+{
+    for (int i{}; i < vars.size(); ++i) {
+        vars(i) = m_is_free(i)
+                      ? kkt(m_kkt->blockOffset(m_var_stage[i]) + m_var_local[i])
+                      : 0.0;
+    }
+    for (int i{}; i < rows.size(); ++i) {
+        rows(i) = kkt(m_kkt->blockOffset(m_row_stage[i]) + m_row_local[i]);
+    }
+}
+
+void RiccatiIpSolver::Solve(ifopt::Problem &nlp)
+{
+    const auto t_start = Clock::now();
+    m_stats = Statistics{};
+    setupStages(nlp);
+
+    const int n = nlp.GetNumberOfOptimizationVariables();
+    const int m = nlp.GetNumberOfConstraints();
+    const int num_free = m_is_free.count();
+    const int num_bounds = m_has_lower.count() + m_has_upper.count();
+
+    // Move the initial point strictly inside the bounds and fix the variables
+    // with equal bounds.
+    Eigen::VectorXd x = nlp.GetVariableValues();
+    for (int i{}; i < n; ++i) {
+        if (!m_is_free(i)) {
+            x(i) = m_lower(i);
+            continue;
+        }
+        const double range = m_upper(i) - m_lower(i);
+        if (m_has_lower(i)) {
+            const double push
+                = std::min(m_options.bound_push
+                               * std::max(1.0, std::abs(m_lower(i))),
+                           m_options.bound_frac * range);
+            x(i) = std::max(x(i), m_lower(i) + push);
+        }
+        if (m_has_upper(i)) {
+            const double push
+                = std::min(m_options.bound_push
+                               * std::max(1.0, std::abs(m_upper(i))),
+                           m_options.bound_frac * range);
+            x(i) = std::min(x(i), m_upper(i) - push);
+        }
+    }
+
+    Eigen::VectorXd lambda = Eigen::VectorXd::Zero(m);
+    Eigen::VectorXd z_lower = m_has_lower.cast<double>().matrix();
+    Eigen::VectorXd z_upper = m_has_upper.cast<double>().matrix();
+    double mu = m_options.mu_init;
+    double tau = std::max(m_options.tau_min, 1.0 - mu);
+    double delta_w_last = 0.0;
+
+    // Slacks to the bounds (one where there is no bound to avoid divisions by
+    // zero).
+    const auto slacks = [&](const Eigen::VectorXd &v,
+                            Eigen::VectorXd &s_lower,
+                            Eigen::VectorXd &s_upper) {
+        s_lower = m_has_lower.select(v - m_lower, 1.0);
+        s_upper = m_has_upper.select(m_upper - v, 1.0);
+    };
+
+    // Barrier objective and constraint violation (l1 norm) at a point. The
+    // barrier objective is infinite outside the bounds.
+    const auto barrier_objective = [&](const Eigen::VectorXd &v,
+                                       Eigen::VectorXd &c,
+                                       double &theta) {
+        Eigen::VectorXd s_lower, s_upper;
+        slacks(v, s_lower, s_upper);
+        if ((s_lower.minCoeff() <= 0.0) || (s_upper.minCoeff() <= 0.0)) {
+            return std::numeric_limits<double>::infinity();
+        }
+        c = nlp.EvaluateConstraints(v.data()) - m_constraint_target;
+        theta = c.lpNorm<1>();
+        const double value = nlp.EvaluateCostFunction(v.data())
+                             - mu * s_lower.array().log().sum()
+                             - mu * s_upper.array().log().sum();
+        return (std::isfinite(value) && std::isfinite(theta))
+                   ? value
+                   : std::numeric_limits<double>::infinity();
+    };
+
+    // Filter of (constraint violation, barrier objective) pairs that trial
+    // points must improve on. It is reset when the barrier parameter changes.
+    std::vector<std::pair<double, double>> filter;
+    double theta_max{};
+    double theta_min{};
+
+    if (m_options.print) {
+        std::cout << "RiccatiIpSolver: " << n << " variables (" << num_free
+                  << " free), " << m << " constraints, "
+                  << m_stage_vars.size() << " stages" << std::endl;
+        std::cout << "iter    objective    inf_pr    inf_du  lg(mu)"
+                  << std::endl;
+    }
+
+    Jacobian jac;
+    Eigen::VectorXd s_lower, s_upper;
+    Eigen::VectorXd kkt_vec, dx(n), dlambda(m);
+    int iter{};
+    for (;; ++iter) {
+        // evaluate the functions at the current point
+        const Eigen::VectorXd c
+            = nlp.EvaluateConstraints(x.data()) - m_constraint_target;
+        const double objective = nlp.EvaluateCostFunction(x.data());
+        const Eigen::VectorXd grad_f = nlp.EvaluateCostFunctionGradient(
+            x.data());
+        jac = nlp.GetJacobianOfConstraints();
+        const Eigen::VectorXd grad_lag = grad_f + jac.transpose() * lambda;
+        slacks(x, s_lower, s_upper);
+
+        // optimality error of the barrier problem for a given mu
+        const auto optimality_error = [&](const double mu_) {
+            const Eigen::VectorXd dual = m_is_free.select(
+                grad_lag - z_lower + z_upper, 0.0);
+            const Eigen::VectorXd compl_lower = m_has_lower.select(
+                z_lower.cwiseProduct(s_lower).array() - mu_, 0.0);
+            const Eigen::VectorXd compl_upper = m_has_upper.select(
+                z_upper.cwiseProduct(s_upper).array() - mu_, 0.0);
+            const double z_norm = z_lower.lpNorm<1>() + z_upper.lpNorm<1>();
+            const double s_d = std::max(s_max,
+                                        (lambda.lpNorm<1>() + z_norm)
+                                            / std::max(1, m + num_bounds))
+                               / s_max;
+            const double s_c
+                = std::max(s_max, z_norm / std::max(1, num_bounds)) / s_max;
+            return std::max({dual.lpNorm<Eigen::Infinity>() / s_d,
+                             c.lpNorm<Eigen::Infinity>(),
+                             std::max(compl_lower.lpNorm<Eigen::Infinity>(),
+                                      compl_upper.lpNorm<Eigen::Infinity>())
+                                 / s_c});
+        };
+
+        m_stats.objective = objective;
+        m_stats.constraint_violation = c.lpNorm<Eigen::Infinity>();
+        if (m_options.print) {
+            const Eigen::VectorXd dual = m_is_free.select(
+                grad_lag - z_lower + z_upper, 0.0);
+            std::cout << std::setw(4) << iter << std::scientific
+                      << std::setprecision(6) << std::setw(13) << objective
+                      << std::setprecision(2) << std::setw(10)
+                      << m_stats.constraint_violation << std::setw(10)
+                      << dual.lpNorm<Eigen::Infinity>() << std::fixed
+                      << std::setprecision(1) << std::setw(8)
+                      << std::log10(mu) << std::defaultfloat << std::endl;
+        }
+
+        if (optimality_error(0.0) <= m_options.tol) {
+            m_stats.status = Status::SUCCESS;
+            break;
+        }
+        if (iter >= m_options.max_iter) {
+            m_stats.status = Status::MAX_ITER_EXCEEDED;
+            break;
+        }
+
+        // decrease the barrier parameter once the barrier problem is solved
+        // well enough
+        const double mu_min = m_options.tol / 10.0;
+        while ((mu > mu_min)
+               && (optimality_error(mu) <= m_options.kappa_eps * mu)) {
+            mu = std::max(mu_min,
+                          std::min(m_options.kappa_mu * mu,
+                                   std::pow(mu, m_options.theta_mu)));
+            tau = std::max(m_options.tau_min, 1.0 - mu);
+            filter.clear();
+        }
+
+        // hessian of the lagrangian
+        const auto t_hess = Clock::now();
+        computeHessian(nlp, x, lambda);
+        m_stats.hessian_time += Milliseconds(Clock::now() - t_hess).count();
+
+        // Newton step of the primal-dual equations with the bound multipliers
+        // eliminated:
+        // | W + sigma  J' | | dx      |     | grad_barrier + J'*lambda |
+        // | J          0  | | dlambda | = - | c                        |
+        const Eigen::VectorXd sigma
+            = m_has_lower.select(z_lower.cwiseQuotient(s_lower), 0.0)
+              + m_has_upper.select(z_upper.cwiseQuotient(s_upper), 0.0);
+        const Eigen::VectorXd grad_barrier
+            = grad_f - m_has_lower.select(mu * s_lower.cwiseInverse(), 0.0)
+              + m_has_upper.select(mu * s_upper.cwiseInverse(), 0.0);
+        const Eigen::VectorXd rhs_vars
+            = grad_barrier + jac.transpose() * lambda;
+
+        const auto t_linear = Clock::now();
+        if (!factorizeKkt(jac, sigma, delta_w_last)) {
+            m_stats.linear_solve_time
+                += Milliseconds(Clock::now() - t_linear).count();
+            m_stats.status = Status::REGULARIZATION_FAILED;
+            break;
+        }
+
+        scatterToKkt(-rhs_vars, -c, kkt_vec);
+        m_kkt->solve(kkt_vec);
+        gatherFromKkt(kkt_vec, dx, dlambda);
+        m_stats.linear_solve_time
+            += Milliseconds(Clock::now() - t_linear).count();
+
+        // Backtracking filter line search. A trial point is accepted if it
+        // sufficiently reduces the constraint violation or the barrier
+        // objective and is not dominated by the filter. Close to feasibility a
+        // sufficient decrease of the barrier objective is required instead.
+        // The first trial step is followed by a second order correction if it
+        // increased the constraint violation.
+        Eigen::VectorXd c_trial;
+        double theta{};
+        const double phi = barrier_objective(x, c_trial, theta);
+        if (iter == 0) {
+            theta_max = 1e4 * std::max(1.0, theta);
+            theta_min = 1e-4 * std::max(1.0, theta);
+        }
+        const double dphi = grad_barrier.dot(dx);
+        const auto is_acceptable = [&](const double theta_trial,
+                                       const double phi_trial,
+                                       const double alpha_trial,
+                                       bool &objective_step) {
+            objective_step = false;
+            if (!std::isfinite(phi_trial) || (theta_trial > theta_max)) {
+                return false;
+            }
+            for (const auto &[theta_filter, phi_filter] : filter) {
+                if ((theta_trial >= theta_filter)
+                    && (phi_trial >= phi_filter)) {
+                    return false;
+                }
+            }
+            if ((theta <= theta_min) && (dphi < 0.0)
+                && (alpha_trial * std::pow(-dphi, s_phi)
+                    > std::pow(theta, s_theta))) {
+                objective_step = true;
+                return phi_trial <= phi + armijo * alpha_trial * dphi;
+            }
+            return (theta_trial <= (1.0 - gamma_theta) * theta)
+                   || (phi_trial <= phi - gamma_phi * theta);
+        };
+
+        const double alpha_max = std::min(
+            fractionToBoundary(s_lower, dx, m_has_lower, tau),
+            fractionToBoundary(s_upper, -dx, m_has_upper, tau));
+        double alpha = alpha_max;
+        bool accepted = false;
+        bool objective_step = false;
+        while (alpha >= alpha_min) {
+            const Eigen::VectorXd x_trial = x + alpha * dx;
+            double theta_trial{};
+            const double phi_trial
+                = barrier_objective(x_trial, c_trial, theta_trial);
+            if (is_acceptable(theta_trial, phi_trial, alpha, objective_step)) {
+                accepted = true;
+                break;
+            }
+
+            if ((alpha == alpha_max) && std::isfinite(phi_trial)
+                && (theta_trial >= theta)) {
+                // second order correction of the constraints
+                const Eigen::VectorXd c_soc = alpha * c + c_trial;
+                scatterToKkt(-rhs_vars, -c_soc, kkt_vec);
+                m_kkt->solve(kkt_vec);
+                Eigen::VectorXd dx_soc(n), dlambda_soc(m);
+                gatherFromKkt(kkt_vec, dx_soc, dlambda_soc);
+                const double alpha_soc = std::min(
+                    fractionToBoundary(s_lower, dx_soc, m_has_lower, tau),
+                    fractionToBoundary(s_upper, -dx_soc, m_has_upper, tau));
+                const Eigen::VectorXd x_soc = x + alpha_soc * dx_soc;
+                double theta_soc{};
+                const double phi_soc
+                    = barrier_objective(x_soc, c_trial, theta_soc);
+                if (is_acceptable(theta_soc, phi_soc, alpha, objective_step)) {
+                    dx = dx_soc;
+                    dlambda = dlambda_soc;
+                    alpha = alpha_soc;
+                    accepted = true;
+                    break;
+                }
+            }
+            alpha *= 0.5;
+        }
+        if (!accepted) {
+            m_stats.status = Status::LINE_SEARCH_FAILED;
+            break;
+        }
+        if (!objective_step) {
+            filter.emplace_back((1.0 - gamma_theta) * theta,
+                                phi - gamma_phi * theta);
+        }
+
+        // step of the bound multipliers
+        const Eigen::VectorXd dz_lower = m_has_lower.select(
+            mu * s_lower.cwiseInverse() - z_lower
+                - z_lower.cwiseQuotient(s_lower).cwiseProduct(dx),
+            0.0);
+        const Eigen::VectorXd dz_upper = m_has_upper.select(
+            mu * s_upper.cwiseInverse() - z_upper
+                + z_upper.cwiseQuotient(s_upper).cwiseProduct(dx),
+            0.0);
+        const double alpha_z
+            = std::min(fractionToBoundary(z_lower, dz_lower, m_has_lower, tau),
+                       fractionToBoundary(z_upper, dz_upper, m_has_upper, tau));
+
+        x += alpha * dx;
+        lambda += alpha * dlambda;
+        z_lower += alpha_z * dz_lower;
+        z_upper += alpha_z * dz_upper;
+
+        // keep the bound multipliers close to their primal estimates
+        slacks(x, s_lower, s_upper);
+        for (int i{}; i < n; ++i) {
+            if (m_has_lower(i)) {
+                z_lower(i) = std::clamp(z_lower(i),
+                                        mu / (kappa_sigma * s_lower(i)),
+                                        kappa_sigma * mu / s_lower(i));
+            }
+            if (m_has_upper(i)) {
+                z_upper(i) = std::clamp(z_upper(i),
+                                        mu / (kappa_sigma * s_upper(i)),
+                                        kappa_sigma * mu / s_upper(i));
+            }
+        }
+    }
+
+    // Factorize the KKT matrix at the solution for the sensitivity updates.
+    m_has_solution = false;
+    if (m_stats.status == Status::SUCCESS) {
+        nlp.SetVariables(x.data());
+        jac = nlp.GetJacobianOfConstraints();
+        const auto t_hess = Clock::now();
+        computeHessian(nlp, x, lambda);
+        m_stats.hessian_time += Milliseconds(Clock::now() - t_hess).count();
+
+        slacks(x, s_lower, s_upper);
+        const Eigen::VectorXd sigma
+            = m_has_lower.select(z_lower.cwiseQuotient(s_lower), 0.0)
+              + m_has_upper.select(z_upper.cwiseQuotient(s_upper), 0.0);
+        const auto t_linear = Clock::now();
+        m_has_solution = factorizeKkt(jac, sigma, delta_w_last);
+        m_stats.linear_solve_time
+            += Milliseconds(Clock::now() - t_linear).count();
+        m_x = x;
+        m_lambda = lambda;
+        m_mu = mu;
+    }
+
+    nlp.SetVariables(x.data());
+    m_stats.iterations = iter;
+    m_stats.total_time = Milliseconds(Clock::now() - t_start).count();
+
+    if (m_options.print) {
+        std::cout << "RiccatiIpSolver: status "
+                  << static_cast<int>(m_stats.status) << ", iterations "
+                  << m_stats.iterations << ", objective " << m_stats.objective
+                  << ", total time " << m_stats.total_time
+                  << " ms, linear solve time " << m_stats.linear_solve_time
+                  << " ms, hessian time " << m_stats.hessian_time << " ms"
+                  << std::endl;
+    }
+}
+
+RiccatiIpSolver::SensitivityStatistics RiccatiIpSolver::sensitivityUpdate(
+    ifopt::Problem &perturbed_nlp,
+    const int num_corrector_iter)
+{
+    if (!m_has_solution) {
+        throw std::logic_error(
+            "RiccatiIpSolver. A sensitivity update requires a successful "
+            "solve.");
+    }
+
+    const auto t_start = Clock::now();
+    const int n = perturbed_nlp.GetNumberOfOptimizationVariables();
+    const int m = perturbed_nlp.GetNumberOfConstraints();
+    if ((n != m_x.size()) || (m != m_lambda.size())) {
+        throw std::invalid_argument(
+            "RiccatiIpSolver. The perturbed problem has a different size.");
+    }
+
+    // The fixed variables take the values of the perturbed problem. The free
+    // variables must have the same kind of bounds as before.
+    const ifopt::Component::VecBound var_bounds
+        = perturbed_nlp.GetBoundsOnOptimizationVariables();
+    Eigen::VectorXd lower(n), upper(n);
+    Eigen::VectorXd x = m_x;
+    for (int i{}; i < n; ++i) {
+        lower(i) = var_bounds[i].lower_;
+        upper(i) = var_bounds[i].upper_;
+        if (((lower(i) < upper(i)) != m_is_free(i))
+            || (m_is_free(i)
+                && (((lower(i) > -ifopt::inf) != m_has_lower(i))
+                    || ((upper(i) < ifopt::inf) != m_has_upper(i))))) {
+            throw std::invalid_argument(
+                "RiccatiIpSolver. The perturbed problem has different kinds "
+                "of variable bounds.");
+        }
+        if (!m_is_free(i)) {
+            x(i) = lower(i);
+        }
+    }
+    const ifopt::Component::VecBound constraint_bounds
+        = perturbed_nlp.GetBoundsOnConstraints();
+    Eigen::VectorXd constraint_target(m);
+    for (int i{}; i < m; ++i) {
+        constraint_target(i) = constraint_bounds[i].lower_;
+    }
+
+    SensitivityStatistics stats;
+    Eigen::VectorXd lambda = m_lambda;
+    Eigen::VectorXd kkt_vec, dx(n), dlambda(m);
+    Jacobian jac;
+    const double tau = std::max(m_options.tau_min, 1.0 - m_mu);
+    for (int iter{}; iter <= num_corrector_iter; ++iter) {
+        // Newton step of the barrier problem of the perturbed problem with the
+        // KKT matrix of the previous solution
+        const Eigen::VectorXd s_lower = m_has_lower.select(x - lower, 1.0);
+        const Eigen::VectorXd s_upper = m_has_upper.select(upper - x, 1.0);
+        const Eigen::VectorXd c
+            = perturbed_nlp.EvaluateConstraints(x.data()) - constraint_target;
+        const Eigen::VectorXd grad_barrier
+            = perturbed_nlp.EvaluateCostFunctionGradient(x.data())
+              - m_has_lower.select(m_mu * s_lower.cwiseInverse(), 0.0)
+              + m_has_upper.select(m_mu * s_upper.cwiseInverse(), 0.0);
+        jac = perturbed_nlp.GetJacobianOfConstraints();
+        const Eigen::VectorXd rhs_vars
+            = grad_barrier + jac.transpose() * lambda;
+
+        scatterToKkt(-rhs_vars, -c, kkt_vec);
+        m_kkt->solve(kkt_vec);
+        gatherFromKkt(kkt_vec, dx, dlambda);
+
+        // stay strictly inside the bounds
+        const double alpha = std::min(
+            fractionToBoundary(s_lower, dx, m_has_lower, tau),
+            fractionToBoundary(s_upper, -dx, m_has_upper, tau));
+        x += alpha * dx;
+        lambda += alpha * dlambda;
+        stats.corrector_iterations = iter;
+    }
+
+    perturbed_nlp.SetVariables(x.data());
+    stats.constraint_violation
+        = (perturbed_nlp.EvaluateConstraints(x.data()) - constraint_target)
+              .lpNorm<Eigen::Infinity>();
+    stats.time = Milliseconds(Clock::now() - t_start).count();
+    return stats;
+}
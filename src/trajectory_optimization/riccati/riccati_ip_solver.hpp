@@ -0,0 +1,238 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ifopt/problem.h>
+#include <ifopt/solver.h>
+
+#include "block_tridiagonal_solver.hpp"
+
+// Assignment of the variables and constraints of a collocation problem to time
+// stages. Each variable or constraint set is split into consecutive blocks of
+// the given length and block i belongs to stage i. For example the states at
+// the knot points use a block length of state_len, and the defects of the
+// trapezoidal collocation constraints also use a block length of state_len
+// (defect k belongs to segment k, which starts at knot point k).
+//
+// A constraint of stage k may only depend on the free variables of the stages
+// k and k+1, and the cost terms may only couple variables of neighbouring
+// stages. A constraint of stages k-1 and k+1 would couple them in the hessian
+// of the lagrangian, which would no longer be block tridiagonal. The jacobian
+// of the constraints is checked against this when solving.
+struct StageLayout
+{
+    std::map<std::string, int> var_block_lens;
+    std::map<std::string, int> constraint_block_lens;
+};
+
+struct RiccatiIpOptions
+{
+    int max_iter = 3000;
+    // convergence tolerance of the scaled optimality error
+    double tol = 1e-6;
+    double mu_init = 0.1;
+    // minimum absolute and relative distance of the initial point to the
+    // bounds
+    double bound_push = 1e-2;
+    double bound_frac = 1e-2;
+    // minimum fraction to the boundary parameter
+    double tau_min = 0.99;
+    // barrier parameter update
+    double kappa_eps = 10.0;
+    double kappa_mu = 0.2;
+    double theta_mu = 1.5;
+    // regularization of the constraint block of the KKT matrix, which keeps
+    // the stage pivot blocks nonsingular
+    double reg_constraints = 1e-9;
+    // print the progress of each iteration
+    bool print = true;
+};
+
+/*
+ * Primal-dual interior point solver for collocation problems with equality
+ * constraints and bounds on the variables, which exploits the block banded
+ * structure of the problem in time.
+ *
+ * The variables and constraints are ordered by time stage, which makes the
+ * KKT matrix of each Newton step block tridiagonal. It is factorized with a
+ * Riccati recursion over the stages (see BlockTridiagonalSolver), so the cost
+ * of the linear solve grows linearly with the number of segments.
+ *
+ * The bounds are handled with a logarithmic barrier and the globalization uses
+ * a backtracking filter line search with a second order correction. The
+ * constant hessians of the quadratic cost terms (see QuadraticCostTerm) are
+ * added exactly. The rest of the hessian of the lagrangian, ie. of the
+ * constraints and of the other cost terms, is approximated by finite
+ * differences of its gradient, where the columns of stages that are at least
+ * three stages apart are perturbed together. Variables with equal lower and
+ * upper bounds (eg. the start and end states) are held fixed.
+ *
+ * The algorithm follows the basic interior point method of IPOPT: Wachter,
+ * Biegler, "On the implementation of an interior-point filter line-search
+ * algorithm for large-scale nonlinear programming", 2006.
+ *
+ * After a successful solve the KKT matrix is factorized at the solution and
+ * kept, so the solution of a slightly perturbed problem (eg. a shifted goal
+ * state or trajectory duration) can be approximated by a parametric
+ * sensitivity update (see sensitivityUpdate) instead of a full solve, as in
+ * sIPOPT: Pirnay, Lopez-Negrete, Biegler, "Optimal sensitivity based on
+ * IPOPT", 2012.
+ */
+class RiccatiIpSolver : public ifopt::Solver
+{
+public:
+    enum class Status
+    {
+        SUCCESS,
+        MAX_ITER_EXCEEDED,
+        LINE_SEARCH_FAILED,
+        REGULARIZATION_FAILED
+    };
+
+    struct Statistics
+    {
+        Status status{Status::MAX_ITER_EXCEEDED};
+        int iterations{};
+        double objective{};
+        double constraint_violation{};
+        // wall clock times in milliseconds
+        double total_time{};
+        double linear_solve_time{};
+        double hessian_time{};
+    };
+
+    struct SensitivityStatistics
+    {
+        int corrector_iterations{};
+        // constraint violation of the perturbed problem at the updated
+        // solution
+        double constraint_violation{};
+        // wall clock time in milliseconds
+        double time{};
+    };
+
+    RiccatiIpSolver(StageLayout layout, const RiccatiIpOptions &options);
+
+    // Solve the problem starting from its current variable values. The
+    // solution is set as the new variable values of the problem.
+    void Solve(ifopt::Problem &nlp) override;
+
+    const Statistics &getStatistics() const
+    {
+        return m_stats;
+    }
+
+    /*
+     * Approximate the solution of a perturbed problem from the solution of the
+     * last successful call to Solve, without a new factorization of the KKT
+     * matrix. The perturbed problem must have the same variables, constraints
+     * and fixed variables, but the values of the fixed variables (eg. the end
+     * state) and the parameters of the constraints and costs (eg. the duration
+     * of the segments) may differ.
+     *
+     * The first order update is a Newton step of the perturbed problem from
+     * the previous solution with the KKT matrix at the previous solution. Each
+     * corrector iteration repeats this step from the updated point with the
+     * same KKT matrix. The updated solution is set as the new variable values
+     * of the perturbed problem. The stored solution is not changed, so several
+     * perturbations of the same problem can be evaluated.
+     *
+     * @param num_corrector_iter Number of corrector iterations after the
+     *   first order update.
+     */
+    SensitivityStatistics sensitivityUpdate(ifopt::Problem &perturbed_nlp,
+                                            const int num_corrector_iter = 0);
+
+private:
+    using Jacobian = ifopt::Component::Jacobian;
+
+    // Map the variables and constraints of the problem to the stages.
+    void setupStages(ifopt::Problem &nlp);
+
+    // Throw if a constraint depends on a free variable outside of its stage
+    // and the next one (see StageLayout).
+    void validateStageCoupling(const Jacobian &jac) const;
+
+    // Sort the cost terms into the ones with a constant hessian, whose sum is
+    // kept, and the ones whose hessian is approximated. Throw if a constant
+    // hessian couples free variables of stages that are not neighbours.
+    void setupCostHessians(ifopt::Problem &nlp);
+
+    // Gradient of the part of the lagrangian whose hessian is approximated,
+    // ie. lambda'*c(x) plus the cost terms without a constant hessian.
+    Eigen::VectorXd evalApproxLagrangianGradient(
+        ifopt::Problem &nlp,
+        const Eigen::VectorXd &x,
+        const Eigen::VectorXd &lambda) const;
+
+    // Compute the stage blocks of the hessian of the lagrangian, from finite
+    // differences of evalApproxLagrangianGradient and the constant hessians.
+    void computeHessian(ifopt::Problem &nlp,
+                        const Eigen::VectorXd &x,
+                        const Eigen::VectorXd &lambda);
+
+    // Fill the KKT matrix from the hessian, the jacobian of the constraints,
+    // the barrier term sigma and the regularization delta_w.
+    void assembleKkt(const Jacobian &jac,
+                     const Eigen::VectorXd &sigma,
+                     const double delta_w);
+
+    // Assemble and factorize the KKT matrix with the smallest regularization
+    // that gives the inertia of a convex problem in the null space of the
+    // constraints. Returns false if no such regularization is found.
+    bool factorizeKkt(const Jacobian &jac,
+                      const Eigen::VectorXd &sigma,
+                      double &delta_w_last);
+
+    // Convert between the full vectors of the problem and the stage ordered
+    // vector of the KKT system.
+    void scatterToKkt(const Eigen::VectorXd &vars,
+                      const Eigen::VectorXd &rows,
+                      Eigen::VectorXd &kkt) const;
+    void gatherFromKkt(const Eigen::VectorXd &kkt,
+                       Eigen::VectorXd &vars,
+                       Eigen::VectorXd &rows) const;
+
+    const StageLayout m_layout;
+    const RiccatiIpOptions m_options;
+    Statistics m_stats;
+
+    // bounds of the variables and values of the constraints
+    Eigen::VectorXd m_lower;
+    Eigen::VectorXd m_upper;
+    Eigen::Array<bool, Eigen::Dynamic, 1> m_has_lower;
+    Eigen::Array<bool, Eigen::Dynamic, 1> m_has_upper;
+    Eigen::Array<bool, Eigen::Dynamic, 1> m_is_free;
+    Eigen::VectorXd m_constraint_target;
+
+    // stage and position in the stage block of each variable and constraint
+    std::vector<int> m_var_stage;
+    std::vector<int> m_var_local;
+    std::vector<int> m_row_stage;
+    std::vector<int> m_row_local;
+    // free variables of each stage
+    std::vector<std::vector<int>> m_stage_vars;
+
+    // cost terms whose hessian is approximated, and the sum of the constant
+    // hessians of the other cost terms (below the diagonal and between free
+    // variables only)
+    std::vector<ifopt::Component::Ptr> m_approx_costs;
+    Jacobian m_const_hess;
+
+    // hessian of the lagrangian w.r.t the free variables of a stage, and
+    // between the free variables of stage k+1 (rows) and stage k (columns)
+    std::vector<Eigen::MatrixXd> m_hess_diag;
+    std::vector<Eigen::MatrixXd> m_hess_off_diag;
+
+    std::unique_ptr<BlockTridiagonalSolver> m_kkt;
+
+    // Solution of the last successful solve, whose KKT matrix is factorized
+    // in m_kkt, for the sensitivity updates.
+    bool m_has_solution{false};
+    Eigen::VectorXd m_x;
+    Eigen::VectorXd m_lambda;
+    double m_mu{};
+};
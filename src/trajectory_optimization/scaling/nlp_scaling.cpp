@@ -0,0 +1,188 @@
+#include "nlp_scaling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    double clampScale(const double scale, const NlpScalingOptions &options)
+    {
+        if (!std::isfinite(scale)) {
+            return 1.0;
+        }
+        return std::clamp(scale, options.min_scale, options.max_scale);
+    }
+
+    bool isFinite(const double bound)
+    {
+        return std::abs(bound) < ifopt::inf;
+    }
+}
+
+NlpScaling computeNlpScaling(ifopt::Problem &nlp,
+                             const NlpScalingOptions &options)
+{
+    const int num_vars = nlp.GetNumberOfOptimizationVariables();
+    const int num_rows = nlp.GetNumberOfConstraints();
+    const Eigen::VectorXd x = nlp.GetVariableValues();
+
+    NlpScaling scaling;
+
+    // variables from their bounds
+    scaling.x_scaling = Eigen::VectorXd::Ones(num_vars);
+    const ifopt::Component::VecBound var_bounds
+        = nlp.GetBoundsOnOptimizationVariables();
+    for (int i{}; i < num_vars; ++i) {
+        const double lower = var_bounds[i].lower_;
+        const double upper = var_bounds[i].upper_;
+        if (isFinite(lower) && isFinite(upper) && (lower < upper)) {
+            const double range = std::max(std::abs(lower), std::abs(upper));
+            scaling.x_scaling(i) = clampScale(1.0 / range, options);
+        }
+    }
+
+    // constraint rows from the jacobian w.r.t the scaled variables, whose
+    // entries are J(i, j) / x_scaling(j)
+    nlp.SetVariables(x.data());
+    const ifopt::Component::Jacobian jac = nlp.GetJacobianOfConstraints();
+    scaling.g_scaling = Eigen::VectorXd::Ones(num_rows);
+    for (int i{}; i < jac.outerSize(); ++i) {
+        double row_max{};
+        for (ifopt::Component::Jacobian::InnerIterator it(jac, i); it; ++it) {
+            const double value = it.value() / scaling.x_scaling(it.col());
+            row_max = std::max(row_max, std::abs(value));
+        }
+        if (row_max > 0.0) {
+            scaling.g_scaling(i)
+                = clampScale(options.target_row_norm / row_max, options);
+        }
+    }
+
+    // objective from its gradient w.r.t the scaled variables
+    if (nlp.HasCostTerms()) {
+        const Eigen::VectorXd grad = nlp.EvaluateCostFunctionGradient(x.data());
+        const double grad_max
+            = grad.cwiseQuotient(scaling.x_scaling).lpNorm<Eigen::Infinity>();
+        if (grad_max > 0.0) {
+            scaling.obj_scaling
+                = clampScale(options.target_gradient / grad_max, options);
+        }
+    }
+    return scaling;
+}
+
+ScaledIpoptAdapter::ScaledIpoptAdapter(ifopt::Problem &nlp,
+                                       NlpScaling scaling,
+                                       bool finite_diff)
+    : ifopt::IpoptAdapter(nlp, finite_diff)
+    , m_scaling{std::move(scaling)}
+{}
+
+bool ScaledIpoptAdapter::get_scaling_parameters(Ipopt::Number &obj_scaling,
+                                                bool &use_x_scaling,
+                                                Ipopt::Index n,
+                                                Ipopt::Number *x_scaling,
+                                                bool &use_g_scaling,
+                                                Ipopt::Index m,
+                                                Ipopt::Number *g_scaling)
+{
+    assert(n == m_scaling.x_scaling.size());
+    assert(m == m_scaling.g_scaling.size());
+    obj_scaling = m_scaling.obj_scaling;
+    use_x_scaling = true;
+    Eigen::Map<Eigen::VectorXd>(x_scaling, n) = m_scaling.x_scaling;
+    use_g_scaling = true;
+    Eigen::Map<Eigen::VectorXd>(g_scaling, m) = m_scaling.g_scaling;
+    return true;
+}
+
+ScaledIpoptSolver::ScaledIpoptSolver(const NlpScalingOptions &options)
+    : m_options{options}
+    , m_ipopt_app{std::make_shared<Ipopt::IpoptApplication>()}
+    , m_status{Ipopt::Solve_Succeeded}
+{
+    m_ipopt_app->RethrowNonIpoptException(true);
+
+    // same defaults as ifopt::IpoptSolver
+    SetOption("linear_solver", "mumps");
+    SetOption("jacobian_approximation", "exact");
+    SetOption("hessian_approximation", "limited-memory");
+    SetOption("max_cpu_time", 40.0);
+    SetOption("tol", 0.001);
+    SetOption("print_timing_statistics", "no");
+    SetOption("print_user_options", "no");
+    SetOption("print_level", 4);
+
+    SetOption("nlp_scaling_method", "user-scaling");
+}
+
+void ScaledIpoptSolver::Solve(ifopt::Problem &nlp)
+{
+    m_status = m_ipopt_app->Initialize();
+    if (m_status != Ipopt::Solve_Succeeded) {
+        throw std::runtime_error(
+            "ScaledIpoptSolver. Ipopt could not be initialized.");
+    }
+
+    std::string jac_type;
+    m_ipopt_app->Options()->GetStringValue(
+        "jacobian_approximation", jac_type, "");
+    const bool finite_diff = jac_type == "finite-difference-values";
+
+    // the scaling ranges are part of the summary of the solve
+    int print_level{};
+    m_ipopt_app->Options()->GetIntegerValue("print_level", print_level, "");
+
+    m_scaling = computeNlpScaling(nlp, m_options);
+    if (print_level >= Ipopt::J_SUMMARY) {
+        printScaling();
+    }
+
+    Ipopt::SmartPtr<Ipopt::TNLP> nlp_ptr
+        = new ScaledIpoptAdapter(nlp, m_scaling, finite_diff);
+    m_status = m_ipopt_app->OptimizeTNLP(nlp_ptr);
+}
+
+void ScaledIpoptSolver::printScaling() const
+{
+    std::cout << "ScaledIpoptSolver. objective scaling = "
+              << m_scaling.obj_scaling << ", variable scaling in ["
+              << m_scaling.x_scaling.minCoeff() << ", "
+              << m_scaling.x_scaling.maxCoeff() << "]";
+    if (m_scaling.g_scaling.size() > 0) {
+        std::cout << ", constraint scaling in ["
+                  << m_scaling.g_scaling.minCoeff() << ", "
+                  << m_scaling.g_scaling.maxCoeff() << "]";
+    }
+    std::cout << std::endl;
+}
+
+void ScaledIpoptSolver::SetOption(const std::string &name,
+                                  const std::string &value)
+{
+    m_ipopt_app->Options()->SetStringValue(name, value);
+}
+
+void ScaledIpoptSolver::SetOption(const std::string &name, int value)
+{
+    m_ipopt_app->Options()->SetIntegerValue(name, value);
+}
+
+void ScaledIpoptSolver::SetOption(const std::string &name, double value)
+{
+    m_ipopt_app->Options()->SetNumericValue(name, value);
+}
+
+double ScaledIpoptSolver::GetTotalWallclockTime()
+{
+    return m_ipopt_app->Statistics()->TotalWallclockTime();
+}
+
+int ScaledIpoptSolver::GetReturnStatus()
+{
+    return m_status;
+}
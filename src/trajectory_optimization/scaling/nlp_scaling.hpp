@@ -0,0 +1,110 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <Eigen/Dense>
+#include <IpIpoptApplication.hpp>
+#include <ifopt/ipopt_adapter.h>
+#include <ifopt/problem.h>
+#include <ifopt/solver.h>
+
+struct NlpScalingOptions
+{
+    // limits of all scaling factors
+    double min_scale = 1e-4;
+    double max_scale = 1e4;
+    // The constraint rows are scaled such that the largest entry of each row
+    // of the scaled jacobian is about this value.
+    double target_row_norm = 1.0;
+    // The objective is scaled such that the largest entry of the scaled
+    // gradient is about this value.
+    double target_gradient = 1.0;
+};
+
+// Scaling factors of the optimization variables, the constraints and the
+// objective, in the form expected by IPOPT: the scaled quantities are
+// x_scaling.*x, g_scaling.*g(x) and obj_scaling*f(x).
+struct NlpScaling
+{
+    double obj_scaling{1.0};
+    Eigen::VectorXd x_scaling;
+    Eigen::VectorXd g_scaling;
+};
+
+/*
+ * Compute the scaling of a problem at its current variable values (the
+ * initial guess).
+ *
+ * A variable with finite and distinct bounds is scaled by the inverse of its
+ * largest absolute bound, so joint angles, velocities and torques all have a
+ * range of about [-1, 1]. Variables without such bounds (eg. fixed start and
+ * end states or unbounded velocities) are not scaled.
+ *
+ * Each constraint row is scaled by the inverse of the largest absolute entry
+ * of its row of the jacobian w.r.t the scaled variables, which balances the
+ * defects of the different joints. The objective is scaled by the inverse of
+ * the largest absolute entry of its gradient w.r.t the scaled variables.
+ */
+NlpScaling computeNlpScaling(ifopt::Problem &nlp,
+                             const NlpScalingOptions &options);
+
+/*
+ * Ipopt adapter that passes a precomputed scaling of the problem to IPOPT. It
+ * is only used by IPOPT when the option nlp_scaling_method is user-scaling.
+ */
+class ScaledIpoptAdapter : public ifopt::IpoptAdapter
+{
+public:
+    ScaledIpoptAdapter(ifopt::Problem &nlp,
+                       NlpScaling scaling,
+                       bool finite_diff = false);
+
+    bool get_scaling_parameters(Ipopt::Number &obj_scaling,
+                                bool &use_x_scaling,
+                                Ipopt::Index n,
+                                Ipopt::Number *x_scaling,
+                                bool &use_g_scaling,
+                                Ipopt::Index m,
+                                Ipopt::Number *g_scaling) override;
+
+private:
+    const NlpScaling m_scaling;
+};
+
+/*
+ * Drop in replacement of ifopt::IpoptSolver, which computes the scaling of the
+ * problem at the initial guess (see computeNlpScaling) and solves it with the
+ * user-scaling of IPOPT. The default options are the same as the ones of
+ * ifopt::IpoptSolver. Setting nlp_scaling_method to another value disables the
+ * automatic scaling. The ranges of the scaling factors are printed with the
+ * summary of IPOPT, ie. for a print_level of at least 3.
+ */
+class ScaledIpoptSolver : public ifopt::Solver
+{
+public:
+    ScaledIpoptSolver(const NlpScalingOptions &options = NlpScalingOptions{});
+
+    void Solve(ifopt::Problem &nlp) override;
+
+    void SetOption(const std::string &name, const std::string &value);
+    void SetOption(const std::string &name, int value);
+    void SetOption(const std::string &name, double value);
+
+    double GetTotalWallclockTime();
+    int GetReturnStatus();
+
+    // Scaling used in the last call to Solve.
+    const NlpScaling &getScaling() const
+    {
+        return m_scaling;
+    }
+
+private:
+    void printScaling() const;
+
+    const NlpScalingOptions m_options;
+    std::shared_ptr<Ipopt::IpoptApplication> m_ipopt_app;
+    int m_status;
+    NlpScaling m_scaling;
+};
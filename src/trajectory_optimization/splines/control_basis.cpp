@@ -0,0 +1,145 @@
+#include "control_basis.hpp"
+
+#include <Eigen/SparseCholesky>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+ControlBasis::ControlBasis(Matrix basis)
+    : m_basis{std::move(basis)}
+{
+    if ((m_basis.rows() == 0) || (m_basis.cols() == 0)) {
+        throw std::invalid_argument("ControlBasis. empty basis.");
+    }
+}
+
+int ControlBasis::getNumKnots() const
+{
+    return m_basis.rows();
+}
+
+int ControlBasis::getNumCoeffs() const
+{
+    return m_basis.cols();
+}
+
+const ControlBasis::Matrix &ControlBasis::getMatrix() const
+{
+    return m_basis;
+}
+
+void ControlBasis::evalControls(const Eigen::Ref<const Eigen::MatrixXd> &coeffs,
+                                Eigen::Ref<Eigen::MatrixXd> controls) const
+{
+    assert(coeffs.cols() == getNumCoeffs());
+    assert(controls.cols() == getNumKnots());
+    controls.noalias() = coeffs * m_basis.transpose();
+}
+
+Eigen::VectorXd ControlBasis::evalControls(const Eigen::VectorXd &coeffs,
+                                           const int ctrl_len) const
+{
+    Eigen::VectorXd controls(ctrl_len * getNumKnots());
+    evalControls(
+        Eigen::Map<const Eigen::MatrixXd>(
+            coeffs.data(), ctrl_len, getNumCoeffs()),
+        Eigen::Map<Eigen::MatrixXd>(controls.data(), ctrl_len, getNumKnots()));
+    return controls;
+}
+
+Eigen::VectorXd ControlBasis::fitCoefficients(const Eigen::VectorXd &controls,
+                                              const int ctrl_len) const
+{
+    // normal equations (B'B)*C' = B'*U'
+    const Eigen::SparseMatrix<double> basis = m_basis;
+    const Eigen::SparseMatrix<double> normal_mat = basis.transpose() * basis;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt(normal_mat);
+    if (ldlt.info() != Eigen::Success) {
+        throw std::runtime_error(
+            "ControlBasis. could not factorize the normal equations.");
+    }
+    const Eigen::MatrixXd rhs
+        = basis.transpose()
+          * controls.reshaped(ctrl_len, getNumKnots()).transpose();
+    const Eigen::MatrixXd coeffs = ldlt.solve(rhs).transpose();
+    return coeffs.reshaped();
+}
+
+int ControlBasis::getMaxCoeffsPerKnot() const
+{
+    int max_nonzeros{};
+    for (int k{}; k < m_basis.outerSize(); ++k) {
+        int nonzeros{};
+        for (Matrix::InnerIterator it(m_basis, k); it; ++it) {
+            ++nonzeros;
+        }
+        max_nonzeros = std::max(max_nonzeros, nonzeros);
+    }
+    return max_nonzeros;
+}
+
+ControlBasis bSplineControlBasis(const int num_knots,
+                                 const int num_coeffs,
+                                 const int degree)
+{
+    if ((degree < 1) || (num_coeffs < degree + 1) || (num_coeffs > num_knots)) {
+        throw std::invalid_argument(
+            "bSplineControlBasis. The number of coefficients must be in "
+            "[degree + 1, number of knots].");
+    }
+
+    // clamped knot vector on [0, 1], with degree+1 repeated knots at each end
+    const int p = degree;
+    const int num_spans = num_coeffs - p;
+    Eigen::VectorXd spline_knots(num_coeffs + p + 1);
+    for (int i{}; i < spline_knots.size(); ++i) {
+        spline_knots(i) = std::clamp(static_cast<double>(i - p) / num_spans,
+                                     0.0,
+                                     1.0);
+    }
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(num_knots * (p + 1));
+    Eigen::VectorXd vals(p + 1);
+    Eigen::VectorXd left(p + 1);
+    Eigen::VectorXd right(p + 1);
+    for (int k{}; k < num_knots; ++k) {
+        const double t = static_cast<double>(k) / (num_knots - 1);
+        // span s with knots s <= t < s+1, where the end point belongs to the
+        // last span
+        const int s
+            = std::min(static_cast<int>(t * num_spans), num_spans - 1) + p;
+
+        // Cox-de Boor recursion for the p+1 nonzero basis functions
+        vals(0) = 1.0;
+        for (int j = 1; j <= p; ++j) {
+            left(j) = t - spline_knots(s + 1 - j);
+            right(j) = spline_knots(s + j) - t;
+            double saved{};
+            for (int r{}; r < j; ++r) {
+                const double temp = vals(r) / (right(r + 1) + left(j - r));
+                vals(r) = saved + right(r + 1) * temp;
+                saved = left(j - r) * temp;
+            }
+            vals(j) = saved;
+        }
+        for (int r{}; r <= p; ++r) {
+            if (vals(r) != 0.0) {
+                triplets.push_back({k, s - p + r, vals(r)});
+            }
+        }
+    }
+
+    ControlBasis::Matrix basis(num_knots, num_coeffs);
+    basis.setFromTriplets(triplets.cbegin(), triplets.cend());
+    return ControlBasis(std::move(basis));
+}
+
+ControlBasis piecewiseLinearControlBasis(const int num_knots,
+                                         const int num_coeffs)
+{
+    return bSplineControlBasis(num_knots, num_coeffs, 1);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+/*
+ * Linear map from a few coefficient vectors to the control vectors at the knot
+ * points of a trajectory, u_k = sum_j B(k, j)*c_j. With the coefficients as
+ * the optimization variables instead of the knot controls, the controls are
+ * smooth by construction and the NLP is smaller for long horizons.
+ *
+ * Both vectors use the stacked layout of the trajectory variables, ie. the
+ * coefficients and the knot controls are matrices with one vector per column,
+ * U = C*B'.
+ */
+class ControlBasis
+{
+public:
+    // basis matrix, (number of knot points x number of coefficients)
+    using Matrix = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+
+    explicit ControlBasis(Matrix basis);
+
+    int getNumKnots() const;
+    int getNumCoeffs() const;
+    const Matrix &getMatrix() const;
+
+    // Knot controls U = C*B' from the coefficients C, one vector per column.
+    void evalControls(const Eigen::Ref<const Eigen::MatrixXd> &coeffs,
+                      Eigen::Ref<Eigen::MatrixXd> controls) const;
+
+    // Same as above for stacked vectors of length ctrl_len.
+    Eigen::VectorXd evalControls(const Eigen::VectorXd &coeffs,
+                                 const int ctrl_len) const;
+
+    // Least squares fit of the coefficients to stacked knot controls, eg. to
+    // create an initial guess from one for the knot controls.
+    Eigen::VectorXd fitCoefficients(const Eigen::VectorXd &controls,
+                                    const int ctrl_len) const;
+
+    // Largest number of coefficients that affect the control at one knot
+    // point.
+    int getMaxCoeffsPerKnot() const;
+
+private:
+    const Matrix m_basis;
+};
+
+/*
+ * Clamped B-spline basis of the given degree with uniformly spaced knots,
+ * sampled at num_knots equally spaced time points. The spline passes through
+ * the first and the last coefficients. The basis functions are nonnegative
+ * and sum to one, so bounds on the coefficients also bound the controls.
+ */
+ControlBasis bSplineControlBasis(const int num_knots,
+                                 const int num_coeffs,
+                                 const int degree);
+
+/*
+ * Piecewise linear basis (a B-spline of degree one), ie. the controls are
+ * linearly interpolated between num_coeffs equally spaced values.
+ */
+ControlBasis piecewiseLinearControlBasis(const int num_knots,
+                                         const int num_coeffs);
@@ -5,90 +5,139 @@
 #include <stdexcept>
 #include <utility>
 
-CubicSpline::CubicSpline(std::vector<Eigen::VectorXd> func_vals,
-                         std::vector<Eigen::VectorXd> grad_vals,
-                         const double start_time,
-                         const double duration)
-    : m_func_vals{std::move(func_vals)}
-    , m_grad_vals{std::move(grad_vals)}
-    , m_start_time{start_time}
-    , m_duration{duration}
+namespace
 {
-    if (m_func_vals.size() < 2) {
-        throw std::invalid_argument(
-            "CubicSpline. Need at least 2 knot values.");
-    }
-
-    if (m_func_vals.size() != m_grad_vals.size()) {
-        throw std::invalid_argument(
-            "CubicSpline. func_vals and grad_vals must have the same size.");
-    }
+    template <int Dim>
+    PolynomialSpline<Dim> createHermiteSpline(
+        const typename CubicSpline<Dim>::KnotsRef &func_vals,
+        const typename CubicSpline<Dim>::KnotsRef &grad_vals,
+        const Eigen::VectorXd &knot_times)
+    {
+        if (func_vals.cols() < 2) {
+            throw std::invalid_argument(
+                "CubicSpline. Need at least 2 knot values.");
+        }
 
-    if (m_duration <= 0.0) {
-        throw std::invalid_argument(
-            "CubicSpline. duration must be positive.");
-    }
+        if (func_vals.cols() != grad_vals.cols()) {
+            throw std::invalid_argument(
+                "CubicSpline. func_vals and grad_vals must have the same "
+                "size.");
+        }
 
-    const Eigen::Index dim = m_func_vals.front().size();
-    if (dim == 0) {
-        throw std::invalid_argument(
-            "CubicSpline. knot vectors must be non-empty.");
-    }
+        if (knot_times.size() != func_vals.cols()) {
+            throw std::invalid_argument(
+                "CubicSpline. There must be one knot time per knot value.");
+        }
+        if ((knot_times.tail(knot_times.size() - 1).array()
+             <= knot_times.head(knot_times.size() - 1).array())
+                .any()) {
+            throw std::invalid_argument(
+                "CubicSpline. knot times must be strictly increasing.");
+        }
 
-    for (size_t i = 0; i < m_func_vals.size(); ++i) {
-        if (m_func_vals[i].size() != dim) {
+        const Eigen::Index dim = func_vals.rows();
+        if (dim == 0) {
             throw std::invalid_argument(
-                "CubicSpline. all function vectors must have the same size.");
+                "CubicSpline. knot vectors must be non-empty.");
         }
-        if (m_grad_vals[i].size() != dim) {
+
+        if (grad_vals.rows() != dim) {
             throw std::invalid_argument(
-                "CubicSpline. all gradient vectors must have the same size as "
-                "the function vectors.");
+                "CubicSpline. all gradient vectors must have the same size "
+                "as the function vectors.");
+        }
+
+        /*
+         * Reference: Kelly, "An Introduction to Trajectory Optimization:
+         * How to Do Your Own Direct Collocation".
+         *
+         * With the Hermite basis functions on s = dt/h in [0, 1],
+         *   x = h00*x0 + h10*h*dx0 + h01*x1 + h11*h*dx1,
+         * and dx0, dx1 time-derivatives, the coefficients of the powers of dt
+         * are below.
+         */
+        const int num_segments = static_cast<int>(func_vals.cols()) - 1;
+        const int order = 4;
+        typename PolynomialSpline<Dim>::Matrix coeffs(dim,
+                                                      num_segments * order);
+        for (int k{}; k < num_segments; ++k) {
+            const double h = knot_times(k + 1) - knot_times(k);
+            const auto x0 = func_vals.col(k);
+            const auto dx0 = grad_vals.col(k);
+            const auto x1 = func_vals.col(k + 1);
+            const auto dx1 = grad_vals.col(k + 1);
+            coeffs.col(k * order) = x0;
+            coeffs.col(k * order + 1) = dx0;
+            coeffs.col(k * order + 2)
+                = 3.0 * (x1 - x0) / (h * h) - (2.0 * dx0 + dx1) / h;
+            coeffs.col(k * order + 3)
+                = 2.0 * (x0 - x1) / (h * h * h) + (dx0 + dx1) / (h * h);
         }
+        return PolynomialSpline<Dim>(std::move(coeffs),
+                                     order,
+                                     func_vals.col(num_segments),
+                                     knot_times);
     }
 }
 
-Eigen::VectorXd CubicSpline::getValue(const double time) const
-{    /*
-     * Reference: Kelly, "An Introduction to Trajectory Optimization:
-     * How to Do Your Own Direct Collocation".
-     */
-    const double end_time = m_start_time + m_duration;
-    if ((time < m_start_time) || (time > end_time)) {
-        std::ostringstream os;
-        os << "CubicSpline. time out of bounds. time: " << time
-           << ", start time: " << m_start_time
-           << ", end time: " << end_time;
-        throw std::invalid_argument(os.str());
-    }
-    // Get the index to the start time of the segment
-    const int num_segments = static_cast<int>(m_func_vals.size()) - 1;
-    const double alpha = (time - m_start_time) / m_duration;
-    const int i_start = static_cast<int>(alpha * num_segments);
+template <int Dim>
+CubicSpline<Dim>::CubicSpline(const KnotsRef &func_vals,
+                              const KnotsRef &grad_vals,
+                              const double start_time,
+                              const double duration)
+    : m_spline{createHermiteSpline<Dim>(
+          func_vals,
+          grad_vals,
+          uniformKnotTimes(func_vals.cols(), start_time, duration))}
+{}
 
-    if (i_start == num_segments) {
-        return m_func_vals[i_start];
-    }
+template <int Dim>
+CubicSpline<Dim>::CubicSpline(const KnotsRef &func_vals,
+                              const KnotsRef &grad_vals,
+                              Eigen::VectorXd knot_times)
+    : m_spline{createHermiteSpline<Dim>(func_vals, grad_vals, knot_times)}
+{}
 
-    const double dt_max = m_duration / static_cast<double>(num_segments);
-    const double ti = m_start_time + static_cast<double>(i_start) * dt_max;
-    const double dt = time - ti;
-    const double s = dt / dt_max;
+template <int Dim>
+typename CubicSpline<Dim>::Vector CubicSpline<Dim>::getValue(
+    const double time) const
+{
+    return m_spline.getValue(time);
+}
 
-    // Cubic Hermite basis functions on s in [0, 1]
-    const double h00 = 2.0 * s * s * s - 3.0 * s * s + 1.0;
-    const double h10 = s * s * s - 2.0 * s * s + s;
-    const double h01 = -2.0 * s * s * s + 3.0 * s * s;
-    const double h11 = s * s * s - s * s;
+template <int Dim>
+void CubicSpline<Dim>::getValue(const double time,
+                                Eigen::Ref<Vector> value) const
+{
+    m_spline.getValue(time, value);
+}
 
-    const Eigen::VectorXd& x0 = m_func_vals[i_start];
-    const Eigen::VectorXd& dx0 = m_grad_vals[i_start];
-    const Eigen::VectorXd& x1 = m_func_vals[i_start + 1];
-    const Eigen::VectorXd& dx1 = m_grad_vals[i_start + 1];
+template <int Dim>
+void CubicSpline<Dim>::getDerivative(const double time,
+                                     const int deriv_order,
+                                     Eigen::Ref<Vector> value) const
+{
+    m_spline.getDerivative(time, deriv_order, value);
+}
+
+template <int Dim>
+typename CubicSpline<Dim>::Knots CubicSpline<Dim>::sampleUniform(
+    const double t0,
+    const double dt,
+    const int n,
+    const int deriv_order) const
+{
+    return m_spline.sampleUniform(t0, dt, n, deriv_order);
+}
+
+template <int Dim>
+typename PolynomialSpline<Dim>::Cursor CubicSpline<Dim>::getCursor() const
+{
+    return m_spline.getCursor();
+}
 
-    // dx0 and dx1 are time-derivatives, so scale tangent terms by dt_max.
-    return h00 * x0
-         + (h10 * dt_max) * dx0
-         + h01 * x1
-         + (h11 * dt_max) * dx1;
-}
\ No newline at end of file
+template class CubicSpline<Eigen::Dynamic>;
+template class CubicSpline<2>;
+template class CubicSpline<4>;
+template class CubicSpline<6>;
+template class CubicSpline<12>;
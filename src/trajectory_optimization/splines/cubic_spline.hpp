@@ -1,11 +1,22 @@
 #pragma once
 
 #include <Eigen/Core>
-#include <vector>
 
+#include "polynomial_spline.hpp"
+
+// Dim is the size of the knot vectors, or Eigen::Dynamic. See
+// PolynomialSpline.
+template <int Dim = Eigen::Dynamic>
 class CubicSpline
 {
 public:
+    using Vector = typename PolynomialSpline<Dim>::Vector;
+    // knot vectors, one per column
+    using Knots = typename PolynomialSpline<Dim>::Matrix;
+    // view of stacked knot vectors, eg. the NLP variables, without a copy
+    using KnotsMap = Eigen::Map<const Knots>;
+    using KnotsRef = Eigen::Ref<const Knots>;
+
     /*
      * Piecewise cubic Hermite spline with uniformly spaced knot times.
      *
@@ -14,17 +25,50 @@ public:
      * @param start_time Start time of the full spline.
      * @param duration Total duration of the full spline.
      */
-    CubicSpline(std::vector<Eigen::VectorXd> func_vals,
-                std::vector<Eigen::VectorXd> grad_vals,
+    CubicSpline(const KnotsRef &func_vals,
+                const KnotsRef &grad_vals,
                 double start_time,
                 double duration);
 
+    /*
+     * Same as above with non-uniformly spaced knot times, eg. from an
+     * adaptive mesh.
+     *
+     * @param knot_times Strictly increasing times of the knot points.
+     */
+    CubicSpline(const KnotsRef &func_vals,
+                const KnotsRef &grad_vals,
+                Eigen::VectorXd knot_times);
+
     // Get the value of the spline at a particular time.
-    Eigen::VectorXd getValue(double time) const;
+    Vector getValue(double time) const;
+
+    // Same as above, but writes the value into a buffer of the knot size.
+    void getValue(double time, Eigen::Ref<Vector> value) const;
+
+    // Analytic time derivative of order deriv_order (eg. 1 for the velocity
+    // of a position spline). See PolynomialSpline::getDerivative().
+    void getDerivative(const double time,
+                       const int deriv_order,
+                       Eigen::Ref<Vector> value) const;
+
+    // Sample the spline, or one of its time derivatives, at n times
+    // t0 + i*dt, one sample per column. See PolynomialSpline::sampleUniform().
+    Knots sampleUniform(const double t0,
+                        const double dt,
+                        const int n,
+                        const int deriv_order = 0) const;
+
+    // Cursor for non-decreasing times, which must not outlive the spline.
+    typename PolynomialSpline<Dim>::Cursor getCursor() const;
 
 private:
-    std::vector<Eigen::VectorXd> m_func_vals;
-    std::vector<Eigen::VectorXd> m_grad_vals;
-    double m_start_time;
-    double m_duration;
-};
\ No newline at end of file
+    // polynomial coefficients of the segments
+    const PolynomialSpline<Dim> m_spline;
+};
+
+extern template class CubicSpline<Eigen::Dynamic>;
+extern template class CubicSpline<2>;
+extern template class CubicSpline<4>;
+extern template class CubicSpline<6>;
+extern template class CubicSpline<12>;
@@ -1,56 +1,109 @@
 #include "linear_spline.hpp"
 
+#include <algorithm>
 #include <exception>
-#include <polynomial_interpolation.hpp>
-
-LinearSpline::LinearSpline(std::vector<Eigen::VectorXd> func_vals,
-                           const double start_time,
-                           const double duration)
-    : m_func_vals{std::move(func_vals)}
-    , m_start_time{start_time}
-    , m_duration{duration}
+#include <stdexcept>
+#include <utility>
+
+namespace
 {
-    if (m_func_vals.empty()) {
-        throw std::invalid_argument("LinearSpline. empty values.");
+    template <int Dim>
+    PolynomialSpline<Dim> createLinearSpline(
+        const typename LinearSpline<Dim>::KnotsRef &func_vals,
+        const Eigen::VectorXd &knot_times)
+    {
+        if (func_vals.cols() == 0) {
+            throw std::invalid_argument("LinearSpline. empty values.");
+        }
+        const Eigen::Index dim = func_vals.rows();
+
+        // A single knot value is a constant between the two knot times.
+        const int num_segments
+            = std::max(static_cast<int>(func_vals.cols()) - 1, 1);
+        if (knot_times.size() != num_segments + 1) {
+            throw std::invalid_argument(
+                "LinearSpline. There must be one knot time per knot value, "
+                "or two for a single knot value.");
+        }
+        if ((knot_times.tail(num_segments).array()
+             <= knot_times.head(num_segments).array())
+                .any()) {
+            throw std::invalid_argument(
+                "LinearSpline. knot times must be strictly increasing.");
+        }
+        const int order = 2;
+        typename PolynomialSpline<Dim>::Matrix coeffs(dim,
+                                                      num_segments * order);
+        const int last = static_cast<int>(func_vals.cols()) - 1;
+        for (int k{}; k < num_segments; ++k) {
+            const double h = knot_times(k + 1) - knot_times(k);
+            const auto xi = func_vals.col(k);
+            const auto xf = func_vals.col(std::min(k + 1, last));
+            coeffs.col(k * order) = xi;
+            coeffs.col(k * order + 1) = (xf - xi) / h;
+        }
+        return PolynomialSpline<Dim>(
+            std::move(coeffs), order, func_vals.col(last), knot_times);
     }
 }
 
-Eigen::VectorXd LinearSpline::getValue(const double time) const
+template <int Dim>
+LinearSpline<Dim>::LinearSpline(const KnotsRef &func_vals,
+                                const double start_time,
+                                const double duration)
+    : m_spline{createLinearSpline<Dim>(
+          func_vals,
+          uniformKnotTimes(std::max<int>(func_vals.cols(), 2),
+                           start_time,
+                           duration))}
+{}
+
+template <int Dim>
+LinearSpline<Dim>::LinearSpline(const KnotsRef &func_vals,
+                                Eigen::VectorXd knot_times)
+    : m_spline{createLinearSpline<Dim>(func_vals, knot_times)}
+{}
+
+template <int Dim>
+typename LinearSpline<Dim>::Vector LinearSpline<Dim>::getValue(
+    const double time) const
+{
+    return m_spline.getValue(time);
+}
+
+template <int Dim>
+void LinearSpline<Dim>::getValue(const double time,
+                                 Eigen::Ref<Vector> value) const
 {
-    // check time bounds
-    const double end_time = m_start_time + m_duration;
-    if ((time < m_start_time) || (time > end_time)) {
-        std::ostringstream os;
-        os << "LinearSpline. time out of bounds. time: " << time
-           << ", start time: " << m_start_time << ", end time: " << end_time;
-        throw std::invalid_argument(os.str());
-    }
+    m_spline.getValue(time, value);
+}
 
-    // Get the index to the start time of the segment.
-    const int num_segments = m_func_vals.size() - 1;
-    const double alpha = (time - m_start_time) / m_duration;
-    const int i_start = static_cast<int>(alpha * num_segments);
+template <int Dim>
+void LinearSpline<Dim>::getDerivative(const double time,
+                                      const int deriv_order,
+                                      Eigen::Ref<Vector> value) const
+{
+    m_spline.getDerivative(time, deriv_order, value);
+}
 
-    // if at end, then return last value
-    if (i_start == num_segments) {
-        return m_func_vals[i_start];
-    }
+template <int Dim>
+typename LinearSpline<Dim>::Knots LinearSpline<Dim>::sampleUniform(
+    const double t0,
+    const double dt,
+    const int n,
+    const int deriv_order) const
+{
+    return m_spline.sampleUniform(t0, dt, n, deriv_order);
+}
 
-    // get start time
-    const double beta = static_cast<double>(i_start) / num_segments;
-    const double ti = beta * m_duration + m_start_time;
-    // duration of time segment
-    const double dt_max = m_duration / num_segments;
-    // time relative to start time of segment
-    const double dt = time - ti;
-    // std::cout << "LinearSpline(). time=" << time << ", alpha=" << alpha
-    //           << ", num_segments=" << num_segments << ", i_start=" << i_start
-    //           << ", ti=" << ti << ", beta=" << beta << ", dt=" << dt
-    //           << ", dt_max=" << dt_max << std::endl;
-
-    // linear polynomial interpolation
-    return interp_linear(m_func_vals[i_start],      // xi
-                         m_func_vals[i_start + 1],  // xf
-                         dt_max,
-                         dt);
+template <int Dim>
+typename PolynomialSpline<Dim>::Cursor LinearSpline<Dim>::getCursor() const
+{
+    return m_spline.getCursor();
 }
+
+template class LinearSpline<Eigen::Dynamic>;
+template class LinearSpline<2>;
+template class LinearSpline<4>;
+template class LinearSpline<6>;
+template class LinearSpline<12>;
@@ -1,27 +1,65 @@
 #pragma once
 
 #include <Eigen/Dense>
-#include <map>
-#include <vector>
+
+#include "polynomial_spline.hpp"
 
 // A linear spline is a piece-wise function with linear polynomials for each
-// time segment.
+// time segment. Dim is the size of the knot vectors, or Eigen::Dynamic.
+template <int Dim = Eigen::Dynamic>
 class LinearSpline
 {
 public:
+    using Vector = typename PolynomialSpline<Dim>::Vector;
+    // knot vectors, one per column
+    using Knots = typename PolynomialSpline<Dim>::Matrix;
+    // view of stacked knot vectors, eg. the NLP variables, without a copy
+    using KnotsMap = Eigen::Map<const Knots>;
+    using KnotsRef = Eigen::Ref<const Knots>;
+
     /*
      * @param func_vals Function values at knot points.
      */
-    LinearSpline(std::vector<Eigen::VectorXd> func_vals,
+    LinearSpline(const KnotsRef &func_vals,
                  const double start_time,
                  const double duration);
 
+    /*
+     * Same as above with non-uniformly spaced knot times.
+     *
+     * @param knot_times Strictly increasing times of the knot points.
+     */
+    LinearSpline(const KnotsRef &func_vals, Eigen::VectorXd knot_times);
+
     // Get the value of the spline at a particular time.
-    Eigen::VectorXd getValue(const double time) const;
+    Vector getValue(const double time) const;
 
-private:
-    const std::vector<Eigen::VectorXd> m_func_vals;
+    // Same as above, but writes the value into a buffer of the knot size.
+    void getValue(const double time, Eigen::Ref<Vector> value) const;
 
-    const double m_start_time;
-    const double m_duration;
+    // Analytic time derivative of order deriv_order (eg. 1 for the velocity
+    // of a position spline). See PolynomialSpline::getDerivative().
+    void getDerivative(const double time,
+                       const int deriv_order,
+                       Eigen::Ref<Vector> value) const;
+
+    // Sample the spline, or one of its time derivatives, at n times
+    // t0 + i*dt, one sample per column. See PolynomialSpline::sampleUniform().
+    Knots sampleUniform(const double t0,
+                        const double dt,
+                        const int n,
+                        const int deriv_order = 0) const;
+
+    // Cursor for non-decreasing times, which must not outlive the spline.
+    typename PolynomialSpline<Dim>::Cursor getCursor() const;
+
+private:
+    // polynomial coefficients of the segments
+    const PolynomialSpline<Dim> m_spline;
 };
+
+extern template class LinearSpline<Eigen::Dynamic>;
+extern template class LinearSpline<2>;
+extern template class LinearSpline<4>;
+extern template class LinearSpline<6>;
+extern template class LinearSpline<12>;
@@ -0,0 +1,284 @@
+#include "polynomial_spline.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // True if the knot times are uniformly spaced up to rounding errors.
+    bool isUniform(const Eigen::VectorXd &knot_times)
+    {
+        const int num_segments = knot_times.size() - 1;
+        const double duration = knot_times(num_segments) - knot_times(0);
+        const double dt_segment = duration / num_segments;
+        const double tol = 1e-10 * std::abs(duration);
+        for (int k{}; k <= num_segments; ++k) {
+            const double uniform_time = knot_times(0) + k * dt_segment;
+            if (std::abs(knot_times(k) - uniform_time) > tol) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+template <int Dim>
+PolynomialSpline<Dim>::PolynomialSpline(Matrix coeffs,
+                                        const int order,
+                                        Vector end_value,
+                                        Eigen::VectorXd knot_times)
+    : m_coeffs{std::move(coeffs)}
+    , m_order{order}
+    , m_end_value{std::move(end_value)}
+    , m_knot_times{std::move(knot_times)}
+    , m_start_time{(m_knot_times.size() > 0) ? m_knot_times(0) : 0.0}
+    , m_end_time{(m_knot_times.size() > 0) ? m_knot_times.tail<1>()(0) : 0.0}
+    , m_uniform{(m_knot_times.size() > 1) && isUniform(m_knot_times)}
+    , m_dt_segment{(m_end_time - m_start_time)
+                   / std::max<int>(m_knot_times.size() - 1, 1)}
+{
+    if ((m_order < 1) || (m_coeffs.cols() == 0)
+        || (m_coeffs.cols() % m_order != 0)) {
+        throw std::invalid_argument(
+            "PolynomialSpline. The number of coefficient columns must be a "
+            "nonzero multiple of the order.");
+    }
+    if (m_end_value.size() != m_coeffs.rows()) {
+        throw std::invalid_argument(
+            "PolynomialSpline. end_value must have the size of the "
+            "coefficients.");
+    }
+    if (m_knot_times.size() != getNumSegments() + 1) {
+        throw std::invalid_argument(
+            "PolynomialSpline. There must be one more knot time than "
+            "segments.");
+    }
+    for (int k{}; k < getNumSegments(); ++k) {
+        if (m_knot_times(k + 1) <= m_knot_times(k)) {
+            throw std::invalid_argument(
+                "PolynomialSpline. knot times must be strictly increasing.");
+        }
+    }
+}
+
+template <int Dim>
+int PolynomialSpline<Dim>::getDim() const
+{
+    return m_coeffs.rows();
+}
+
+template <int Dim>
+int PolynomialSpline<Dim>::getNumSegments() const
+{
+    return m_coeffs.cols() / m_order;
+}
+
+template <int Dim>
+int PolynomialSpline<Dim>::getOrder() const
+{
+    return m_order;
+}
+
+template <int Dim>
+const Eigen::VectorXd &PolynomialSpline<Dim>::getKnotTimes() const
+{
+    return m_knot_times;
+}
+
+template <int Dim>
+void PolynomialSpline<Dim>::getValue(const double time,
+                                     Eigen::Ref<Vector> value) const
+{
+    getDerivative(time, 0, value);
+}
+
+template <int Dim>
+typename PolynomialSpline<Dim>::Vector PolynomialSpline<Dim>::getValue(
+    const double time) const
+{
+    Vector value(getDim());
+    getValue(time, value);
+    return value;
+}
+
+template <int Dim>
+void PolynomialSpline<Dim>::getDerivative(const double time,
+                                          const int deriv_order,
+                                          Eigen::Ref<Vector> value) const
+{
+    assert(value.size() == getDim());
+    if ((time < m_start_time) || (time > m_end_time)) {
+        std::ostringstream os;
+        os << "PolynomialSpline. time out of bounds. time: " << time
+           << ", start time: " << m_start_time << ", end time: " << m_end_time;
+        throw std::invalid_argument(os.str());
+    }
+
+    const int segment = findSegment(time);
+    // time relative to start time of segment
+    const double dt = time - m_knot_times(segment);
+    evalSegment(segment, dt, deriv_order, value);
+}
+
+template <int Dim>
+typename PolynomialSpline<Dim>::Matrix PolynomialSpline<Dim>::sampleUniform(
+    const double t0,
+    const double dt,
+    const int n,
+    const int deriv_order) const
+{
+    const double last_time = t0 + (n - 1) * dt;
+    if ((n < 0) || (dt < 0.0)
+        || ((n > 0) && ((t0 < m_start_time) || (last_time > m_end_time)))) {
+        std::ostringstream os;
+        os << "PolynomialSpline. sample times out of bounds. first time: "
+           << t0 << ", last time: " << last_time
+           << ", start time: " << m_start_time << ", end time: " << m_end_time;
+        throw std::invalid_argument(os.str());
+    }
+
+    Matrix samples(getDim(), n);
+    Cursor cursor(*this);
+    for (int i{}; i < n; ++i) {
+        cursor.getDerivative(t0 + i * dt, deriv_order, samples.col(i));
+    }
+    return samples;
+}
+
+template <int Dim>
+typename PolynomialSpline<Dim>::Cursor PolynomialSpline<Dim>::getCursor() const
+{
+    return Cursor(*this);
+}
+
+template <int Dim>
+int PolynomialSpline<Dim>::findSegment(const double time) const
+{
+    const int num_segments = getNumSegments();
+    if (time >= m_end_time) {
+        return num_segments;
+    }
+    if (m_uniform) {
+        const int segment
+            = static_cast<int>((time - m_start_time) / m_dt_segment);
+        return std::min(segment, num_segments - 1);
+    }
+    // Branch-free binary search for the last knot before the time. The
+    // conditional add compiles to a conditional move.
+    const double *first = m_knot_times.data();
+    int len = num_segments;
+    while (len > 1) {
+        const int half = len / 2;
+        first += (first[half] <= time) ? half : 0;
+        len -= half;
+    }
+    return static_cast<int>(first - m_knot_times.data());
+}
+
+template <int Dim>
+double PolynomialSpline<Dim>::getSegmentDuration(const int segment) const
+{
+    return m_knot_times(segment + 1) - m_knot_times(segment);
+}
+
+template <int Dim>
+void PolynomialSpline<Dim>::evalSegment(const int segment,
+                                        const double dt,
+                                        const int deriv_order,
+                                        Eigen::Ref<Vector> value) const
+{
+    const int num_segments = getNumSegments();
+    if (segment == num_segments) {
+        if (deriv_order == 0) {
+            value = m_end_value;
+        } else {
+            evalSegment(num_segments - 1,
+                        getSegmentDuration(num_segments - 1),
+                        deriv_order,
+                        value);
+        }
+        return;
+    }
+    if (deriv_order >= m_order) {
+        value.setZero();
+        return;
+    }
+
+    // Horner's scheme from the highest power down. The derivative of order r
+    // of c_p*dt^p is p!/(p-r)! * c_p * dt^(p-r).
+    const auto factor = [deriv_order](const int p) {
+        double f = 1.0;
+        for (int i = p - deriv_order + 1; i <= p; ++i) {
+            f *= i;
+        }
+        return f;
+    };
+    const int first_col = segment * m_order;
+    value = factor(m_order - 1) * m_coeffs.col(first_col + m_order - 1);
+    for (int p = m_order - 2; p >= deriv_order; --p) {
+        value = dt * value + factor(p) * m_coeffs.col(first_col + p);
+    }
+}
+
+template <int Dim>
+PolynomialSpline<Dim>::Cursor::Cursor(const PolynomialSpline &spline)
+    : m_spline{&spline}
+    , m_prev_time{spline.m_start_time}
+{}
+
+template <int Dim>
+void PolynomialSpline<Dim>::Cursor::getValue(const double time,
+                                             Eigen::Ref<Vector> value)
+{
+    getDerivative(time, 0, value);
+}
+
+template <int Dim>
+void PolynomialSpline<Dim>::Cursor::getDerivative(const double time,
+                                                  const int deriv_order,
+                                                  Eigen::Ref<Vector> value)
+{
+    assert(time >= m_prev_time);
+    assert(value.size() == m_spline->getDim());
+    m_prev_time = time;
+    const PolynomialSpline &s = *m_spline;
+    const int num_segments = s.getNumSegments();
+    if (time >= s.m_end_time) {
+        s.evalSegment(num_segments, 0.0, deriv_order, value);
+        return;
+    }
+    // Move to the segment that contains the time. For a sampling period
+    // shorter than the segments, this is at most one step per sample.
+    while ((m_segment < num_segments - 1)
+           && (time >= s.m_knot_times(m_segment + 1))) {
+        ++m_segment;
+    }
+    s.evalSegment(
+        m_segment, time - s.m_knot_times(m_segment), deriv_order, value);
+}
+
+Eigen::VectorXd uniformKnotTimes(const int num_knots,
+                                 const double start_time,
+                                 const double duration)
+{
+    Eigen::VectorXd knot_times(num_knots);
+    const double dt_segment = duration / std::max(num_knots - 1, 1);
+    for (int k{}; k < num_knots; ++k) {
+        knot_times(k) = start_time + k * dt_segment;
+    }
+    // the end time is exact
+    if (num_knots > 1) {
+        knot_times(num_knots - 1) = start_time + duration;
+    }
+    return knot_times;
+}
+
+template class PolynomialSpline<Eigen::Dynamic>;
+template class PolynomialSpline<2>;
+template class PolynomialSpline<4>;
+template class PolynomialSpline<6>;
+template class PolynomialSpline<12>;
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <type_traits>
+
+/*
+ * Piecewise polynomial, stored as the coefficients of each segment in powers
+ * of the time since the start of the segment. The coefficients are computed
+ * once from the knot values (see CubicSpline, QuadraticSpline and
+ * LinearSpline), so an evaluation is a Horner loop over the powers, vectorized
+ * over the elements of the value.
+ *
+ * The knot times are a sorted array of breakpoints, eg. from an adaptive mesh.
+ * A random time query finds its segment by a branch-free binary search, or
+ * directly from the time if the knots are uniformly spaced.
+ *
+ * The time derivatives are the analytic derivatives of the polynomials. The
+ * derivatives at a knot time are the ones of the segment that starts there,
+ * and the ones at the end time are the ones of the last segment.
+ *
+ * Dim is the size of the values, or Eigen::Dynamic. With a fixed size, the
+ * values are returned without heap allocations. The spline is instantiated
+ * for the sizes of dispatchSplineDim().
+ */
+template <int Dim = Eigen::Dynamic>
+class PolynomialSpline
+{
+public:
+    using Vector = Eigen::Matrix<double, Dim, 1>;
+    // one vector per column
+    using Matrix = Eigen::Matrix<double, Dim, Eigen::Dynamic>;
+
+    /*
+     * Evaluates the spline at non-decreasing times, eg. for an executor that
+     * consumes samples in real time. It moves forward segment by segment
+     * instead of searching for the segment and checking the time bounds at
+     * every sample. The spline must outlive the cursor.
+     */
+    class Cursor
+    {
+    public:
+        explicit Cursor(const PolynomialSpline &spline);
+
+        /*
+         * Get the value of the spline at a time that is not before the start
+         * time or the time of the previous call. Times after the end time
+         * give the value at the end time.
+         *
+         * @param value Output, of size getDim() of the spline.
+         */
+        void getValue(const double time, Eigen::Ref<Vector> value);
+
+        // Same as above for the time derivative of order deriv_order.
+        void getDerivative(const double time,
+                           const int deriv_order,
+                           Eigen::Ref<Vector> value);
+
+    private:
+        const PolynomialSpline *m_spline;
+        int m_segment{};
+        double m_prev_time;
+    };
+
+    /*
+     * @param coeffs Coefficients, (dim x (num_segments * order)). Column
+     *   k * order + p holds the coefficients of power p of segment k, so the
+     *   coefficients of a segment are contiguous.
+     * @param order Number of coefficients per segment, ie. degree + 1.
+     * @param end_value Value at the end time.
+     * @param knot_times Strictly increasing times of the num_segments + 1
+     *   knot points.
+     */
+    PolynomialSpline(Matrix coeffs,
+                     const int order,
+                     Vector end_value,
+                     Eigen::VectorXd knot_times);
+
+    int getDim() const;
+    int getNumSegments() const;
+    int getOrder() const;
+    const Eigen::VectorXd &getKnotTimes() const;
+
+    /*
+     * Get the value of the spline at a particular time, without allocating.
+     *
+     * @param value Output, of size getDim().
+     */
+    void getValue(const double time, Eigen::Ref<Vector> value) const;
+
+    // Get the value of the spline at a particular time.
+    Vector getValue(const double time) const;
+
+    /*
+     * Get the time derivative of order deriv_order (eg. 1 for the velocity of
+     * a position spline) at a particular time. Order 0 is the value.
+     *
+     * @param value Output, of size getDim().
+     */
+    void getDerivative(const double time,
+                       const int deriv_order,
+                       Eigen::Ref<Vector> value) const;
+
+    /*
+     * Sample the spline, or its time derivative of order deriv_order, at n
+     * times t0 + i*dt in one pass. The time bounds are checked once, for the
+     * first and the last time.
+     *
+     * @return Values, one sample per column, (getDim() x n).
+     */
+    Matrix sampleUniform(const double t0,
+                         const double dt,
+                         const int n,
+                         const int deriv_order = 0) const;
+
+    Cursor getCursor() const;
+
+private:
+    // Index of the segment that contains a time within the time bounds, or
+    // getNumSegments() at the end time.
+    int findSegment(const double time) const;
+
+    // Duration of a segment.
+    double getSegmentDuration(const int segment) const;
+
+    /*
+     * Time derivative of a segment at time dt from its start. At the end
+     * time, segment getNumSegments() gives the end value (order 0) or the
+     * derivatives of the last segment.
+     */
+    void evalSegment(const int segment,
+                     const double dt,
+                     const int deriv_order,
+                     Eigen::Ref<Vector> value) const;
+
+    const Matrix m_coeffs;
+    const int m_order;
+    const Vector m_end_value;
+    // breakpoints, (num_segments + 1)
+    const Eigen::VectorXd m_knot_times;
+    const double m_start_time;
+    const double m_end_time;
+    // Uniformly spaced knots, whose segment is found from the time without a
+    // search.
+    const bool m_uniform;
+    const double m_dt_segment;
+};
+
+extern template class PolynomialSpline<Eigen::Dynamic>;
+extern template class PolynomialSpline<2>;
+extern template class PolynomialSpline<4>;
+extern template class PolynomialSpline<6>;
+extern template class PolynomialSpline<12>;
+
+/*
+ * Calls fn(std::integral_constant<int, Dim>{}) with the instantiated fixed
+ * size Dim equal to dim, eg. the state size of the cartpole (4) or the SO101
+ * arm (12), or with Eigen::Dynamic for other sizes.
+ */
+template <typename Fn>
+auto dispatchSplineDim(const int dim, Fn &&fn)
+{
+    switch (dim) {
+        case 2:
+            return fn(std::integral_constant<int, 2>{});
+        case 4:
+            return fn(std::integral_constant<int, 4>{});
+        case 6:
+            return fn(std::integral_constant<int, 6>{});
+        case 12:
+            return fn(std::integral_constant<int, 12>{});
+        default:
+            return fn(std::integral_constant<int, Eigen::Dynamic>{});
+    }
+}
+
+// Times of num_knots uniformly spaced knots over the duration.
+Eigen::VectorXd uniformKnotTimes(const int num_knots,
+                                 const double start_time,
+                                 const double duration);
@@ -1,129 +1,166 @@
 #include "quadratic_spline.hpp"
 
 #include <exception>
-#include <iostream>
-#include <polynomial_interpolation.hpp>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
-QuadraticSpline::QuadraticSpline(std::vector<Eigen::VectorXd> func_vals,
-                                 std::vector<Eigen::VectorXd> constraint_vals,
-                                 const ConstraintType constraint_type,
-                                 const double start_time,
-                                 const double duration)
-    : m_func_vals{std::move(func_vals)}
-    , m_constraint_vals{std::move(constraint_vals)}
-    , m_constraint_type{constraint_type}
-    , m_start_time{start_time}
-    , m_duration{duration}
+namespace
 {
-    if (m_func_vals.empty()) {
-        throw std::invalid_argument("QuadraticSpline. empty values.");
-    }
-
-    if (m_duration <= 0.0) {
-        throw std::invalid_argument(
-            "QuadraticSpline. duration must be positive.");
-    }
-    // size consistency is checked below based on m_constraint_type
-    if (m_func_vals.size() < 2) {
-        throw std::invalid_argument(
-            "QuadraticSpline. Need at least 2 knot values.");
-    }
-
-    switch (m_constraint_type) {
-        case ConstraintType::Gradient:
-            if (m_constraint_vals.size() != m_func_vals.size()) {
-                throw std::invalid_argument(
-                    "QuadraticSpline. gradient count must equal knot count.");
-            }
-            break;
-
-        case ConstraintType::Midpoint:
-            if (m_constraint_vals.size() != m_func_vals.size() - 1) {
-                throw std::invalid_argument(
-                    "QuadraticSpline. midpoint/value count must be exactly one "
-                    "less than knot count.");
-            }
-            break;
+    template <int Dim>
+    PolynomialSpline<Dim> createQuadraticSpline(
+        const typename QuadraticSpline<Dim>::KnotsRef &func_vals,
+        const typename QuadraticSpline<Dim>::KnotsRef &constraint_vals,
+        const QuadraticConstraintType constraint_type,
+        const Eigen::VectorXd &knot_times)
+    {
+        using ConstraintType = QuadraticConstraintType;
+        if (func_vals.cols() == 0) {
+            throw std::invalid_argument("QuadraticSpline. empty values.");
+        }
 
-        default:
+        // size consistency is checked below based on constraint_type
+        if (func_vals.cols() < 2) {
             throw std::invalid_argument(
-                "QuadraticSpline. invalid constraint type.");
-    }
+                "QuadraticSpline. Need at least 2 knot values.");
+        }
+        if (knot_times.size() != func_vals.cols()) {
+            throw std::invalid_argument(
+                "QuadraticSpline. There must be one knot time per knot value.");
+        }
+        if ((knot_times.tail(knot_times.size() - 1).array()
+             <= knot_times.head(knot_times.size() - 1).array())
+                .any()) {
+            throw std::invalid_argument(
+                "QuadraticSpline. knot times must be strictly increasing.");
+        }
 
-    const Eigen::Index dim = m_func_vals.front().size();
-    if (dim == 0) {
-        throw std::invalid_argument(
-            "QuadraticSpline. knot vectors must be non-empty.");
-    }
+        switch (constraint_type) {
+            case ConstraintType::Gradient:
+                if (constraint_vals.cols() != func_vals.cols()) {
+                    throw std::invalid_argument(
+                        "QuadraticSpline. gradient count must equal knot "
+                        "count.");
+                }
+                break;
+
+            case ConstraintType::Midpoint:
+                if (constraint_vals.cols() != func_vals.cols() - 1) {
+                    throw std::invalid_argument(
+                        "QuadraticSpline. midpoint/value count must be "
+                        "exactly one less than knot count.");
+                }
+                break;
+
+            default:
+                throw std::invalid_argument(
+                    "QuadraticSpline. invalid constraint type.");
+        }
 
-    for (size_t i = 0; i < m_func_vals.size(); ++i) {
-        if (m_func_vals[i].size() != dim) {
+        const Eigen::Index dim = func_vals.rows();
+        if (dim == 0) {
             throw std::invalid_argument(
-                "QuadraticSpline. all knot vectors must have the same size.");
+                "QuadraticSpline. knot vectors must be non-empty.");
         }
-    }
 
-    for (size_t i = 0; i < m_constraint_vals.size(); ++i) {
-        if (m_constraint_vals[i].size() != dim) {
+        if (constraint_vals.rows() != dim) {
             throw std::invalid_argument(
                 "QuadraticSpline. all constraint vectors must have the same "
                 "size as the knot vectors.");
         }
+
+        // coefficients of the powers of the time since the segment start, see
+        // interp_quad() and interp_quad_midpoint()
+        const int num_segments = static_cast<int>(func_vals.cols()) - 1;
+        const int order = 3;
+        typename PolynomialSpline<Dim>::Matrix coeffs(dim,
+                                                      num_segments * order);
+        for (int k{}; k < num_segments; ++k) {
+            const double h = knot_times(k + 1) - knot_times(k);
+            const auto xi = func_vals.col(k);
+            coeffs.col(k * order) = xi;
+            if (constraint_type == ConstraintType::Gradient) {
+                const auto dxi = constraint_vals.col(k);
+                const auto dxf = constraint_vals.col(k + 1);
+                coeffs.col(k * order + 1) = dxi;
+                coeffs.col(k * order + 2) = (dxf - dxi) / (2.0 * h);
+            } else {
+                const auto xc = constraint_vals.col(k);
+                const auto xf = func_vals.col(k + 1);
+                coeffs.col(k * order + 1) = (4.0 * xc - 3.0 * xi - xf) / h;
+                coeffs.col(k * order + 2)
+                    = 2.0 * (xi - 2.0 * xc + xf) / (h * h);
+            }
+        }
+        return PolynomialSpline<Dim>(std::move(coeffs),
+                                     order,
+                                     func_vals.col(num_segments),
+                                     knot_times);
     }
 }
 
-Eigen::VectorXd QuadraticSpline::getValue(const double time) const
+template <int Dim>
+QuadraticSpline<Dim>::QuadraticSpline(const KnotsRef &func_vals,
+                                      const KnotsRef &constraint_vals,
+                                      const ConstraintType constraint_type,
+                                      const double start_time,
+                                      const double duration)
+    : m_spline{createQuadraticSpline<Dim>(
+          func_vals,
+          constraint_vals,
+          constraint_type,
+          uniformKnotTimes(func_vals.cols(), start_time, duration))}
+{}
+
+template <int Dim>
+QuadraticSpline<Dim>::QuadraticSpline(const KnotsRef &func_vals,
+                                      const KnotsRef &constraint_vals,
+                                      const ConstraintType constraint_type,
+                                      Eigen::VectorXd knot_times)
+    : m_spline{createQuadraticSpline<Dim>(
+          func_vals, constraint_vals, constraint_type, knot_times)}
+{}
+
+template <int Dim>
+typename QuadraticSpline<Dim>::Vector QuadraticSpline<Dim>::getValue(
+    const double time) const
 {
-    // check time bounds
-    const double end_time = m_start_time + m_duration;
-    if ((time < m_start_time) || (time > end_time)) {
-        std::ostringstream os;
-        os << "QuadraticSpline. time out of bounds. time: " << time
-           << ", start time: " << m_start_time << ", end time: " << end_time;
-        throw std::invalid_argument(os.str());
-    }
+    return m_spline.getValue(time);
+}
 
-    // Get the index to the start time of the segment.
-    const int num_segments = m_func_vals.size() - 1;
-    const double alpha = (time - m_start_time) / m_duration;
-    const int i_start = static_cast<int>(alpha * num_segments);
+template <int Dim>
+void QuadraticSpline<Dim>::getValue(const double time,
+                                    Eigen::Ref<Vector> value) const
+{
+    m_spline.getValue(time, value);
+}
 
-    // if at end, then return last value
-    if (i_start == num_segments) {
-        return m_func_vals[i_start];
-    }
+template <int Dim>
+void QuadraticSpline<Dim>::getDerivative(const double time,
+                                         const int deriv_order,
+                                         Eigen::Ref<Vector> value) const
+{
+    m_spline.getDerivative(time, deriv_order, value);
+}
 
-    // get start time
-    const double beta = static_cast<double>(i_start) / num_segments;
-    const double ti = beta * m_duration + m_start_time;
-    // duration of time segment
-    const double dt_max = m_duration / num_segments;
-    // time relative to start time of segment
-    const double dt = time - ti;
-    // std::cout << "QuadraticSpline(). time=" << time << ", alpha=" << alpha
-    //           << ", num_segments=" << num_segments << ", i_start=" << i_start
-    //           << ", ti=" << ti << ", beta=" << beta << ", dt=" << dt
-    //           << ", dt_max=" << dt_max << std::endl;
-
-    switch (m_constraint_type) {
-        case ConstraintType::Gradient:
-            return interp_quad(m_func_vals[i_start],            // x_i
-                               m_constraint_vals[i_start],      // dx_i
-                               m_constraint_vals[i_start + 1],  // dx_{i+1}
-                               dt_max,
-                               dt);
-
-        case ConstraintType::Midpoint:
-            return interp_quad_midpoint(m_func_vals[i_start],        // x_i
-                                        m_constraint_vals[i_start],  // x_c
-                                        m_func_vals[i_start + 1],    // x_{i+1}
-                                        dt_max,
-                                        dt);
-
-        default:
-            throw std::invalid_argument(
-                "QuadraticSpline. invalid constraint type.");
-    }
+template <int Dim>
+typename QuadraticSpline<Dim>::Knots QuadraticSpline<Dim>::sampleUniform(
+    const double t0,
+    const double dt,
+    const int n,
+    const int deriv_order) const
+{
+    return m_spline.sampleUniform(t0, dt, n, deriv_order);
 }
+
+template <int Dim>
+typename PolynomialSpline<Dim>::Cursor QuadraticSpline<Dim>::getCursor() const
+{
+    return m_spline.getCursor();
+}
+
+template class QuadraticSpline<Eigen::Dynamic>;
+template class QuadraticSpline<2>;
+template class QuadraticSpline<4>;
+template class QuadraticSpline<6>;
+template class QuadraticSpline<12>;
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 
 #include <ifopt/variable_set.h>
 
+#include "evaluation_arena.hpp"
+
 // Representation for the discrete variables (eg. states or controls) over the
 // trajectory.
 class TrajectoryVariables final : public ifopt::VariableSet
@@ -13,19 +16,29 @@ public:
      * @param x_init Initial solution values (guessed solution).
      * @param bounds Bounds of the discrete state variables.
      */
-    TrajectoryVariables(const std::string& name,
+    TrajectoryVariables(const std::string &name,
                         Eigen::VectorXd x_init,
                         ifopt::Component::VecBound bounds)
         : VariableSet(x_init.size(), name)
         , m_x{std::move(x_init)}
         , m_bounds{std::move(bounds)}
     {
-        assert(m_bounds.size() == m_x.size());
+        assert(m_bounds.size() == static_cast<std::size_t>(m_x.size()));
     }
 
+    /*
+     * The temporaries of the previous iterate are released when the values
+     * change, see getArena(). ifopt sets the variables for every callback of
+     * the solver (it ignores IPOPT's new_x flag), so the callbacks at the same
+     * iterate keep the arena.
+     */
     void SetVariables(const Eigen::VectorXd &x) override
     {
+        if (x == m_x) {
+            return;
+        }
         m_x = x;
+        m_arena.reset();
     }
 
     Eigen::VectorXd GetValues() const override
@@ -33,11 +46,48 @@ public:
         return m_x;
     }
 
+    // Same as GetValues() but without copying the values. The reference is
+    // valid as long as this object exists and the values change in place when
+    // the solver sets new variables.
+    const Eigen::VectorXd &getValuesRef() const
+    {
+        return m_x;
+    }
+
+    /*
+     * View of the values as a matrix with one column per vector, eg. a
+     * (state_len x num_knots) matrix for states at the knot points. The view
+     * does not copy the values.
+     *
+     * @param vec_len Number of elements of each vector.
+     */
+    Eigen::Map<const Eigen::MatrixXd> getValuesMatrix(const int vec_len) const
+    {
+        assert((vec_len > 0) && (m_x.size() % vec_len == 0));
+        return Eigen::Map<const Eigen::MatrixXd>(
+            m_x.data(), vec_len, m_x.size() / vec_len);
+    }
+
     ifopt::Component::VecBound GetBounds() const override
     {
         return m_bounds;
     }
 
+    /*
+     * Memory for the temporaries of the constraints and costs that depend on
+     * these variables. It is reset once per iterate, ie. when the solver sets
+     * new values, so the evaluations at an iterate share it and stop
+     * allocating after the first iterates.
+     *
+     * This covers the evaluations of the components only. The evaluation
+     * functions of ifopt::Problem, which IPOPT calls, still allocate the
+     * vectors and jacobians they return at every iteration.
+     */
+    EvaluationArena &getArena() const
+    {
+        return m_arena;
+    }
+
 private:
     // This holds the discrete state or control values in a single vector. For n
     // state vectors each with k elements gives a single combined vector of n*k
@@ -48,4 +98,5 @@ private:
     // x_1(k-1), ..., x_(n-1)0, x_(n-1)1, ..., x_(n-1)(k-1)].
     Eigen::VectorXd m_x;
     ifopt::Component::VecBound m_bounds;
+    mutable EvaluationArena m_arena;
 };
@@ -0,0 +1,666 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ifopt/constraint_set.h>
+
+#include "control_basis.hpp"
+#include "duration_variable.hpp"
+#include "evaluation_arena.hpp"
+#include "jacobian_filler.hpp"
+#include "trajectory_variables.hpp"
+
+/*
+ * Requirements of the dynamics used by CollocationConstraints. The members
+ * are called directly, so an implementation defined inline in a header can be
+ * inlined into the evaluation of the constraints.
+ *
+ * eval(state, control, time, dx) writes the output of the dynamics function
+ * into dx.
+ *
+ * jacobians(state, control, time, jac_wrt_state, jac_wrt_control) writes the
+ * jacobians of the dynamics function w.r.t the state and w.r.t the control.
+ * The jacobians are the ones of the previous call at the same time point, so
+ * their values can be updated in place when their sparsity pattern does not
+ * change.
+ */
+template <typename T>
+concept CollocationDynamics
+    = requires(T dyn,
+               const Eigen::VectorXd &state,
+               const Eigen::VectorXd &control,
+               const double time,
+               Eigen::Ref<Eigen::VectorXd> dx,
+               ifopt::Component::Jacobian &jac) {
+          dyn.eval(state, control, time, dx);
+          dyn.jacobians(state, control, time, jac, jac);
+      };
+
+/*
+ * Dynamics that can also evaluate the jacobians at all knot points at once
+ * (eg. FiniteDifferenceDynamics), with one state and control vector per
+ * column. CollocationConstraints uses it instead of jacobians() per time
+ * point.
+ */
+template <typename T>
+concept KnotJacobiansDynamics
+    = CollocationDynamics<T>
+      && requires(T dyn,
+                  const Eigen::Ref<const Eigen::MatrixXd> &states,
+                  const Eigen::Ref<const Eigen::MatrixXd> &controls,
+                  const Eigen::VectorXd &times,
+                  std::vector<ifopt::Component::Jacobian> &jacs) {
+             dyn.jacobiansAtKnots(states, controls, times, jacs, jacs);
+         };
+
+// Type erased dynamics, which wraps callbacks that evaluate the dynamics and
+// its jacobians. It is convenient for prototyping, at the cost of an indirect
+// call per time point.
+struct FunctionDynamics
+{
+    // callback signature for evaluating the dynamics into the output vector
+    // dx
+    using DynIntoFn = std::function<void(const Eigen::VectorXd &state,
+                                         const Eigen::VectorXd &control,
+                                         const double time,
+                                         Eigen::Ref<Eigen::VectorXd> dx)>;
+    // callback signature for evaluating the jacobians of the dynamics w.r.t
+    // the state and w.r.t the control
+    using JacobiansDynIntoFn
+        = std::function<void(const Eigen::VectorXd &state,
+                             const Eigen::VectorXd &control,
+                             const double time,
+                             ifopt::Component::Jacobian &jac_wrt_state,
+                             ifopt::Component::Jacobian &jac_wrt_control)>;
+
+    void eval(const Eigen::VectorXd &state,
+              const Eigen::VectorXd &control,
+              const double time,
+              Eigen::Ref<Eigen::VectorXd> dx) const
+    {
+        dyn_fn(state, control, time, dx);
+    }
+
+    void jacobians(const Eigen::VectorXd &state,
+                   const Eigen::VectorXd &control,
+                   const double time,
+                   ifopt::Component::Jacobian &jac_wrt_state,
+                   ifopt::Component::Jacobian &jac_wrt_control) const
+    {
+        jac_dyn_fn(state, control, time, jac_wrt_state, jac_wrt_control);
+    }
+
+    DynIntoFn dyn_fn;
+    JacobiansDynIntoFn jac_dyn_fn;
+};
+
+/*
+ * Type erased dynamics that share one implementation of the dynamics, eg. a
+ * RobotDynamics with its workspace for several constraint sets. The
+ * constraint sets must not be evaluated concurrently.
+ */
+template <CollocationDynamics Dynamics>
+FunctionDynamics toFunctionDynamics(const std::shared_ptr<Dynamics> &dynamics)
+{
+    return FunctionDynamics{
+        .dyn_fn =
+            [dynamics](const Eigen::VectorXd &state,
+                       const Eigen::VectorXd &control,
+                       const double time,
+                       Eigen::Ref<Eigen::VectorXd> dx) {
+                dynamics->eval(state, control, time, dx);
+            },
+        .jac_dyn_fn =
+            [dynamics](const Eigen::VectorXd &state,
+                       const Eigen::VectorXd &control,
+                       const double time,
+                       ifopt::Component::Jacobian &jac_wrt_state,
+                       ifopt::Component::Jacobian &jac_wrt_control) {
+                dynamics->jacobians(
+                    state, control, time, jac_wrt_state, jac_wrt_control);
+            }};
+}
+
+/*
+ * Trapezoidal collocation defect constraints,
+ * x_(k+1) - x_k - h/2*(f_k + f_(k+1)) = 0, for a trajectory with segments of
+ * equal duration h. The dynamics f are evaluated through the members of
+ * Dynamics (see CollocationDynamics).
+ *
+ * The duration of the trajectory is either fixed or an optimization variable
+ * (DurationVariable), in which case h = T/N for the current duration T. For a
+ * free duration the dynamics are assumed to be time invariant, ie. the
+ * jacobian w.r.t the duration does not include the derivative of the dynamics
+ * w.r.t the time.
+ *
+ * The control variables are either the controls at the knot points or the
+ * coefficients of a basis (ControlBasis), which gives the knot controls
+ * through a sparse matrix.
+ *
+ * The dynamics values and the jacobians of the dynamics are kept in buffers
+ * that are sized once in the constructor, and the triplets of the jacobian of
+ * the constraints are taken from the arena of the state variables (see
+ * TrajectoryVariables::getArena()). The jacobian blocks are updated in place
+ * when their sparsity pattern does not change, so the evaluations do not
+ * allocate after the first iterates when the caller keeps the blocks (see
+ * JacobianFiller), and they are not thread safe.
+ */
+template <CollocationDynamics Dynamics>
+class CollocationConstraints : public ifopt::ConstraintSet
+{
+public:
+    /*
+     * @param num_constraints This is the total number of constraint equations
+     *   produced by all of the defect constraint equations, which equals (#
+     *   number of segments) * (state length).
+     * @param state_len The number of elements in a state vector at a particular
+     *   time.
+     * @param control_len The number of elements in a control vector at a
+     *   particular time.
+     * @param dt_segment The fixed duration of every time segement.
+     * @param dynamics Dynamics of the system, which is owned by the
+     *   constraints.
+     */
+    CollocationConstraints(
+        const int num_constraints,
+        const std::shared_ptr<TrajectoryVariables> &state_vars,
+        const int state_len,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+        const int control_len,
+        const double dt_segment,
+        Dynamics dynamics);
+
+    /*
+     * Same as above, but with the duration of the trajectory as an
+     * optimization variable.
+     *
+     * @param duration_var Duration of the trajectory, which must be added to
+     *   the problem as a variable set.
+     */
+    CollocationConstraints(
+        const int num_constraints,
+        const std::shared_ptr<TrajectoryVariables> &state_vars,
+        const int state_len,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+        const int control_len,
+        const std::shared_ptr<DurationVariable> &duration_var,
+        Dynamics dynamics);
+
+    /*
+     * Parameterize the controls with a basis, so the control variables are
+     * the coefficients of the basis instead of the knot controls. Call it
+     * before the constraints are added to the problem.
+     *
+     * @param ctrl_basis Basis with one row per knot point and one column per
+     *   control vector of the control variables.
+     */
+    void setControlBasis(ControlBasis ctrl_basis);
+
+    // Get the current values of all constraints
+    Eigen::VectorXd GetValues() const override;
+
+    // Same as GetValues(), but writes the values into a vector of GetRows()
+    // elements.
+    void fillValues(Eigen::Ref<Eigen::VectorXd> values) const;
+
+    ifopt::Component::VecBound GetBounds() const override
+    {
+        // defects should all be zero
+        ifopt::Component::VecBound bounds(GetRows(), {0.0, 0.0});
+        return bounds;
+    }
+
+    // Create the jacobian of the contraints w.r.t all of the optimization
+    // variables (state, control, and the duration if it is free).
+    void FillJacobianBlock(
+        std::string var_set,
+        ifopt::Component::Jacobian &jac_block) const override;
+
+private:
+    enum class VariableType
+    {
+        STATE,
+        CONTROL
+    };
+
+    // Create the jacobian of the constraints w.r.t the specified variable
+    // types.
+    void FillJacobianWrt(const VariableType var_type,
+                         ifopt::Component::Jacobian &jac_block) const;
+
+    // Create the jacobian of the constraints w.r.t the duration of the
+    // trajectory.
+    void FillJacobianWrtDuration(ifopt::Component::Jacobian &jac_block) const;
+
+    int getVarTypeLen(const VariableType var_type) const;
+
+    // Duration of each segment, which is fixed or derived from the duration
+    // variable.
+    double getSegmentDuration() const;
+
+    // Controls at the knot points, one vector per column. They are a view of
+    // the control variables, or evaluated through the control basis.
+    Eigen::Ref<const Eigen::MatrixXd> getKnotControls() const;
+
+    // Number of triplets of the largest jacobian block.
+    int getMaxTriplets() const;
+
+    // Evaluate the dynamics at every time point into m_dyn_values, unless
+    // they were already evaluated for the current values of the variables.
+    // This lets the values and the jacobian w.r.t the duration share one
+    // evaluation per time point.
+    void updateDynValues() const;
+
+    // Evaluate the jacobians of the dynamics at every time point, unless they
+    // were already evaluated for the current values of the variables. This
+    // lets the state and control blocks share one evaluation per time point.
+    void updateDynJacobians() const;
+
+    const std::shared_ptr<TrajectoryVariables> m_state_vars;
+    const int m_state_len;
+    const std::shared_ptr<TrajectoryVariables> m_ctrl_vars;
+    const int m_control_len;
+    const double m_dt_segment;
+    // duration of the trajectory if it is free, otherwise nullptr
+    std::shared_ptr<DurationVariable> m_duration_var;
+    // names of the variable sets, which are compared with the names passed to
+    // FillJacobianBlock() without copying them
+    const std::string m_state_vars_name;
+    const std::string m_ctrl_vars_name;
+    std::string m_duration_var_name;
+    // The dynamics may keep its own workspace, so it is updated by the const
+    // evaluation functions.
+    mutable Dynamics m_dynamics;
+    int m_num_segments;
+    // basis of the control variables, if they are not the knot controls
+    std::optional<ControlBasis> m_ctrl_basis;
+
+    // Workspace, sized once in the constructor and reused by every
+    // evaluation.
+    // dynamics at each time point, one vector per column, and the variable
+    // values and the segment duration at which they were evaluated
+    mutable Eigen::MatrixXd m_dyn_values;
+    mutable bool m_has_dyn_values{false};
+    mutable Eigen::VectorXd m_dyn_state_values;
+    mutable Eigen::VectorXd m_dyn_ctrl_values;
+    mutable double m_dyn_segment_duration{};
+    // state and control at the time point being evaluated
+    mutable Eigen::VectorXd m_state_buf;
+    mutable Eigen::VectorXd m_control_buf;
+    // knot controls evaluated through the control basis
+    mutable Eigen::MatrixXd m_knot_controls;
+    // times of the knot points
+    mutable Eigen::VectorXd m_knot_times;
+    // jacobians of the dynamics at each time point, and the variable values
+    // at which they were evaluated
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_wrt_state;
+    mutable std::vector<ifopt::Component::Jacobian> m_jac_dyn_wrt_control;
+    mutable bool m_has_dyn_jacobians{false};
+    mutable Eigen::VectorXd m_jac_state_values;
+    mutable Eigen::VectorXd m_jac_ctrl_values;
+    mutable JacobianFiller m_state_jac_filler;
+    mutable JacobianFiller m_ctrl_jac_filler;
+    mutable JacobianFiller m_duration_jac_filler;
+};
+
+template <CollocationDynamics Dynamics>
+CollocationConstraints<Dynamics>::CollocationConstraints(
+    const int num_constraints,
+    const std::shared_ptr<TrajectoryVariables> &state_vars,
+    const int state_len,
+    const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+    const int control_len,
+    const double dt_segment,
+    Dynamics dynamics)
+    : ConstraintSet(num_constraints, "trap_col_constraints")
+    , m_state_vars{state_vars}
+    , m_state_len{state_len}
+    , m_ctrl_vars{ctrl_vars}
+    , m_control_len{control_len}
+    , m_dt_segment{dt_segment}
+    , m_state_vars_name{state_vars->GetName()}
+    , m_ctrl_vars_name{ctrl_vars->GetName()}
+    , m_dynamics{std::move(dynamics)}
+{
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    assert(state_vec.size() % m_state_len == 0);
+    const int num_knot_pts = state_vec.size() / m_state_len;
+    m_num_segments = num_knot_pts - 1;
+    assert(num_constraints == m_num_segments * m_state_len);
+
+    m_dyn_values.resize(m_state_len, num_knot_pts);
+    m_state_buf.resize(m_state_len);
+    m_control_buf.resize(m_control_len);
+    m_knot_times.resize(num_knot_pts);
+    m_jac_dyn_wrt_state.resize(num_knot_pts);
+    m_jac_dyn_wrt_control.resize(num_knot_pts);
+    m_dyn_state_values.resize(state_vec.size());
+    m_dyn_ctrl_values.resize(m_ctrl_vars->getValuesRef().size());
+    m_jac_state_values.resize(state_vec.size());
+    m_jac_ctrl_values.resize(m_ctrl_vars->getValuesRef().size());
+}
+
+template <CollocationDynamics Dynamics>
+CollocationConstraints<Dynamics>::CollocationConstraints(
+    const int num_constraints,
+    const std::shared_ptr<TrajectoryVariables> &state_vars,
+    const int state_len,
+    const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+    const int control_len,
+    const std::shared_ptr<DurationVariable> &duration_var,
+    Dynamics dynamics)
+    : CollocationConstraints(
+          num_constraints,
+          state_vars,
+          state_len,
+          ctrl_vars,
+          control_len,
+          duration_var->getSegmentDuration(num_constraints / state_len),
+          std::move(dynamics))
+{
+    m_duration_var = duration_var;
+    m_duration_var_name = duration_var->GetName();
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::setControlBasis(ControlBasis ctrl_basis)
+{
+    assert(ctrl_basis.getNumKnots() == m_num_segments + 1);
+    assert(m_ctrl_vars->getValuesRef().size()
+           == ctrl_basis.getNumCoeffs() * m_control_len);
+    m_knot_controls.resize(m_control_len, ctrl_basis.getNumKnots());
+    m_ctrl_basis.emplace(std::move(ctrl_basis));
+    m_has_dyn_values = false;
+    m_has_dyn_jacobians = false;
+}
+
+template <CollocationDynamics Dynamics>
+int CollocationConstraints<Dynamics>::getMaxTriplets() const
+{
+    // Each defect depends on the states and controls at two time points.
+    // The dynamics jacobians are dense in the worst case, and each state
+    // block also adds an identity matrix. With a control basis, each control
+    // entry is spread over the coefficients of its knot point.
+    const int coeffs_per_knot
+        = m_ctrl_basis ? m_ctrl_basis->getMaxCoeffsPerKnot() : 1;
+    const int max_var_len
+        = std::max(m_state_len, m_control_len * coeffs_per_knot);
+    return 2 * m_num_segments * m_state_len * (max_var_len + 1);
+}
+
+template <CollocationDynamics Dynamics>
+Eigen::Ref<const Eigen::MatrixXd>
+CollocationConstraints<Dynamics>::getKnotControls() const
+{
+    const Eigen::Map<const Eigen::MatrixXd> controls
+        = m_ctrl_vars->getValuesMatrix(m_control_len);
+    if (!m_ctrl_basis) {
+        return controls;
+    }
+    m_ctrl_basis->evalControls(controls, m_knot_controls);
+    return m_knot_controls;
+}
+
+template <CollocationDynamics Dynamics>
+double CollocationConstraints<Dynamics>::getSegmentDuration() const
+{
+    if (m_duration_var) {
+        return m_duration_var->getSegmentDuration(m_num_segments);
+    }
+    return m_dt_segment;
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::updateDynValues() const
+{
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_vec = m_ctrl_vars->getValuesRef();
+    const double h = getSegmentDuration();
+    if (m_has_dyn_values && (state_vec == m_dyn_state_values)
+        && (ctrl_vec == m_dyn_ctrl_values) && (h == m_dyn_segment_duration)) {
+        return;
+    }
+
+    // views with one state or control vector per column (state_len x (N+1)
+    // and control_len x (N+1))
+    const Eigen::Map<const Eigen::MatrixXd> states
+        = m_state_vars->getValuesMatrix(m_state_len);
+    const Eigen::Ref<const Eigen::MatrixXd> controls = getKnotControls();
+    assert(states.cols() == m_num_segments + 1);
+    assert(controls.cols() == states.cols());
+
+    const int num_knot_pts = m_num_segments + 1;
+    for (int k{}; k < num_knot_pts; ++k) {
+        // time relative to start time of zero
+        const double tk = k * h;
+        m_state_buf = states.col(k);
+        m_control_buf = controls.col(k);
+        m_dynamics.eval(m_state_buf, m_control_buf, tk, m_dyn_values.col(k));
+    }
+    m_dyn_state_values = state_vec;
+    m_dyn_ctrl_values = ctrl_vec;
+    m_dyn_segment_duration = h;
+    m_has_dyn_values = true;
+}
+
+template <CollocationDynamics Dynamics>
+Eigen::VectorXd CollocationConstraints<Dynamics>::GetValues() const
+{
+    Eigen::VectorXd defect_constraints(GetRows());
+    fillValues(defect_constraints);
+    return defect_constraints;
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::fillValues(
+    Eigen::Ref<Eigen::VectorXd> values) const
+{
+    assert(values.size() == GetRows());
+    // Dynamics stage: evaluate the dynamics once per time point, giving the
+    // matrix F = [f_0, f_1, ..., f_N].
+    updateDynValues();
+
+    // Defect stage: column k of the defect matrix is defect k,
+    // x_(k+1) - x_k - h/2*(f_k + f_(k+1)). The matrix is stored in the
+    // output vector, so it has the stacked layout of the constraints.
+    const Eigen::Map<const Eigen::MatrixXd> states
+        = m_state_vars->getValuesMatrix(m_state_len);
+    const int N = m_num_segments;
+    Eigen::Map<Eigen::MatrixXd> defects(values.data(), m_state_len, N);
+    defects.noalias() = states.rightCols(N) - states.leftCols(N)
+                        - (getSegmentDuration() / 2.0)
+                              * (m_dyn_values.leftCols(N)
+                                 + m_dyn_values.rightCols(N));
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::FillJacobianBlock(
+    std::string var_set,
+    ifopt::Component::Jacobian &jac_block) const
+{
+    if (var_set == m_state_vars_name) {
+        FillJacobianWrt(VariableType::STATE, jac_block);
+    } else if (var_set == m_ctrl_vars_name) {
+        FillJacobianWrt(VariableType::CONTROL, jac_block);
+    } else if (m_duration_var && (var_set == m_duration_var_name)) {
+        FillJacobianWrtDuration(jac_block);
+    }
+}
+
+template <CollocationDynamics Dynamics>
+int CollocationConstraints<Dynamics>::getVarTypeLen(
+    const VariableType var_type) const
+{
+    switch (var_type) {
+        case VariableType::STATE:
+            return m_state_len;
+
+        case VariableType::CONTROL:
+            return m_control_len;
+    }
+    assert(false);
+    return m_state_len;
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::updateDynJacobians() const
+{
+    const Eigen::VectorXd &state_vec = m_state_vars->getValuesRef();
+    const Eigen::VectorXd &ctrl_vec = m_ctrl_vars->getValuesRef();
+    if (m_has_dyn_jacobians && (state_vec == m_jac_state_values)
+        && (ctrl_vec == m_jac_ctrl_values)) {
+        return;
+    }
+
+    const Eigen::Ref<const Eigen::MatrixXd> controls = getKnotControls();
+    const int num_knot_pts = m_num_segments + 1;
+    if constexpr (KnotJacobiansDynamics<Dynamics>) {
+        m_knot_times.setLinSpaced(
+            num_knot_pts, 0.0, getSegmentDuration() * m_num_segments);
+        m_dynamics.jacobiansAtKnots(
+            m_state_vars->getValuesMatrix(m_state_len),
+            controls,
+            m_knot_times,
+            m_jac_dyn_wrt_state,
+            m_jac_dyn_wrt_control);
+        m_jac_state_values = state_vec;
+        m_jac_ctrl_values = ctrl_vec;
+        m_has_dyn_jacobians = true;
+        return;
+    }
+    for (int j{}; j < num_knot_pts; ++j) {
+        // get state, control, and time at time index j
+        m_state_buf = state_vec(Eigen::seqN(j * m_state_len, m_state_len));
+        m_control_buf = controls.col(j);
+        const double tj = getSegmentDuration() * j;
+        m_dynamics.jacobians(m_state_buf,
+                             m_control_buf,
+                             tj,
+                             m_jac_dyn_wrt_state[j],
+                             m_jac_dyn_wrt_control[j]);
+    }
+    m_jac_state_values = state_vec;
+    m_jac_ctrl_values = ctrl_vec;
+    m_has_dyn_jacobians = true;
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::FillJacobianWrt(
+    const VariableType var_type,
+    ifopt::Component::Jacobian &jac_block) const
+{
+    updateDynJacobians();
+
+    // use list of triplets to simplify and avoid costly random
+    // insertions when constructing the final sparse jacobian matrix.
+    EvaluationArena &arena = m_state_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
+    TripletList triplets
+        = arena.makeVector<Eigen::Triplet<double>>(getMaxTriplets());
+    const int var_type_len = getVarTypeLen(var_type);
+    const double hk = getSegmentDuration();
+
+    // Here k represents the kth vector defect constraint equation. Set the stop
+    // point such that the state at time point j=k+1 can be accessed for the
+    // last iteration.
+    const int k_max = m_num_segments;
+
+    // The jacobian of defect k w.r.t state or control vector j is nonzero for
+    // j=k and j=k+1 (gives two non-zero submatrices in the output jacobian).
+    // This submatrix starts at (k*state_len, j*var_len) and has
+    // size=(state_len x var_len).
+    //
+    // In general the jacobian of defect k w.r.t state j is:
+    // dck_dxj = dxk1_dxj - dxk_dxj - hk/2*(dfk1_dxj + dfk_dxj)
+    // j=k => dxk1_dxj=0 and dfk1_dxj=0
+    // j=k+1 => dxk_dxj=0 and dfk_dxj=0
+    //
+    // and the jacobian of defect k w.r.t control j is:
+    // dck_duj = - hk/2*(dfk1_duj + dfk_duj)
+    //
+    // With a control basis, u_j = sum_m B(j, m)*c_m, so the jacobian w.r.t
+    // the coefficients c_m is dck_dcm = sum_j dck_duj*B(j, m).
+    const bool use_basis
+        = (var_type == VariableType::CONTROL) && m_ctrl_basis.has_value();
+    for (int k{}; k < k_max; ++k) {
+        for (int j = k; j < k + 2; ++j) {
+            // defects increment for each row
+            const int row_start = k * m_state_len;
+            // control/state vectors increment for each column
+            const int col_start = j * var_type_len;
+
+            // jacobian of the dynamics at time point j, which represents
+            // either dfk_dvj (for j=k) or dfk1_dvj (for j=k+1)
+            const ifopt::Component::Jacobian &dfj_dvj
+                = (var_type == VariableType::STATE) ? m_jac_dyn_wrt_state[j]
+                                                    : m_jac_dyn_wrt_control[j];
+            for (int i{}; i < dfj_dvj.outerSize(); ++i) {
+                for (ifopt::Component::Jacobian::InnerIterator it(dfj_dvj, i);
+                     it;
+                     ++it) {
+                    if (!use_basis) {
+                        triplets.emplace_back(row_start + it.row(),
+                                              col_start + it.col(),
+                                              -hk / 2 * it.value());
+                        continue;
+                    }
+                    // duplicate triplets of neighbouring knot points are
+                    // summed by the filler
+                    for (ControlBasis::Matrix::InnerIterator b_it(
+                             m_ctrl_basis->getMatrix(), j);
+                         b_it;
+                         ++b_it) {
+                        triplets.emplace_back(
+                            row_start + it.row(),
+                            b_it.col() * m_control_len + it.col(),
+                            -hk / 2 * it.value() * b_it.value());
+                    }
+                }
+            }
+
+            if (var_type == VariableType::STATE) {
+                // jacobian of the discrete state, which represents either
+                // dxk_dxj (for j=k) or dxk1_dxj (for j=k+1). Duplicate
+                // triplets are summed by the filler.
+                const double sign = (k == j) ? -1.0 : 1.0;
+                for (int i{}; i < m_state_len; ++i) {
+                    triplets.emplace_back(row_start + i, col_start + i, sign);
+                }
+            }
+        }
+    }
+
+    JacobianFiller &filler = (var_type == VariableType::STATE)
+                                 ? m_state_jac_filler
+                                 : m_ctrl_jac_filler;
+    filler.fill(triplets, jac_block);
+}
+
+template <CollocationDynamics Dynamics>
+void CollocationConstraints<Dynamics>::FillJacobianWrtDuration(
+    ifopt::Component::Jacobian &jac_block) const
+{
+    // With h = T/N the derivative of defect k w.r.t the duration T is
+    // dck_dT = -1/(2N)*(f_k + f_(k+1)). The dynamics values are usually
+    // cached from the evaluation of the constraint values.
+    updateDynValues();
+    const int N = m_num_segments;
+    EvaluationArena &arena = m_state_vars->getArena();
+    const EvaluationArena::Frame frame(arena);
+    TripletList triplets = arena.makeVector<Eigen::Triplet<double>>(GetRows());
+    for (int k{}; k < N; ++k) {
+        for (int i{}; i < m_state_len; ++i) {
+            const double dck_dT
+                = -(m_dyn_values(i, k) + m_dyn_values(i, k + 1)) / (2.0 * N);
+            triplets.emplace_back(k * m_state_len + i, 0, dck_dT);
+        }
+    }
+    m_duration_jac_filler.fill(triplets, jac_block);
+}
@@ -1,6 +1,9 @@
 #include "control_effort_trapezoidal_cost.hpp"
 
 #include <cassert>
+#include <stdexcept>
+
+#include "evaluation_arena.hpp"
 
 ControlEffortTrapezoidalCost::ControlEffortTrapezoidalCost(
     const std::string &cost_name,
@@ -13,12 +16,53 @@ ControlEffortTrapezoidalCost::ControlEffortTrapezoidalCost(
     , m_dt_segment{dt_segment}
 {}
 
+ControlEffortTrapezoidalCost::ControlEffortTrapezoidalCost(
+    const std::string &cost_name,
+    const std::string &ctrl_vars_name,
+    const int ctrl_len,
+    const std::string &duration_vars_name)
+    : CostTerm(cost_name)
+    , m_ctrl_vars_name{ctrl_vars_name}
+    , m_ctrl_len{ctrl_len}
+    , m_dt_segment{}
+    , m_duration_vars_name{duration_vars_name}
+{}
+
+void ControlEffortTrapezoidalCost::InitVariableDependedQuantities(
+    const VariablesPtr &x_init)
+{
+    m_ctrl_vars = x_init->GetComponent<TrajectoryVariables>(m_ctrl_vars_name);
+    if (!m_ctrl_vars) {
+        throw std::invalid_argument(
+            "ControlEffortTrapezoidalCost. No trajectory variables named "
+            + m_ctrl_vars_name);
+    }
+    if (!m_duration_vars_name.empty()) {
+        m_duration_var
+            = x_init->GetComponent<DurationVariable>(m_duration_vars_name);
+        if (!m_duration_var) {
+            throw std::invalid_argument(
+                "ControlEffortTrapezoidalCost. No duration variable named "
+                + m_duration_vars_name);
+        }
+    }
+}
+
+double ControlEffortTrapezoidalCost::getSegmentDuration() const
+{
+    if (m_duration_var) {
+        const int num_segments = m_ctrl_vars->GetRows() / m_ctrl_len - 1;
+        return m_duration_var->getSegmentDuration(num_segments);
+    }
+    return m_dt_segment;
+}
+
 double ControlEffortTrapezoidalCost::GetCost() const
 {
-    const Eigen::VectorXd ctrl_vars
-        = GetVariables()->GetComponent(m_ctrl_vars_name)->GetValues();
-    assert(ctrl_vars.size() % m_ctrl_len == 0);
-    const int num_vectors = ctrl_vars.size() / m_ctrl_len;
+    // view with one control vector per column
+    const Eigen::Map<const Eigen::MatrixXd> ctrl_vecs
+        = m_ctrl_vars->getValuesMatrix(m_ctrl_len);
+    const int num_vectors = ctrl_vecs.cols();
 
     // Integrate the control squared over the trajectory numerically using
     // trapezoidal quadrature. Loop through the control vectors in pairs
@@ -27,13 +71,10 @@ double ControlEffortTrapezoidalCost::GetCost() const
     double cost{};
 
     for (int k{}; k < num_vectors - 1; ++k) {
-        const auto uk = ctrl_vars(Eigen::seqN(k * m_ctrl_len, m_ctrl_len));
-        const int k1 = k + 1;
-        const auto uk1 = ctrl_vars(Eigen::seqN(k1 * m_ctrl_len, m_ctrl_len));
-
-        cost += uk.squaredNorm() + uk1.squaredNorm();
+        cost += ctrl_vecs.col(k).squaredNorm()
+                + ctrl_vecs.col(k + 1).squaredNorm();
     }
-    cost = 0.5 * m_dt_segment * cost;
+    cost = 0.5 * getSegmentDuration() * cost;
 
     return cost;
 };
@@ -44,13 +85,15 @@ void ControlEffortTrapezoidalCost::FillJacobianBlock(
 {
     if (var_set == m_ctrl_vars_name) {
         // loop through each control vector
-        const VectorXd ctrl_vars
-            = GetVariables()->GetComponent(m_ctrl_vars_name)->GetValues();
+        const Eigen::VectorXd &ctrl_vars = m_ctrl_vars->getValuesRef();
         assert(ctrl_vars.size() % m_ctrl_len == 0);
         const int num_vectors = ctrl_vars.size() / m_ctrl_len;
 
-        std::vector<Eigen::Triplet<double>> triplets;
-        triplets.reserve(ctrl_vars.size());
+        const double dt_segment = getSegmentDuration();
+        EvaluationArena &arena = m_ctrl_vars->getArena();
+        const EvaluationArena::Frame frame(arena);
+        TripletList triplets
+            = arena.makeVector<Eigen::Triplet<double>>(ctrl_vars.size());
         for (int k{}; k < num_vectors; ++k) {
             const auto uk = ctrl_vars(Eigen::seqN(k * m_ctrl_len, m_ctrl_len));
             for (int j{}; j < m_ctrl_len; ++j) {
@@ -58,15 +101,18 @@ void ControlEffortTrapezoidalCost::FillJacobianBlock(
                     // jacobian w.r.t elements of either first or last
                     // control vector
                     triplets.push_back(
-                        {0, k * m_ctrl_len + j, m_dt_segment * uk(j)});
+                        {0, k * m_ctrl_len + j, dt_segment * uk(j)});
                     continue;
                 }
                 // jacobian w.r.t elements of neither first or last control
                 // vector
                 triplets.push_back(
-                    {0, k * m_ctrl_len + j, 2 * m_dt_segment * uk(j)});
+                    {0, k * m_ctrl_len + j, 2 * dt_segment * uk(j)});
             }
         }
-        jac.setFromTriplets(triplets.cbegin(), triplets.cend());
+        m_ctrl_jac_filler.fill(triplets, jac);
+    } else if (m_duration_var && (var_set == m_duration_vars_name)) {
+        // The cost is proportional to the duration, so dJ/dT = J/T.
+        jac.coeffRef(0, 0) = GetCost() / m_duration_var->getDuration();
     }
 }
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "collocation_constraints.hpp"
+
+// Requirements of the dynamics wrapped by FiniteDifferenceDynamics, which only
+// has to evaluate the dynamics function (see CollocationDynamics).
+template <typename T>
+concept DynamicsFunction = requires(T dyn,
+                                    const Eigen::VectorXd &state,
+                                    const Eigen::VectorXd &control,
+                                    const double time,
+                                    Eigen::Ref<Eigen::VectorXd> dx) {
+    dyn.eval(state, control, time, dx);
+};
+
+// Dynamics that can also evaluate all knot points in one call (eg.
+// RobotDynamics), with one state and control vector per column and one
+// column of dyn_values per time point.
+template <typename T>
+concept KnotDynamicsFunction
+    = DynamicsFunction<T>
+      && requires(T dyn,
+                  const Eigen::Ref<const Eigen::MatrixXd> &states,
+                  const Eigen::Ref<const Eigen::MatrixXd> &controls,
+                  const Eigen::VectorXd &times,
+                  Eigen::Ref<Eigen::MatrixXd> dyn_values) {
+             dyn.evalAtKnots(states, controls, times, dyn_values);
+         };
+
+/*
+ * Write a dense matrix into a sparse jacobian, including its zero entries, so
+ * the sparsity pattern is the same for every evaluation. If the jacobian
+ * already has the dense pattern, only its values are updated.
+ */
+inline void fillDenseJacobian(const Eigen::MatrixXd &values,
+                              ifopt::Component::Jacobian &jac)
+{
+    if ((jac.rows() != values.rows()) || (jac.cols() != values.cols())
+        || (jac.nonZeros() != values.size())) {
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(values.size());
+        for (int i{}; i < values.rows(); ++i) {
+            for (int j{}; j < values.cols(); ++j) {
+                triplets.push_back({i, j, values(i, j)});
+            }
+        }
+        jac.resize(values.rows(), values.cols());
+        jac.setFromTriplets(triplets.cbegin(), triplets.cend());
+        return;
+    }
+    for (int i{}; i < jac.outerSize(); ++i) {
+        for (ifopt::Component::Jacobian::InnerIterator it(jac, i); it; ++it) {
+            it.valueRef() = values(it.row(), it.col());
+        }
+    }
+}
+
+/*
+ * Dynamics whose jacobians are computed by central finite differences of the
+ * dynamics function, eg. to prototype a model without analytic derivatives.
+ *
+ * The dynamics at knot point j only depend on the state and control at j, so
+ * element i of every knot vector can be perturbed at once (one color per
+ * element of the state and the control). If the dynamics evaluate all knot
+ * points in one call (see KnotDynamicsFunction), a color takes two such
+ * calls, ie. 2*(state_len + control_len) calls for the jacobians at all knot
+ * points, independent of the number of segments. Each call still evaluates
+ * the dynamics at every knot point, so the work grows with the number of
+ * segments unless the dynamics batch the knot points. Otherwise the dynamics
+ * are evaluated per knot point, which are ordinary central differences with
+ * 2*(state_len + control_len)*(N+1) calls.
+ *
+ * The colors can be split between threads, each with its own copy of the
+ * dynamics. The threads are started for every evaluation, so they only pay
+ * off for expensive dynamics or many knot points.
+ */
+template <DynamicsFunction Dynamics>
+class FiniteDifferenceDynamics
+{
+public:
+    /*
+     * @param rel_step Step of element i, relative to max(1, |v_i|).
+     * @param num_threads Number of threads for the colors, or zero for the
+     *   number of hardware threads. Each thread copies the dynamics.
+     */
+    explicit FiniteDifferenceDynamics(Dynamics dynamics,
+                                      const double rel_step = 1e-6,
+                                      const int num_threads = 1)
+        : m_rel_step{rel_step}
+        , m_dynamics(getNumThreads(num_threads), dynamics)
+    {}
+
+    void eval(const Eigen::VectorXd &state,
+              const Eigen::VectorXd &control,
+              const double time,
+              Eigen::Ref<Eigen::VectorXd> dx)
+    {
+        m_dynamics.front().eval(state, control, time, dx);
+    }
+
+    // Jacobians at a single time point.
+    void jacobians(const Eigen::VectorXd &state,
+                   const Eigen::VectorXd &control,
+                   const double time,
+                   ifopt::Component::Jacobian &jac_wrt_state,
+                   ifopt::Component::Jacobian &jac_wrt_control)
+    {
+        std::vector<Eigen::MatrixXd> df_dx(1);
+        std::vector<Eigen::MatrixXd> df_du(1);
+        // a single time point is not worth the threads
+        jacobiansAtKnotsDense(state,
+                              control,
+                              Eigen::VectorXd::Constant(1, time),
+                              1,
+                              df_dx,
+                              df_du);
+        fillDenseJacobian(df_dx.front(), jac_wrt_state);
+        fillDenseJacobian(df_du.front(), jac_wrt_control);
+    }
+
+    /*
+     * Jacobians at all knot points, with one state and control vector per
+     * column.
+     */
+    void jacobiansAtKnots(
+        const Eigen::Ref<const Eigen::MatrixXd> &states,
+        const Eigen::Ref<const Eigen::MatrixXd> &controls,
+        const Eigen::VectorXd &times,
+        std::vector<ifopt::Component::Jacobian> &jacs_wrt_state,
+        std::vector<ifopt::Component::Jacobian> &jacs_wrt_control)
+    {
+        jacobiansAtKnotsDense(states,
+                              controls,
+                              times,
+                              static_cast<int>(m_dynamics.size()),
+                              m_df_dx,
+                              m_df_du);
+        for (int j{}; j < times.size(); ++j) {
+            fillDenseJacobian(m_df_dx[j], jacs_wrt_state[j]);
+            fillDenseJacobian(m_df_du[j], jacs_wrt_control[j]);
+        }
+    }
+
+private:
+    static int getNumThreads(const int num_threads)
+    {
+        if (num_threads > 0) {
+            return num_threads;
+        }
+        const int hw_threads
+            = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, hw_threads);
+    }
+
+    // Dense jacobians at all knot points, with the colors split between at
+    // most max_threads threads.
+    void jacobiansAtKnotsDense(
+        const Eigen::Ref<const Eigen::MatrixXd> &states,
+        const Eigen::Ref<const Eigen::MatrixXd> &controls,
+        const Eigen::VectorXd &times,
+        const int max_threads,
+        std::vector<Eigen::MatrixXd> &df_dx,
+        std::vector<Eigen::MatrixXd> &df_du)
+    {
+        const int state_len = states.rows();
+        const int control_len = controls.rows();
+        const int num_knots = times.size();
+        df_dx.resize(num_knots);
+        df_du.resize(num_knots);
+        for (int j{}; j < num_knots; ++j) {
+            df_dx[j].resize(state_len, state_len);
+            df_du[j].resize(state_len, control_len);
+        }
+
+        // Color c perturbs element c of every state vector, or element
+        // c - state_len of every control vector. Each color writes its own
+        // column of the jacobians, so the threads do not share outputs.
+        const int num_colors = state_len + control_len;
+        const auto eval_colors = [&](const int thread_idx,
+                                     const int num_threads) {
+            Dynamics &dyn = m_dynamics[thread_idx];
+            if constexpr (KnotDynamicsFunction<Dynamics>) {
+                // one call per perturbation of all knot points
+                Eigen::MatrixXd pert_states = states;
+                Eigen::MatrixXd pert_controls = controls;
+                Eigen::MatrixXd dyn_plus(state_len, num_knots);
+                Eigen::MatrixXd dyn_minus(state_len, num_knots);
+                Eigen::RowVectorXd steps(num_knots);
+                for (int c = thread_idx; c < num_colors; c += num_threads) {
+                    const bool is_state = c < state_len;
+                    const int i = is_state ? c : c - state_len;
+                    auto v = is_state ? pert_states.row(i)
+                                      : pert_controls.row(i);
+                    const auto v0 = is_state ? states.row(i) : controls.row(i);
+                    steps = m_rel_step * v0.cwiseAbs().cwiseMax(1.0);
+                    v = v0 + steps;
+                    dyn.evalAtKnots(
+                        pert_states, pert_controls, times, dyn_plus);
+                    v = v0 - steps;
+                    dyn.evalAtKnots(
+                        pert_states, pert_controls, times, dyn_minus);
+                    v = v0;
+                    for (int j{}; j < num_knots; ++j) {
+                        Eigen::MatrixXd &jac = is_state ? df_dx[j] : df_du[j];
+                        jac.col(i) = (dyn_plus.col(j) - dyn_minus.col(j))
+                                     / (2.0 * steps(j));
+                    }
+                }
+                return;
+            }
+            Eigen::VectorXd state(state_len);
+            Eigen::VectorXd control(control_len);
+            Eigen::VectorXd dx_plus(state_len);
+            Eigen::VectorXd dx_minus(state_len);
+            for (int c = thread_idx; c < num_colors; c += num_threads) {
+                const bool is_state = c < state_len;
+                const int i = is_state ? c : c - state_len;
+                for (int j{}; j < num_knots; ++j) {
+                    state = states.col(j);
+                    control = controls.col(j);
+                    double &v = is_state ? state(i) : control(i);
+                    const double v0 = v;
+                    const double step
+                        = m_rel_step * std::max(1.0, std::abs(v0));
+                    v = v0 + step;
+                    dyn.eval(state, control, times(j), dx_plus);
+                    v = v0 - step;
+                    dyn.eval(state, control, times(j), dx_minus);
+                    Eigen::MatrixXd &jac = is_state ? df_dx[j] : df_du[j];
+                    jac.col(i) = (dx_plus - dx_minus) / (2.0 * step);
+                }
+            }
+        };
+
+        const int num_threads = std::min(max_threads, num_colors);
+        if (num_threads == 1) {
+            eval_colors(0, 1);
+            return;
+        }
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+        for (int t = 1; t < num_threads; ++t) {
+            threads.emplace_back(eval_colors, t, num_threads);
+        }
+        eval_colors(0, num_threads);
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    const double m_rel_step;
+    // one copy of the dynamics per thread
+    std::vector<Dynamics> m_dynamics;
+    // dense jacobians at the knot points, reused by every call
+    std::vector<Eigen::MatrixXd> m_df_dx;
+    std::vector<Eigen::MatrixXd> m_df_du;
+};
+
+// input of the dynamics function that a jacobian is taken w.r.t
+enum class DynamicsInput
+{
+    STATE,
+    CONTROL
+};
+
+/*
+ * Callback with the signature of the jacobian callbacks of the collocation
+ * constraints (eg. TrapezoidalCollocationConstraints::JacobianDynFn), which
+ * computes the jacobian of dyn_fn w.r.t one of its inputs by central finite
+ * differences at a single time point.
+ */
+inline std::function<ifopt::Component::Jacobian(const Eigen::VectorXd &state,
+                                                const Eigen::VectorXd &control,
+                                                const double time)>
+finiteDifferenceJacobianFn(
+    std::function<Eigen::VectorXd(const Eigen::VectorXd &state,
+                                  const Eigen::VectorXd &control,
+                                  const double time)> dyn_fn,
+    const DynamicsInput wrt,
+    const double rel_step = 1e-6)
+{
+    return [dyn_fn = std::move(dyn_fn), wrt, rel_step](
+               const Eigen::VectorXd &state,
+               const Eigen::VectorXd &control,
+               const double time) {
+        Eigen::VectorXd x = state;
+        Eigen::VectorXd u = control;
+        Eigen::VectorXd &v = (wrt == DynamicsInput::STATE) ? x : u;
+        Eigen::MatrixXd values(state.size(), v.size());
+        for (int i{}; i < v.size(); ++i) {
+            const double v0 = v(i);
+            const double step = rel_step * std::max(1.0, std::abs(v0));
+            v(i) = v0 + step;
+            const Eigen::VectorXd dx_plus = dyn_fn(x, u, time);
+            v(i) = v0 - step;
+            const Eigen::VectorXd dx_minus = dyn_fn(x, u, time);
+            v(i) = v0;
+            values.col(i) = (dx_plus - dx_minus) / (2.0 * step);
+        }
+        ifopt::Component::Jacobian jac;
+        fillDenseJacobian(values, jac);
+        return jac;
+    };
+}
@@ -2,6 +2,7 @@
 
 #include <ifopt/constraint_set.h>
 
+#include "collocation_constraints.hpp"
 #include "trajectory_variables.hpp"
 
 // A utility function to convert a sparse matrix to a vector of
@@ -13,10 +14,11 @@ std::vector<Eigen::Triplet<double>> sparseMatrixToTriplets(
     const int row_start,
     const int col_start);
 
-// todo: consider the final time as an optimization variable in order to support
-// minimizing total time of a trajectory
-
-class TrapezoidalCollocationConstraints final : public ifopt::ConstraintSet
+// Collocation constraints with type erased dynamics callbacks, which is
+// convenient for prototyping. Use CollocationConstraints directly with a
+// dynamics type to avoid the indirect calls.
+class TrapezoidalCollocationConstraints final
+    : public CollocationConstraints<FunctionDynamics>
 {
 public:
     // calback signature for evaluating the dynamics
@@ -29,6 +31,8 @@ public:
         const Eigen::VectorXd &state,
         const Eigen::VectorXd &control,
         const double time)>;
+    using DynIntoFn = FunctionDynamics::DynIntoFn;
+    using JacobiansDynIntoFn = FunctionDynamics::JacobiansDynIntoFn;
 
     /*
      * @param num_constraints This is the total number of constraint equations
@@ -58,71 +62,24 @@ public:
         const DynFn &dyn_fn,
         const JacobianDynFn &jac_dyn_wrt_state_fn,
         const JacobianDynFn &jac_dyn_wrt_control_fn);
-    // Get the current values of all constraints
-    Eigen::VectorXd GetValues() const override;
-
-    ifopt::Component::VecBound GetBounds() const override
-    {
-        // defects should all be zero
-        ifopt::Component::VecBound bounds(GetRows(), {0.0, 0.0});
-        return bounds;
-    }
-
-    // Create the jacobian of the contraints w.r.t all of the optimization
-    // variables (state, control).
-    void FillJacobianBlock(
-        std::string var_set,
-        ifopt::Component::Jacobian &jac_block) const override;
-
-private:
-    enum class VariableType
-    {
-        STATE,
-        CONTROL
-    };
-
-    // Create the jacobian of the constraints w.r.t the specified variable
-    // types.
-    void FillJacobianWrt(const VariableType var_type,
-                         ifopt::Component::Jacobian &jac_block) const;
-
-    int getVarTypeLen(const VariableType var_type) const;
-
-    // Create the jacobian of defect constraint vector k w.r.t the vector
-    // variable type (eg. state or control) at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtVar(
-        const VariableType var_type,
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
-
-    // Create the jacobian of defect constraint vector k w.r.t the state vector
-    // at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtState(
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
 
-    // Create the jacobian of defect constraint vector k w.r.t the control
-    // vector at time point j.
-    ifopt::Component::Jacobian jacConstraintsWrtControl(
-        const size_t k,
-        const size_t j,
-        const Eigen::VectorXd &state,
-        const Eigen::VectorXd &control,
-        const double time) const;
-
-    const std::shared_ptr<TrajectoryVariables> m_state_vars;
-    const int m_state_len;
-    const std::shared_ptr<TrajectoryVariables> m_ctrl_vars;
-    const int m_control_len;
-    const double m_dt_segment;
-    const DynFn m_dyn_fn;
-    const JacobianDynFn m_jac_dyn_wrt_state_fn;
-    const JacobianDynFn m_jac_dyn_wrt_control_fn;
-    int m_num_segments;
+    /*
+     * Same as above, but the dynamics and its jacobians are evaluated into
+     * the buffers of the constraints, so callbacks that do not allocate (eg.
+     * computeDyn() and computeDynJacobians()) avoid allocations per time
+     * point.
+     *
+     * @param dyn_fn Callback function to evaluate the dynamics function.
+     * @param jac_dyn_fn Callback function to evaluate the jacobians of the
+     *   dynamics function w.r.t the input state and the input control.
+     */
+    TrapezoidalCollocationConstraints(
+        const int num_constraints,
+        const std::shared_ptr<TrajectoryVariables> &state_vars,
+        const int state_len,
+        const std::shared_ptr<TrajectoryVariables> &ctrl_vars,
+        const int control_len,
+        const double dt_segment,
+        const DynIntoFn &dyn_fn,
+        const JacobiansDynIntoFn &jac_dyn_fn);
 };
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <polynomial_spline.hpp>
+#include <traj_element.hpp>
+
+#include "knot_dynamics.hpp"
+#include "sampled_state_traj_view.hpp"
+#include "pinocchio/multibody/model.hpp"
+
+/*
+ * View of a solution vector that an extractor keeps, eg. of the values of
+ * TrajectoryVariables. It only binds to a vector that exists beyond the call,
+ * so passing a temporary (eg. traj_state_vars->GetValues()) does not compile,
+ * instead of leaving a dangling view. The conversion is implicit, so the
+ * extractors are constructed from vectors.
+ */
+class SolutionView
+{
+public:
+    SolutionView(const Eigen::VectorXd &values)
+        : m_values{values.data(), values.size()}
+    {}
+
+    SolutionView(Eigen::VectorXd &&values) = delete;
+
+    const Eigen::Map<const Eigen::VectorXd> &getValues() const
+    {
+        return m_values;
+    }
+
+private:
+    Eigen::Map<const Eigen::VectorXd> m_values;
+};
+
+/*
+ * Common engine of the trajectory extractors of the collocation schemes.
+ *
+ * A scheme derives from CollocationTrajExtractor<Scheme>, describes its
+ * collocation points as sets of stacked states and controls (eg. the knot
+ * points, and the midpoints of Hermite-Simpson) and supplies only its
+ * interpolants through the member templates
+ *
+ *   template <int Dim> StateSpline<Dim> createStateSpline() const;
+ *   template <int Dim> CtrlSpline<Dim> createCtrlSpline() const;
+ *
+ * where the splines are eg. a QuadraticSpline, CubicSpline or LinearSpline of
+ * the state or control size Dim (see dispatchSplineDim()), or any other
+ * interpolant with the same sampling interface. The engine evaluates the
+ * dynamics at the collocation points (in parallel on an optional
+ * KnotDynamicsPool), samples the interpolants and creates the output
+ * trajectories the same way for all schemes.
+ *
+ * The engine is instantiated in the translation unit of each scheme.
+ */
+template <typename Scheme>
+class CollocationTrajExtractor
+{
+public:
+    // callback signature for evaluating the dynamics, eg. computeDyn() or
+    // toKnotDynFn(dyn)
+    using DynFn = KnotDynFn;
+
+    // Get collocation traj. This is equivalent to the NLP solution without any
+    // post processing (no use of splines or interpolation).
+    DiscreteJointStateTraj createCollocationStateTraj();
+    DiscreteJointDataTraj createCollocationCtrlTraj();
+
+    // Formed by first creating splines from the NLP solution and then
+    // interpolating based on the sample period.
+    DiscreteJointStateTraj createSampledStateTraj(const double sample_period);
+    DiscreteJointDataTraj createSampledCtrlTraj(const double sample_period);
+
+    // Same samples as createSampledStateTraj(), computed on demand while
+    // iterating, eg. to stream them to the bus or the simulator. The view
+    // owns the spline, so it may outlive the extractor.
+    SampledStateTrajView viewSampledStateTraj(const double sample_period);
+
+    // Joint jerks, ie. the time derivative of ddq of the sampled state
+    // trajectory, eg. to check the smoothness of servo commands.
+    DiscreteJointDataTraj createSampledJerkTraj(const double sample_period);
+
+protected:
+    // Stacked states and controls of collocation points that are one segment
+    // apart, the first one time_offset after the start time.
+    struct PointSet
+    {
+        Eigen::Map<const Eigen::VectorXd> state_vars;
+        Eigen::Map<const Eigen::VectorXd> ctrl_vars;
+        double time_offset;
+    };
+
+    /*
+     * The solution vectors of the point sets are viewed, not copied, so they
+     * must outlive the extractor. The dynamics at the collocation points are
+     * evaluated on the calling thread, or in parallel on the threads of the
+     * pool if one is given. The pool is created once by the caller, eg. for
+     * the extractors of a batch of solutions, and only used by the
+     * constructor.
+     *
+     * @param point_sets Collocation points, the knot points first and then
+     *   the sets of points within the segments, by increasing time offset.
+     */
+    CollocationTrajExtractor(const double start_time,
+                             const double traj_dur,
+                             const int state_len,
+                             const int ctrl_len,
+                             const double dt_segment,
+                             std::vector<PointSet> point_sets,
+                             const pinocchio::Model &model,
+                             const DynFn &dyn_fn,
+                             KnotDynamicsPool *pool);
+
+    const double m_start_time;
+    const double m_dur;
+    const int m_state_len;
+    const int m_ctrl_len;
+    const double m_dt_segment;
+    const std::vector<PointSet> m_point_sets;
+    const DynFn m_dyn_fn;
+    // stacked time derivatives of the states, one vector per point set
+    const std::vector<Eigen::VectorXd> m_dyn_vals;
+
+private:
+    std::vector<Eigen::VectorXd> createDynVals(const pinocchio::Model &model,
+                                               KnotDynamicsPool *pool);
+
+    int getNumSamples(const double sample_period) const;
+
+    // Joint data trajectory with one sample per column, sample_period apart.
+    DiscreteJointDataTraj createDataTraj(const Eigen::MatrixXd &samples,
+                                         const double sample_period) const;
+
+    const Scheme &getScheme() const;
+};
+
+template <typename Scheme>
+CollocationTrajExtractor<Scheme>::CollocationTrajExtractor(
+    const double start_time,
+    const double traj_dur,
+    const int state_len,
+    const int ctrl_len,
+    const double dt_segment,
+    std::vector<PointSet> point_sets,
+    const pinocchio::Model &model,
+    const DynFn &dyn_fn,
+    KnotDynamicsPool *pool)
+    : m_start_time{start_time}
+    , m_dur{traj_dur}
+    , m_state_len{state_len}
+    , m_ctrl_len{ctrl_len}
+    , m_dt_segment{dt_segment}
+    , m_point_sets{std::move(point_sets)}
+    , m_dyn_fn{dyn_fn}
+    , m_dyn_vals{createDynVals(model, pool)}
+{}
+
+template <typename Scheme>
+DiscreteJointStateTraj
+CollocationTrajExtractor<Scheme>::createCollocationStateTraj()
+{
+    /*
+    Interleave the point sets by segment. The knot points have one more point
+    than the sets within the segments, which gives the final state.
+    */
+    DiscreteJointStateTraj traj;
+    const int nv = m_state_len / 2;
+    const int num_knots = m_point_sets.front().state_vars.size() / m_state_len;
+    for (int k{}; k < num_knots; ++k) {
+        for (std::size_t s{}; s < m_point_sets.size(); ++s) {
+            const PointSet &set = m_point_sets[s];
+            if ((k + 1) * m_state_len > set.state_vars.size()) {
+                continue;
+            }
+            const double time
+                = m_start_time + k * m_dt_segment + set.time_offset;
+            const auto state
+                = set.state_vars.segment(k * m_state_len, m_state_len);
+            const auto dstate_dt
+                = m_dyn_vals[s].segment(k * m_state_len, m_state_len);
+            traj.push_back({.time = time,
+                            .q = state.head(nv),
+                            .dq = state.tail(nv),
+                            .ddq = dstate_dt.tail(nv)});
+        }
+    }
+    return traj;
+}
+
+template <typename Scheme>
+DiscreteJointDataTraj
+CollocationTrajExtractor<Scheme>::createCollocationCtrlTraj()
+{
+    DiscreteJointDataTraj traj;
+    const int num_knots = m_point_sets.front().ctrl_vars.size() / m_ctrl_len;
+    for (int k{}; k < num_knots; ++k) {
+        for (const PointSet &set : m_point_sets) {
+            if ((k + 1) * m_ctrl_len > set.ctrl_vars.size()) {
+                continue;
+            }
+            traj.push_back(
+                {.time = m_start_time + k * m_dt_segment + set.time_offset,
+                 .data = set.ctrl_vars.segment(k * m_ctrl_len, m_ctrl_len)});
+        }
+    }
+    return traj;
+}
+
+template <typename Scheme>
+DiscreteJointStateTraj
+CollocationTrajExtractor<Scheme>::createSampledStateTraj(
+    const double sample_period)
+{
+    return viewSampledStateTraj(sample_period).toTraj();
+}
+
+template <typename Scheme>
+DiscreteJointDataTraj CollocationTrajExtractor<Scheme>::createSampledCtrlTraj(
+    const double sample_period)
+{
+    // create and sample the control spline, with fixed-size vectors for the
+    // common control sizes
+    const int num_samples = getNumSamples(sample_period);
+    return createDataTraj(
+        dispatchSplineDim(m_ctrl_len,
+                          [&](auto dim) -> Eigen::MatrixXd {
+                              constexpr int Dim = decltype(dim)::value;
+                              return getScheme()
+                                  .template createCtrlSpline<Dim>()
+                                  .sampleUniform(m_start_time,
+                                                 sample_period,
+                                                 num_samples);
+                          }),
+        sample_period);
+}
+
+template <typename Scheme>
+SampledStateTrajView CollocationTrajExtractor<Scheme>::viewSampledStateTraj(
+    const double sample_period)
+{
+    // create the state spline, with fixed-size vectors for the common state
+    // sizes, and sample it lazily
+    const int num_samples = getNumSamples(sample_period);
+    return dispatchSplineDim(m_state_len, [&](auto dim) {
+        constexpr int Dim = decltype(dim)::value;
+        using StateSpline
+            = decltype(getScheme().template createStateSpline<Dim>());
+        return SampledStateTrajView(
+            makeStateSampleFn(
+                std::make_shared<const StateSpline>(
+                    getScheme().template createStateSpline<Dim>()),
+                m_state_len),
+            m_start_time,
+            sample_period,
+            num_samples);
+    });
+}
+
+template <typename Scheme>
+DiscreteJointDataTraj CollocationTrajExtractor<Scheme>::createSampledJerkTraj(
+    const double sample_period)
+{
+    // second derivative of the velocities
+    const int num_samples = getNumSamples(sample_period);
+    return createDataTraj(
+        dispatchSplineDim(m_state_len,
+                          [&](auto dim) -> Eigen::MatrixXd {
+                              constexpr int Dim = decltype(dim)::value;
+                              return getScheme()
+                                  .template createStateSpline<Dim>()
+                                  .sampleUniform(m_start_time,
+                                                 sample_period,
+                                                 num_samples,
+                                                 2)
+                                  .bottomRows(m_state_len / 2);
+                          }),
+        sample_period);
+}
+
+template <typename Scheme>
+std::vector<Eigen::VectorXd> CollocationTrajExtractor<Scheme>::createDynVals(
+    const pinocchio::Model &model,
+    KnotDynamicsPool *pool)
+{
+    std::vector<Eigen::VectorXd> dyn_vals;
+    dyn_vals.reserve(m_point_sets.size());
+    for (const PointSet &set : m_point_sets) {
+        Eigen::VectorXd set_dyn_vals(set.state_vars.size());
+        evalKnotDynamics(m_dyn_fn,
+                         model,
+                         set.state_vars,
+                         m_state_len,
+                         set.ctrl_vars,
+                         m_ctrl_len,
+                         m_start_time + set.time_offset,
+                         m_dt_segment,
+                         pool,
+                         set_dyn_vals);
+        dyn_vals.push_back(std::move(set_dyn_vals));
+    }
+    return dyn_vals;
+}
+
+template <typename Scheme>
+int CollocationTrajExtractor<Scheme>::getNumSamples(
+    const double sample_period) const
+{
+    return static_cast<int>(m_dur / sample_period) + 1;
+}
+
+template <typename Scheme>
+DiscreteJointDataTraj CollocationTrajExtractor<Scheme>::createDataTraj(
+    const Eigen::MatrixXd &samples,
+    const double sample_period) const
+{
+    DiscreteJointDataTraj sampled_traj;
+    for (int i{}; i < samples.cols(); ++i) {
+        const double time = i * sample_period + m_start_time;
+        sampled_traj.push_back(
+            JointData{.time = time, .data = samples.col(i)});
+    }
+    return sampled_traj;
+}
+
+template <typename Scheme>
+const Scheme &CollocationTrajExtractor<Scheme>::getScheme() const
+{
+    return static_cast<const Scheme &>(*this);
+}
@@ -0,0 +1,61 @@
+#include "euler_traj_extractor.hpp"
+
+#include <linear_spline.hpp>
+#include <polynomial_spline.hpp>
+
+namespace pin = pinocchio;
+
+EulerTrajExtractor::EulerTrajExtractor(const double start_time,
+                                       const double traj_dur,
+                                       const SolutionView state_vars,
+                                       const int state_len,
+                                       const SolutionView ctrl_vars,
+                                       const int ctrl_len,
+                                       const double dt_segment,
+                                       const pin::Model &model,
+                                       const DynFn &dyn_fn,
+                                       KnotDynamicsPool *pool)
+    : CollocationTrajExtractor(
+          start_time,
+          traj_dur,
+          state_len,
+          ctrl_len,
+          dt_segment,
+          {{.state_vars = state_vars.getValues(),
+            .ctrl_vars = ctrl_vars.getValues(),
+            .time_offset = 0.0}},
+          model,
+          dyn_fn,
+          pool)
+{}
+
+template <int Dim>
+LinearSpline<Dim> EulerTrajExtractor::createStateSpline() const
+{
+    // The slope of segment k is (x_(k+1) - x_k) / dt = f(x_k, u_k, t_k).
+    const PointSet &knots = m_point_sets[0];
+    const int num_state_vecs = knots.state_vars.size() / m_state_len;
+    return LinearSpline<Dim>(
+        typename LinearSpline<Dim>::KnotsMap(
+            knots.state_vars.data(), m_state_len, num_state_vecs),
+        m_start_time,
+        m_dur);
+}
+
+template <int Dim>
+PolynomialSpline<Dim> EulerTrajExtractor::createCtrlSpline() const
+{
+    // zero-order hold of the control of the first knot point of each
+    // segment, the last knot control is the value at the end time
+    using KnotsMap = Eigen::Map<const typename PolynomialSpline<Dim>::Matrix>;
+    const PointSet &knots = m_point_sets[0];
+    const int num_ctrl_vecs = knots.ctrl_vars.size() / m_ctrl_len;
+    const KnotsMap ctrls(knots.ctrl_vars.data(), m_ctrl_len, num_ctrl_vecs);
+    return PolynomialSpline<Dim>(ctrls.leftCols(num_ctrl_vecs - 1),
+                                 1,
+                                 ctrls.col(num_ctrl_vecs - 1),
+                                 uniformKnotTimes(
+                                     num_ctrl_vecs, m_start_time, m_dur));
+}
+
+template class CollocationTrajExtractor<EulerTrajExtractor>;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <traj_element.hpp>
+
+#include "collocation_traj_extractor.hpp"
+#include "pinocchio/multibody/model.hpp"
+
+template <int Dim>
+class LinearSpline;
+
+// Takes a solution discretized with the explicit Euler method, eg. of the
+// BoxDdpSolver, and outputs trajectories with different discretization that
+// are consistent with it:
+//   x_(k+1) = x_k + dt * f(x_k, u_k, t_k)
+// The states are linear in time within a segment, with the time derivative of
+// its first knot point, and the controls are held over a segment.
+class EulerTrajExtractor : public CollocationTrajExtractor<EulerTrajExtractor>
+{
+public:
+    // The solution vectors are viewed, not copied, so they must outlive the
+    // extractor (temporaries do not compile, see SolutionView). The dynamics
+    // at the knot points are evaluated on the threads of the pool, if any
+    // (see CollocationTrajExtractor).
+    EulerTrajExtractor(const double start_time,
+                       const double traj_dur,
+                       const SolutionView state_vars,
+                       const int state_len,
+                       const SolutionView ctrl_vars,
+                       const int ctrl_len,
+                       const double dt_segment,
+                       const pinocchio::Model &model,
+                       const DynFn &dyn_fn,
+                       KnotDynamicsPool *pool = nullptr);
+
+private:
+    friend class CollocationTrajExtractor<EulerTrajExtractor>;
+
+    // Interpolants of the scheme, Dim is the state or control size, or
+    // Eigen::Dynamic (see dispatchSplineDim()). The states are linear
+    // through the knot states, so [dq; ddq] is the dynamics at the first knot
+    // point of each segment, and the controls are piecewise constant.
+    template <int Dim>
+    LinearSpline<Dim> createStateSpline() const;
+    template <int Dim>
+    PolynomialSpline<Dim> createCtrlSpline() const;
+};
+
+extern template class CollocationTrajExtractor<EulerTrajExtractor>;
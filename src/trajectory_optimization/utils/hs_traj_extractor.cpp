@@ -8,254 +8,93 @@ namespace pin = pinocchio;
 HermSimpTrajExtractor::HermSimpTrajExtractor(
     const double start_time,
     const double traj_dur,
-    const Eigen::VectorXd &state_vars,
-    const Eigen::VectorXd &state_mid_vars,
+    const SolutionView state_vars,
+    const SolutionView state_mid_vars,
     const int state_len,
-    const Eigen::VectorXd &ctrl_vars,
-    const Eigen::VectorXd &ctrl_mid_vars,
+    const SolutionView ctrl_vars,
+    const SolutionView ctrl_mid_vars,
     const int ctrl_len,
     const double dt_segment,
     const pin::Model &model,
-    const DynFn &dyn_fn)
-    : m_start_time{start_time}
-    , m_dur{traj_dur}
-    , m_state_vars{state_vars}
-    , m_state_mid_vars{state_mid_vars}
-    , m_state_len{state_len}
-    , m_ctrl_vars{ctrl_vars}
-    , m_ctrl_mid_vars{ctrl_mid_vars}
-    , m_ctrl_len{ctrl_len}
-    , m_dt_segment{dt_segment}
-    , m_dyn_fn{dyn_fn}
-    , m_dyn_vals{createDynVals(model)}
-    , m_dyn_mid_vals{createDynMidVals(model)}
+    const DynFn &dyn_fn,
+    KnotDynamicsPool *pool)
+    : CollocationTrajExtractor(
+          start_time,
+          traj_dur,
+          state_len,
+          ctrl_len,
+          dt_segment,
+          // the midpoints are half a segment after the knot points
+          {{.state_vars = state_vars.getValues(),
+            .ctrl_vars = ctrl_vars.getValues(),
+            .time_offset = 0.0},
+           {.state_vars = state_mid_vars.getValues(),
+            .ctrl_vars = ctrl_mid_vars.getValues(),
+            .time_offset = 0.5 * dt_segment}},
+          model,
+          dyn_fn,
+          pool)
 {}
 
-DiscreteJointStateTraj HermSimpTrajExtractor::createCollocationStateTraj(
-    const pin::Model &model)
-{
-    /*
-    Loop through the state and midpoint state variables,
-    but handle the last state variable outside the loop.
-    This is because there is one less midpoint state variable
-    compared to the state variables at the knot points.
-    */
-    DiscreteJointStateTraj traj;
-    const int num_segments = m_state_mid_vars.size() / m_state_len;
-
-    for (int k{}; k < num_segments; ++k) {
-        const double tk = m_start_time + k * m_dt_segment;
-        const double tmid = tk + 0.5 * m_dt_segment;
-
-        const Eigen::VectorXd state_k
-            = m_state_vars(Eigen::seqN(k * m_state_len, m_state_len));
-        const Eigen::VectorXd dyn_k
-            = m_dyn_vals(Eigen::seqN(k * m_state_len, m_state_len));
-        traj.push_back(
-            {.time = tk,
-             .q = state_k(Eigen::seqN(0, m_state_len / 2)),
-             .dq = state_k(Eigen::seqN(m_state_len / 2, m_state_len / 2)),
-             .ddq = dyn_k(Eigen::seqN(m_state_len / 2, m_state_len / 2))});
-
-        const Eigen::VectorXd state_mid
-            = m_state_mid_vars(Eigen::seqN(k * m_state_len, m_state_len));
-        const Eigen::VectorXd dyn_mid
-            = m_dyn_mid_vals(Eigen::seqN(k * m_state_len, m_state_len));
-        traj.push_back(
-            {.time = tmid,
-             .q = state_mid(Eigen::seqN(0, m_state_len / 2)),
-             .dq = state_mid(Eigen::seqN(m_state_len / 2, m_state_len / 2)),
-             .ddq = dyn_mid(Eigen::seqN(m_state_len / 2, m_state_len / 2))});
-    }
-
-    const double tf = m_start_time + num_segments * m_dt_segment;
-    const Eigen::VectorXd state_f
-        = m_state_vars(Eigen::seqN(num_segments * m_state_len, m_state_len));
-    const Eigen::VectorXd dyn_f
-        = m_dyn_vals(Eigen::seqN(num_segments * m_state_len, m_state_len));
-    traj.push_back(
-        {.time = tf,
-         .q = state_f(Eigen::seqN(0, m_state_len / 2)),
-         .dq = state_f(Eigen::seqN(m_state_len / 2, m_state_len / 2)),
-         .ddq = dyn_f(Eigen::seqN(m_state_len / 2, m_state_len / 2))});
-
-    return traj;
-}
-
-DiscreteJointDataTraj HermSimpTrajExtractor::createCollocationCtrlTraj(
-    const pinocchio::Model &model)
-{
-    /*
-    Loop through the state and midpoint state variables,
-    but handle the last state variable outside the loop.
-    This is because there is one less midpoint state variable
-    compared to the state variables at the knot points.
-    */
-    DiscreteJointDataTraj traj;
-    const int num_segments = m_ctrl_mid_vars.size() / m_ctrl_len;
-
-    for (int k{}; k < num_segments; ++k) {
-        const double tk = m_start_time + k * m_dt_segment;
-        const double tmid = tk + 0.5 * m_dt_segment;
-
-        const Eigen::VectorXd ctrl_k
-            = m_ctrl_vars(Eigen::seqN(k * m_ctrl_len, m_ctrl_len));
-        const Eigen::VectorXd ctrl_mid
-            = m_ctrl_mid_vars(Eigen::seqN(k * m_ctrl_len, m_ctrl_len));
-
-        traj.push_back({.time = tk, .data = ctrl_k});
-        traj.push_back({.time = tmid, .data = ctrl_mid});
-    }
-
-    const double tf = m_start_time + num_segments * m_dt_segment;
-    const Eigen::VectorXd ctrl_f
-        = m_ctrl_vars(Eigen::seqN(num_segments * m_ctrl_len, m_ctrl_len));
-    traj.push_back({.time = tf, .data = ctrl_f});
-
-    return traj;
-}
-
-DiscreteJointStateTraj HermSimpTrajExtractor::createSampledStateTraj(
-    const double sample_period)
-{
-    // create quadratic spline
-    const CubicSpline state_spline = createStateSpline();
-
-    const QuadraticSpline dyn_spline = createDynSpline();
-
-    // create sample trajectory
-    return createDiscreteJointStateTraj(sample_period,
-                                        state_spline,
-                                        dyn_spline);
-}
-
-DiscreteJointDataTraj HermSimpTrajExtractor::createSampledCtrlTraj(
-    const double sample_period)
-{
-    std::vector<Eigen::VectorXd> ctrl_knot_vals;
-    std::vector<Eigen::VectorXd> ctrl_mid_vals;
-
-    const int num_ctrl_knots = m_ctrl_vars.size() / m_ctrl_len;
-    const int num_ctrl_mids = m_ctrl_mid_vars.size() / m_ctrl_len;
-
-    for (int i{}; i < num_ctrl_knots; ++i) {
-        ctrl_knot_vals.push_back(
-            m_ctrl_vars(Eigen::seqN(i * m_ctrl_len, m_ctrl_len)));
-    }
-
-    for (int i{}; i < num_ctrl_mids; ++i) {
-        ctrl_mid_vals.push_back(
-            m_ctrl_mid_vars(Eigen::seqN(i * m_ctrl_len, m_ctrl_len)));
-    }
-
-    const QuadraticSpline ctrl_spline(ctrl_knot_vals,
-                                      ctrl_mid_vals,
-                                      QuadraticSpline::ConstraintType::Midpoint,
-                                      m_start_time,
-                                      m_dur);
-
-    DiscreteJointDataTraj sampled_traj;
-    const int num_samples = static_cast<int>(m_dur / sample_period) + 1;
-    for (int i{}; i < num_samples; ++i) {
-        const double time = i * sample_period + m_start_time;
-        sampled_traj.push_back(
-            JointData{.time = time, .data = ctrl_spline.getValue(time)});
-    }
-    return sampled_traj;
-}
-
-CubicSpline HermSimpTrajExtractor::createStateSpline()
-{
-    std::vector<Eigen::VectorXd> state_vals;
-    std::vector<Eigen::VectorXd> state_grad_vals;
-    const int num_state_vecs = m_state_vars.size() / m_state_len;
-    for (int i = 0; i < num_state_vecs; ++i) {
-        state_vals.push_back(
-            m_state_vars(Eigen::seqN(i * m_state_len, m_state_len)));
-        state_grad_vals.push_back(
-            m_dyn_vals(Eigen::seqN(i * m_state_len, m_state_len)));
-    }
-
-    return CubicSpline(state_vals, state_grad_vals, m_start_time, m_dur);
-}
-
-QuadraticSpline HermSimpTrajExtractor::createDynSpline()
-{
-    std::vector<Eigen::VectorXd> dyn_knot_vals;
-    std::vector<Eigen::VectorXd> dyn_mid_vals;
-    const int num_segments = m_state_mid_vars.size() / m_state_len;
-
-    for (int k{}; k < num_segments + 1; ++k) {
-        dyn_knot_vals.push_back(
-            m_dyn_vals(Eigen::seqN(k * m_state_len, m_state_len)));
-    }
-
-    for (int k{}; k < num_segments; ++k) {
-        dyn_mid_vals.push_back(
-            m_dyn_mid_vals(Eigen::seqN(k * m_state_len, m_state_len)));
-    }
-
-    return QuadraticSpline(dyn_knot_vals,
-                           dyn_mid_vals,
-                           QuadraticSpline::ConstraintType::Midpoint,
-                           m_start_time,
-                           m_dur);
-}
+HermSimpTrajExtractor::HermSimpTrajExtractor(
+    const double start_time,
+    const double traj_dur,
+    const SolutionView state_vars,
+    const SolutionView state_mid_vars,
+    const int state_len,
+    const SolutionView ctrl_vars,
+    const SolutionView ctrl_mid_vars,
+    const int ctrl_len,
+    const pin::Model &model,
+    const DynFn &dyn_fn,
+    KnotDynamicsPool *pool)
+    : HermSimpTrajExtractor(start_time,
+                            traj_dur,
+                            state_vars,
+                            state_mid_vars,
+                            state_len,
+                            ctrl_vars,
+                            ctrl_mid_vars,
+                            ctrl_len,
+                            traj_dur
+                                / (state_mid_vars.getValues().size()
+                                   / state_len),
+                            model,
+                            dyn_fn,
+                            pool)
+{}
 
-DiscreteJointStateTraj HermSimpTrajExtractor::createDiscreteJointStateTraj(
-    const double sample_period,
-    const CubicSpline &state_spline,
-    const QuadraticSpline &dyn_spline)
+template <int Dim>
+CubicSpline<Dim> HermSimpTrajExtractor::createStateSpline() const
 {
-    DiscreteJointStateTraj sample_traj;
-    const int num_samples = static_cast<int>(m_dur / sample_period) + 1;
-    for (int i{}; i < num_samples; ++i) {
-        const double time = i * sample_period + m_start_time;
-        const Eigen::VectorXd state = state_spline.getValue(time);
-        const Eigen::VectorXd dstate_dt = dyn_spline.getValue(time);
-        sample_traj.push_back(
-            {.time = time,
-             .q = state(Eigen::seqN(0, state.size() / 2)),
-             .dq = state(Eigen::seqN(state.size() / 2, state.size() / 2)),
-             .ddq
-             = dstate_dt(Eigen::seqN(state.size() / 2, state.size() / 2))});
-    }
-    return sample_traj;
+    // The derivative of the spline of [q; dq] gives [dq; ddq]. Where the
+    // Hermite-Simpson defects are zero, ddq is the quadratic interpolation of
+    // the accelerations at the knot points and the midpoints.
+    // Views of the stacked states and their time derivatives, one per column.
+    using KnotsMap = typename CubicSpline<Dim>::KnotsMap;
+    const PointSet &knots = m_point_sets[0];
+    const int num_state_vecs = knots.state_vars.size() / m_state_len;
+    return CubicSpline<Dim>(
+        KnotsMap(knots.state_vars.data(), m_state_len, num_state_vecs),
+        KnotsMap(m_dyn_vals[0].data(), m_state_len, num_state_vecs),
+        m_start_time,
+        m_dur);
 }
 
-Eigen::VectorXd HermSimpTrajExtractor::createDynVals(const pin::Model &model)
+template <int Dim>
+QuadraticSpline<Dim> HermSimpTrajExtractor::createCtrlSpline() const
 {
-    Eigen::VectorXd dyn_vals = Eigen::VectorXd::Zero(m_state_vars.size());
-    const int num_state_vecs = m_state_vars.size() / m_state_len;
-    for (int i{}; i < num_state_vecs; ++i) {
-        const Eigen::VectorXd state
-            = m_state_vars(Eigen::seqN(i * m_state_len, m_state_len));
-        const Eigen::VectorXd ctrl
-            = m_ctrl_vars(Eigen::seqN(i * m_ctrl_len, m_ctrl_len));
-        const double time = i * m_dt_segment;
-        dyn_vals(Eigen::seqN(i * m_state_len, m_state_len))
-            = m_dyn_fn(state, ctrl, time, model);
-    }
-    return dyn_vals;
+    using KnotsMap = typename QuadraticSpline<Dim>::KnotsMap;
+    const PointSet &knots = m_point_sets[0];
+    const PointSet &mids = m_point_sets[1];
+    const int num_ctrl_knots = knots.ctrl_vars.size() / m_ctrl_len;
+    const int num_ctrl_mids = mids.ctrl_vars.size() / m_ctrl_len;
+    return QuadraticSpline<Dim>(
+        KnotsMap(knots.ctrl_vars.data(), m_ctrl_len, num_ctrl_knots),
+        KnotsMap(mids.ctrl_vars.data(), m_ctrl_len, num_ctrl_mids),
+        QuadraticConstraintType::Midpoint,
+        m_start_time,
+        m_dur);
 }
 
-Eigen::VectorXd HermSimpTrajExtractor::createDynMidVals(const pin::Model &model)
-{
-    Eigen::VectorXd dyn_mid_vals
-        = Eigen::VectorXd::Zero(m_state_mid_vars.size());
-    const int num_state_mid_vecs = m_state_mid_vars.size() / m_state_len;
-
-    for (int i{}; i < num_state_mid_vecs; ++i) {
-        const Eigen::VectorXd state_mid
-            = m_state_mid_vars(Eigen::seqN(i * m_state_len, m_state_len));
-        const Eigen::VectorXd ctrl_mid
-            = m_ctrl_mid_vars(Eigen::seqN(i * m_ctrl_len, m_ctrl_len));
-        const double time
-            = m_start_time + (static_cast<double>(i) + 0.5) * m_dt_segment;
-
-        dyn_mid_vals(Eigen::seqN(i * m_state_len, m_state_len))
-            = m_dyn_fn(state_mid, ctrl_mid, time, model);
-    }
-
-    return dyn_mid_vals;
-}
+template class CollocationTrajExtractor<HermSimpTrajExtractor>;
@@ -3,68 +3,62 @@
 #include <Eigen/Dense>
 #include <traj_element.hpp>
 
+#include "collocation_traj_extractor.hpp"
 #include "pinocchio/multibody/model.hpp"
 
-class QuadraticSpline;
+template <int Dim>
 class CubicSpline;
+template <int Dim>
+class QuadraticSpline;
 
 // Takes a Hermite-Simpson collocation solution and outputs trajectories with
 // different discretization based on interpolating splines.
 class HermSimpTrajExtractor
+    : public CollocationTrajExtractor<HermSimpTrajExtractor>
 {
 public:
-    // calback signature for evaluating the dynamics
-    using DynFn = std::function<Eigen::VectorXd(const Eigen::VectorXd &state,
-                                                const Eigen::VectorXd &control,
-                                                const double time,
-                                                const pinocchio::Model &model)>;
-
+    // The solution vectors are viewed, not copied, so they must outlive the
+    // extractor (temporaries do not compile, see SolutionView). The dynamics
+    // at the knot points are evaluated on the threads of the pool, if any
+    // (see CollocationTrajExtractor).
     HermSimpTrajExtractor(const double start_time,
-                             const double traj_dur,
-                             const Eigen::VectorXd &state_vars,
-                             const Eigen::VectorXd &state_mid_vars,
-                             const int state_len,
-                             const Eigen::VectorXd &ctrl_vars,
-                             const Eigen::VectorXd &ctrl_mid_vars,
-                             const int ctrl_len,
-                             const double dt_segment,
-                             const pinocchio::Model &model,
-                             const DynFn &dyn_fn);
+                          const double traj_dur,
+                          const SolutionView state_vars,
+                          const SolutionView state_mid_vars,
+                          const int state_len,
+                          const SolutionView ctrl_vars,
+                          const SolutionView ctrl_mid_vars,
+                          const int ctrl_len,
+                          const double dt_segment,
+                          const pinocchio::Model &model,
+                          const DynFn &dyn_fn,
+                          KnotDynamicsPool *pool = nullptr);
 
-    // Get collocation traj. This is equivalent to the NLP solution without any
-    // post processing (no use of splines or interpolation).
-    DiscreteJointStateTraj createCollocationStateTraj(
-        const pinocchio::Model &model);
-    DiscreteJointDataTraj createCollocationCtrlTraj(
-        const pinocchio::Model &model);
-
-    // Formed by first creating splines from the NLP solution and then
-    // interpolating based on the sample period.
-    DiscreteJointStateTraj createSampledStateTraj(const double sample_period);
-    DiscreteJointDataTraj createSampledCtrlTraj(const double sample_period);
+    // Same as above, but the segments have equal durations derived from the
+    // (eg. optimized) duration of the trajectory.
+    HermSimpTrajExtractor(const double start_time,
+                          const double traj_dur,
+                          const SolutionView state_vars,
+                          const SolutionView state_mid_vars,
+                          const int state_len,
+                          const SolutionView ctrl_vars,
+                          const SolutionView ctrl_mid_vars,
+                          const int ctrl_len,
+                          const pinocchio::Model &model,
+                          const DynFn &dyn_fn,
+                          KnotDynamicsPool *pool = nullptr);
 
 private:
-    Eigen::VectorXd createDynVals(const pinocchio::Model &model);
-    Eigen::VectorXd createDynMidVals(const pinocchio::Model &model);
-    CubicSpline createStateSpline();
-    QuadraticSpline createDynSpline();
-
-    DiscreteJointStateTraj createDiscreteJointStateTraj(
-        const double sample_period,
-        const CubicSpline &state_spline,
-        const QuadraticSpline &dstate_dt_spline);
+    friend class CollocationTrajExtractor<HermSimpTrajExtractor>;
 
-    const double m_start_time;
-    const double m_dur;
-    const Eigen::VectorXd m_state_vars;
-    const int m_state_len;
-    const Eigen::VectorXd m_ctrl_vars;
-    const int m_ctrl_len;
-    const double m_dt_segment;
-    const DynFn m_dyn_fn;
+    // Interpolants of the scheme, Dim is the state or control size, or
+    // Eigen::Dynamic (see dispatchSplineDim()). The states are cubic through
+    // the knot states and their dynamics, and the controls quadratic through
+    // the knot and midpoint controls.
+    template <int Dim>
+    CubicSpline<Dim> createStateSpline() const;
+    template <int Dim>
+    QuadraticSpline<Dim> createCtrlSpline() const;
+};
 
-    const Eigen::VectorXd m_dyn_vals;
-    const Eigen::VectorXd m_state_mid_vars;
-    const Eigen::VectorXd m_ctrl_mid_vars;
-    const Eigen::VectorXd m_dyn_mid_vals;
-};
\ No newline at end of file
+extern template class CollocationTrajExtractor<HermSimpTrajExtractor>;
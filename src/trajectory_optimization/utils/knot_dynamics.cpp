@@ -0,0 +1,169 @@
+#include "knot_dynamics.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace pin = pinocchio;
+
+namespace
+{
+    int getPoolSize(const int num_threads)
+    {
+        if (num_threads > 0) {
+            return num_threads;
+        }
+        const int hw_threads
+            = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, hw_threads);
+    }
+}
+
+KnotDynamicsPool::KnotDynamicsPool(const pin::Model &model,
+                                   const int num_threads)
+    : m_model{model}
+{
+    const int pool_size = getPoolSize(num_threads);
+    m_workspaces.reserve(pool_size);
+    for (int t{}; t < pool_size; ++t) {
+        m_workspaces.emplace_back(model);
+    }
+    m_threads.reserve(pool_size - 1);
+    for (int t = 1; t < pool_size; ++t) {
+        m_threads.emplace_back(&KnotDynamicsPool::work, this, t);
+    }
+}
+
+KnotDynamicsPool::~KnotDynamicsPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start_cv.notify_all();
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+}
+
+const pin::Model &KnotDynamicsPool::getModel() const
+{
+    return m_model;
+}
+
+int KnotDynamicsPool::getNumThreads() const
+{
+    return static_cast<int>(m_workspaces.size());
+}
+
+void KnotDynamicsPool::run(const Task &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_num_pending = static_cast<int>(m_threads.size());
+        m_error = nullptr;
+        ++m_generation;
+    }
+    m_start_cv.notify_all();
+
+    std::exception_ptr error;
+    try {
+        task(0, m_workspaces[0]);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_num_pending == 0; });
+    m_task = nullptr;
+    if (!error) {
+        error = m_error;
+    }
+    lock.unlock();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void KnotDynamicsPool::work(const int thread_idx)
+{
+    long generation{};
+    while (true) {
+        const Task *task{};
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cv.wait(lock, [&] {
+                return m_stop || m_generation != generation;
+            });
+            if (m_stop) {
+                return;
+            }
+            generation = m_generation;
+            task = m_task;
+        }
+
+        std::exception_ptr error;
+        try {
+            (*task)(thread_idx, m_workspaces[thread_idx]);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (error && !m_error) {
+                m_error = error;
+            }
+            --m_num_pending;
+        }
+        m_done_cv.notify_one();
+    }
+}
+
+void evalKnotDynamics(const KnotDynFn &dyn_fn,
+                      const pin::Model &model,
+                      const Eigen::Ref<const Eigen::VectorXd> &state_vars,
+                      const int state_len,
+                      const Eigen::Ref<const Eigen::VectorXd> &ctrl_vars,
+                      const int ctrl_len,
+                      const double first_time,
+                      const double dt_segment,
+                      KnotDynamicsPool *pool,
+                      Eigen::Ref<Eigen::VectorXd> dyn_vals)
+{
+    assert(dyn_vals.size() == state_vars.size());
+    assert(pool == nullptr || &pool->getModel() == &model);
+    const int num_knots = state_vars.size() / state_len;
+    const int num_threads = (pool != nullptr) ? pool->getNumThreads() : 1;
+
+    // Each thread takes a contiguous range of knots, so the threads write
+    // separate parts of the output.
+    const auto eval_knots = [&](const int thread_idx, DynamicsWorkspace &ws) {
+        const int first_knot = thread_idx * num_knots / num_threads;
+        const int end_knot = (thread_idx + 1) * num_knots / num_threads;
+        if (first_knot == end_knot) {
+            return;
+        }
+        Eigen::VectorXd state(state_len);
+        Eigen::VectorXd ctrl(ctrl_len);
+        for (int k = first_knot; k < end_knot; ++k) {
+            state = state_vars.segment(k * state_len, state_len);
+            ctrl = ctrl_vars.segment(k * ctrl_len, ctrl_len);
+            dyn_fn(state,
+                   ctrl,
+                   first_time + k * dt_segment,
+                   model,
+                   ws,
+                   dyn_vals.segment(k * state_len, state_len));
+        }
+    };
+
+    if (pool == nullptr) {
+        DynamicsWorkspace ws(model);
+        eval_knots(0, ws);
+        return;
+    }
+    pool->run(eval_knots);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "pinocchio/multibody/model.hpp"
+#include "robot_dynamics.hpp"
+
+/*
+ * Signature for evaluating the dynamics at a knot point into dx, with the
+ * workspace of the calling thread, eg. computeDyn(). It is called from
+ * several threads at once, so it must not modify shared state.
+ */
+using KnotDynFn = std::function<void(const Eigen::VectorXd &state,
+                                     const Eigen::VectorXd &control,
+                                     const double time,
+                                     const pinocchio::Model &model,
+                                     DynamicsWorkspace &ws,
+                                     Eigen::Ref<Eigen::VectorXd> dx)>;
+
+/*
+ * Adapts a dynamics function that returns dx and manages its own data, eg.
+ * dyn(), to a KnotDynFn.
+ */
+template <typename Fn>
+KnotDynFn toKnotDynFn(Fn dyn_fn)
+{
+    return [dyn_fn](const Eigen::VectorXd &state,
+                    const Eigen::VectorXd &control,
+                    const double time,
+                    const pinocchio::Model &model,
+                    DynamicsWorkspace & /*ws*/,
+                    Eigen::Ref<Eigen::VectorXd> dx) {
+        dx = dyn_fn(state, control, time, model);
+    };
+}
+
+/*
+ * Threads with a dynamics workspace each, which are started once and reused
+ * for every evaluation, eg. when the extractors of a batch of solved
+ * trajectories share a pool. The pool is owned by the caller and must
+ * outlive its users. It is not thread safe, so one evaluation runs at a time.
+ */
+class KnotDynamicsPool
+{
+public:
+    using Task = std::function<void(const int thread_idx,
+                                    DynamicsWorkspace &ws)>;
+
+    /*
+     * @param num_threads Number of threads including the calling one, or
+     *   zero for the number of hardware threads.
+     */
+    KnotDynamicsPool(const pinocchio::Model &model, const int num_threads);
+
+    KnotDynamicsPool(const KnotDynamicsPool &) = delete;
+    KnotDynamicsPool &operator=(const KnotDynamicsPool &) = delete;
+
+    ~KnotDynamicsPool();
+
+    const pinocchio::Model &getModel() const;
+
+    int getNumThreads() const;
+
+    /*
+     * Run the task once on every thread, the calling one with index zero,
+     * and wait until all of them are done. An exception of a task is
+     * rethrown here.
+     */
+    void run(const Task &task);
+
+private:
+    void work(const int thread_idx);
+
+    const pinocchio::Model &m_model;
+    std::vector<DynamicsWorkspace> m_workspaces;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv;
+    std::condition_variable m_done_cv;
+    const Task *m_task{};
+    long m_generation{};
+    int m_num_pending{};
+    bool m_stop{};
+    std::exception_ptr m_error;
+};
+
+/*
+ * Evaluate the dynamics at the stacked states and controls of the knot
+ * points, and write them directly into the stacked output. Without a pool
+ * the knots are evaluated on the calling thread. With a pool they are
+ * independent, so they are split between its threads, each with its own
+ * workspace.
+ *
+ * @param first_time Time of the first knot point, passed to dyn_fn.
+ * @param dt_segment Time between the knot points.
+ * @param pool Threads of the evaluation, or null for the calling thread. It
+ *   must be created for the same model.
+ * @param dyn_vals Output, stacked dynamics of the same size as state_vars.
+ */
+void evalKnotDynamics(const KnotDynFn &dyn_fn,
+                      const pinocchio::Model &model,
+                      const Eigen::Ref<const Eigen::VectorXd> &state_vars,
+                      const int state_len,
+                      const Eigen::Ref<const Eigen::VectorXd> &ctrl_vars,
+                      const int ctrl_len,
+                      const double first_time,
+                      const double dt_segment,
+                      KnotDynamicsPool *pool,
+                      Eigen::Ref<Eigen::VectorXd> dyn_vals);
@@ -0,0 +1,138 @@
+#include "reduced_model.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+#include "pinocchio/algorithm/model.hpp"
+#include "pinocchio/algorithm/rnea.hpp"
+
+namespace pin = pinocchio;
+
+namespace
+{
+    // Expand a state of the reduced model into full_e, which keeps its
+    // storage if it already has the sizes of the full model.
+    void expandState(const Eigen::VectorXd &full_q_ref,
+                     const int full_nv,
+                     const std::vector<int> &q_indices,
+                     const std::vector<int> &v_indices,
+                     const JointState &e,
+                     JointState &full_e)
+    {
+        full_e.time = e.time;
+        full_e.q = full_q_ref;
+        full_e.dq.setZero(full_nv);
+        full_e.ddq.setZero(full_nv);
+        full_e.q(q_indices) = e.q;
+        full_e.dq(v_indices) = e.dq;
+        full_e.ddq(v_indices) = e.ddq;
+    }
+}
+
+ReducedModel buildLockedJointsModel(
+    const pin::Model &full_model,
+    const std::vector<std::string> &locked_joints,
+    const Eigen::VectorXd &full_q_ref)
+{
+    if (full_q_ref.size() != full_model.nq) {
+        throw std::invalid_argument(
+            "buildLockedJointsModel. The reference configuration must have "
+            "the size of the full configuration.");
+    }
+    std::vector<pin::JointIndex> locked_ids;
+    for (const std::string &name : locked_joints) {
+        if (!full_model.existJointName(name)) {
+            throw std::invalid_argument(
+                "buildLockedJointsModel. No joint named " + name);
+        }
+        locked_ids.push_back(full_model.getJointId(name));
+    }
+
+    pin::Model model
+        = pin::buildReducedModel(full_model, locked_ids, full_q_ref);
+    std::vector<int> q_indices(model.nq);
+    std::vector<int> v_indices(model.nv);
+    // joint 0 is the universe, which has no configuration
+    for (int j = 1; j < model.njoints; ++j) {
+        const pin::JointIndex full_id = full_model.getJointId(model.names[j]);
+        for (int i{}; i < model.nqs[j]; ++i) {
+            q_indices[model.idx_qs[j] + i] = full_model.idx_qs[full_id] + i;
+        }
+        for (int i{}; i < model.nvs[j]; ++i) {
+            v_indices[model.idx_vs[j] + i] = full_model.idx_vs[full_id] + i;
+        }
+    }
+    return ReducedModel{.model = std::move(model),
+                        .full_q_ref = full_q_ref,
+                        .full_nv = full_model.nv,
+                        .q_indices = std::move(q_indices),
+                        .v_indices = std::move(v_indices)};
+}
+
+Eigen::VectorXd reduceState(const ReducedModel &reduced,
+                            const Eigen::VectorXd &full_state)
+{
+    assert(full_state.size() == reduced.full_q_ref.size() + reduced.full_nv);
+    const auto full_q = full_state.head(reduced.full_q_ref.size());
+    const auto full_v = full_state.tail(reduced.full_nv);
+    Eigen::VectorXd state(reduced.model.nq + reduced.model.nv);
+    state.head(reduced.model.nq) = full_q(reduced.q_indices);
+    state.tail(reduced.model.nv) = full_v(reduced.v_indices);
+    return state;
+}
+
+DiscreteJointStateTraj expandStateTraj(const ReducedModel &reduced,
+                                       const DiscreteJointStateTraj &traj)
+{
+    DiscreteJointStateTraj full_traj;
+    for (const JointState &e : traj) {
+        JointState full_e;
+        expandState(reduced.full_q_ref,
+                    reduced.full_nv,
+                    reduced.q_indices,
+                    reduced.v_indices,
+                    e,
+                    full_e);
+        full_traj.push_back(std::move(full_e));
+    }
+    return full_traj;
+}
+
+SampledStateTrajView expandStateTraj(const ReducedModel &reduced,
+                                     const SampledStateTrajView &traj)
+{
+    return traj.transform([full_q_ref = reduced.full_q_ref,
+                           full_nv = reduced.full_nv,
+                           q_indices = reduced.q_indices,
+                           v_indices = reduced.v_indices](
+                              const JointState &e, JointState &full_e) {
+        expandState(full_q_ref, full_nv, q_indices, v_indices, e, full_e);
+    });
+}
+
+DiscreteJointDataTraj expandCtrlTraj(
+    const ReducedModel &reduced,
+    const pin::Model &full_model,
+    const DiscreteJointStateTraj &full_state_traj,
+    const DiscreteJointDataTraj &ctrl_traj)
+{
+    if (full_state_traj.size() != ctrl_traj.size()) {
+        throw std::invalid_argument(
+            "expandCtrlTraj. The state and control trajectories must have the "
+            "same time points.");
+    }
+    pin::Data data(full_model);
+    DiscreteJointDataTraj full_traj;
+    for (std::size_t i{}; i < ctrl_traj.size(); ++i) {
+        const JointState &s = full_state_traj[i];
+        // holding torques of the locked joints, and the optimized torques of
+        // the other joints
+        JointData full_e{.time = ctrl_traj[i].time,
+                         .data = pin::rnea(full_model, data, s.q, s.dq, s.ddq)};
+        full_e.data(reduced.v_indices) = ctrl_traj[i].data;
+        full_traj.push_back(std::move(full_e));
+    }
+    return full_traj;
+}
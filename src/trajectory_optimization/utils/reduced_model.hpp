@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "pinocchio/multibody/model.hpp"
+#include "sampled_state_traj_view.hpp"
+#include "traj_element.hpp"
+
+// A model with some joints locked at fixed positions (eg. the gripper during
+// a move), and the maps between the reduced and the full model. The states
+// of both models have the layout [q; v].
+struct ReducedModel
+{
+    pinocchio::Model model;
+    // configuration of the full model, with the locked joints at their fixed
+    // positions
+    Eigen::VectorXd full_q_ref;
+    // number of velocity elements of the full model
+    int full_nv{};
+    // index in the full model of each configuration and velocity element of
+    // the reduced model
+    std::vector<int> q_indices;
+    std::vector<int> v_indices;
+};
+
+/*
+ * Build a reduced model with pinocchio::buildReducedModel().
+ *
+ * @param locked_joints Names of the joints to lock.
+ * @param full_q_ref Configuration of the full model, which sets the positions
+ *   of the locked joints.
+ */
+ReducedModel buildLockedJointsModel(
+    const pinocchio::Model &full_model,
+    const std::vector<std::string> &locked_joints,
+    const Eigen::VectorXd &full_q_ref);
+
+// Select the elements of a state of the full model that belong to the reduced
+// model.
+Eigen::VectorXd reduceState(const ReducedModel &reduced,
+                            const Eigen::VectorXd &full_state);
+
+/*
+ * Expand a state trajectory of the reduced model to the full model. The
+ * locked joints are at their fixed positions with zero velocity and
+ * acceleration.
+ */
+DiscreteJointStateTraj expandStateTraj(const ReducedModel &reduced,
+                                       const DiscreteJointStateTraj &traj);
+
+// Same as above, but lazily while iterating the view, so a consumer that
+// streams the samples does not store them. The view copies the maps of the
+// reduced model.
+SampledStateTrajView expandStateTraj(const ReducedModel &reduced,
+                                     const SampledStateTrajView &traj);
+
+/*
+ * Expand a control (joint torque) trajectory of the reduced model to the full
+ * model. The torques of the locked joints are the ones that hold them in
+ * place, from the inverse dynamics of the full model.
+ *
+ * @param full_state_traj State trajectory of the full model at the same time
+ *   points as the control trajectory, eg. from expandStateTraj().
+ */
+DiscreteJointDataTraj expandCtrlTraj(
+    const ReducedModel &reduced,
+    const pinocchio::Model &full_model,
+    const DiscreteJointStateTraj &full_state_traj,
+    const DiscreteJointDataTraj &ctrl_traj);
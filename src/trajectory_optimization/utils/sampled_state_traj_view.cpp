@@ -0,0 +1,102 @@
+#include "sampled_state_traj_view.hpp"
+
+#include <utility>
+
+SampledStateTrajView::Iterator::Iterator(SampleFn sample_fn,
+                                         const double start_time,
+                                         const double sample_period,
+                                         const int num_samples)
+    : m_sample_fn{std::move(sample_fn)}
+    , m_start_time{start_time}
+    , m_sample_period{sample_period}
+    , m_num_samples{num_samples}
+{
+    sample();
+}
+
+const JointState &SampledStateTrajView::Iterator::operator*() const
+{
+    return m_sample;
+}
+
+const JointState *SampledStateTrajView::Iterator::operator->() const
+{
+    return &m_sample;
+}
+
+SampledStateTrajView::Iterator &SampledStateTrajView::Iterator::operator++()
+{
+    ++m_index;
+    sample();
+    return *this;
+}
+
+void SampledStateTrajView::Iterator::operator++(int)
+{
+    ++*this;
+}
+
+void SampledStateTrajView::Iterator::sample()
+{
+    if (m_index < m_num_samples) {
+        m_sample_fn(m_index * m_sample_period + m_start_time, m_sample);
+    }
+}
+
+SampledStateTrajView::SampledStateTrajView(MakeSampleFn make_sample_fn,
+                                           const double start_time,
+                                           const double sample_period,
+                                           const int num_samples)
+    : m_make_sample_fn{std::move(make_sample_fn)}
+    , m_start_time{start_time}
+    , m_sample_period{sample_period}
+    , m_num_samples{num_samples}
+{}
+
+SampledStateTrajView::Iterator SampledStateTrajView::begin() const
+{
+    if (m_num_samples <= 0) {
+        return Iterator();
+    }
+    return Iterator(
+        m_make_sample_fn(), m_start_time, m_sample_period, m_num_samples);
+}
+
+std::default_sentinel_t SampledStateTrajView::end() const
+{
+    return std::default_sentinel;
+}
+
+int SampledStateTrajView::size() const
+{
+    return m_num_samples;
+}
+
+DiscreteJointStateTraj SampledStateTrajView::toTraj() const
+{
+    DiscreteJointStateTraj traj;
+    for (const JointState &sample : *this) {
+        traj.push_back(sample);
+    }
+    return traj;
+}
+
+SampledStateTrajView SampledStateTrajView::transform(
+    TransformFn transform_fn) const
+{
+    MakeSampleFn make_sample_fn = [make_sample_fn = m_make_sample_fn,
+                                   transform_fn = std::move(transform_fn)]() {
+        return SampleFn(
+            [sample_fn = make_sample_fn(),
+             transform_fn,
+             sample = JointState{}](const double time,
+                                    JointState &out) mutable {
+                sample_fn(time, sample);
+                transform_fn(sample, out);
+            });
+    };
+    return SampledStateTrajView(std::move(make_sample_fn),
+                                m_start_time,
+                                m_sample_period,
+                                m_num_samples);
+}
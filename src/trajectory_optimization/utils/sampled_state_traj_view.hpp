@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+
+#include "traj_element.hpp"
+
+/*
+ * Lazy view of a sampled state trajectory, eg. from the splines of a
+ * trajectory extractor. The samples at times start_time + i*sample_period are
+ * computed on demand while iterating, into storage of the iterator that is
+ * reused from one sample to the next, so the memory use does not depend on
+ * the duration or the sample rate. Each pass over the view evaluates the
+ * samples again.
+ *
+ *   for (const JointState &sample : extractor.viewSampledStateTraj(dt)) {
+ *       ...
+ *   }
+ */
+class SampledStateTrajView
+    : public std::ranges::view_interface<SampledStateTrajView>
+{
+public:
+    // Writes the sample at a time into sample. The times of the calls are
+    // non-decreasing.
+    using SampleFn = std::function<void(const double time, JointState &sample)>;
+    // Creates the SampleFn of one pass over the trajectory.
+    using MakeSampleFn = std::function<SampleFn()>;
+    // Writes the transformed sample into out, eg. the sample expanded to the
+    // joints of a full model.
+    using TransformFn
+        = std::function<void(const JointState &sample, JointState &out)>;
+
+    // Input iterator, the referenced sample is overwritten on increment.
+    class Iterator
+    {
+    public:
+        using value_type = JointState;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+
+        const JointState &operator*() const;
+        const JointState *operator->() const;
+
+        Iterator &operator++();
+        void operator++(int);
+
+        friend bool operator==(const Iterator &it, std::default_sentinel_t)
+        {
+            return it.m_index >= it.m_num_samples;
+        }
+
+    private:
+        friend class SampledStateTrajView;
+
+        Iterator(SampleFn sample_fn,
+                 const double start_time,
+                 const double sample_period,
+                 const int num_samples);
+
+        // Evaluate the sample at the current index.
+        void sample();
+
+        SampleFn m_sample_fn;
+        double m_start_time{};
+        double m_sample_period{};
+        int m_num_samples{};
+        int m_index{};
+        JointState m_sample{};
+    };
+
+    SampledStateTrajView() = default;
+
+    /*
+     * @param make_sample_fn Called once per pass over the view.
+     * @param num_samples Number of samples, at start_time + i*sample_period.
+     */
+    SampledStateTrajView(MakeSampleFn make_sample_fn,
+                         const double start_time,
+                         const double sample_period,
+                         const int num_samples);
+
+    Iterator begin() const;
+    std::default_sentinel_t end() const;
+    int size() const;
+
+    // Materialize the samples, eg. for consumers of DiscreteJointStateTraj.
+    DiscreteJointStateTraj toTraj() const;
+
+    // Lazy view of the samples transformed by transform_fn, at the same
+    // times. Each pass keeps one sample of this view besides its output.
+    SampledStateTrajView transform(TransformFn transform_fn) const;
+
+private:
+    MakeSampleFn m_make_sample_fn;
+    double m_start_time{};
+    double m_sample_period{};
+    int m_num_samples{};
+};
+
+/*
+ * Creates the SampleFn of a spline of the state [q; dq], eg. a CubicSpline or
+ * QuadraticSpline, where ddq is taken from the time derivative [dq; ddq]. Each
+ * pass has its own cursor over the spline and buffers of the state size, so
+ * no memory is allocated per sample after the first one. The spline is shared
+ * by the passes.
+ */
+template <typename Spline>
+SampledStateTrajView::MakeSampleFn makeStateSampleFn(
+    std::shared_ptr<const Spline> state_spline,
+    const int state_len)
+{
+    using Vector = typename Spline::Vector;
+    return [state_spline, state_len]() -> SampledStateTrajView::SampleFn {
+        const int nv = state_len / 2;
+        return [state_spline,
+                cursor = state_spline->getCursor(),
+                state = Vector(state_len),
+                dstate_dt = Vector(state_len),
+                nv](const double time, JointState &sample) mutable {
+            cursor.getValue(time, state);
+            cursor.getDerivative(time, 1, dstate_dt);
+            sample.time = time;
+            sample.q = state.head(nv);
+            sample.dq = state.tail(nv);
+            sample.ddq = dstate_dt.tail(nv);
+        };
+    };
+}
@@ -0,0 +1,151 @@
+#include "traj_compression.hpp"
+
+#include <ranges>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // Douglas-Peucker over the samples between the first and the last ones.
+    void selectLinearWaypoints(const Eigen::MatrixXd &q,
+                               const Eigen::VectorXd &times,
+                               std::vector<bool> &keep)
+    {
+        // ranges between two waypoints that may need more waypoints, instead
+        // of a recursion whose depth grows with the number of samples
+        std::vector<std::pair<int, int>> ranges{
+            {0, static_cast<int>(q.cols()) - 1}};
+        while (!ranges.empty()) {
+            const auto [first, last] = ranges.back();
+            ranges.pop_back();
+            const int num_inner = last - first - 1;
+            if (num_inner < 1) {
+                continue;
+            }
+
+            // line between the waypoints at the inner sample times, one
+            // sample per column
+            const Eigen::RowVectorXd s
+                = (times.segment(first + 1, num_inner).array() - times(first))
+                  / (times(last) - times(first));
+            const Eigen::MatrixXd line
+                = q.col(first).replicate(1, num_inner)
+                  + (q.col(last) - q.col(first)) * s;
+
+            // largest scaled error over the joints and the samples
+            Eigen::Index worst{};
+            const double max_err
+                = (q.middleCols(first + 1, num_inner) - line)
+                      .cwiseAbs()
+                      .colwise()
+                      .maxCoeff()
+                      .maxCoeff(&worst);
+            if (max_err > 1.0) {
+                const int split = first + 1 + static_cast<int>(worst);
+                keep[split] = true;
+                ranges.emplace_back(first, split);
+                ranges.emplace_back(split, last);
+            }
+        }
+    }
+
+    // Deadband on the difference to the last waypoint.
+    void selectHoldWaypoints(const Eigen::MatrixXd &q, std::vector<bool> &keep)
+    {
+        int last_kept{};
+        for (int i = 1; i < q.cols(); ++i) {
+            const double err
+                = (q.col(i) - q.col(last_kept)).lpNorm<Eigen::Infinity>();
+            if (err > 1.0) {
+                keep[i] = true;
+                last_kept = i;
+            }
+        }
+    }
+
+    // Select the waypoints of a trajectory with more than two samples into
+    // keep, from one pass over the samples.
+    template <typename Traj>
+    void selectWaypoints(const Traj &traj,
+                         const Eigen::VectorXd &tolerance,
+                         const WaypointReconstruction reconstruction,
+                         std::vector<bool> &keep)
+    {
+        // positions scaled by the tolerances, so the error bound is one for
+        // all joints, one sample per column
+        const int num_samples = keep.size();
+        const Eigen::VectorXd inv_tolerance = tolerance.cwiseInverse();
+        Eigen::MatrixXd q(tolerance.size(), num_samples);
+        Eigen::VectorXd times(num_samples);
+        int i{};
+        for (const JointState &e : traj) {
+            if (e.q.size() != tolerance.size()) {
+                std::ostringstream os;
+                os << "compressStateTraj(). sample " << i << " has "
+                   << e.q.size() << " joints, but there are "
+                   << tolerance.size() << " tolerances.";
+                throw std::invalid_argument(os.str());
+            }
+            q.col(i) = e.q.cwiseProduct(inv_tolerance);
+            times(i) = e.time;
+            ++i;
+        }
+
+        keep.front() = true;
+        keep.back() = true;
+        switch (reconstruction) {
+            case WaypointReconstruction::Linear:
+                selectLinearWaypoints(q, times, keep);
+                break;
+            case WaypointReconstruction::Hold:
+                selectHoldWaypoints(q, keep);
+                break;
+        }
+    }
+
+    template <typename Traj>
+    DiscreteJointStateTraj compressSamples(
+        const Traj &traj,
+        const Eigen::VectorXd &tolerance,
+        const WaypointReconstruction reconstruction)
+    {
+        if ((tolerance.array() <= 0.0).any()) {
+            throw std::invalid_argument(
+                "compressStateTraj(). tolerances must be positive.");
+        }
+        const int num_samples = static_cast<int>(std::ranges::size(traj));
+        std::vector<bool> keep(num_samples, true);
+        if (num_samples > 2) {
+            keep.assign(num_samples, false);
+            selectWaypoints(traj, tolerance, reconstruction, keep);
+        }
+
+        // second pass, which copies the waypoints
+        DiscreteJointStateTraj waypoints;
+        int i{};
+        for (const JointState &e : traj) {
+            if (keep[i++]) {
+                waypoints.push_back(e);
+            }
+        }
+        return waypoints;
+    }
+}
+
+DiscreteJointStateTraj compressStateTraj(
+    const DiscreteJointStateTraj &traj,
+    const Eigen::VectorXd &tolerance,
+    const WaypointReconstruction reconstruction)
+{
+    return compressSamples(traj, tolerance, reconstruction);
+}
+
+DiscreteJointStateTraj compressStateTraj(
+    const SampledStateTrajView &traj,
+    const Eigen::VectorXd &tolerance,
+    const WaypointReconstruction reconstruction)
+{
+    return compressSamples(traj, tolerance, reconstruction);
+}
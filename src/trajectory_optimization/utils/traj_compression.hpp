@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include "sampled_state_traj_view.hpp"
+#include "traj_element.hpp"
+
+// How the consumer of a compressed trajectory reconstructs the positions
+// between its waypoints.
+enum class WaypointReconstruction
+{
+    // linear interpolation in time, eg. for storage or a spline executor
+    Linear,
+    // the last waypoint is held until the next one, like the goal positions of
+    // SO101Bus::execute_traj_full() and the controls of the Simulator
+    Hold
+};
+
+/*
+ * Select a small subset of the samples of a state trajectory as waypoints,
+ * such that the reconstruction of the positions at every sample time is
+ * within a per-joint tolerance. The first and the last samples are always
+ * kept, and the waypoints keep their time stamps, velocities and
+ * accelerations, so the result can be sent to an executor that schedules each
+ * waypoint at its own time.
+ *
+ * Linear uses the Douglas-Peucker algorithm in joint space: the sample with
+ * the largest error w.r.t the line between two waypoints becomes a waypoint
+ * until all errors are within the tolerances. Hold keeps a sample when it
+ * differs from the last waypoint by more than the tolerance. The errors are
+ * evaluated for all joints and samples between two waypoints at once.
+ *
+ * @param traj Samples with strictly increasing times.
+ * @param tolerance Positive error bound of each joint.
+ */
+DiscreteJointStateTraj compressStateTraj(
+    const DiscreteJointStateTraj &traj,
+    const Eigen::VectorXd &tolerance,
+    const WaypointReconstruction reconstruction);
+
+/*
+ * Same as above for a lazy view, eg. of the splines of an extractor. The view
+ * is iterated twice, and only the scaled positions and the waypoints are
+ * stored, not the samples.
+ */
+DiscreteJointStateTraj compressStateTraj(
+    const SampledStateTrajView &traj,
+    const Eigen::VectorXd &tolerance,
+    const WaypointReconstruction reconstruction);
@@ -0,0 +1,43 @@
+#include "trajectory_bounds.hpp"
+
+#include <cassert>
+
+ifopt::Component::VecBound createStateBounds(
+    const int num_state_vars,
+    const ifopt::Component::VecBound &path_bounds,
+    const Eigen::VectorXd &state_start,
+    const Eigen::VectorXd &state_end)
+{
+    const int state_len = static_cast<int>(path_bounds.size());
+    assert(state_start.size() == state_len);
+    assert(state_end.size() == state_len);
+    assert(num_state_vars % state_len == 0);
+
+    ifopt::Component::VecBound bounds;
+    bounds.reserve(num_state_vars);
+    const int num_state_vecs = num_state_vars / state_len;
+    for (int i{}; i < num_state_vecs; ++i) {
+        if (i == 0) {
+            // initial state bounds
+            for (int j{}; j < state_len; ++j) {
+                bounds.push_back({state_start(j), state_start(j)});
+            }
+        } else if (i == num_state_vecs - 1) {
+            // final state bounds
+            for (int j{}; j < state_len; ++j) {
+                bounds.push_back({state_end(j), state_end(j)});
+            }
+        } else {
+            bounds.insert(bounds.end(), path_bounds.begin(), path_bounds.end());
+        }
+    }
+    assert(static_cast<int>(bounds.size()) == num_state_vars);
+    return bounds;
+}
+
+ifopt::Component::VecBound createControlBounds(const int num_control_vars,
+                                               const double max_force)
+{
+    return ifopt::Component::VecBound(num_control_vars,
+                                      {-max_force, max_force});
+}
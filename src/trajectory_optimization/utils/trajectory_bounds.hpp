@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ifopt/composite.h>
+
+/*
+ * Create an upper and lower bound for each state vector along the trajectory.
+ * The first and the last states are fixed to the start and end states, and
+ * the states in between are within the path bounds.
+ *
+ * @param num_state_vars Number of stacked state variables, a multiple of the
+ *   state size.
+ * @param path_bounds Bounds of each element of the states in between.
+ */
+ifopt::Component::VecBound createStateBounds(
+    const int num_state_vars,
+    const ifopt::Component::VecBound &path_bounds,
+    const Eigen::VectorXd &state_start,
+    const Eigen::VectorXd &state_end);
+
+// Symmetric bound for each control variable.
+ifopt::Component::VecBound createControlBounds(const int num_control_vars,
+                                               const double max_force);
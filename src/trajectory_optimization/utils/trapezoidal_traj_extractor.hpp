@@ -3,62 +3,57 @@
 #include <Eigen/Dense>
 #include <traj_element.hpp>
 
+#include "collocation_traj_extractor.hpp"
 #include "pinocchio/multibody/model.hpp"
 
+template <int Dim>
 class QuadraticSpline;
+template <int Dim>
 class LinearSpline;
 
 // Takes a trapezoidal collocation solution and outputs trajectories with
 // different discretization based on interpolating splines.
 class TrapezoidalTrajExtractor
+    : public CollocationTrajExtractor<TrapezoidalTrajExtractor>
 {
 public:
-    // calback signature for evaluating the dynamics
-    using DynFn = std::function<Eigen::VectorXd(const Eigen::VectorXd &state,
-                                                const Eigen::VectorXd &control,
-                                                const double time,
-                                                const pinocchio::Model &model)>;
-
+    // The solution vectors are viewed, not copied, so they must outlive the
+    // extractor (temporaries do not compile, see SolutionView). The dynamics
+    // at the knot points are evaluated on the threads of the pool, if any
+    // (see CollocationTrajExtractor).
     TrapezoidalTrajExtractor(const double start_time,
                              const double traj_dur,
-                             const Eigen::VectorXd &state_vars,
+                             const SolutionView state_vars,
                              const int state_len,
-                             const Eigen::VectorXd &ctrl_vars,
+                             const SolutionView ctrl_vars,
                              const int ctrl_len,
                              const double dt_segment,
                              const pinocchio::Model &model,
-                             const DynFn &dyn_fn);
-
-    // Get collocation traj. This is equivalent to the NLP solution without any
-    // post processing (no use of splines or interpolation).
-    DiscreteJointStateTraj createCollocationStateTraj(
-        const pinocchio::Model &model);
-    DiscreteJointDataTraj createCollocationCtrlTraj(
-        const pinocchio::Model &model);
+                             const DynFn &dyn_fn,
+                             KnotDynamicsPool *pool = nullptr);
 
-    // Formed by first creating splines from the NLP solution and then
-    // interpolating based on the sample period.
-    DiscreteJointStateTraj createSampledStateTraj(const double sample_period);
-    DiscreteJointDataTraj createSampledCtrlTraj(const double sample_period);
+    // Same as above, but the segments have equal durations derived from the
+    // (eg. optimized) duration of the trajectory.
+    TrapezoidalTrajExtractor(const double start_time,
+                             const double traj_dur,
+                             const SolutionView state_vars,
+                             const int state_len,
+                             const SolutionView ctrl_vars,
+                             const int ctrl_len,
+                             const pinocchio::Model &model,
+                             const DynFn &dyn_fn,
+                             KnotDynamicsPool *pool = nullptr);
 
 private:
-    Eigen::VectorXd createDynVals(const pinocchio::Model &model);
-    QuadraticSpline createStateSpline();
-    LinearSpline createDynSpline();
-
-    DiscreteJointStateTraj createDiscreteJointStateTraj(
-        const double sample_period,
-        const QuadraticSpline &state_spline,
-        const LinearSpline &dstate_dt_spline);
-
-    const double m_start_time;
-    const double m_dur;
-    const Eigen::VectorXd m_state_vars;
-    const int m_state_len;
-    const Eigen::VectorXd m_ctrl_vars;
-    const int m_ctrl_len;
-    const double m_dt_segment;
-    const DynFn m_dyn_fn;
-
-    const Eigen::VectorXd m_dyn_vals;
+    friend class CollocationTrajExtractor<TrapezoidalTrajExtractor>;
+
+    // Interpolants of the scheme, Dim is the state or control size, or
+    // Eigen::Dynamic (see dispatchSplineDim()). The states are quadratic
+    // through the knot states and their dynamics, and the controls linear.
+    template <int Dim>
+    QuadraticSpline<Dim> createStateSpline() const;
+    template <int Dim>
+    LinearSpline<Dim> createCtrlSpline() const;
 };
+
+extern template class CollocationTrajExtractor<TrapezoidalTrajExtractor>;
@@ -0,0 +1,209 @@
+#include "derivative_check.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include <Eigen/Dense>
+
+namespace
+{
+    // A constraint set or cost term, and the first row of its values in the
+    // values of all components.
+    struct ComponentRows
+    {
+        ifopt::Component::Ptr component;
+        int row{};
+    };
+
+    // Constraint sets first, then cost terms, which have one row each.
+    std::vector<ComponentRows> getComponentRows(const ifopt::Problem &nlp)
+    {
+        std::vector<ComponentRows> components;
+        int row{};
+        for (const ifopt::Composite *composite :
+             {&nlp.GetConstraints(), &nlp.GetCosts()}) {
+            for (const ifopt::Component::Ptr &c : composite->GetComponents()) {
+                components.push_back({c, row});
+                row += c->GetRows();
+            }
+        }
+        return components;
+    }
+
+    void evalValues(const std::vector<ComponentRows> &components,
+                    Eigen::Ref<Eigen::VectorXd> values)
+    {
+        for (const ComponentRows &c : components) {
+            values.segment(c.row, c.component->GetRows())
+                = c.component->GetValues();
+        }
+    }
+
+    int getNumThreads(const int num_threads)
+    {
+        if (num_threads > 0) {
+            return num_threads;
+        }
+        const int hw_threads
+            = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, hw_threads);
+    }
+}
+
+std::vector<BlockDerivativeError> checkDerivatives(
+    const ProblemBuilder &build_problem,
+    const DerivativeCheckOptions &options)
+{
+    const int num_points = options.num_points;
+    const int num_threads = getNumThreads(options.num_threads);
+    // one problem per thread, built here so the builder does not have to be
+    // thread safe
+    std::vector<std::unique_ptr<ifopt::Problem>> problems;
+    for (int t{}; t < num_threads; ++t) {
+        problems.push_back(std::make_unique<ifopt::Problem>());
+        build_problem(*problems.back());
+    }
+    ifopt::Problem &nlp = *problems.front();
+    const std::vector<ComponentRows> components = getComponentRows(nlp);
+    const int num_rows
+        = components.empty() ? 0
+                             : components.back().row
+                                   + components.back().component->GetRows();
+    const int num_vars = nlp.GetNumberOfOptimizationVariables();
+
+    // random points around the initial values
+    const Eigen::VectorXd x_init = nlp.GetVariableValues();
+    std::mt19937 gen(options.seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Eigen::MatrixXd points(num_vars, num_points);
+    for (int p{}; p < num_points; ++p) {
+        for (int i{}; i < num_vars; ++i) {
+            const double scale = std::max(1.0, std::abs(x_init(i)));
+            points(i, p)
+                = x_init(i) + options.perturbation * scale * dist(gen);
+        }
+    }
+
+    // Central differences of the values of all components. Each thread
+    // writes its own columns of the jacobians.
+    std::vector<Eigen::MatrixXd> fd_jacs(num_points,
+                                         Eigen::MatrixXd(num_rows, num_vars));
+    const auto eval_columns = [&](const int thread_idx) {
+        ifopt::Problem &thread_nlp = *problems[thread_idx];
+        const std::vector<ComponentRows> thread_components
+            = getComponentRows(thread_nlp);
+        Eigen::VectorXd values_plus(num_rows);
+        Eigen::VectorXd values_minus(num_rows);
+        for (int p{}; p < num_points; ++p) {
+            Eigen::VectorXd x = points.col(p);
+            for (int i = thread_idx; i < num_vars; i += num_threads) {
+                const double x0 = x(i);
+                const double step
+                    = options.rel_step * std::max(1.0, std::abs(x0));
+                x(i) = x0 + step;
+                thread_nlp.SetVariables(x.data());
+                evalValues(thread_components, values_plus);
+                x(i) = x0 - step;
+                thread_nlp.SetVariables(x.data());
+                evalValues(thread_components, values_minus);
+                x(i) = x0;
+                fd_jacs[p].col(i) = (values_plus - values_minus) / (2.0 * step);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(eval_columns, t);
+    }
+    eval_columns(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    // first column of each variable set
+    const ifopt::Composite::ComponentVec var_sets
+        = nlp.GetOptVariables()->GetComponents();
+    std::vector<int> var_cols;
+    int col{};
+    for (const ifopt::Component::Ptr &v : var_sets) {
+        var_cols.push_back(col);
+        col += v->GetRows();
+    }
+
+    // compare with the analytic jacobians, block by block
+    std::vector<BlockDerivativeError> errors;
+    for (const ComponentRows &c : components) {
+        for (const ifopt::Component::Ptr &v : var_sets) {
+            errors.push_back({.component = c.component->GetName(),
+                              .var_set = v->GetName()});
+        }
+    }
+    for (int p{}; p < num_points; ++p) {
+        nlp.SetVariables(points.col(p).data());
+        for (std::size_t k{}; k < components.size(); ++k) {
+            const ComponentRows &c = components[k];
+            const int rows = c.component->GetRows();
+            const Eigen::MatrixXd analytic_jac(c.component->GetJacobian());
+            for (std::size_t s{}; s < var_sets.size(); ++s) {
+                const int cols = var_sets[s]->GetRows();
+                const auto analytic
+                    = analytic_jac.middleCols(var_cols[s], cols);
+                const auto fd
+                    = fd_jacs[p].block(c.row, var_cols[s], rows, cols);
+                const Eigen::MatrixXd rel_errors
+                    = (analytic - fd).cwiseAbs().cwiseQuotient(
+                        fd.cwiseAbs().cwiseMax(1.0));
+                Eigen::Index row{};
+                Eigen::Index col{};
+                const double rel_error = rel_errors.maxCoeff(&row, &col);
+                BlockDerivativeError &e = errors[k * var_sets.size() + s];
+                if ((p == 0) || (rel_error > e.rel_error)) {
+                    e.rel_error = rel_error;
+                    e.abs_error = std::abs(analytic(row, col) - fd(row, col));
+                    e.point = p;
+                    e.row = row;
+                    e.col = col;
+                    e.analytic = analytic(row, col);
+                    e.finite_diff = fd(row, col);
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+void printDerivativeErrors(std::ostream &os,
+                           std::vector<BlockDerivativeError> errors)
+{
+    std::stable_sort(errors.begin(),
+                     errors.end(),
+                     [](const BlockDerivativeError &a,
+                        const BlockDerivativeError &b) {
+                         return a.rel_error > b.rel_error;
+                     });
+    const std::ios_base::fmtflags flags = os.flags();
+    os << std::scientific << std::setprecision(3);
+    for (const BlockDerivativeError &e : errors) {
+        os << e.component << " w.r.t " << e.var_set
+           << ": rel error " << e.rel_error << ", abs error " << e.abs_error
+           << " at (" << e.row << ", " << e.col << ") of point " << e.point
+           << ", analytic " << e.analytic << ", finite diff "
+           << e.finite_diff << std::endl;
+    }
+    os.flags(flags);
+}
+
+bool derivativesWithinTolerance(const std::vector<BlockDerivativeError> &errors,
+                                const double tol)
+{
+    return std::all_of(errors.cbegin(),
+                       errors.cend(),
+                       [tol](const BlockDerivativeError &e) {
+                           return e.rel_error <= tol;
+                       });
+}
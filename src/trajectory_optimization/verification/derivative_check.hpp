@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <ifopt/problem.h>
+
+struct DerivativeCheckOptions
+{
+    // number of random points at which the derivatives are checked
+    int num_points{3};
+    // Each point offsets variable i from its initial value by a uniform
+    // random value in +-perturbation*max(1, |x_i|).
+    double perturbation{0.1};
+    // finite difference step of variable i, relative to max(1, |x_i|)
+    double rel_step{1e-6};
+    // number of threads, or zero for the number of hardware threads
+    int num_threads{0};
+    unsigned int seed{1};
+};
+
+// Worst entry of a block of the jacobian of one constraint set or cost term
+// w.r.t one variable set, over all points of the check.
+struct BlockDerivativeError
+{
+    std::string component;
+    std::string var_set;
+    // |analytic - finite_diff| / max(1, |finite_diff|) of the worst entry
+    double rel_error{};
+    double abs_error{};
+    int point{};
+    int row{};
+    int col{};
+    double analytic{};
+    double finite_diff{};
+};
+
+// Adds the variable sets, constraint sets and cost terms to an empty problem.
+using ProblemBuilder = std::function<void(ifopt::Problem &nlp)>;
+
+/*
+ * Compare the jacobians of all constraint sets and cost terms of a problem
+ * with central finite differences at random points around the initial values
+ * of the variables. It replaces IPOPT's derivative_test, which would add the
+ * finite differences to every solve.
+ *
+ * The columns of the finite differences are split between threads. The
+ * components are not thread safe, so each thread evaluates its own problem
+ * from the builder, which must give the same problem on every call.
+ *
+ * @return One entry per block of the jacobians, in the order of the
+ *   components and variable sets.
+ */
+std::vector<BlockDerivativeError> checkDerivatives(
+    const ProblemBuilder &build_problem,
+    const DerivativeCheckOptions &options = {});
+
+// Print one line per block, with the worst blocks first.
+void printDerivativeErrors(std::ostream &os,
+                           std::vector<BlockDerivativeError> errors);
+
+// True if the relative error of every block is at most tol.
+bool derivativesWithinTolerance(const std::vector<BlockDerivativeError> &errors,
+                                const double tol);